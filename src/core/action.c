@@ -61,6 +61,7 @@
 #include "switch.h"
 #include "events.h"
 #include "cfg/cfg_struct.h"
+#include "cfg_prof.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -1580,6 +1581,7 @@ int run_actions(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 	struct timeval tvb = {0}, tve = {0};
 	struct timezone tz;
 	unsigned int tdiff;
+	int prof;
 
 	ret = E_UNSPEC;
 	h->rec_lev++;
@@ -1597,6 +1599,7 @@ int run_actions(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 		if(unlikely(setjmp(h->jmp_env))) {
 			h->rec_lev = 0;
 			ret = h->last_retcode;
+			ksr_cfgprof_unwind(h);
 			goto end;
 		}
 #endif
@@ -1617,7 +1620,11 @@ int run_actions(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 		if(unlikely(log_prefix_mode == 1)) {
 			log_prefix_set(msg);
 		}
+		prof = (ksr_cfgprof_enabled()) ? ksr_cfgprof_start(h, t) : 0;
 		ret = do_action(h, t, msg);
+		if(unlikely(prof)) {
+			ksr_cfgprof_end();
+		}
 		_cfg_crt_action = 0;
 		if(unlikely(log_prefix_mode == 1)) {
 			log_prefix_set(msg);
@@ -66,6 +66,9 @@
 #include "sr_compat.h"
 #include "msg_translator.h"
 #include "async_task.h"
+#include "overload_ctl.h"
+#include "rcv_stats.h"
+#include "cfg_prof.h"
 
 #include "kemi.h"
 #include "ppcfg.h"
@@ -231,6 +234,7 @@ extern char *default_routename;
 %token DROP
 %token RETURN
 %token RETURN_MODE
+%token EXPR_BYTECODE
 %token BREAK
 %token LOG_TOK
 %token ERROR
@@ -541,6 +545,11 @@ extern char *default_routename;
 %token EVENT_ROUTE_CALLBACK
 %token RECEIVED_ROUTE_CALLBACK
 %token RECEIVED_ROUTE_MODE
+%token OVERLOAD_CONTROL
+%token OVERLOAD_TARGET
+%token OVERLOAD_VALIDITY
+%token RECEIVE_STATS
+%token CFG_PROFILER
 %token PRE_ROUTING_CALLBACK
 %token MAX_RECURSIVE_LEVEL
 %token MAX_BRANCHES_PARAM
@@ -2050,6 +2059,8 @@ assign_stm:
 	| SERVER_ID EQUAL error  { yyerror("number expected"); }
     | RETURN_MODE EQUAL NUMBER { ksr_return_mode=$3; }
 	| RETURN_MODE EQUAL error  { yyerror("number expected"); }
+    | EXPR_BYTECODE EQUAL NUMBER { ksr_expr_bytecode=$3; }
+	| EXPR_BYTECODE EQUAL error  { yyerror("number expected"); }
 	| KEMI DOT REQUEST_ROUTE_CALLBACK EQUAL STRING {
 			kemi_request_route_callback.s = $5;
 			kemi_request_route_callback.len = strlen($5);
@@ -2110,6 +2121,16 @@ assign_stm:
 	| KEMI DOT PRE_ROUTING_CALLBACK EQUAL error { yyerror("string expected"); }
     | RECEIVED_ROUTE_MODE EQUAL intno { ksr_evrt_received_mode=$3; }
 	| RECEIVED_ROUTE_MODE EQUAL error  { yyerror("number  expected"); }
+	| OVERLOAD_CONTROL EQUAL intno { ksr_ovl_mode=$3; }
+	| OVERLOAD_CONTROL EQUAL error  { yyerror("number  expected"); }
+	| OVERLOAD_TARGET EQUAL NUMBER { ksr_ovl_target=$3; }
+	| OVERLOAD_TARGET EQUAL error  { yyerror("number  expected"); }
+	| OVERLOAD_VALIDITY EQUAL NUMBER { ksr_ovl_validity=$3; }
+	| OVERLOAD_VALIDITY EQUAL error  { yyerror("number  expected"); }
+	| RECEIVE_STATS EQUAL intno { ksr_rcv_stats_mode=$3; }
+	| RECEIVE_STATS EQUAL error  { yyerror("number  expected"); }
+	| CFG_PROFILER EQUAL NUMBER { ksr_cfgprof_rate=$3; }
+	| CFG_PROFILER EQUAL error  { yyerror("number  expected"); }
     | MAX_RECURSIVE_LEVEL EQUAL NUMBER { set_max_recursive_level($3); }
     | MAX_BRANCHES_PARAM EQUAL NUMBER { sr_dst_max_branches = $3; }
     | LATENCY_LOG EQUAL intno { default_core_cfg.latency_log=$3; }
@@ -0,0 +1,570 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: sampling profiler for the native config interpreter.
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ *
+ * When enabled, one out of N top level actions executed by run_actions()
+ * is profiled together with all the actions nested inside it (blocks,
+ * sub-routes, event routes executed by module functions). Each executed
+ * action is accounted with its own (self) time to the stack of actions
+ * that led to it, in a shared memory table. The actions are identified
+ * by their address, which is the same in all processes because they are
+ * created while parsing the config, before forking.
+ *
+ * The table can be printed per config file position or in the folded
+ * format used by flamegraph tools.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "cfg_prof.h"
+#include "sr_module.h"
+#include "locking.h"
+#include "hashes.h"
+#include "dprint.h"
+#include "mem/shm_mem.h"
+#include "mem/mem.h"
+
+#define KSR_CFGPROF_SIZE 1024		/**< hash table slots */
+#define KSR_CFGPROF_MAX_ITEMS 16384 /**< max number of profiled stacks */
+#define KSR_CFGPROF_FRAME_SIZE 128	/**< max size of a printed frame */
+
+typedef struct ksr_cfgprof_item
+{
+	unsigned int hid;
+	int depth;
+	unsigned long calls;
+	unsigned long long time_ns; /* self time */
+	struct ksr_cfgprof_item *next;
+	struct action *stack[1];
+} ksr_cfgprof_item_t;
+
+struct ksr_cfgprof_state
+{
+	gen_lock_t lock;
+	int rate;
+	int items;
+	unsigned long dropped;
+	ksr_cfgprof_item_t *slots[KSR_CFGPROF_SIZE];
+};
+
+typedef struct ksr_cfgprof_frame
+{
+	struct action *a;
+	void *ctx;
+	int sampled;
+	struct timespec tb;
+	unsigned long long child; /* time of nested actions */
+} ksr_cfgprof_frame_t;
+
+int ksr_cfgprof_rate = 0;
+int *_ksr_cfgprof_rate = NULL;
+
+static ksr_cfgprof_state_t *_ksr_cfgprof_state = NULL;
+
+/* per process stack of actions in execution */
+static ksr_cfgprof_frame_t _ksr_cfgprof_stack[KSR_CFGPROF_DEPTH];
+static int _ksr_cfgprof_depth = 0;
+static unsigned int _ksr_cfgprof_cnt = 0;
+
+/**
+ *
+ */
+int ksr_cfgprof_init(void)
+{
+	if(ksr_cfgprof_rate < 0) {
+		LM_ERR("invalid cfg profiler sampling rate: %d\n", ksr_cfgprof_rate);
+		return -1;
+	}
+	_ksr_cfgprof_state =
+			(ksr_cfgprof_state_t *)shm_malloc(sizeof(ksr_cfgprof_state_t));
+	if(_ksr_cfgprof_state == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_ksr_cfgprof_state, 0, sizeof(ksr_cfgprof_state_t));
+	if(lock_init(&_ksr_cfgprof_state->lock) == 0) {
+		LM_ERR("failed to init the lock\n");
+		shm_free(_ksr_cfgprof_state);
+		_ksr_cfgprof_state = NULL;
+		return -1;
+	}
+	_ksr_cfgprof_state->rate = ksr_cfgprof_rate;
+	_ksr_cfgprof_rate = &_ksr_cfgprof_state->rate;
+	return 0;
+}
+
+/**
+ * free the profiled stacks - lock must be held
+ */
+static void ksr_cfgprof_clean(void)
+{
+	ksr_cfgprof_item_t *it;
+	ksr_cfgprof_item_t *it0;
+	int i;
+
+	for(i = 0; i < KSR_CFGPROF_SIZE; i++) {
+		it = _ksr_cfgprof_state->slots[i];
+		while(it != NULL) {
+			it0 = it;
+			it = it->next;
+			shm_free(it0);
+		}
+		_ksr_cfgprof_state->slots[i] = NULL;
+	}
+	_ksr_cfgprof_state->items = 0;
+	_ksr_cfgprof_state->dropped = 0;
+}
+
+/**
+ *
+ */
+void ksr_cfgprof_destroy(void)
+{
+	_ksr_cfgprof_rate = NULL;
+	if(_ksr_cfgprof_state != NULL) {
+		ksr_cfgprof_clean();
+		lock_destroy(&_ksr_cfgprof_state->lock);
+		shm_free(_ksr_cfgprof_state);
+		_ksr_cfgprof_state = NULL;
+	}
+}
+
+/**
+ * account the self time of the stack with the top at depth
+ */
+static void ksr_cfgprof_record(int depth, unsigned long long tns)
+{
+	ksr_cfgprof_item_t *it;
+	unsigned int hid;
+	int i;
+
+	hid = 0;
+	for(i = 0; i <= depth; i++) {
+		hid = hid * 31 + (unsigned int)((unsigned long)_ksr_cfgprof_stack[i].a
+										 >> 3);
+	}
+
+	lock_get(&_ksr_cfgprof_state->lock);
+	for(it = _ksr_cfgprof_state->slots[hid & (KSR_CFGPROF_SIZE - 1)];
+			it != NULL; it = it->next) {
+		if(it->hid != hid || it->depth != depth) {
+			continue;
+		}
+		for(i = depth; i >= 0; i--) {
+			if(it->stack[i] != _ksr_cfgprof_stack[i].a) {
+				break;
+			}
+		}
+		if(i < 0) {
+			break;
+		}
+	}
+	if(it == NULL) {
+		if(_ksr_cfgprof_state->items >= KSR_CFGPROF_MAX_ITEMS) {
+			_ksr_cfgprof_state->dropped++;
+			lock_release(&_ksr_cfgprof_state->lock);
+			return;
+		}
+		it = (ksr_cfgprof_item_t *)shm_malloc(sizeof(ksr_cfgprof_item_t)
+											  + depth * sizeof(struct action *));
+		if(it == NULL) {
+			lock_release(&_ksr_cfgprof_state->lock);
+			SHM_MEM_ERROR;
+			return;
+		}
+		memset(it, 0, sizeof(ksr_cfgprof_item_t));
+		it->hid = hid;
+		it->depth = depth;
+		for(i = 0; i <= depth; i++) {
+			it->stack[i] = _ksr_cfgprof_stack[i].a;
+		}
+		it->next = _ksr_cfgprof_state->slots[hid & (KSR_CFGPROF_SIZE - 1)];
+		_ksr_cfgprof_state->slots[hid & (KSR_CFGPROF_SIZE - 1)] = it;
+		_ksr_cfgprof_state->items++;
+	}
+	it->calls++;
+	it->time_ns += tns;
+	lock_release(&_ksr_cfgprof_state->lock);
+}
+
+/**
+ * action a is going to be executed
+ * - return 1 if ksr_cfgprof_end() has to be called after it, 0 otherwise
+ */
+int ksr_cfgprof_start(void *ctx, struct action *a)
+{
+	ksr_cfgprof_frame_t *f;
+	int rate;
+
+	if(_ksr_cfgprof_depth == 0) {
+		/* read once, the rpc command can disable it meanwhile */
+		rate = *_ksr_cfgprof_rate;
+		if(rate <= 0) {
+			return 0;
+		}
+		f = &_ksr_cfgprof_stack[0];
+		f->sampled = (++_ksr_cfgprof_cnt % rate == 0) ? 1 : 0;
+	} else {
+		if(_ksr_cfgprof_stack[0].sampled == 0
+				|| _ksr_cfgprof_depth >= KSR_CFGPROF_DEPTH) {
+			return 0;
+		}
+		f = &_ksr_cfgprof_stack[_ksr_cfgprof_depth];
+		f->sampled = 1;
+	}
+	f->a = a;
+	f->ctx = ctx;
+	f->child = 0;
+	if(f->sampled) {
+		clock_gettime(CLOCK_MONOTONIC, &f->tb);
+	}
+	_ksr_cfgprof_depth++;
+	return 1;
+}
+
+/**
+ * the last started action was executed
+ */
+void ksr_cfgprof_end(void)
+{
+	ksr_cfgprof_frame_t *f;
+	struct timespec te;
+	unsigned long long d;
+
+	if(_ksr_cfgprof_depth <= 0) {
+		return;
+	}
+	_ksr_cfgprof_depth--;
+	f = &_ksr_cfgprof_stack[_ksr_cfgprof_depth];
+	if(f->sampled == 0 || _ksr_cfgprof_state == NULL) {
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &te);
+	d = (unsigned long long)(te.tv_sec - f->tb.tv_sec) * 1000000000ULL
+		+ te.tv_nsec - f->tb.tv_nsec;
+	if(_ksr_cfgprof_depth > 0) {
+		_ksr_cfgprof_stack[_ksr_cfgprof_depth - 1].child += d;
+	}
+	ksr_cfgprof_record(_ksr_cfgprof_depth, (d > f->child) ? d - f->child : 0);
+}
+
+/**
+ * end the actions of the context left by a longjmp (e.g., exit)
+ */
+void ksr_cfgprof_unwind(void *ctx)
+{
+	while(_ksr_cfgprof_depth > 0
+			&& _ksr_cfgprof_stack[_ksr_cfgprof_depth - 1].ctx == ctx) {
+		ksr_cfgprof_end();
+	}
+}
+
+/**
+ * name of the action - module function name or a core statement
+ */
+static const char *ksr_cfgprof_action_name(struct action *a)
+{
+	if(is_mod_func(a)) {
+		return ((cmd_export_t *)(a->val[0].u.data))->name;
+	}
+	switch(a->type) {
+		case IF_T:
+			return "if";
+		case SWITCH_T:
+		case SWITCH_JT_T:
+		case SWITCH_COND_T:
+		case MATCH_COND_T:
+			return "switch";
+		case WHILE_T:
+			return "while";
+		case BLOCK_T:
+			return "block";
+		case ROUTE_T:
+			return "route";
+		case ASSIGN_T:
+		case ADD_T:
+			return "assign";
+		case DROP_T:
+			return "drop";
+		case FORWARD_T:
+		case FORWARD_TCP_T:
+		case FORWARD_UDP_T:
+		case FORWARD_TLS_T:
+		case FORWARD_SCTP_T:
+			return "forward";
+		case LOG_T:
+			return "log";
+		default:
+			return "core";
+	}
+}
+
+static int ksr_cfgprof_frame_print(struct action *a, char *buf, int len)
+{
+	int n;
+
+	n = snprintf(buf, len, "%s@%s:%d", ksr_cfgprof_action_name(a),
+			(a->cfile) ? a->cfile : "", a->cline);
+	if(n < 0 || n >= len) {
+		return -1;
+	}
+	return n;
+}
+
+/**
+ *
+ */
+void ksr_cfgprof_rpc_enable(rpc_t *rpc, void *ctx)
+{
+	int rate = 100;
+
+	if(_ksr_cfgprof_rate == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	if(rpc->scan(ctx, "*d", &rate) == 1 && rate <= 0) {
+		rpc->fault(ctx, 500, "Invalid sampling rate");
+		return;
+	}
+	*_ksr_cfgprof_rate = rate;
+	rpc->add(ctx, "d", rate);
+}
+
+/**
+ *
+ */
+void ksr_cfgprof_rpc_disable(rpc_t *rpc, void *ctx)
+{
+	if(_ksr_cfgprof_rate == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	*_ksr_cfgprof_rate = 0;
+}
+
+/**
+ *
+ */
+void ksr_cfgprof_rpc_reset(rpc_t *rpc, void *ctx)
+{
+	if(_ksr_cfgprof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	lock_get(&_ksr_cfgprof_state->lock);
+	ksr_cfgprof_clean();
+	lock_release(&_ksr_cfgprof_state->lock);
+}
+
+/**
+ * copy the profiled stacks to a pkg buffer, to be printed without holding
+ * the lock - the copies are linked by next, free the first with pkg_free()
+ */
+static int ksr_cfgprof_snapshot(ksr_cfgprof_item_t **list, int *rate,
+		int *items, unsigned long *dropped)
+{
+	ksr_cfgprof_item_t *it;
+	ksr_cfgprof_item_t *cp;
+	ksr_cfgprof_item_t **last;
+	char *p;
+	size_t size;
+	size_t isize;
+	int i;
+
+	*list = NULL;
+	lock_get(&_ksr_cfgprof_state->lock);
+	*rate = _ksr_cfgprof_state->rate;
+	*items = _ksr_cfgprof_state->items;
+	*dropped = _ksr_cfgprof_state->dropped;
+	size = 0;
+	for(i = 0; i < KSR_CFGPROF_SIZE; i++) {
+		for(it = _ksr_cfgprof_state->slots[i]; it != NULL; it = it->next) {
+			size += sizeof(ksr_cfgprof_item_t)
+					+ it->depth * sizeof(struct action *);
+		}
+	}
+	if(size == 0) {
+		lock_release(&_ksr_cfgprof_state->lock);
+		return 0;
+	}
+	p = (char *)pkg_malloc(size);
+	if(p == NULL) {
+		lock_release(&_ksr_cfgprof_state->lock);
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	last = list;
+	for(i = 0; i < KSR_CFGPROF_SIZE; i++) {
+		for(it = _ksr_cfgprof_state->slots[i]; it != NULL; it = it->next) {
+			isize = sizeof(ksr_cfgprof_item_t)
+					+ it->depth * sizeof(struct action *);
+			cp = (ksr_cfgprof_item_t *)p;
+			memcpy(cp, it, isize);
+			cp->next = NULL;
+			*last = cp;
+			last = &cp->next;
+			p += isize;
+		}
+	}
+	lock_release(&_ksr_cfgprof_state->lock);
+	return 0;
+}
+
+/**
+ * list the profiled actions per config position
+ */
+void ksr_cfgprof_rpc_list(rpc_t *rpc, void *ctx)
+{
+	ksr_cfgprof_item_t *list;
+	ksr_cfgprof_item_t *it;
+	struct action *a;
+	unsigned long dropped;
+	void *th;
+	void *ih;
+	int rate;
+	int items;
+
+	if(_ksr_cfgprof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	if(ksr_cfgprof_snapshot(&list, &rate, &items, &dropped) < 0) {
+		rpc->fault(ctx, 500, "No more memory");
+		return;
+	}
+	if(rpc->add(ctx, "{", &th) < 0) {
+		rpc->fault(ctx, 500, "Internal error creating rpc");
+		goto done;
+	}
+	rpc->struct_add(
+			th, "ddj", "rate", rate, "items", items, "dropped", dropped);
+	for(it = list; it != NULL; it = it->next) {
+		a = it->stack[it->depth];
+		if(rpc->struct_add(th, "{", "action", &ih) < 0) {
+			rpc->fault(ctx, 500, "Internal error creating rpc");
+			goto done;
+		}
+		rpc->struct_add(ih, "sssddjj", "name", ksr_cfgprof_action_name(a),
+				"route", (a->rname) ? a->rname : "", "file",
+				(a->cfile) ? a->cfile : "", "line", a->cline, "depth",
+				it->depth, "calls", it->calls, "time_us",
+				(unsigned long)(it->time_ns / 1000));
+	}
+
+done:
+	if(list != NULL) {
+		pkg_free(list);
+	}
+}
+
+/**
+ * print the profiled stacks in folded format (frame;frame;... value)
+ * - optional parameter: "time" (default, value in usec) or "calls"
+ */
+void ksr_cfgprof_rpc_flamegraph(rpc_t *rpc, void *ctx)
+{
+	ksr_cfgprof_item_t *list;
+	ksr_cfgprof_item_t *it;
+	struct action *a;
+	str mode = STR_NULL;
+	unsigned long dropped;
+	char *buf;
+	int blen;
+	int len;
+	int n;
+	int j;
+	int rate;
+	int items;
+	int calls = 0;
+
+	if(_ksr_cfgprof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	if(rpc->scan(ctx, "*S", &mode) == 1 && mode.len > 0) {
+		if(mode.len == 5 && strncmp(mode.s, "calls", 5) == 0) {
+			calls = 1;
+		} else if(mode.len != 4 || strncmp(mode.s, "time", 4) != 0) {
+			rpc->fault(ctx, 500, "Invalid mode (use time or calls)");
+			return;
+		}
+	}
+	blen = (KSR_CFGPROF_DEPTH * 2 + 1) * KSR_CFGPROF_FRAME_SIZE;
+	buf = (char *)pkg_malloc(blen);
+	if(buf == NULL) {
+		PKG_MEM_ERROR;
+		rpc->fault(ctx, 500, "No more memory");
+		return;
+	}
+	if(ksr_cfgprof_snapshot(&list, &rate, &items, &dropped) < 0) {
+		pkg_free(buf);
+		rpc->fault(ctx, 500, "No more memory");
+		return;
+	}
+	for(it = list; it != NULL; it = it->next) {
+		len = 0;
+		for(j = 0; j <= it->depth; j++) {
+			a = it->stack[j];
+			/* new frame for each entered route block */
+			if(a->rname != NULL
+					&& (j == 0 || it->stack[j - 1]->rname == NULL
+							|| strcmp(it->stack[j - 1]->rname, a->rname)
+									   != 0)) {
+				n = snprintf(buf + len, blen - len, "route[%s];", a->rname);
+				if(n < 0 || n >= blen - len) {
+					break;
+				}
+				len += n;
+			}
+			n = ksr_cfgprof_frame_print(a, buf + len, blen - len);
+			if(n < 0) {
+				break;
+			}
+			len += n;
+			if(j < it->depth) {
+				buf[len++] = ';';
+			}
+		}
+		if(j <= it->depth) {
+			continue;
+		}
+		n = snprintf(buf + len, blen - len, " %llu",
+				(calls) ? (unsigned long long)it->calls : it->time_ns / 1000);
+		if(n < 0 || n >= blen - len) {
+			continue;
+		}
+		len += n;
+		if(rpc->add(ctx, "s", buf) < 0) {
+			break;
+		}
+	}
+	if(list != NULL) {
+		pkg_free(list);
+	}
+	pkg_free(buf);
+}
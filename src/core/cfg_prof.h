@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: sampling profiler for the native config interpreter.
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#ifndef _cfg_prof_h_
+#define _cfg_prof_h_
+
+#include "route_struct.h"
+#include "compiler_opt.h"
+#include "rpc.h"
+
+#define KSR_CFGPROF_DEPTH 32 /**< max depth of profiled nested actions */
+
+typedef struct ksr_cfgprof_state ksr_cfgprof_state_t;
+
+/** sampling rate set in config (0 - disabled) */
+extern int ksr_cfgprof_rate;
+/** shm sampling rate - 1 out of N top level actions is profiled */
+extern int *_ksr_cfgprof_rate;
+
+int ksr_cfgprof_init(void);
+void ksr_cfgprof_destroy(void);
+
+int ksr_cfgprof_start(void *ctx, struct action *a);
+void ksr_cfgprof_end(void);
+void ksr_cfgprof_unwind(void *ctx);
+
+#define ksr_cfgprof_enabled() \
+	(unlikely(_ksr_cfgprof_rate != NULL && *_ksr_cfgprof_rate > 0))
+
+void ksr_cfgprof_rpc_enable(rpc_t *rpc, void *ctx);
+void ksr_cfgprof_rpc_disable(rpc_t *rpc, void *ctx);
+void ksr_cfgprof_rpc_reset(rpc_t *rpc, void *ctx);
+void ksr_cfgprof_rpc_list(rpc_t *rpc, void *ctx);
+void ksr_cfgprof_rpc_flamegraph(rpc_t *rpc, void *ctx);
+
+#endif
@@ -47,6 +47,10 @@
 #include "tcp_options.h"
 #include "cfg_core.h"
 #include "ppcfg.h"
+#include "overload_ctl.h"
+#include "rcv_stats.h"
+#include "cfg_prof.h"
+#include "kemi_prof.h"
 #include "sr_module.h"
 
 #ifdef USE_DNS_CACHE
@@ -590,6 +594,116 @@ static void core_shmmem(rpc_t *rpc, void *c)
 			mi.total_frags);
 }
 
+static void core_overload(rpc_t *rpc, void *c)
+{
+	void *handle;
+	int load, busy, udpq, reduction, dsts;
+	unsigned int seq;
+
+	if(ksr_ovl_mode == 0) {
+		rpc->fault(c, 500, "Overload control not enabled");
+		return;
+	}
+	ksr_ovl_get_info(&load, &busy, &udpq, &reduction, &seq, &dsts);
+	rpc->add(c, "{", &handle);
+	rpc->struct_add(handle, "dddddud", "target", ksr_ovl_target, "load",
+			load, "busy", busy, "udp_queue", udpq, "oc", reduction, "oc_seq",
+			seq, "overloaded_destinations", dsts);
+}
+
+static const char *core_overload_doc[] = {
+		"Returns the overload control state: measured load (percents),"
+		" advertised oc value and number of overloaded next hops.",
+		0 /* Method signature(s) */
+};
+
+static void core_rcv_stats(rpc_t *rpc, void *c)
+{
+	void *handle;
+	void *bhandle;
+	ksr_rcv_stats_info_t info;
+	char bname[24];
+	int p, i;
+
+	if(ksr_rcv_stats_mode == 0) {
+		rpc->fault(c, 500, "Receive statistics not enabled");
+		return;
+	}
+	for(p = 0; p < *process_count; p++) {
+		if(ksr_rcv_stats_get(p, &info) < 0 || info.msgs == 0) {
+			continue;
+		}
+		rpc->add(c, "{", &handle);
+		rpc->struct_add(handle, "ddsjjjjj", "index", p, "pid", pt[p].pid,
+				"description", pt[p].desc, "msgs", info.msgs, "busy_us",
+				info.busy_us, "route_us", info.route_us, "queue_msgs",
+				info.queue_msgs, "queue_us", info.queue_us);
+		rpc->struct_add(handle, "{", "route_time", &bhandle);
+		for(i = 0; i < KSR_RCV_STATS_BUCKETS; i++) {
+			if(ksr_rcv_stats_bounds[i] != 0) {
+				snprintf(bname, sizeof(bname), "lt_%uus",
+						ksr_rcv_stats_bounds[i]);
+			} else {
+				snprintf(bname, sizeof(bname), "ge_%uus",
+						ksr_rcv_stats_bounds[i - 1]);
+			}
+			rpc->struct_add(bhandle, "j", bname, info.route_buckets[i]);
+		}
+	}
+}
+
+static const char *core_rcv_stats_doc[] = {
+		"Returns per process receive statistics: number of messages,"
+		" processing and route execution time, route time histogram and"
+		" queue latency (usec).",
+		0 /* Method signature(s) */
+};
+
+static const char *core_cfgprof_enable_doc[] = {
+		"Enable the config profiler. Optional parameter: sampling rate"
+		" (profile one out of N top level actions, default 100).",
+		0 /* Method signature(s) */
+};
+
+static const char *core_cfgprof_disable_doc[] = {
+		"Disable the config profiler.", 0 /* Method signature(s) */
+};
+
+static const char *core_cfgprof_reset_doc[] = {
+		"Reset the config profiler data.", 0 /* Method signature(s) */
+};
+
+static const char *core_cfgprof_list_doc[] = {
+		"List the config profiler data per action (route, file, line,"
+		" calls, self time).",
+		0 /* Method signature(s) */
+};
+
+static const char *core_cfgprof_flamegraph_doc[] = {
+		"Print the config profiler data in folded stacks format, usable"
+		" by flamegraph tools. Optional parameter: time (default) or"
+		" calls.",
+		0 /* Method signature(s) */
+};
+
+static const char *core_kemiprof_enable_doc[] = {
+		"Enable the KEMI functions profiler.", 0 /* Method signature(s) */
+};
+
+static const char *core_kemiprof_disable_doc[] = {
+		"Disable the KEMI functions profiler.", 0 /* Method signature(s) */
+};
+
+static const char *core_kemiprof_reset_doc[] = {
+		"Reset the KEMI functions profiler data.", 0 /* Method signature(s) */
+};
+
+static const char *core_kemiprof_list_doc[] = {
+		"List the number of calls and the execution time histogram for the"
+		" executed KEMI functions.",
+		0 /* Method signature(s) */
+};
+
 static const char *core_shmmem_doc[] = {
 		"Returns shared memory info. It has an optional parameter that "
 		"specifies"
@@ -1075,6 +1189,23 @@ static rpc_export_t core_rpc_methods[] = {
 	{"core.arg", core_arg, core_arg_doc, RPC_RET_ARRAY},
 	{"core.kill", core_kill, core_kill_doc, 0},
 	{"core.shmmem", core_shmmem, core_shmmem_doc, 0},
+	{"core.overload", core_overload, core_overload_doc, 0},
+	{"core.rcv_stats", core_rcv_stats, core_rcv_stats_doc, 0},
+	{"core.cfgprof_enable", ksr_cfgprof_rpc_enable, core_cfgprof_enable_doc,
+			0},
+	{"core.cfgprof_disable", ksr_cfgprof_rpc_disable,
+			core_cfgprof_disable_doc, 0},
+	{"core.cfgprof_reset", ksr_cfgprof_rpc_reset, core_cfgprof_reset_doc, 0},
+	{"core.cfgprof_list", ksr_cfgprof_rpc_list, core_cfgprof_list_doc, 0},
+	{"core.cfgprof_flamegraph", ksr_cfgprof_rpc_flamegraph,
+			core_cfgprof_flamegraph_doc, RPC_RET_ARRAY},
+	{"core.kemiprof_enable", sr_kemi_prof_rpc_enable, core_kemiprof_enable_doc,
+			0},
+	{"core.kemiprof_disable", sr_kemi_prof_rpc_disable,
+			core_kemiprof_disable_doc, 0},
+	{"core.kemiprof_reset", sr_kemi_prof_rpc_reset, core_kemiprof_reset_doc,
+			0},
+	{"core.kemiprof_list", sr_kemi_prof_rpc_list, core_kemiprof_list_doc, 0},
 #if defined(SF_MALLOC) || defined(LL_MALLOC)
 	{"core.sfmalloc", core_sfmalloc, core_sfmalloc_doc, 0},
 #endif
@@ -57,6 +57,8 @@ struct counter_record
 	counter_cbk_f cbk;
 	struct counter_record *grp_next; /* next in group */
 	str doc;
+	int hnbounds;			/* histogram upper bounds number (0 if not) */
+	counter_val_t *hbounds; /* histogram upper bounds */
 };
 
 
@@ -149,6 +151,14 @@ void destroy_counters()
 			pkg_free(_cnts_vals);
 		_cnts_vals = 0;
 	}
+	if(cnt_id2record) {
+		/* histogram bounds (the records are freed with the hash entries) */
+		for(r = 0; r < cnts_no; r++) {
+			if(cnt_id2record[r] && cnt_id2record[r]->h.id == r
+					&& cnt_id2record[r]->hbounds)
+				pkg_free(cnt_id2record[r]->hbounds);
+		}
+	}
 	if(cnts_hash_table.table) {
 		for(r = 0; r < cnts_hash_table.size; r++) {
 			clist_foreach_safe(&cnts_hash_table.table[r], e, bak, next)
@@ -306,6 +316,64 @@ static struct grp_record *grp_hash_get_create(str *group)
 }
 
 
+/** reserve the next counter id for a record (internal version).
+ * The temporary prefork values array and the id to record array are
+ * increased if needed.
+ * @return the new id on success, -1 on error.
+ */
+static int cnt_id_reserve(struct counter_record *cnt_rec)
+{
+	counter_array_t *v;
+	struct counter_record **p;
+	unsigned short id;
+	int n;
+
+	if(cnts_no >= MAX_COUNTER_ID)
+		/* too many counters */
+		return -1;
+	id = cnts_no;
+	/* check to see if it fits in the prefork tmp. vals array.
+	   This array contains only one "row", is allocated in pkg and
+	   is used only until counters_prefork_init() (after that the
+	   array is replaced with a shm version with all the needed rows).
+	 */
+	if(id >= _cnts_row_len || _cnts_vals == 0) {
+		/* array to small or not yet allocated => reallocate/allocate it
+		   (min size PREINIT_CNTS_VALS_SIZE, max MAX_COUNTER_ID)
+		 */
+		n = (id < PREINIT_CNTS_VALS_SIZE)
+					? PREINIT_CNTS_VALS_SIZE
+					: ((2 * (id + (id == 0)) < MAX_COUNTER_ID)
+									  ? (2 * (id + (id == 0)))
+									  : MAX_COUNTER_ID + 1);
+		v = pkg_realloc(_cnts_vals, n * sizeof(*_cnts_vals));
+		if(v == 0)
+			/* realloc/malloc error */
+			return -1;
+		_cnts_vals = v;
+		/* zero newly allocated memory */
+		memset(&_cnts_vals[_cnts_row_len], 0,
+				(n - _cnts_row_len) * sizeof(*_cnts_vals));
+		_cnts_row_len = n; /* record new length */
+	}
+	/* add a pointer to it in the records array */
+	if(cnt_id2record_size <= id) {
+		/* must increase the array */
+		p = pkg_realloc(
+				cnt_id2record, 2 * cnt_id2record_size * sizeof(*cnt_id2record));
+		if(p == 0)
+			return -1;
+		cnt_id2record = p;
+		cnt_id2record_size *= 2;
+		memset(&cnt_id2record[id], 0,
+				(cnt_id2record_size - id) * sizeof(*cnt_id2record));
+	}
+	cnt_id2record[id] = cnt_rec;
+	cnts_no++;
+	return id;
+}
+
+
 /** adds new counter to the hash table (no checks, internal version).
  * @return pointer to new record on success, 0 on error.
  */
@@ -316,7 +384,6 @@ static struct counter_record *cnt_hash_add(str *group, str *name, int flags,
 	struct counter_record *cnt_rec;
 	struct grp_record *grp_rec;
 	struct counter_record **p;
-	counter_array_t *v;
 	int doc_len;
 	int n;
 
@@ -344,11 +411,12 @@ static struct counter_record *cnt_hash_add(str *group, str *name, int flags,
 	cnt_rec->name.len = name->len;
 	cnt_rec->doc.s = cnt_rec->name.s + name->len + 1;
 	cnt_rec->doc.len = doc_len;
-	cnt_rec->h.id = cnts_no++;
 	cnt_rec->flags = flags;
 	cnt_rec->cbk_param = param;
 	cnt_rec->cbk = cbk;
 	cnt_rec->grp_next = 0;
+	cnt_rec->hnbounds = 0;
+	cnt_rec->hbounds = 0;
 	memcpy(cnt_rec->group.s, group->s, group->len + 1);
 	memcpy(cnt_rec->name.s, name->s, name->len + 1);
 	if(doc)
@@ -357,46 +425,10 @@ static struct counter_record *cnt_hash_add(str *group, str *name, int flags,
 		cnt_rec->doc.s[0] = 0;
 	e->key = cnt_rec->name;
 	e->flags = 0;
-	/* check to see if it fits in the prefork tmp. vals array.
-	   This array contains only one "row", is allocated in pkg and
-	   is used only until counters_prefork_init() (after that the
-	   array is replaced with a shm version with all the needed rows).
-	 */
-	if(cnt_rec->h.id >= _cnts_row_len || _cnts_vals == 0) {
-		/* array to small or not yet allocated => reallocate/allocate it
-		   (min size PREINIT_CNTS_VALS_SIZE, max MAX_COUNTER_ID)
-		 */
-		n = (cnt_rec->h.id < PREINIT_CNTS_VALS_SIZE)
-					? PREINIT_CNTS_VALS_SIZE
-					: ((2 * (cnt_rec->h.id + (cnt_rec->h.id == 0))
-							   < MAX_COUNTER_ID)
-									? (2
-											* (cnt_rec->h.id
-													+ (cnt_rec->h.id == 0)))
-									: MAX_COUNTER_ID + 1);
-		v = pkg_realloc(_cnts_vals, n * sizeof(*_cnts_vals));
-		if(v == 0)
-			/* realloc/malloc error */
-			goto error;
-		_cnts_vals = v;
-		/* zero newly allocated memory */
-		memset(&_cnts_vals[_cnts_row_len], 0,
-				(n - _cnts_row_len) * sizeof(*_cnts_vals));
-		_cnts_row_len = n; /* record new length */
-	}
-	/* add a pointer to it in the records array */
-	if(cnt_id2record_size <= cnt_rec->h.id) {
-		/* must increase the array */
-		p = pkg_realloc(
-				cnt_id2record, 2 * cnt_id2record_size * sizeof(*cnt_id2record));
-		if(p == 0)
-			goto error;
-		cnt_id2record = p;
-		cnt_id2record_size *= 2;
-		memset(&cnt_id2record[cnt_rec->h.id], 0,
-				(cnt_id2record_size - cnt_rec->h.id) * sizeof(*cnt_id2record));
-	}
-	cnt_id2record[cnt_rec->h.id] = cnt_rec;
+	n = cnt_id_reserve(cnt_rec);
+	if(n < 0)
+		goto error;
+	cnt_rec->h.id = n;
 	/* add into the hash */
 	str_hash_add(&cnts_hash_table, e);
 	/* insert it sorted in the per group list */
@@ -590,6 +622,193 @@ int counter_register_array(const char *group, counter_def_t *defs)
 }
 
 
+/** register a new histogram.
+ * Can be called only before forking (e.g. from mod_init()).
+ * The histogram uses nbounds + 3 consecutive counter ids: the count (the
+ * main counter, visible in the group), the sum of the observed values and
+ * one per bucket (+Inf included). Like for the other counters, the values
+ * are kept per process and aggregated on read.
+ * @param hist - result parameter, filled with the histogram handle.
+ * @param group - group name
+ * @param name  - histogram name (group.name must be unique).
+ * @param bounds - bucket upper bounds (strictly increasing).
+ * @param nbounds - bounds number (1 .. CNT_HIST_MAX_BOUNDS).
+ * @param doc - description/documentation string.
+ * @return 0 on success, < 0 on error (-1 invalid parameters or malloc error,
+ *          -2 already registered).
+ */
+int counter_hist_register(counter_hist_t *hist, const char *group,
+		const char *name, counter_val_t *bounds, int nbounds, const char *doc)
+{
+	struct counter_record *cnt_rec;
+	counter_handle_t h;
+	int i;
+	int ret;
+
+	hist->h.id = 0;
+	hist->nbounds = 0;
+	hist->bounds = 0;
+	if(nbounds <= 0 || nbounds > CNT_HIST_MAX_BOUNDS) {
+		LM_ERR("invalid number of bounds %d for histogram %s.%s\n", nbounds,
+				group, name);
+		return -1;
+	}
+	for(i = 1; i < nbounds; i++) {
+		if(bounds[i] <= bounds[i - 1]) {
+			LM_ERR("histogram %s.%s bounds are not increasing (%ld <= %ld)\n",
+					group, name, (long)bounds[i], (long)bounds[i - 1]);
+			return -1;
+		}
+	}
+	ret = counter_register(&h, group, name, 0, 0, 0, doc, 0);
+	if(ret < 0)
+		return ret;
+	cnt_rec = cnt_id2record[h.id];
+	if(unlikely(h.id + 1 != cnts_no)) {
+		LM_BUG("histogram %s.%s - unexpected counter id %d (%d)\n", group,
+				name, h.id, cnts_no);
+		return -1;
+	}
+	/* sum + buckets */
+	for(i = 0; i < nbounds + 2; i++) {
+		if(cnt_id_reserve(cnt_rec) < 0) {
+			LM_ERR("failed to reserve the ids for histogram %s.%s\n", group,
+					name);
+			return -1;
+		}
+	}
+	cnt_rec->hbounds = pkg_malloc(nbounds * sizeof(counter_val_t));
+	if(cnt_rec->hbounds == 0) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memcpy(cnt_rec->hbounds, bounds, nbounds * sizeof(counter_val_t));
+	cnt_rec->hnbounds = nbounds;
+
+	hist->h = h;
+	hist->nbounds = nbounds;
+	hist->bounds = cnt_rec->hbounds;
+	return 0;
+}
+
+
+/** fill in the handle of an existing histogram.
+ * @param hist - filled with the corresp. handle on success.
+ * @param group - histogram group name.
+ * @param name - histogram name.
+ * @return 0 on success, < 0 on error (not found or not a histogram).
+ */
+int counter_hist_lookup(
+		counter_hist_t *hist, const char *group, const char *name)
+{
+	struct counter_record *cnt_rec;
+	counter_handle_t h;
+
+	hist->h.id = 0;
+	hist->nbounds = 0;
+	hist->bounds = 0;
+	if(counter_lookup(&h, group, name) < 0)
+		return -1;
+	cnt_rec = cnt_id2record[h.id];
+	if(cnt_rec->hnbounds == 0)
+		return -1;
+	hist->h = h;
+	hist->nbounds = cnt_rec->hnbounds;
+	hist->bounds = cnt_rec->hbounds;
+	return 0;
+}
+
+
+/** fill an array with log-linear histogram bounds.
+ * Each power of 10 interval between min and max is split in steps linear
+ * buckets (e.g. min=1, max=1000, steps=2: 1, 5, 10, 55, 100, 550, 1000).
+ * @param bounds - array to be filled.
+ * @param size - array size.
+ * @param min - first bound (>= 1).
+ * @param max - last bound.
+ * @param steps - linear steps per power of 10 interval (>= 1).
+ * @return the number of bounds set, < 0 on error.
+ */
+int counter_hist_loglinear(counter_val_t *bounds, int size, counter_val_t min,
+		counter_val_t max, int steps)
+{
+	counter_val_t b;
+	counter_val_t v;
+	int n;
+	int i;
+
+	if(min < 1 || max < min || steps < 1 || size < 1)
+		return -1;
+	n = 0;
+	for(b = min; b <= max; b *= 10) {
+		for(i = 0; i < steps; i++) {
+			v = b + (b * 9 * i) / steps;
+			if(v > max)
+				break;
+			if(n > 0 && v <= bounds[n - 1])
+				continue;
+			if(n >= size)
+				return n;
+			bounds[n++] = v;
+		}
+	}
+	if(n < size && bounds[n - 1] < max)
+		bounds[n++] = max;
+	return n;
+}
+
+
+/** check if a counter is a histogram.
+ * @param handle - counter handle.
+ * @return the number of bounds for histograms, 0 otherwise.
+ */
+int counter_is_hist(counter_handle_t handle)
+{
+	if(unlikely(cnt_id2record == 0 || handle.id >= cnts_no))
+		return 0;
+	if(cnt_id2record[handle.id]->h.id != handle.id)
+		return 0;
+	return cnt_id2record[handle.id]->hnbounds;
+}
+
+
+/** get the aggregated values of a histogram.
+ * @param handle - histogram handle (hist.h).
+ * @param hval - filled with the count, the sum and the cumulative buckets.
+ * @return 0 on success, -1 on error (e.g. not a histogram).
+ */
+int counter_hist_get_val(counter_handle_t handle, counter_hist_val_t *hval)
+{
+	struct counter_record *cnt_rec;
+	counter_handle_t h;
+	counter_val_t v;
+	int i;
+
+	if(unlikely(_cnts_vals == 0 || cnt_id2record == 0)) {
+		/* not init yet */
+		LM_BUG("counters not fully initialized yet\n");
+		return -1;
+	}
+	if(unlikely(counter_is_hist(handle) == 0))
+		return -1;
+	cnt_rec = cnt_id2record[handle.id];
+	hval->nbounds = cnt_rec->hnbounds;
+	hval->bounds = cnt_rec->hbounds;
+	hval->count = counter_get_raw_val(handle);
+	h.id = handle.id + 1;
+	hval->sum = counter_get_raw_val(h);
+	v = 0;
+	for(i = 0; i <= hval->nbounds; i++) {
+		h.id = handle.id + 2 + i;
+		v += counter_get_raw_val(h);
+		hval->buckets[i] = v;
+	}
+	/* the per process rows are read without locking, keep +Inf == count */
+	hval->count = hval->buckets[hval->nbounds];
+	return 0;
+}
+
+
 /** get the value of the counter, bypassing callbacks.
  * @param handle - counter handle obtained using counter_lookup() or
  *                 counter_register().
@@ -644,7 +863,9 @@ counter_val_t counter_get_val(counter_handle_t handle)
  */
 void counter_reset(counter_handle_t handle)
 {
+	counter_handle_t h;
 	int r;
+	int n;
 
 	if(unlikely(_cnts_vals == 0 || cnt_id2record == 0)) {
 		/* not init yet */
@@ -659,6 +880,13 @@ void counter_reset(counter_handle_t handle)
 		return;
 	for(r = 0; r < cnts_max_rows; r++)
 		counter_pprocess_val(r, handle) = 0;
+	n = cnt_id2record[handle.id]->hnbounds;
+	if(unlikely(n && cnt_id2record[handle.id]->h.id == handle.id)) {
+		/* histogram - reset also the sum and the buckets */
+		for(h.id = handle.id + 1; h.id < handle.id + n + 3; h.id++)
+			for(r = 0; r < cnts_max_rows; r++)
+				counter_pprocess_val(r, h) = 0;
+	}
 	return;
 }
 
@@ -29,12 +29,24 @@
  *    counter_lookup(&h, "my_counters", "foo");
  *  4. get a counter value (the handle can be obtained like above)
  *    val = counter_get(h);
+ *
+ *  Histograms (kept per process like the counters, aggregated on read):
+ *  1. register (before forking):
+ *    counter_hist_t hist;
+ *    counter_val_t bounds[] = {10, 50, 100, 500};
+ *    counter_hist_register(&hist, "my_counters", "foo_time", bounds, 4,
+ *        "test histogram");
+ *  2. add an observed value:
+ *    counter_hist_observe(&hist, 42);
+ *  3. get the aggregated values (count, sum, cumulative buckets):
+ *    counter_hist_get_val(hist.h, &hval);
  */
 
 #ifndef __counters_h
 #define __counters_h
 
 #include "pt.h"
+#include "compiler_opt.h"
 
 /* counter flags */
 #define CNT_F_NO_RESET 1 /* don't reset */
@@ -78,6 +90,30 @@ struct counter_def_s
 
 typedef struct counter_def_s counter_def_t;
 
+/** max number of upper bounds for a histogram (without +Inf) */
+#define CNT_HIST_MAX_BOUNDS 32
+
+/* histogram handle - the count is kept in the counter with the id h.id,
+ * the sum of the observed values in the next one and then the non
+ * cumulative buckets (nbounds + 1, last is +Inf) */
+typedef struct counter_hist_s
+{
+	counter_handle_t h;
+	int nbounds;
+	counter_val_t *bounds; /**< upper bounds (inclusive), increasing */
+} counter_hist_t;
+
+/* aggregated histogram values */
+typedef struct counter_hist_val_s
+{
+	counter_val_t count;
+	counter_val_t sum;
+	int nbounds;
+	counter_val_t *bounds;
+	/** cumulative buckets (<= bounds[i]), last one (+Inf) is the count */
+	counter_val_t buckets[CNT_HIST_MAX_BOUNDS + 1];
+} counter_hist_val_t;
+
 
 extern counter_array_t *_cnts_vals;
 extern int _cnts_row_len; /* number of elements per row */
@@ -97,6 +133,15 @@ int counter_lookup(
 		counter_handle_t *handle, const char *group, const char *name);
 int counter_lookup_str(counter_handle_t *handle, str *group, str *name);
 
+int counter_hist_register(counter_hist_t *hist, const char *group,
+		const char *name, counter_val_t *bounds, int nbounds, const char *doc);
+int counter_hist_lookup(
+		counter_hist_t *hist, const char *group, const char *name);
+int counter_hist_loglinear(counter_val_t *bounds, int size, counter_val_t min,
+		counter_val_t max, int steps);
+int counter_is_hist(counter_handle_t handle);
+int counter_hist_get_val(counter_handle_t handle, counter_hist_val_t *hval);
+
 void counter_reset(counter_handle_t handle);
 counter_val_t counter_get_val(counter_handle_t handle);
 counter_val_t counter_get_raw_val(counter_handle_t handle);
@@ -131,6 +176,27 @@ inline static void counter_add(counter_handle_t handle, int v)
 }
 
 
+/** adds an observed value to a histogram.
+ * @param hist - histogram handle filled by counter_hist_register() or
+ *               counter_hist_lookup().
+ * @param v - value.
+ */
+inline static void counter_hist_observe(counter_hist_t *hist, counter_val_t v)
+{
+	counter_array_t *row;
+	int i;
+
+	if(unlikely(hist->h.id == 0))
+		return;
+	for(i = 0; i < hist->nbounds && v > hist->bounds[i]; i++)
+		;
+	row = &_cnts_vals[process_no * _cnts_row_len + hist->h.id];
+	row[0].v++;
+	row[1].v += v;
+	row[2 + i].v++;
+}
+
+
 void counter_iterate_grp_names(void (*cbk)(void *p, str *grp_name), void *p);
 void counter_iterate_grp_var_names(
 		const char *group, void (*cbk)(void *p, str *var_name), void *p);
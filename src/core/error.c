@@ -109,6 +109,11 @@ int err2reason_phrase(int int_error, /* current internal error */
 			*sip_error = -int_error;
 			break;
 
+		case E_OVERLOADED:
+			error_txt = "Next hop overloaded";
+			*sip_error = -int_error;
+			break;
+
 		case E_OUT_OF_MEM:
 			error_txt = "Message processing error";
 			*sip_error = 500;
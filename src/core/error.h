@@ -69,6 +69,7 @@
 #define E_BAD_SERVER -500
 #define E_ADM_PROHIBITED -510
 #define E_BLOCKLISTED -520
+#define E_OVERLOADED -503 /* dropped by overload control */
 
 
 #define MAX_REASON_LEN 128
@@ -68,6 +68,7 @@
 #endif
 #include "compiler_opt.h"
 #include "core_stats.h"
+#include "overload_ctl.h"
 
 #ifdef DEBUG_DMALLOC
 #include <dmalloc.h>
@@ -628,6 +629,19 @@ int forward_request_mode(struct sip_msg *msg, str *dst, unsigned short port,
 			}
 		}
 #endif
+		if(unlikely(ksr_ovl_mode != 0)) {
+			if(ksr_ovl_dst_reject(send_info, msg)) {
+				su2ip_addr(&ip, &send_info->to);
+				LM_DBG("overloaded destination:%s:%d (%d)\n", ip_addr2a(&ip),
+						su_getport(&send_info->to), send_info->proto);
+				ret = ser_error = E_OVERLOADED;
+#ifdef USE_DNS_FAILOVER
+				continue; /* try another ip */
+#else
+				goto error;
+#endif
+			}
+		}
 
 		if(unlikely(_forward_set_send_info == 1)) {
 			onsnd_info.to = &send_info->to;
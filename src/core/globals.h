@@ -233,6 +233,7 @@ extern str _ksr_xavp_via_reply_params;
 extern int ksr_sip_parser_mode;
 extern int ksr_cfg_print_mode;
 extern int ksr_return_mode;
+extern int ksr_expr_bytecode;
 
 extern int ksr_wait_worker1_mode;
 extern int ksr_wait_worker1_time;
@@ -605,5 +605,7 @@ int sr_kemi_hdr_remove(sip_msg_t *msg, str *hname);
 
 sr_kemi_xval_t *sr_kemi_exec_func(
 		sr_kemi_t *ket, sip_msg_t *msg, int pno, sr_kemi_xval_t *vps);
+int sr_kemi_exec_func_noparams(
+		sr_kemi_t *ket, sip_msg_t *msg, sr_kemi_xval_t **xret);
 
 #endif
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: KEMI functions execution profiler.
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ *
+ * When enabled, the number of calls and the execution time histogram of
+ * each exported KEMI function (KSR.*) executed by the embedded language
+ * interpreters is kept in shared memory. The functions are identified by
+ * the address of their export structure, which is the same in all the
+ * processes. The items are only added (under lock) and never removed
+ * while running, so they are looked up and updated without locking.
+ */
+
+#include <string.h>
+
+#include "kemi_prof.h"
+#include "atomic_ops.h"
+#include "locking.h"
+#include "dprint.h"
+#include "mem/shm_mem.h"
+
+#define SR_KEMI_PROF_SIZE 1024 /**< hash table slots */
+
+typedef struct sr_kemi_prof_item
+{
+	sr_kemi_t *ket;
+	volatile long calls;
+	volatile long time_ns;
+	volatile long buckets[SR_KEMI_PROF_BUCKETS];
+	struct sr_kemi_prof_item *next;
+} sr_kemi_prof_item_t;
+
+typedef struct sr_kemi_prof_state
+{
+	gen_lock_t lock;
+	int mode;
+	int items;
+	sr_kemi_prof_item_t *slots[SR_KEMI_PROF_SIZE];
+} sr_kemi_prof_state_t;
+
+int *_sr_kemi_prof_mode = NULL;
+
+const unsigned int sr_kemi_prof_bounds[SR_KEMI_PROF_BUCKETS] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 0};
+
+static sr_kemi_prof_state_t *_sr_kemi_prof_state = NULL;
+
+/**
+ *
+ */
+int sr_kemi_prof_init(void)
+{
+	_sr_kemi_prof_state =
+			(sr_kemi_prof_state_t *)shm_malloc(sizeof(sr_kemi_prof_state_t));
+	if(_sr_kemi_prof_state == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_sr_kemi_prof_state, 0, sizeof(sr_kemi_prof_state_t));
+	if(lock_init(&_sr_kemi_prof_state->lock) == 0) {
+		LM_ERR("failed to init the lock\n");
+		shm_free(_sr_kemi_prof_state);
+		_sr_kemi_prof_state = NULL;
+		return -1;
+	}
+	_sr_kemi_prof_mode = &_sr_kemi_prof_state->mode;
+	return 0;
+}
+
+/**
+ *
+ */
+void sr_kemi_prof_destroy(void)
+{
+	sr_kemi_prof_item_t *it;
+	sr_kemi_prof_item_t *it0;
+	int i;
+
+	_sr_kemi_prof_mode = NULL;
+	if(_sr_kemi_prof_state == NULL) {
+		return;
+	}
+	for(i = 0; i < SR_KEMI_PROF_SIZE; i++) {
+		it = _sr_kemi_prof_state->slots[i];
+		while(it != NULL) {
+			it0 = it;
+			it = it->next;
+			shm_free(it0);
+		}
+	}
+	lock_destroy(&_sr_kemi_prof_state->lock);
+	shm_free(_sr_kemi_prof_state);
+	_sr_kemi_prof_state = NULL;
+}
+
+/**
+ *
+ */
+static sr_kemi_prof_item_t *sr_kemi_prof_get(sr_kemi_t *ket)
+{
+	sr_kemi_prof_item_t *it;
+	unsigned int idx;
+
+	idx = (unsigned int)(((unsigned long)ket) >> 4) & (SR_KEMI_PROF_SIZE - 1);
+	for(it = _sr_kemi_prof_state->slots[idx]; it != NULL; it = it->next) {
+		if(it->ket == ket) {
+			return it;
+		}
+	}
+
+	lock_get(&_sr_kemi_prof_state->lock);
+	/* added meanwhile by another process? */
+	for(it = _sr_kemi_prof_state->slots[idx]; it != NULL; it = it->next) {
+		if(it->ket == ket) {
+			lock_release(&_sr_kemi_prof_state->lock);
+			return it;
+		}
+	}
+	it = (sr_kemi_prof_item_t *)shm_malloc(sizeof(sr_kemi_prof_item_t));
+	if(it == NULL) {
+		lock_release(&_sr_kemi_prof_state->lock);
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(it, 0, sizeof(sr_kemi_prof_item_t));
+	it->ket = ket;
+	it->next = _sr_kemi_prof_state->slots[idx];
+	membar_write();
+	_sr_kemi_prof_state->slots[idx] = it;
+	_sr_kemi_prof_state->items++;
+	lock_release(&_sr_kemi_prof_state->lock);
+	return it;
+}
+
+/**
+ * account the execution of ket started at tb
+ */
+void sr_kemi_prof_update(sr_kemi_t *ket, struct timespec *tb)
+{
+	sr_kemi_prof_item_t *it;
+	struct timespec te;
+	long d;
+	int i;
+
+	if(_sr_kemi_prof_state == NULL || ket == NULL) {
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &te);
+	d = (te.tv_sec - tb->tv_sec) * 1000000000L + (te.tv_nsec - tb->tv_nsec);
+	if(d < 0) {
+		d = 0;
+	}
+	it = sr_kemi_prof_get(ket);
+	if(it == NULL) {
+		return;
+	}
+	for(i = 0; i < SR_KEMI_PROF_BUCKETS - 1; i++) {
+		if(d < (long)sr_kemi_prof_bounds[i] * 1000L) {
+			break;
+		}
+	}
+	atomic_inc_long(&it->calls);
+	atomic_add_long(&it->time_ns, d);
+	atomic_inc_long(&it->buckets[i]);
+}
+
+/**
+ * call f for the stats of each executed function
+ */
+int sr_kemi_prof_iterate(sr_kemi_prof_cbk_f f, void *p)
+{
+	sr_kemi_prof_item_t *it;
+	sr_kemi_prof_stats_t st;
+	int i;
+	int j;
+
+	if(_sr_kemi_prof_state == NULL) {
+		return -1;
+	}
+	for(i = 0; i < SR_KEMI_PROF_SIZE; i++) {
+		for(it = _sr_kemi_prof_state->slots[i]; it != NULL; it = it->next) {
+			st.ket = it->ket;
+			st.calls = (unsigned long)atomic_get_long(&it->calls);
+			st.time_ns = (unsigned long)atomic_get_long(&it->time_ns);
+			for(j = 0; j < SR_KEMI_PROF_BUCKETS; j++) {
+				st.buckets[j] = (unsigned long)atomic_get_long(&it->buckets[j]);
+			}
+			if(f(&st, p) < 0) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ *
+ */
+void sr_kemi_prof_rpc_enable(rpc_t *rpc, void *ctx)
+{
+	if(_sr_kemi_prof_mode == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	*_sr_kemi_prof_mode = 1;
+}
+
+/**
+ *
+ */
+void sr_kemi_prof_rpc_disable(rpc_t *rpc, void *ctx)
+{
+	if(_sr_kemi_prof_mode == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	*_sr_kemi_prof_mode = 0;
+}
+
+/**
+ * reset the values - the items are kept, other processes may use them
+ */
+void sr_kemi_prof_rpc_reset(rpc_t *rpc, void *ctx)
+{
+	sr_kemi_prof_item_t *it;
+	int i;
+	int j;
+
+	if(_sr_kemi_prof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	for(i = 0; i < SR_KEMI_PROF_SIZE; i++) {
+		for(it = _sr_kemi_prof_state->slots[i]; it != NULL; it = it->next) {
+			atomic_set_long(&it->calls, 0);
+			atomic_set_long(&it->time_ns, 0);
+			for(j = 0; j < SR_KEMI_PROF_BUCKETS; j++) {
+				atomic_set_long(&it->buckets[j], 0);
+			}
+		}
+	}
+}
+
+typedef struct sr_kemi_prof_rpc_ctx
+{
+	rpc_t *rpc;
+	void *ctx;
+} sr_kemi_prof_rpc_ctx_t;
+
+static int sr_kemi_prof_rpc_list_item(sr_kemi_prof_stats_t *st, void *p)
+{
+	sr_kemi_prof_rpc_ctx_t *rc = (sr_kemi_prof_rpc_ctx_t *)p;
+	void *th;
+	void *bh;
+	char bname[24];
+	int i;
+
+	if(st->calls == 0) {
+		return 0;
+	}
+	if(rc->rpc->add(rc->ctx, "{", &th) < 0) {
+		rc->rpc->fault(rc->ctx, 500, "Internal error creating rpc");
+		return -1;
+	}
+	rc->rpc->struct_add(th, "SSjj", "module", &st->ket->mname, "function",
+			&st->ket->fname, "calls", st->calls, "time_us",
+			st->time_ns / 1000);
+	rc->rpc->struct_add(th, "{", "time_hist", &bh);
+	for(i = 0; i < SR_KEMI_PROF_BUCKETS; i++) {
+		if(sr_kemi_prof_bounds[i] != 0) {
+			snprintf(bname, sizeof(bname), "lt_%uus", sr_kemi_prof_bounds[i]);
+		} else {
+			snprintf(bname, sizeof(bname), "ge_%uus",
+					sr_kemi_prof_bounds[i - 1]);
+		}
+		rc->rpc->struct_add(bh, "j", bname, st->buckets[i]);
+	}
+	return 0;
+}
+
+/**
+ *
+ */
+void sr_kemi_prof_rpc_list(rpc_t *rpc, void *ctx)
+{
+	sr_kemi_prof_rpc_ctx_t rc;
+
+	if(_sr_kemi_prof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	rc.rpc = rpc;
+	rc.ctx = ctx;
+	sr_kemi_prof_iterate(sr_kemi_prof_rpc_list_item, &rc);
+}
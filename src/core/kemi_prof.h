@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: KEMI functions execution profiler.
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#ifndef _kemi_prof_h_
+#define _kemi_prof_h_
+
+#include <time.h>
+
+#include "kemi.h"
+#include "compiler_opt.h"
+#include "rpc.h"
+
+/** execution time histogram buckets (upper bounds in usec, last is +Inf) */
+#define SR_KEMI_PROF_BUCKETS 8
+
+typedef struct sr_kemi_prof_stats
+{
+	sr_kemi_t *ket;
+	unsigned long calls;
+	unsigned long time_ns;
+	unsigned long buckets[SR_KEMI_PROF_BUCKETS]; /**< not cumulative */
+} sr_kemi_prof_stats_t;
+
+typedef int (*sr_kemi_prof_cbk_f)(sr_kemi_prof_stats_t *st, void *p);
+
+extern int *_sr_kemi_prof_mode;
+extern const unsigned int sr_kemi_prof_bounds[SR_KEMI_PROF_BUCKETS];
+
+int sr_kemi_prof_init(void);
+void sr_kemi_prof_destroy(void);
+
+void sr_kemi_prof_update(sr_kemi_t *ket, struct timespec *tb);
+int sr_kemi_prof_iterate(sr_kemi_prof_cbk_f f, void *p);
+
+#define sr_kemi_prof_enabled() \
+	(unlikely(_sr_kemi_prof_mode != NULL && *_sr_kemi_prof_mode != 0))
+
+/** start measuring a KEMI function execution - evaluates to 1 if enabled */
+#define sr_kemi_prof_start(ts) \
+	((sr_kemi_prof_enabled()) ? (clock_gettime(CLOCK_MONOTONIC, (ts)), 1) : 0)
+
+/** end measuring a KEMI function execution started with prof set to 1 */
+#define sr_kemi_prof_end(prof, ket, ts)           \
+	do {                                          \
+		if(unlikely(prof))                        \
+			sr_kemi_prof_update((ket), (ts));     \
+	} while(0)
+
+void sr_kemi_prof_rpc_enable(rpc_t *rpc, void *ctx);
+void sr_kemi_prof_rpc_disable(rpc_t *rpc, void *ctx);
+void sr_kemi_prof_rpc_reset(rpc_t *rpc, void *ctx);
+void sr_kemi_prof_rpc_list(rpc_t *rpc, void *ctx);
+
+#endif
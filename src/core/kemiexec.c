@@ -29,6 +29,7 @@
 #include "dprint.h"
 #include "parser/msg_parser.h"
 #include "kemi.h"
+#include "kemi_prof.h"
 
 
 /**
@@ -65,7 +66,7 @@ static inline sr_kemi_xval_t *sr_kemi_return_false(sr_kemi_t *ket)
 /**
  *
  */
-sr_kemi_xval_t *sr_kemi_exec_func(
+static sr_kemi_xval_t *sr_kemi_exec_func_ex(
 		sr_kemi_t *ket, sip_msg_t *msg, int pno, sr_kemi_xval_t *vps)
 {
 	int ret;
@@ -1903,3 +1904,42 @@ sr_kemi_xval_t *sr_kemi_exec_func(
 			return sr_kemi_return_false(ket);
 	}
 }
+
+/**
+ *
+ */
+sr_kemi_xval_t *sr_kemi_exec_func(
+		sr_kemi_t *ket, sip_msg_t *msg, int pno, sr_kemi_xval_t *vps)
+{
+	sr_kemi_xval_t *xret;
+	struct timespec tsb;
+	int prof;
+
+	prof = sr_kemi_prof_start(&tsb);
+	xret = sr_kemi_exec_func_ex(ket, msg, pno, vps);
+	sr_kemi_prof_end(prof, ket, &tsb);
+	return xret;
+}
+
+/**
+ * execute a KEMI function without parameters, as done directly by the
+ * app_* modules
+ * - xret is set for functions returning SR_KEMIP_XVAL, otherwise the
+ *   return code of the function is returned
+ */
+int sr_kemi_exec_func_noparams(
+		sr_kemi_t *ket, sip_msg_t *msg, sr_kemi_xval_t **xret)
+{
+	struct timespec tsb;
+	int prof;
+	int ret = 0;
+
+	prof = sr_kemi_prof_start(&tsb);
+	if(ket->rtype == SR_KEMIP_XVAL) {
+		*xret = ((sr_kemi_xfm_f)(ket->func))(msg);
+	} else {
+		ret = ((sr_kemi_fm_f)(ket->func))(msg);
+	}
+	sr_kemi_prof_end(prof, ket, &tsb);
+	return ret;
+}
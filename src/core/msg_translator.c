@@ -107,6 +107,7 @@
 #include "pvapi.h"
 #include "xavp.h"
 #include "rand/kam_rand.h"
+#include "overload_ctl.h"
 
 #define append_str_trans(_dest, _src, _len, _msg) \
 	append_str((_dest), (_src), (_len));
@@ -2402,6 +2403,9 @@ char *generate_res_buf_from_sip_res(
 	str xparams;
 	str sdup;
 	sr_lump_t *anchor;
+	struct via_param *ovl_vp;
+	str ovl_val;
+	str ovl_params;
 
 	buf = msg->buf;
 	len = msg->len;
@@ -2448,6 +2452,49 @@ char *generate_res_buf_from_sip_res(
 		}
 	}
 
+	/* overload control value for upstream, if it asked for it */
+	if(unlikely(ksr_ovl_mode != 0) && msg->via2
+			&& !(mode & BUILD_NO_VIA1_UPDATE)) {
+		ovl_vp = ksr_ovl_reply_via_params(msg->via2, &ovl_val, &ovl_params);
+		if(ovl_vp != NULL) {
+			/* value of the 'oc' param, then the other params at the end -
+			 * via type to be removed like the via1 delete lump if the reply
+			 * is stored in shm */
+			anchor = anchor_lump(msg,
+					ovl_vp->name.s + ovl_vp->name.len - msg->buf, 0,
+					HDR_VIA_T);
+			if(anchor == NULL) {
+				LM_ERR("unable to get the anchor\n");
+				goto error;
+			}
+			if(pkg_str_dup(&sdup, &ovl_val) < 0) {
+				PKG_MEM_ERROR;
+				goto error;
+			}
+			if(insert_new_lump_after(anchor, sdup.s, sdup.len, 0) == 0) {
+				LM_ERR("unable to add overload control value\n");
+				pkg_free(sdup.s);
+				goto error;
+			}
+			anchor = anchor_lump(msg,
+					msg->via2->params.s + msg->via2->params.len - msg->buf, 0,
+					HDR_VIA_T);
+			if(anchor == NULL) {
+				LM_ERR("unable to get the anchor\n");
+				goto error;
+			}
+			if(pkg_str_dup(&sdup, &ovl_params) < 0) {
+				PKG_MEM_ERROR;
+				goto error;
+			}
+			if(insert_new_lump_after(anchor, sdup.s, sdup.len, 0) == 0) {
+				LM_ERR("unable to add overload control params\n");
+				pkg_free(sdup.s);
+				goto error;
+			}
+		}
+	}
+
 	/* Calculate message body difference and adjust
 	      * Content-Length
 	      */
@@ -2525,6 +2572,12 @@ char *build_res_buf_from_sip_req(unsigned int code, str *text, str *new_tag,
 	int httpreq;
 	char *pvia;
 	str xparams = STR_NULL;
+	struct via_param *ovl_vp = NULL;
+	str ovl_val = STR_NULL;
+	str ovl_params = STR_NULL;
+	char *pvia1;
+	char *vsplit;
+	int voff;
 
 	body = 0;
 	buf = 0;
@@ -2576,6 +2629,14 @@ char *build_res_buf_from_sip_req(unsigned int code, str *text, str *new_tag,
 		}
 	}
 
+	/* overload control value for upstream, if it asked for it */
+	if(unlikely(ksr_ovl_mode != 0)) {
+		ovl_vp = ksr_ovl_reply_via_params(msg->via1, &ovl_val, &ovl_params);
+		if(ovl_vp != NULL) {
+			len += ovl_val.len + ovl_params.len;
+		}
+	}
+
 	/* first line */
 	len += msg->first_line.u.request.version.len
 		   + 1 /*space*/ + 3 /*code*/ + 1 /*space*/ + text->len
@@ -2672,6 +2733,7 @@ char *build_res_buf_from_sip_req(unsigned int code, str *text, str *new_tag,
 				if(unlikely(httpreq))
 					pvia = p;
 				if(hdr == msg->h_via1) {
+					pvia1 = p;
 					if(rport_buf && msg->via1->rport) { /* replace old rport */
 						/* copy until rport */
 						append_str_trans(p, hdr->name.s,
@@ -2698,6 +2760,10 @@ char *build_res_buf_from_sip_req(unsigned int code, str *text, str *new_tag,
 						/* add extra parameters */
 						append_str(p, xparams.s, xparams.len);
 					}
+					if(ovl_vp != NULL) {
+						/* add overload control parameters */
+						append_str(p, ovl_params.s, ovl_params.len);
+					}
 					/* copy the rest of the via */
 					if(rport_buf && msg->via1->rport) {
 						append_str_trans(p,
@@ -2716,6 +2782,28 @@ char *build_res_buf_from_sip_req(unsigned int code, str *text, str *new_tag,
 										- msg->via1->branch->size,
 								msg);
 					}
+					if(ovl_vp != NULL) {
+						/* set the value of the 'oc' param - its offset
+						 * changes if it is after the added params */
+						if(rport_buf && msg->via1->rport) {
+							vsplit = msg->via1->rport->start - 1;
+						} else if(msg->via1->branch) {
+							vsplit = msg->via1->branch->start
+									 + msg->via1->branch->size;
+						} else {
+							vsplit = hdr->body.s + hdr->body.len;
+						}
+						voff = ovl_vp->name.s + ovl_vp->name.len - hdr->name.s;
+						if(ovl_vp->name.s >= vsplit) {
+							voff += (p - pvia1)
+									- ((hdr->body.s + hdr->body.len)
+											- hdr->name.s);
+						}
+						memmove(pvia1 + voff + ovl_val.len, pvia1 + voff,
+								p - pvia1 - voff);
+						memcpy(pvia1 + voff, ovl_val.s, ovl_val.len);
+						p += ovl_val.len;
+					}
 				} else {
 					/* normal whole via copy */
 					append_str_trans(p, hdr->name.s,
@@ -3243,6 +3331,27 @@ char *create_via_hf(unsigned int *len, struct sip_msg *msg,
 		}
 	}
 
+	/* test and add overload control parameter - rfc7339 */
+	if(unlikely(ksr_ovl_mode != 0)) {
+		via = (char *)pkg_malloc(extra_params.len + 4);
+		if(via == 0) {
+			PKG_MEM_ERROR;
+			if(extra_params.s)
+				pkg_free(extra_params.s);
+			return 0;
+		}
+		if(extra_params.s != NULL && extra_params.len > 0) {
+			memcpy(via, extra_params.s, extra_params.len);
+		}
+		if(extra_params.s != NULL) {
+			pkg_free(extra_params.s);
+		}
+		memcpy(via + extra_params.len, ";oc", 3);
+		extra_params.s = via;
+		extra_params.len += 3;
+		extra_params.s[extra_params.len] = '\0';
+	}
+
 	/* test and add xavp params */
 	if(msg && (msg->msg_flags & FL_ADD_XAVP_VIA_PARAMS)
 			&& _ksr_xavp_via_params.len > 0) {
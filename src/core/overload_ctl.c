@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: SIP overload control (RFC 7339, loss based).
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ *
+ * The local load is sampled by a timer from the number of workers busy
+ * with a message, the fill level of the UDP receive buffers and the
+ * optional load sources registered by modules (e.g., tm transactions).
+ * When it goes over the target, the percentage of requests the upstream
+ * servers should drop (the 'oc' value) is increased and advertised in
+ * the Via of upstream in the local and relayed replies, if the upstream
+ * added the 'oc' param to its Via. The 'oc' values received in replies
+ * from downstream are stored per destination and used to drop initial
+ * requests before they are sent out.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#ifdef __OS_linux
+#include <linux/sock_diag.h>
+#endif
+
+#include "overload_ctl.h"
+#include "dprint.h"
+#include "ut.h"
+#include "pt.h"
+#include "hashes.h"
+#include "locking.h"
+#include "timer.h"
+#include "timer_ticks.h"
+#include "socket_info.h"
+#include "mem/shm_mem.h"
+#include "rand/kam_rand.h"
+#include "sr_module.h"
+#include "parser/parse_via.h"
+#include "parser/parse_to.h"
+
+#define KSR_OVL_TIMER_INTERVAL 500 /* ms */
+#define KSR_OVL_DST_SIZE 256	   /* must be a power of 2 */
+#define KSR_OVL_STEP_DOWN 5		   /* oc decrease per interval */
+#define KSR_OVL_HYSTERESIS 10	   /* load under target to decrease oc */
+
+typedef struct ksr_ovl_dst
+{
+	union sockaddr_union to;
+	int proto;
+	int reduction;
+	unsigned int seq;
+	ticks_t expires;
+} ksr_ovl_dst_t;
+
+struct ksr_ovl_state
+{
+	atomic_t busy;
+	int busy_avg;
+	int udpq;
+	int load;
+	int reduction;
+	unsigned int seq;
+	ticks_t dst_expires;
+	gen_lock_t lock;
+	ksr_ovl_dst_t dst[KSR_OVL_DST_SIZE];
+};
+
+typedef struct ksr_ovl_load
+{
+	char *name;
+	ksr_ovl_load_f f;
+} ksr_ovl_load_t;
+
+int ksr_ovl_mode = 0;
+int ksr_ovl_target = 80;
+int ksr_ovl_validity = 500;
+
+ksr_ovl_state_t *_ksr_ovl_state = NULL;
+atomic_t *_ksr_ovl_busy = NULL;
+
+static ksr_ovl_load_t _ksr_ovl_loads[KSR_OVL_LOAD_SIZE];
+static int _ksr_ovl_loads_no = 0;
+static struct timer_ln *_ksr_ovl_timer = NULL;
+
+static str _ksr_ovl_algo = str_init("loss");
+
+/**
+ *
+ */
+int ksr_ovl_register_load(char *name, ksr_ovl_load_f f)
+{
+	if(_ksr_ovl_loads_no >= KSR_OVL_LOAD_SIZE) {
+		LM_ERR("too many overload control load sources (%s)\n", name);
+		return -1;
+	}
+	_ksr_ovl_loads[_ksr_ovl_loads_no].name = name;
+	_ksr_ovl_loads[_ksr_ovl_loads_no].f = f;
+	_ksr_ovl_loads_no++;
+	return 0;
+}
+
+/**
+ * percent of sip workers processing a message
+ */
+static int ksr_ovl_busy_load(void)
+{
+	int i;
+	int n;
+	int busy;
+
+	n = 0;
+	for(i = 0; i < get_proc_no(); i++) {
+		if(pt[i].rank > 0 && pt[i].rank < PROC_SIPRPC) {
+			n++;
+		}
+	}
+	if(n == 0) {
+		return 0;
+	}
+	busy = atomic_get(&_ksr_ovl_state->busy);
+	if(busy > n) {
+		busy = n;
+	}
+	return busy * 100 / n;
+}
+
+/**
+ * max fill level of the udp receive buffers in percents
+ */
+static int ksr_ovl_udpq_load(void)
+{
+	int load = 0;
+#ifdef SO_MEMINFO
+	struct socket_info *si;
+	unsigned int meminfo[SK_MEMINFO_VARS];
+	socklen_t mlen;
+	int l;
+
+	for(si = udp_listen; si; si = si->next) {
+		if(si->socket < 0) {
+			continue;
+		}
+		mlen = sizeof(meminfo);
+		if(getsockopt(si->socket, SOL_SOCKET, SO_MEMINFO, meminfo, &mlen) < 0
+				|| meminfo[SK_MEMINFO_RCVBUF] == 0) {
+			continue;
+		}
+		l = (int)((unsigned long)meminfo[SK_MEMINFO_RMEM_ALLOC] * 100
+				  / meminfo[SK_MEMINFO_RCVBUF]);
+		if(l > load) {
+			load = l;
+		}
+	}
+#endif
+	return (load > 100) ? 100 : load;
+}
+
+/**
+ * timer - sample the load and update the advertised oc value
+ */
+static ticks_t ksr_ovl_timer(ticks_t ticks, struct timer_ln *tl, void *data)
+{
+	int load;
+	int l;
+	int i;
+	int reduction;
+
+	_ksr_ovl_state->busy_avg =
+			(3 * _ksr_ovl_state->busy_avg + ksr_ovl_busy_load()) / 4;
+	_ksr_ovl_state->udpq = ksr_ovl_udpq_load();
+
+	load = _ksr_ovl_state->busy_avg;
+	if(_ksr_ovl_state->udpq > load) {
+		load = _ksr_ovl_state->udpq;
+	}
+	for(i = 0; i < _ksr_ovl_loads_no; i++) {
+		l = _ksr_ovl_loads[i].f();
+		if(l > load) {
+			load = l;
+		}
+	}
+	if(load > 100) {
+		load = 100;
+	}
+	_ksr_ovl_state->load = load;
+
+	reduction = _ksr_ovl_state->reduction;
+	if(load > ksr_ovl_target) {
+		/* increase proportionally with the excess */
+		l = (load - ksr_ovl_target) / 2;
+		reduction += (l > KSR_OVL_STEP_DOWN) ? l : KSR_OVL_STEP_DOWN;
+		if(reduction > 100) {
+			reduction = 100;
+		}
+	} else if(load < ksr_ovl_target - KSR_OVL_HYSTERESIS) {
+		reduction -= KSR_OVL_STEP_DOWN;
+		if(reduction < 0) {
+			reduction = 0;
+		}
+	}
+	if(reduction != _ksr_ovl_state->reduction) {
+		LM_DBG("overload control value changed from %d to %d (load: %d)\n",
+				_ksr_ovl_state->reduction, reduction, load);
+		_ksr_ovl_state->reduction = reduction;
+		_ksr_ovl_state->seq++;
+	}
+
+	return (ticks_t)(-1); /* periodical */
+}
+
+/**
+ *
+ */
+int ksr_ovl_init(void)
+{
+	if(ksr_ovl_mode == 0) {
+		return 0;
+	}
+	if(ksr_ovl_target <= 0 || ksr_ovl_target > 100) {
+		LM_ERR("invalid overload control target: %d\n", ksr_ovl_target);
+		return -1;
+	}
+	_ksr_ovl_state = (ksr_ovl_state_t *)shm_malloc(sizeof(ksr_ovl_state_t));
+	if(_ksr_ovl_state == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_ksr_ovl_state, 0, sizeof(ksr_ovl_state_t));
+	if(lock_init(&_ksr_ovl_state->lock) == 0) {
+		LM_ERR("failed to init the lock\n");
+		goto error;
+	}
+	atomic_set(&_ksr_ovl_state->busy, 0);
+	/* oc-seq has to increase also across restarts */
+	_ksr_ovl_state->seq = (unsigned int)time(NULL);
+
+	_ksr_ovl_timer = timer_alloc();
+	if(_ksr_ovl_timer == NULL) {
+		LM_ERR("failed to allocate the timer\n");
+		goto error;
+	}
+	timer_init(_ksr_ovl_timer, ksr_ovl_timer, 0, 0);
+	if(timer_add(_ksr_ovl_timer, MS_TO_TICKS(KSR_OVL_TIMER_INTERVAL)) < 0) {
+		LM_ERR("failed to add the timer\n");
+		timer_free(_ksr_ovl_timer);
+		_ksr_ovl_timer = NULL;
+		goto error;
+	}
+	_ksr_ovl_busy = &_ksr_ovl_state->busy;
+	return 0;
+
+error:
+	shm_free(_ksr_ovl_state);
+	_ksr_ovl_state = NULL;
+	return -1;
+}
+
+/**
+ *
+ */
+void ksr_ovl_destroy(void)
+{
+	_ksr_ovl_busy = NULL;
+	if(_ksr_ovl_timer != NULL) {
+		timer_del(_ksr_ovl_timer);
+		timer_free(_ksr_ovl_timer);
+		_ksr_ovl_timer = NULL;
+	}
+	if(_ksr_ovl_state != NULL) {
+		lock_destroy(&_ksr_ovl_state->lock);
+		shm_free(_ksr_ovl_state);
+		_ksr_ovl_state = NULL;
+	}
+}
+
+/**
+ *
+ */
+struct via_param *ksr_ovl_reply_via_params(
+		struct via_body *via, str *ocval, str *params)
+{
+	static char ocbuf[8];
+	static char pbuf[80];
+	via_param_t *vp;
+
+	if(_ksr_ovl_state == NULL || via == NULL) {
+		return NULL;
+	}
+	for(vp = via->param_lst; vp != NULL; vp = vp->next) {
+		if(vp->name.len == 2 && strncasecmp(vp->name.s, "oc", 2) == 0) {
+			break;
+		}
+	}
+	if(vp == NULL || vp->value.len > 0) {
+		/* upstream does not support overload control */
+		return NULL;
+	}
+	ocval->len = snprintf(ocbuf, sizeof(ocbuf), "=%d",
+			_ksr_ovl_state->reduction);
+	ocval->s = ocbuf;
+	params->len = snprintf(pbuf, sizeof(pbuf),
+			";oc-validity=%d;oc-seq=%u;oc-algo=\"%.*s\"",
+			(_ksr_ovl_state->reduction > 0) ? ksr_ovl_validity : 0,
+			_ksr_ovl_state->seq, _ksr_ovl_algo.len, _ksr_ovl_algo.s);
+	if(params->len <= 0 || params->len >= sizeof(pbuf)) {
+		LM_ERR("failed to build the overload control params\n");
+		return NULL;
+	}
+	params->s = pbuf;
+	return vp;
+}
+
+#define ksr_ovl_dst_idx(_su, _proto)                                \
+	((get_hash1_raw((char *)&(_su)->s, sockaddru_len(*(_su))) + (_proto)) \
+			& (KSR_OVL_DST_SIZE - 1))
+
+/**
+ *
+ */
+void ksr_ovl_reply_received(sip_msg_t *msg)
+{
+	via_oc_t oc;
+	ksr_ovl_dst_t *d;
+	unsigned int idx;
+	unsigned int reduction;
+	ticks_t now;
+	ticks_t expires;
+
+	if(_ksr_ovl_state == NULL || msg->via1 == NULL) {
+		return;
+	}
+	if(parse_via_oc(msg, msg->via1, &oc) < 0 || oc.oc != 2) {
+		return;
+	}
+	if(oc.algo.len > 0
+			&& !(oc.algo.len >= _ksr_ovl_algo.len
+					&& strncasecmp(oc.algo.s + ((oc.algo.s[0] == '"') ? 1 : 0),
+							   _ksr_ovl_algo.s, _ksr_ovl_algo.len)
+							   == 0)) {
+		LM_DBG("unsupported overload control algorithm [%.*s]\n",
+				oc.algo.len, oc.algo.s);
+		return;
+	}
+	if(str2int(&oc.ocval, &reduction) < 0) {
+		LM_DBG("invalid oc value [%.*s]\n", oc.ocval.len, oc.ocval.s);
+		return;
+	}
+	if(reduction > 100) {
+		reduction = 100;
+	}
+
+	now = get_ticks_raw();
+	expires = now + MS_TO_TICKS(oc.validity);
+	idx = ksr_ovl_dst_idx(&msg->rcv.src_su, msg->rcv.proto);
+	d = &_ksr_ovl_state->dst[idx];
+
+	lock_get(&_ksr_ovl_state->lock);
+	if(d->proto == msg->rcv.proto && su_cmp(&d->to, &msg->rcv.src_su)
+			&& TICKS_LT(now, d->expires) && oc.seq < d->seq) {
+		/* older value */
+		lock_release(&_ksr_ovl_state->lock);
+		return;
+	}
+	d->to = msg->rcv.src_su;
+	d->proto = msg->rcv.proto;
+	d->reduction = (oc.validity > 0) ? (int)reduction : 0;
+	d->seq = oc.seq;
+	d->expires = expires;
+	if(d->reduction > 0 && TICKS_GT(expires, _ksr_ovl_state->dst_expires)) {
+		_ksr_ovl_state->dst_expires = expires;
+	}
+	lock_release(&_ksr_ovl_state->lock);
+}
+
+/**
+ *
+ */
+int ksr_ovl_dst_reject(struct dest_info *dst, sip_msg_t *msg)
+{
+	ksr_ovl_dst_t *d;
+	unsigned int idx;
+	ticks_t now;
+	int reduction = 0;
+
+	if(_ksr_ovl_state == NULL) {
+		return 0;
+	}
+	now = get_ticks_raw();
+	if(TICKS_GE(now, _ksr_ovl_state->dst_expires)) {
+		/* no destination is overloaded */
+		return 0;
+	}
+	if(msg == NULL) {
+		/* locally generated request (e.g., BYE) - never dropped */
+		return 0;
+	}
+	/* only initial requests are dropped */
+	if(msg->first_line.type != SIP_REQUEST
+			|| (msg->REQ_METHOD & (METHOD_ACK | METHOD_CANCEL))) {
+		return 0;
+	}
+	if(parse_headers(msg, HDR_TO_F, 0) < 0 || msg->to == NULL
+			|| get_to(msg)->tag_value.len > 0) {
+		return 0;
+	}
+
+	idx = ksr_ovl_dst_idx(&dst->to, dst->proto);
+	d = &_ksr_ovl_state->dst[idx];
+	lock_get(&_ksr_ovl_state->lock);
+	if(d->proto == dst->proto && su_cmp(&d->to, &dst->to)
+			&& TICKS_LT(now, d->expires)) {
+		reduction = d->reduction;
+	}
+	lock_release(&_ksr_ovl_state->lock);
+
+	if(reduction <= 0) {
+		return 0;
+	}
+	return ((kam_rand() % 100) < reduction) ? 1 : 0;
+}
+
+/**
+ *
+ */
+void ksr_ovl_get_info(int *load, int *busy, int *udpq, int *reduction,
+		unsigned int *seq, int *dsts)
+{
+	ticks_t now;
+	int i;
+
+	*load = *busy = *udpq = *reduction = *dsts = 0;
+	*seq = 0;
+	if(_ksr_ovl_state == NULL) {
+		return;
+	}
+	*load = _ksr_ovl_state->load;
+	*busy = _ksr_ovl_state->busy_avg;
+	*udpq = _ksr_ovl_state->udpq;
+	*reduction = _ksr_ovl_state->reduction;
+	*seq = _ksr_ovl_state->seq;
+	now = get_ticks_raw();
+	lock_get(&_ksr_ovl_state->lock);
+	for(i = 0; i < KSR_OVL_DST_SIZE; i++) {
+		if(_ksr_ovl_state->dst[i].reduction > 0
+				&& TICKS_LT(now, _ksr_ovl_state->dst[i].expires)) {
+			(*dsts)++;
+		}
+	}
+	lock_release(&_ksr_ovl_state->lock);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: SIP overload control (RFC 7339, loss based).
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#ifndef _overload_ctl_h_
+#define _overload_ctl_h_
+
+#include "atomic_ops.h"
+#include "ip_addr.h"
+#include "compiler_opt.h"
+#include "parser/msg_parser.h"
+
+#define KSR_OVL_LOAD_SIZE 4 /**< max number of external load sources */
+
+/** external load source - returns load in percents (0..100) */
+typedef int (*ksr_ovl_load_f)(void);
+
+typedef struct ksr_ovl_state ksr_ovl_state_t;
+
+extern int ksr_ovl_mode;
+extern int ksr_ovl_target;
+extern int ksr_ovl_validity;
+extern ksr_ovl_state_t *_ksr_ovl_state;
+extern atomic_t *_ksr_ovl_busy;
+
+int ksr_ovl_init(void);
+void ksr_ovl_destroy(void);
+
+/** register an external load source (e.g., from mod_init) */
+int ksr_ovl_register_load(char *name, ksr_ovl_load_f f);
+
+/** workers processing a message now - wrapped around receive_msg() */
+#define ksr_ovl_busy_inc()                \
+	do {                                  \
+		if(unlikely(_ksr_ovl_busy != NULL)) \
+			atomic_inc(_ksr_ovl_busy);      \
+	} while(0)
+
+#define ksr_ovl_busy_dec()                \
+	do {                                  \
+		if(unlikely(_ksr_ovl_busy != NULL)) \
+			atomic_dec(_ksr_ovl_busy);      \
+	} while(0)
+
+/** overload control values for the Via of upstream in a local or relayed
+ * reply - returns the 'oc' Via param to get the value or NULL if nothing
+ * has to be added */
+struct via_param *ksr_ovl_reply_via_params(
+		struct via_body *via, str *ocval, str *params);
+
+/** store the overload control params from a received reply */
+void ksr_ovl_reply_received(sip_msg_t *msg);
+
+/** return 1 if the request has to be dropped for the destination - only
+ * initial requests received from the network (msg not NULL) are dropped */
+int ksr_ovl_dst_reject(struct dest_info *dst, sip_msg_t *msg);
+
+/** load values for rpc */
+void ksr_ovl_get_info(int *load, int *busy, int *udpq, int *reduction,
+		unsigned int *seq, int *dsts);
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: per process receive and processing time statistics.
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ *
+ * The counters are kept per process in the 'rcv' group of the counters
+ * framework, so they are updated without locking. The script execution
+ * time is accounted in a fixed set of histogram buckets. The queue latency
+ * is the time from the moment the message was received (kernel timestamp
+ * for UDP when SO_TIMESTAMPNS is enabled, start of reading for TCP) till
+ * the routing script is started.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "rcv_stats.h"
+#include "counters.h"
+#include "dprint.h"
+
+int ksr_rcv_stats_mode = 0;
+struct timespec ksr_rcv_tsin = {0, 0};
+
+const unsigned int ksr_rcv_stats_bounds[KSR_RCV_STATS_BUCKETS] = {
+		100, 1000, 10000, 100000, 1000000, 0};
+
+static struct rcv_counters_h
+{
+	counter_handle_t msgs;
+	counter_handle_t busy_us;
+	counter_handle_t route_us;
+	counter_handle_t route_buckets[KSR_RCV_STATS_BUCKETS];
+	counter_handle_t queue_msgs;
+	counter_handle_t queue_us;
+} rcv_cnts_h;
+
+/* rcv counters definitions */
+static counter_def_t rcv_cnt_defs[] = {
+		{&rcv_cnts_h.msgs, "msgs", 0, 0, 0,
+				"number of messages handled by the receive function."},
+		{&rcv_cnts_h.busy_us, "busy_us", 0, 0, 0,
+				"time spent processing received messages (usec)."},
+		{&rcv_cnts_h.route_us, "route_us", 0, 0, 0,
+				"time spent executing request and reply routes (usec)."},
+		{&rcv_cnts_h.route_buckets[0], "route_lt_100us", 0, 0, 0,
+				"routes executed in less than 100 usec."},
+		{&rcv_cnts_h.route_buckets[1], "route_lt_1ms", 0, 0, 0,
+				"routes executed in 100 usec to 1 msec."},
+		{&rcv_cnts_h.route_buckets[2], "route_lt_10ms", 0, 0, 0,
+				"routes executed in 1 to 10 msec."},
+		{&rcv_cnts_h.route_buckets[3], "route_lt_100ms", 0, 0, 0,
+				"routes executed in 10 to 100 msec."},
+		{&rcv_cnts_h.route_buckets[4], "route_lt_1s", 0, 0, 0,
+				"routes executed in 100 msec to 1 sec."},
+		{&rcv_cnts_h.route_buckets[5], "route_ge_1s", 0, 0, 0,
+				"routes executed in 1 sec or more."},
+		{&rcv_cnts_h.queue_msgs, "queue_msgs", 0, 0, 0,
+				"number of messages with a receive timestamp."},
+		{&rcv_cnts_h.queue_us, "queue_us", 0, 0, 0,
+				"time from receiving the message till running the routing "
+				"script (usec)."},
+		{0, 0, 0, 0, 0, 0}};
+
+
+/**
+ * register the counters - must be called before forking
+ */
+int ksr_rcv_stats_init(void)
+{
+	if(ksr_rcv_stats_mode == 0) {
+		return 0;
+	}
+	if(counter_register_array("rcv", rcv_cnt_defs) < 0) {
+		LM_ERR("failed to register the receive counters\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * enable kernel receive timestamps on socket
+ */
+int ksr_rcv_stats_sockopt(int fd)
+{
+#ifdef SO_TIMESTAMPNS
+	int optval = 1;
+
+	if(ksr_rcv_stats_mode != 2) {
+		return 0;
+	}
+	if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, (void *)&optval,
+			   sizeof(optval))
+			== -1) {
+		LM_WARN("setsockopt(SO_TIMESTAMPNS) on fd %d: %s\n", fd,
+				strerror(errno));
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+static inline unsigned long ksr_rcv_stats_diff(
+		struct timespec *tb, struct timespec *te)
+{
+	long d;
+
+	d = (te->tv_sec - tb->tv_sec) * 1000000L
+		+ (te->tv_nsec - tb->tv_nsec) / 1000L;
+	return (d > 0) ? (unsigned long)d : 0;
+}
+
+/**
+ * routing script is about to be executed - account the queue latency
+ * and start the route time measurement
+ */
+void ksr_rcv_stats_route_start(struct timespec *ts)
+{
+	struct timespec tnow;
+
+	if(ksr_rcv_tsin.tv_sec != 0) {
+		clock_gettime(CLOCK_REALTIME, &tnow);
+		counter_inc(rcv_cnts_h.queue_msgs);
+		counter_add(
+				rcv_cnts_h.queue_us, ksr_rcv_stats_diff(&ksr_rcv_tsin, &tnow));
+		ksr_rcv_tsin.tv_sec = 0;
+		ksr_rcv_tsin.tv_nsec = 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+/**
+ * routing script executed - account its duration
+ */
+void ksr_rcv_stats_route_end(struct timespec *ts)
+{
+	struct timespec tnow;
+	unsigned long d;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &tnow);
+	d = ksr_rcv_stats_diff(ts, &tnow);
+	counter_add(rcv_cnts_h.route_us, d);
+	for(i = 0; i < KSR_RCV_STATS_BUCKETS - 1; i++) {
+		if(d < ksr_rcv_stats_bounds[i]) {
+			break;
+		}
+	}
+	counter_inc(rcv_cnts_h.route_buckets[i]);
+}
+
+/**
+ * processing of the received message done
+ */
+void ksr_rcv_stats_done(struct timespec *ts)
+{
+	struct timespec tnow;
+
+	clock_gettime(CLOCK_MONOTONIC, &tnow);
+	counter_inc(rcv_cnts_h.msgs);
+	counter_add(rcv_cnts_h.busy_us, ksr_rcv_stats_diff(ts, &tnow));
+	/* not consumed by the routing script (e.g., parse error) */
+	ksr_rcv_tsin.tv_sec = 0;
+	ksr_rcv_tsin.tv_nsec = 0;
+}
+
+/**
+ * get the counters of process p_no
+ */
+int ksr_rcv_stats_get(int p_no, ksr_rcv_stats_info_t *info)
+{
+	int i;
+
+	if(ksr_rcv_stats_mode == 0) {
+		return -1;
+	}
+	memset(info, 0, sizeof(ksr_rcv_stats_info_t));
+	info->msgs = counter_pprocess_val(p_no, rcv_cnts_h.msgs);
+	info->busy_us = counter_pprocess_val(p_no, rcv_cnts_h.busy_us);
+	info->route_us = counter_pprocess_val(p_no, rcv_cnts_h.route_us);
+	for(i = 0; i < KSR_RCV_STATS_BUCKETS; i++) {
+		info->route_buckets[i] =
+				counter_pprocess_val(p_no, rcv_cnts_h.route_buckets[i]);
+	}
+	info->queue_msgs = counter_pprocess_val(p_no, rcv_cnts_h.queue_msgs);
+	info->queue_us = counter_pprocess_val(p_no, rcv_cnts_h.queue_us);
+	return 0;
+}
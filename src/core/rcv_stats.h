@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/** Kamailio core :: per process receive and processing time statistics.
+ * @file
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#ifndef _rcv_stats_h_
+#define _rcv_stats_h_
+
+#include <time.h>
+
+#include "compiler_opt.h"
+
+/** route execution time histogram buckets (exclusive upper bounds in usec,
+ * named lt_* and ge_* for the last one) */
+#define KSR_RCV_STATS_BUCKETS 6
+
+typedef struct ksr_rcv_stats_info
+{
+	unsigned long msgs;	   /**< messages handled by receive_msg() */
+	unsigned long busy_us; /**< time spent inside receive_msg() */
+	unsigned long route_us; /**< time spent executing the routing script */
+	unsigned long route_buckets[KSR_RCV_STATS_BUCKETS];
+	unsigned long queue_msgs; /**< messages with a receive timestamp */
+	unsigned long queue_us;	  /**< time from receive timestamp to script */
+} ksr_rcv_stats_info_t;
+
+/** 0 - off; 1 - processing time stats; 2 - also kernel udp timestamps */
+extern int ksr_rcv_stats_mode;
+/** receive timestamp of the message being processed (realtime clock) */
+extern struct timespec ksr_rcv_tsin;
+extern const unsigned int ksr_rcv_stats_bounds[KSR_RCV_STATS_BUCKETS];
+
+int ksr_rcv_stats_init(void);
+int ksr_rcv_stats_sockopt(int fd);
+
+void ksr_rcv_stats_route_start(struct timespec *ts);
+void ksr_rcv_stats_route_end(struct timespec *ts);
+void ksr_rcv_stats_done(struct timespec *ts);
+int ksr_rcv_stats_get(int p_no, ksr_rcv_stats_info_t *info);
+
+/** start of processing time measurement - at the top of receive_msg() */
+#define ksr_rcv_stats_start(ts)                          \
+	do {                                                 \
+		if(unlikely(ksr_rcv_stats_mode != 0))            \
+			clock_gettime(CLOCK_MONOTONIC, (ts));        \
+	} while(0)
+
+#endif
@@ -56,6 +56,8 @@
 #include "cfg/cfg.h"
 #include "core_stats.h"
 #include "kemi.h"
+#include "overload_ctl.h"
+#include "rcv_stats.h"
 
 #ifdef DEBUG_DMALLOC
 #include <mem/dmalloc.h>
@@ -310,6 +312,7 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 	unsigned int cidlockset = 0;
 	int errsipmsg = 0;
 	int exectime = 0;
+	struct timespec tsb = {0}, tsr = {0};
 
 	if(rcv_info->bind_address == NULL) {
 		LM_ERR("critical - incoming message without local socket [%.*s ...]\n",
@@ -317,6 +320,9 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 		return -1;
 	}
 
+	ksr_ovl_busy_inc();
+	ksr_rcv_stats_start(&tsb);
+
 	if(ksr_evrt_received_mode != 0) {
 		if(ksr_evrt_received(buf, &len, rcv_info) < 0) {
 			LM_DBG("dropping the received message\n");
@@ -484,6 +490,9 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 		 * (like presence of at least one via), so you can count
 		 * on via1 being parsed in a pre-script callback --andrei
 		*/
+		if(unlikely(ksr_rcv_stats_mode != 0)) {
+			ksr_rcv_stats_route_start(&tsr);
+		}
 		if(exec_pre_script_cb(msg, REQUEST_CB_TYPE) == 0) {
 			STATS_REQ_FWD_DROP();
 			goto end; /* drop the request */
@@ -534,6 +543,9 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 						"request-route executed in: %d usec\n", diff);
 			}
 		}
+		if(unlikely(ksr_rcv_stats_mode != 0)) {
+			ksr_rcv_stats_route_end(&tsr);
+		}
 
 		/* execute post request-script callbacks */
 		exec_post_script_cb(msg, REQUEST_CB_TYPE);
@@ -558,6 +570,10 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 			gettimeofday(&tvb, NULL);
 		}
 
+		if(ksr_ovl_mode != 0) {
+			ksr_ovl_reply_received(msg);
+		}
+
 		/* execute pre-script callbacks, if any; -jiri */
 		/* if some of the callbacks said not to continue with
 		 * script processing, don't do so
@@ -565,6 +581,9 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 		 * (like presence of at least one via), so you can count
 		 * on via1 being parsed in a pre-script callback --andrei
 		*/
+		if(unlikely(ksr_rcv_stats_mode != 0)) {
+			ksr_rcv_stats_route_start(&tsr);
+		}
 		if(exec_pre_script_cb(msg, ONREPLY_CB_TYPE) == 0) {
 			STATS_RPL_FWD_DROP();
 			goto end; /* drop the reply */
@@ -627,6 +646,9 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 						"reply-route executed in: %d usec\n", diff);
 			}
 		}
+		if(unlikely(ksr_rcv_stats_mode != 0)) {
+			ksr_rcv_stats_route_end(&tsr);
+		}
 
 		/* execute post reply-script callbacks */
 		exec_post_script_cb(msg, ONREPLY_CB_TYPE);
@@ -639,6 +661,10 @@ end:
 	pkg_free(msg);
 	/* reset log prefix */
 	log_prefix_set(NULL);
+	ksr_ovl_busy_dec();
+	if(unlikely(ksr_rcv_stats_mode != 0)) {
+		ksr_rcv_stats_done(&tsb);
+	}
 	return 0;
 
 #ifndef NO_ONREPLY_ROUTE_ERROR
@@ -659,6 +685,10 @@ error00:
 	ksr_msg_env_reset();
 	/* reset log prefix */
 	log_prefix_set(NULL);
+	ksr_ovl_busy_dec();
+	if(unlikely(ksr_rcv_stats_mode != 0)) {
+		ksr_rcv_stats_done(&tsb);
+	}
 	return -1;
 }
 
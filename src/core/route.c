@@ -736,6 +736,8 @@ int fix_actions(struct action *a)
 					*/
 					if((ret = fix_rval_expr(t->val[0].u.data)) < 0)
 						goto error;
+					if((ret = rve_compile(rve)) < 0)
+						goto error;
 				}
 				if((t->val[1].type == ACTIONS_ST) && (t->val[1].u.data)) {
 					if((ret = fix_actions((struct action *)t->val[1].u.data))
@@ -814,6 +816,8 @@ int fix_actions(struct action *a)
 					}
 					if((ret = fix_rval_expr(t->val[0].u.data)) < 0)
 						goto error;
+					if((ret = rve_compile(rve)) < 0)
+						goto error;
 				} else {
 					LM_CRIT("null while() expression\n");
 					ret = E_BUG;
@@ -858,6 +862,8 @@ int fix_actions(struct action *a)
 					}
 					if((ret = fix_rval_expr(t->val[0].u.data)) < 0)
 						goto error;
+					if((ret = rve_compile(rve)) < 0)
+						goto error;
 				} else {
 					LM_CRIT("null drop/return expression\n");
 					ret = E_BUG;
@@ -85,6 +85,10 @@
 /* control return code evaluation mode */
 int ksr_return_mode = 0;
 
+/* compile the integer expressions of the script to bytecode:
+ * 0 - no, 1 - yes, 2 - yes and check the results with the interpreter */
+int ksr_expr_bytecode = 0;
+
 inline static void rval_force_clean(struct rvalue *rv)
 {
 	if(rv->flags & RV_CNT_ALLOCED_F) {
@@ -193,6 +197,8 @@ void rve_destroy(struct rval_expr *rve)
 			if(rve->right.rve)
 				rve_destroy(rve->right.rve);
 		}
+		if(rve->code)
+			pkg_free(rve->code);
 		pkg_free(rve);
 	}
 }
@@ -1833,13 +1839,13 @@ inline static int long_rve_defined(struct run_act_ctx *h, struct sip_msg *msg,
 }
 
 
-/** evals a long expr to a long.
+/** evals a long expr to a long, walking the expression tree.
  *
  *  *res=(int)eval(rve)
  *  @return 0 on success, \<0 on error
  */
-int rval_expr_eval_long(struct run_act_ctx *h, struct sip_msg *msg, long *res,
-		struct rval_expr *rve)
+static int rval_expr_eval_long_tree(struct run_act_ctx *h,
+		struct sip_msg *msg, long *res, struct rval_expr *rve)
 {
 	long i1, i2, ret;
 	struct rval_cache c1, c2;
@@ -2093,6 +2099,494 @@ int rval_expr_eval_long(struct run_act_ctx *h, struct sip_msg *msg, long *res,
 }
 
 
+/*
+ * Bytecode of the integer expressions.
+ *
+ * The conditions of if, while and return are evaluated for each message
+ * by walking their expression tree, with a switch on the operator and a
+ * recursive call for each node. rve_compile() lowers the integer part of
+ * such an expression, after it was fixed up and optimized (constants
+ * folded), to a flat sequence of instructions working on a small array
+ * of registers: the operands of an operator are computed in the
+ * registers following its own, && and || become conditional jumps and
+ * the pvars are read through their already parsed spec. The operators
+ * with string or undefined value semantics (==, !=, string functions,
+ * defined, ...) stay a single instruction evaluating their subtree with
+ * the interpreter, so the result is always the one of
+ * rval_expr_eval_long_tree().
+ *
+ * Only the expressions are compiled: the actions, including the if and
+ * while owning them, are still run by run_actions() and do_action(). A
+ * condition like $var(a) > 5 && $var(b) < 10 takes about a third of the
+ * time of the tree walk (see test/misc/code/rve_bytecode_bench.c), a
+ * comparison with == or != of a pvar is left to the interpreter and not
+ * compiled at all.
+ */
+
+/** max number of registers of a compiled expression */
+#define RVE_CODE_REGS 16
+/** max number of instructions of a compiled expression */
+#define RVE_CODE_MAX 256
+
+enum rve_code_op
+{
+	RVC_LOADK,	/**< r[d] = constant */
+	RVC_LOADPV,	 /**< r[d] = (long)getf(param) */
+	RVC_LOADPVT, /**< r[d] = (long)trans(getf(param)) */
+	RVC_LOADRV, /**< r[d] = (long)rval (avp, select, string, ...) */
+	RVC_EVAL,	/**< r[d] = subexpression, with the interpreter */
+	RVC_JZ,		/**< if(!r[d]) goto jmp */
+	RVC_JNZ,	/**< if(r[d]) { r[d] = 1; goto jmp } */
+	RVC_UMINUS, /**< r[d] = -r[d] */
+	RVC_BOOL,	/**< r[d] = !!r[d] */
+	RVC_LNOT,	/**< r[d] = !r[d] */
+	RVC_BNOT,	/**< r[d] = ~r[d] */
+	RVC_MUL,	/**< r[d] = r[d] * r[d+1], same for the ops below */
+	RVC_DIV,
+	RVC_MOD,
+	RVC_PLUS,
+	RVC_MINUS,
+	RVC_BOR,
+	RVC_BAND,
+	RVC_BXOR,
+	RVC_BLSHIFT,
+	RVC_BRSHIFT,
+	RVC_GT,
+	RVC_GTE,
+	RVC_LT,
+	RVC_LTE,
+	RVC_EQ,
+	RVC_DIFF
+};
+
+struct rve_instr
+{
+	unsigned short op; /**< enum rve_code_op */
+	unsigned short d;  /**< destination register */
+	union
+	{
+		long l;				   /**< constant */
+		int jmp;			   /**< index of the jump target */
+		struct rval_expr *rve; /**< rval or subexpression */
+		struct
+		{
+			pv_getf_t getf;		   /**< get function of the pvar */
+			pv_param_t *param;	   /**< parsed name and index */
+			trans_t *trans;		   /**< transformations, if any */
+			struct rval_expr *rve; /**< rval, for string values */
+		} pv;
+	} u;
+};
+
+struct rve_code
+{
+	int n;	  /**< number of instructions */
+	int pure; /**< no function call, can be evaluated twice */
+	struct rve_instr ins[1];
+};
+
+
+/** returns the instruction for a binary integer operator, -1 if none. */
+static int rve_code_op2(enum rval_expr_op op)
+{
+	switch(op) {
+		case RVE_MUL_OP:
+			return RVC_MUL;
+		case RVE_DIV_OP:
+			return RVC_DIV;
+		case RVE_MOD_OP:
+			return RVC_MOD;
+		case RVE_PLUS_OP: /* int in an int context */
+		case RVE_IPLUS_OP:
+			return RVC_PLUS;
+		case RVE_MINUS_OP:
+			return RVC_MINUS;
+		case RVE_BOR_OP:
+			return RVC_BOR;
+		case RVE_BAND_OP:
+			return RVC_BAND;
+		case RVE_BXOR_OP:
+			return RVC_BXOR;
+		case RVE_BLSHIFT_OP:
+			return RVC_BLSHIFT;
+		case RVE_BRSHIFT_OP:
+			return RVC_BRSHIFT;
+		case RVE_GT_OP:
+			return RVC_GT;
+		case RVE_GTE_OP:
+			return RVC_GTE;
+		case RVE_LT_OP:
+			return RVC_LT;
+		case RVE_LTE_OP:
+			return RVC_LTE;
+		case RVE_IEQ_OP:
+			return RVC_EQ;
+		case RVE_IDIFF_OP:
+			return RVC_DIFF;
+		default:
+			return -1;
+	}
+}
+
+
+/** generates the code evaluating rve in register d.
+ * @return 0 on success, -1 if the expression is too big
+ */
+static int rve_code_gen(
+		struct rve_instr *ins, int *n, struct rval_expr *rve, int d)
+{
+	struct rvalue *rv;
+	int op, j;
+
+#define RVC_EMIT(o)                           \
+	do {                                      \
+		if(unlikely(*n >= RVE_CODE_MAX))      \
+			return -1;                        \
+		memset(&ins[*n], 0, sizeof(*ins));    \
+		ins[*n].op = (o);                     \
+		ins[*n].d = d;                        \
+		(*n)++;                               \
+	} while(0)
+
+	if(d >= RVE_CODE_REGS - 1)
+		return -1;
+	switch(rve->op) {
+		case RVE_RVAL_OP:
+			rv = &rve->left.rval;
+			if(rv->type == RV_LONG) {
+				RVC_EMIT(RVC_LOADK);
+				ins[*n - 1].u.l = rv->v.l;
+			} else if(rv->type == RV_PVAR && rv->v.pvs.getf != NULL
+					  && rv->v.pvs.type != PVT_NONE) {
+				/* the accessor of the spec is resolved here, the code
+				 * calls it directly */
+				RVC_EMIT(rv->v.pvs.trans ? RVC_LOADPVT : RVC_LOADPV);
+				ins[*n - 1].u.pv.getf = rv->v.pvs.getf;
+				ins[*n - 1].u.pv.param = &rv->v.pvs.pvp;
+				ins[*n - 1].u.pv.trans = (trans_t *)rv->v.pvs.trans;
+				ins[*n - 1].u.pv.rve = rve;
+			} else {
+				RVC_EMIT(RVC_LOADRV);
+				ins[*n - 1].u.rve = rve;
+			}
+			return 0;
+		case RVE_LONG_OP:
+			return rve_code_gen(ins, n, rve->left.rve, d);
+		case RVE_UMINUS_OP:
+		case RVE_BOOL_OP:
+		case RVE_LNOT_OP:
+		case RVE_BNOT_OP:
+			if(rve_code_gen(ins, n, rve->left.rve, d) < 0)
+				return -1;
+			if(rve->op == RVE_UMINUS_OP)
+				RVC_EMIT(RVC_UMINUS);
+			else if(rve->op == RVE_BOOL_OP)
+				RVC_EMIT(RVC_BOOL);
+			else if(rve->op == RVE_LNOT_OP)
+				RVC_EMIT(RVC_LNOT);
+			else
+				RVC_EMIT(RVC_BNOT);
+			return 0;
+		case RVE_LAND_OP:
+		case RVE_LOR_OP:
+			if(rve_code_gen(ins, n, rve->left.rve, d) < 0)
+				return -1;
+			j = *n;
+			RVC_EMIT((rve->op == RVE_LAND_OP) ? RVC_JZ : RVC_JNZ);
+			if(rve_code_gen(ins, n, rve->right.rve, d) < 0)
+				return -1;
+			RVC_EMIT(RVC_BOOL);
+			ins[j].u.jmp = *n;
+			return 0;
+		default:
+			op = rve_code_op2(rve->op);
+			if(op < 0) {
+				/* not an integer operator => interpreter */
+				RVC_EMIT(RVC_EVAL);
+				ins[*n - 1].u.rve = rve;
+				return 0;
+			}
+			if(rve_code_gen(ins, n, rve->left.rve, d) < 0)
+				return -1;
+			if(rve_code_gen(ins, n, rve->right.rve, d + 1) < 0)
+				return -1;
+			RVC_EMIT(op);
+			return 0;
+	}
+#undef RVC_EMIT
+}
+
+
+/** returns 0 if the expression calls functions, 1 otherwise. */
+static int rve_code_pure(struct rval_expr *rve)
+{
+	if(rve == NULL)
+		return 1;
+	if(rve->op == RVE_RVAL_OP)
+		return rve->left.rval.type != RV_ACTION_ST
+			   && rve->left.rval.type != RV_BEXPR;
+	if(rve_op_unary(rve->op))
+		return rve_code_pure(rve->left.rve);
+	return rve_code_pure(rve->left.rve) && rve_code_pure(rve->right.rve);
+}
+
+
+/** runs the bytecode of an expression.
+ *
+ *  *res=(int)eval(rve)
+ *  @return 0 on success, \<0 on error
+ */
+static int rve_code_exec(struct run_act_ctx *h, struct sip_msg *msg,
+		long *res, struct rve_code *code)
+{
+	long r[RVE_CODE_REGS];
+	struct rve_instr *ins;
+	struct rve_instr *end;
+	struct rval_cache c;
+	pv_value_t pval;
+	int ret;
+
+	ret = 0;
+	ins = code->ins;
+	end = ins + code->n;
+	while(ins < end) {
+		switch(ins->op) {
+			case RVC_LOADK:
+				r[ins->d] = ins->u.l;
+				ret = 0;
+				break;
+			case RVC_LOADPV:
+			case RVC_LOADPVT:
+				/* same as rval_get_long() for a pvar */
+				r[ins->d] = 0;
+				ret = 0;
+				if(unlikely(msg == NULL))
+					break;
+				memset(&pval, 0, sizeof(pv_value_t));
+				if(unlikely((*ins->u.pv.getf)(msg, ins->u.pv.param, &pval) != 0))
+					break; /* undefined */
+				if(ins->op == RVC_LOADPVT
+						&& tr_exec(msg, ins->u.pv.trans, &pval) != 0)
+					break;
+				if(likely(pval.flags & PV_VAL_INT)) {
+					r[ins->d] = pval.ri;
+				} else if(pval.flags & PV_VAL_STR) {
+					/* conversion of the value, destroyed by the cache */
+					rval_cache_init(&c);
+					c.cache_type = RV_CACHE_PVAR;
+					c.val_type = RV_STR;
+					c.c.pval = pval;
+					ret = rval_get_long(h, msg, &r[ins->d],
+							&ins->u.pv.rve->left.rval, &c);
+					rval_cache_clean(&c);
+					rval_get_long_handle_ret(ret,
+							"rval expression conversion to int"
+							" failed",
+							ins->u.pv.rve);
+					if(unlikely(ret < 0))
+						return ret;
+					break;
+				}
+				pv_value_destroy(&pval);
+				break;
+			case RVC_LOADRV:
+				ret = rval_get_long(
+						h, msg, &r[ins->d], &ins->u.rve->left.rval, 0);
+				rval_get_long_handle_ret(ret,
+						"rval expression conversion to int"
+						" failed",
+						ins->u.rve);
+				if(unlikely(ret < 0))
+					return ret;
+				break;
+			case RVC_EVAL:
+				ret = rval_expr_eval_long(h, msg, &r[ins->d], ins->u.rve);
+				if(unlikely(ret < 0))
+					return ret;
+				break;
+			case RVC_JZ:
+				ret = 0;
+				if(r[ins->d] == 0) {
+					ins = code->ins + ins->u.jmp;
+					continue;
+				}
+				break;
+			case RVC_JNZ:
+				ret = 0;
+				if(r[ins->d]) {
+					r[ins->d] = 1;
+					ins = code->ins + ins->u.jmp;
+					continue;
+				}
+				break;
+			case RVC_UMINUS:
+				r[ins->d] = -r[ins->d];
+				ret = 0;
+				break;
+			case RVC_BOOL:
+				r[ins->d] = !!r[ins->d];
+				ret = 0;
+				break;
+			case RVC_LNOT:
+				r[ins->d] = !r[ins->d];
+				ret = 0;
+				break;
+			case RVC_BNOT:
+				r[ins->d] = ~r[ins->d];
+				ret = 0;
+				break;
+			case RVC_MUL:
+				r[ins->d] = r[ins->d] * r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_DIV:
+				if(unlikely(r[ins->d + 1] == 0)) {
+					LM_ERR("rv div by 0\n");
+					return -1;
+				}
+				r[ins->d] = r[ins->d] / r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_MOD:
+				if(unlikely(r[ins->d + 1] == 0)) {
+					LM_ERR("rv mod by 0\n");
+					return -1;
+				}
+				r[ins->d] = r[ins->d] % r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_PLUS:
+				r[ins->d] = r[ins->d] + r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_MINUS:
+				r[ins->d] = r[ins->d] - r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_BOR:
+				r[ins->d] = r[ins->d] | r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_BAND:
+				r[ins->d] = r[ins->d] & r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_BXOR:
+				r[ins->d] = r[ins->d] ^ r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_BLSHIFT:
+				r[ins->d] = r[ins->d] << r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_BRSHIFT:
+				r[ins->d] = r[ins->d] >> r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_GT:
+				r[ins->d] = r[ins->d] > r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_GTE:
+				r[ins->d] = r[ins->d] >= r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_LT:
+				r[ins->d] = r[ins->d] < r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_LTE:
+				r[ins->d] = r[ins->d] <= r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_EQ:
+				r[ins->d] = r[ins->d] == r[ins->d + 1];
+				ret = 0;
+				break;
+			case RVC_DIFF:
+				r[ins->d] = r[ins->d] != r[ins->d + 1];
+				ret = 0;
+				break;
+			default:
+				LM_BUG("invalid rve instruction %d\n", ins->op);
+				return -1;
+		}
+		ins++;
+	}
+	*res = r[0];
+	return ret;
+}
+
+
+/** evals a long expr to a long.
+ *
+ *  *res=(int)eval(rve)
+ *  @return 0 on success, \<0 on error
+ */
+int rval_expr_eval_long(struct run_act_ctx *h, struct sip_msg *msg, long *res,
+		struct rval_expr *rve)
+{
+	long v;
+	int ret, vret;
+
+	if(likely(rve->code == NULL))
+		return rval_expr_eval_long_tree(h, msg, res, rve);
+
+	ret = rve_code_exec(h, msg, res, rve->code);
+	if(unlikely(ksr_expr_bytecode == 2 && rve->code->pure)) {
+		vret = rval_expr_eval_long_tree(h, msg, &v, rve);
+		if(vret != ret || (ret >= 0 && v != *res)) {
+			LM_BUG("compiled expression (%d,%d-%d,%d) returned %ld (%d),"
+				   " interpreted %ld (%d)\n",
+					rve->fpos.s_line, rve->fpos.s_col, rve->fpos.e_line,
+					rve->fpos.e_col, *res, ret, v, vret);
+		}
+	}
+	return ret;
+}
+
+
+/** compiles a fixed up integer expression to bytecode.
+ * Done only if enabled by the expr_bytecode global parameter, for the
+ * expressions that are always evaluated as integer (conditions and
+ * return values). Expressions that would not be compiled to more than
+ * one instruction running the interpreter are left unchanged.
+ * @return 0 on success (compiled or not), -1 on error
+ */
+int rve_compile(struct rval_expr *rve)
+{
+	struct rve_instr ins[RVE_CODE_MAX];
+	struct rve_code *code;
+	int n;
+
+	if(ksr_expr_bytecode == 0 || rve == NULL || rve->code != NULL)
+		return 0;
+	n = 0;
+	if(rve_code_gen(ins, &n, rve, 0) < 0) {
+		LM_DBG("expression (%d,%d-%d,%d) too big, not compiled\n",
+				rve->fpos.s_line, rve->fpos.s_col, rve->fpos.e_line,
+				rve->fpos.e_col);
+		return 0;
+	}
+	if(n == 0 || (n == 1 && ins[0].op == RVC_EVAL))
+		return 0;
+	code = pkg_malloc(
+			sizeof(struct rve_code) + (n - 1) * sizeof(struct rve_instr));
+	if(code == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	code->n = n;
+	code->pure = rve_code_pure(rve);
+	memcpy(code->ins, ins, n * sizeof(struct rve_instr));
+	rve->code = code;
+	LM_DBG("expression (%d,%d-%d,%d) compiled to %d instructions\n",
+			rve->fpos.s_line, rve->fpos.s_col, rve->fpos.e_line,
+			rve->fpos.e_col, n);
+	return 0;
+}
+
+
 /**
  * @brief Evals a rval expression into an int or another rv(str)
  * @warning rv result (rv_res) must be rval_destroy()'ed if non-null
@@ -3424,6 +3918,7 @@ static int rve_optimize(struct rval_expr *rve)
 
 	ret = 0;
 	rv = 0;
+	memset(&tmp_rve, 0, sizeof(tmp_rve));
 	if(scr_opt_lev < 1)
 		return 0;
 	if(rve->op == RVE_RVAL_OP) /* if rval, nothing to do */
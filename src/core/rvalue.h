@@ -132,6 +132,8 @@ struct rvalue
 #define RV_RE_F 4		  /**< string is a RE with a valid v->re member */
 #define RV_RE_ALLOCED_F 8 /**< v->re.regex must be freed */
 
+struct rve_code;
+
 struct rval_expr
 {
 	enum rval_expr_op op;
@@ -146,6 +148,7 @@ struct rval_expr
 		struct rvalue rval;
 	} right;
 	struct cfg_pos fpos;
+	struct rve_code *code; /**< bytecode, see rve_compile() */
 };
 
 
@@ -337,4 +340,7 @@ void rve_destroy(struct rval_expr *rve);
 
 /** fix a rval_expr. */
 int fix_rval_expr(void *p);
+
+/** compiles a fixed up integer expression to bytecode, if enabled. */
+int rve_compile(struct rval_expr *rve);
 #endif /* _rvalue_h */
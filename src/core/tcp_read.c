@@ -74,6 +74,7 @@
 #include "events.h"
 #include "stun.h"
 #include "nonsip_hooks.h"
+#include "rcv_stats.h"
 
 #ifdef READ_HTTP11
 #define HTTP11CONTINUE "HTTP/1.1 100 Continue\r\nContent-Length: 0\r\n\r\n"
@@ -1608,6 +1609,12 @@ again:
 							   because we always alloc BUF_SIZE+1 */
 		*req->parsed = 0;
 
+		if(unlikely(ksr_rcv_stats_mode != 0) && req->tvrstart.tv_sec != 0) {
+			/* queue latency is measured from the start of reading */
+			ksr_rcv_tsin.tv_sec = req->tvrstart.tv_sec;
+			ksr_rcv_tsin.tv_nsec = req->tvrstart.tv_usec * 1000;
+		}
+
 		if(req->state == H_PING_CRLF) {
 			init_dst_from_rcv(&dst, &con->rcv);
 
@@ -59,6 +59,7 @@
 #include "events.h"
 #include "async_task.h"
 #include "stun.h"
+#include "rcv_stats.h"
 #ifdef USE_RAW_SOCKS
 #include "raw_sock.h"
 #endif /* USE_RAW_SOCKS */
@@ -609,6 +610,9 @@ int udp_init(struct socket_info *sock_info)
 	if(probe_max_send_buffer(sock_info->socket) == -1)
 		goto error;
 
+	/* failure is not critical, only the queue latency is not measured */
+	ksr_rcv_stats_sockopt(sock_info->socket);
+
 	if(bind(sock_info->socket, &addr->s, sockaddru_len(*addr)) == -1) {
 		LM_ERR("bind(%x, %p, %d) on %s: %s\n", sock_info->socket, &addr->s,
 				(unsigned)sockaddru_len(*addr), sock_info->address_str.s,
@@ -632,6 +636,47 @@ error:
 #define UDP_RCV_PRINTBUF_SIZE 512
 #define UDP_RCV_PRINT_LEN 100
 
+#ifdef SO_TIMESTAMPNS
+/**
+ * recvfrom() alternative that also gets the kernel receive timestamp
+ * into ksr_rcv_tsin
+ */
+static int udp_recvmsg_ts(int fd, char *buf, int size,
+		union sockaddr_union *from, unsigned int *fromlen)
+{
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cbuf[CMSG_SPACE(sizeof(struct timespec))];
+	int ret;
+
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	memset(&mh, 0, sizeof(struct msghdr));
+	mh.msg_name = from;
+	mh.msg_namelen = *fromlen;
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+
+	ret = recvmsg(fd, &mh, 0);
+	if(ret < 0) {
+		return ret;
+	}
+	*fromlen = mh.msg_namelen;
+	for(cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL;
+			cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+		if(cmsg->cmsg_level == SOL_SOCKET
+				&& cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+			memcpy(&ksr_rcv_tsin, CMSG_DATA(cmsg), sizeof(struct timespec));
+			break;
+		}
+	}
+	return ret;
+}
+#endif
+
 /**
  *
  */
@@ -669,8 +714,14 @@ int udp_rcv_loop()
 
 	for(;;) {
 		fromaddrlen = sizeof(union sockaddr_union);
-		len = recvfrom(bind_address->socket, buf, BUF_SIZE, 0,
-				(struct sockaddr *)fromaddr, &fromaddrlen);
+#ifdef SO_TIMESTAMPNS
+		if(unlikely(ksr_rcv_stats_mode == 2)) {
+			len = udp_recvmsg_ts(bind_address->socket, buf, BUF_SIZE,
+					fromaddr, &fromaddrlen);
+		} else
+#endif
+			len = recvfrom(bind_address->socket, buf, BUF_SIZE, 0,
+					(struct sockaddr *)fromaddr, &fromaddrlen);
 		if(len == -1) {
 			if(errno == EAGAIN) {
 				LM_DBG("packet with bad checksum received\n");
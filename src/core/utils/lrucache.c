@@ -0,0 +1,202 @@
+/*
+ * lrucache - per process caches of compiled expressions
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*!
+* \file
+* \brief core/utils :: Per process caches of compiled expressions
+* \ingroup core/utils
+* Module: \ref core/utils
+*/
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/hashes.h"
+
+#include "lrucache.h"
+
+/* offset of the data area in an item */
+#define KSR_LRU_DATA_OFF \
+	((sizeof(ksr_lru_item_t) + sizeof(long) - 1) & ~(sizeof(long) - 1))
+
+/**
+ *
+ */
+void ksr_lru_cache_init(ksr_lru_cache_t *c, unsigned int size,
+		unsigned int dsize, ksr_lru_compile_f fcompile, ksr_lru_free_f ffree,
+		void *param)
+{
+	memset(c, 0, sizeof(ksr_lru_cache_t));
+	c->size = (size > 0) ? size : 1;
+	c->dsize = (dsize + sizeof(long) - 1) & ~(sizeof(long) - 1);
+	c->fcompile = fcompile;
+	c->ffree = ffree;
+	c->param = param;
+}
+
+static void ksr_lru_unlink(ksr_lru_cache_t *c, ksr_lru_item_t *it)
+{
+	if(it->prev)
+		it->prev->next = it->next;
+	else
+		c->head = it->next;
+	if(it->next)
+		it->next->prev = it->prev;
+	else
+		c->tail = it->prev;
+	it->prev = it->next = NULL;
+}
+
+static void ksr_lru_push(ksr_lru_cache_t *c, ksr_lru_item_t *it)
+{
+	it->prev = NULL;
+	it->next = c->head;
+	if(c->head)
+		c->head->prev = it;
+	else
+		c->tail = it;
+	c->head = it;
+}
+
+static void ksr_lru_item_free(ksr_lru_cache_t *c, ksr_lru_item_t *it)
+{
+	if(c->ffree)
+		c->ffree(it, c->param);
+	pkg_free(it);
+}
+
+/* drop the least recently used item */
+static void ksr_lru_evict(ksr_lru_cache_t *c)
+{
+	ksr_lru_item_t *it;
+	ksr_lru_item_t **pit;
+
+	it = c->tail;
+	if(it == NULL)
+		return;
+	for(pit = &c->slots[it->hashid & (c->nslots - 1)]; *pit != NULL;
+			pit = &(*pit)->hnext) {
+		if(*pit == it) {
+			*pit = it->hnext;
+			break;
+		}
+	}
+	ksr_lru_unlink(c, it);
+	c->nitems--;
+	if(c->evictions)
+		counter_inc(*c->evictions);
+	ksr_lru_item_free(c, it);
+}
+
+/**
+ *
+ */
+ksr_lru_item_t *ksr_lru_cache_get(ksr_lru_cache_t *c, str *key, int flags)
+{
+	ksr_lru_item_t *it;
+	unsigned int hashid;
+	unsigned int n;
+
+	if(key == NULL || key->s == NULL || key->len < 0) {
+		return NULL;
+	}
+	if(c->slots == NULL) {
+		for(n = 16; n < c->size; n <<= 1)
+			;
+		c->slots = (ksr_lru_item_t **)pkg_malloc(n * sizeof(ksr_lru_item_t *));
+		if(c->slots == NULL) {
+			PKG_MEM_ERROR;
+			return NULL;
+		}
+		memset(c->slots, 0, n * sizeof(ksr_lru_item_t *));
+		c->nslots = n;
+	}
+
+	hashid = get_hash1_raw(key->s, key->len) + (unsigned int)flags;
+	for(it = c->slots[hashid & (c->nslots - 1)]; it != NULL; it = it->hnext) {
+		if(it->hashid == hashid && it->flags == flags
+				&& it->key.len == key->len
+				&& memcmp(it->key.s, key->s, key->len) == 0) {
+			if(it != c->head) {
+				ksr_lru_unlink(c, it);
+				ksr_lru_push(c, it);
+			}
+			if(c->hits)
+				counter_inc(*c->hits);
+			return it;
+		}
+	}
+	if(c->misses)
+		counter_inc(*c->misses);
+
+	it = (ksr_lru_item_t *)pkg_malloc(
+			KSR_LRU_DATA_OFF + c->dsize + key->len + 1);
+	if(it == NULL) {
+		PKG_MEM_ERROR;
+		return NULL;
+	}
+	memset(it, 0, KSR_LRU_DATA_OFF + c->dsize);
+	it->hashid = hashid;
+	it->flags = flags;
+	it->data = (char *)it + KSR_LRU_DATA_OFF;
+	it->key.s = (char *)it->data + c->dsize;
+	memcpy(it->key.s, key->s, key->len);
+	it->key.s[key->len] = '\0';
+	it->key.len = key->len;
+
+	/* compiled from the copy, the object can keep references to it */
+	if(c->fcompile(it, c->param) != 0) {
+		pkg_free(it);
+		return NULL;
+	}
+
+	while(c->nitems >= c->size) {
+		ksr_lru_evict(c);
+	}
+	it->hnext = c->slots[hashid & (c->nslots - 1)];
+	c->slots[hashid & (c->nslots - 1)] = it;
+	ksr_lru_push(c, it);
+	c->nitems++;
+
+	return it;
+}
+
+/**
+ *
+ */
+void ksr_lru_cache_destroy(ksr_lru_cache_t *c)
+{
+	ksr_lru_item_t *it;
+
+	while((it = c->tail) != NULL) {
+		ksr_lru_unlink(c, it);
+		ksr_lru_item_free(c, it);
+	}
+	c->nitems = 0;
+	if(c->slots != NULL) {
+		pkg_free(c->slots);
+		c->slots = NULL;
+	}
+	c->nslots = 0;
+}
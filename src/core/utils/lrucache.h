@@ -0,0 +1,111 @@
+/*
+ * lrucache - per process caches of compiled expressions
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*!
+* \file
+* \brief core/utils :: Per process caches of compiled expressions
+* \ingroup core/utils
+* Module: \ref core/utils
+*
+* Bounded cache in private memory of the objects compiled from strings
+* given at runtime (e.g., regular expressions taken from variables), the
+* least recently used one being dropped when it is full. The items are
+* looked up by the string and an integer with compile flags. The owner
+* gives the callbacks compiling and freeing the object, stored in the
+* item data area of the size given at init time.
+*/
+
+#ifndef _LRUCACHE_H_
+#define _LRUCACHE_H_
+
+#include "../../core/str.h"
+#include "../../core/counters.h"
+
+typedef struct ksr_lru_item
+{
+	unsigned int hashid;
+	int flags;
+	str key;				   /* zero terminated copy of the string */
+	void *data;				   /* compiled object, dsize bytes */
+	struct ksr_lru_item *hnext; /* next in the hash slot */
+	struct ksr_lru_item *prev;	/* previous in the lru list */
+	struct ksr_lru_item *next;	/* next in the lru list */
+} ksr_lru_item_t;
+
+/* compile it->key with it->flags into it->data - return 0 on success */
+typedef int (*ksr_lru_compile_f)(ksr_lru_item_t *it, void *param);
+/* release what the compile callback set in it->data */
+typedef void (*ksr_lru_free_f)(ksr_lru_item_t *it, void *param);
+
+typedef struct ksr_lru_cache
+{
+	ksr_lru_item_t **slots;
+	unsigned int nslots; /* power of two */
+	unsigned int nitems;
+	unsigned int size;	 /* max number of items */
+	unsigned int dsize;	 /* size of the data area of the items */
+	ksr_lru_item_t *head; /* most recently used */
+	ksr_lru_item_t *tail; /* least recently used */
+	ksr_lru_compile_f fcompile;
+	ksr_lru_free_f ffree;
+	void *param;
+	/* optional counters, incremented when set */
+	counter_handle_t *hits;
+	counter_handle_t *misses;
+	counter_handle_t *evictions;
+} ksr_lru_cache_t;
+
+/*!
+ * \brief Set the attributes of a cache
+ *
+ * No memory is allocated until the first ksr_lru_cache_get() of the
+ * process, so it can be done before forking.
+ * \param c cache
+ * \param size max number of items, at least 1
+ * \param dsize size of the data area of the items
+ * \param fcompile compile callback
+ * \param ffree free callback, called only for compiled items
+ * \param param given to the callbacks
+ */
+void ksr_lru_cache_init(ksr_lru_cache_t *c, unsigned int size,
+		unsigned int dsize, ksr_lru_compile_f fcompile, ksr_lru_free_f ffree,
+		void *param);
+
+/*!
+ * \brief Get the item of a string, compiling it if not in the cache
+ *
+ * The item is owned by the cache, it must not be freed and stays valid
+ * until at least size other strings are taken.
+ * \param c cache
+ * \param key string to be compiled
+ * \param flags compile flags, part of the lookup key
+ * \return cache item, NULL on error
+ */
+ksr_lru_item_t *ksr_lru_cache_get(ksr_lru_cache_t *c, str *key, int flags);
+
+/*!
+ * \brief Free all items of the cache of the current process
+ */
+void ksr_lru_cache_destroy(ksr_lru_cache_t *c);
+
+#endif
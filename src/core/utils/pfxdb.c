@@ -0,0 +1,299 @@
+/*
+ * pfxdb - read-only memory mapped prefix databases
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*!
+* \file
+* \brief core/utils :: Read-only memory mapped prefix databases
+* \ingroup core/utils
+* Module: \ref core/utils
+*/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/atomic_ops.h"
+
+#include "pfxdb.h"
+
+/* check that a section of n items of size isz fits in the file */
+static int pfxdb_section_ok(
+		pfxdb_hdr_t *hdr, uint64_t off, uint64_t n, uint64_t isz)
+{
+	if(off < sizeof(pfxdb_hdr_t) || (off & 7) != 0 || off > hdr->size)
+		return 0;
+	if(n > (hdr->size - off) / isz)
+		return 0;
+	return 1;
+}
+
+/**
+ * map a pfxdb file read-only, checking its header
+ */
+pfxdb_t *pfxdb_open(char *path)
+{
+	pfxdb_t *db = NULL;
+	pfxdb_hdr_t *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+	uint32_t i;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		LM_ERR("cannot open file [%s] (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+	if(fstat(fd, &st) < 0) {
+		LM_ERR("cannot stat file [%s] (%s)\n", path, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	if(st.st_size < (off_t)sizeof(pfxdb_hdr_t)) {
+		LM_ERR("file [%s] is too small (%ld)\n", path, (long)st.st_size);
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		LM_ERR("cannot mmap file [%s] (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+
+	hdr = (pfxdb_hdr_t *)map;
+	if(memcmp(hdr->magic, PFXDB_MAGIC, PFXDB_MAGIC_LEN) != 0
+			|| hdr->version != PFXDB_VERSION) {
+		LM_ERR("file [%s] is not a pfxdb file of version %d\n", path,
+				PFXDB_VERSION);
+		goto error;
+	}
+	if(hdr->size != (uint64_t)st.st_size) {
+		LM_ERR("file [%s] is truncated (%llu/%llu)\n", path,
+				(unsigned long long)st.st_size, (unsigned long long)hdr->size);
+		goto error;
+	}
+	if(!pfxdb_section_ok(hdr, hdr->tables_off, hdr->ntables,
+			   sizeof(pfxdb_table_t))
+			|| !pfxdb_section_ok(hdr, hdr->nodes_off, (uint64_t)hdr->nnodes + 1,
+					sizeof(pfxdb_node_t))
+			|| !pfxdb_section_ok(
+					hdr, hdr->refs_off, hdr->nrefs, sizeof(uint32_t))
+			|| !pfxdb_section_ok(
+					hdr, hdr->vals_off, hdr->nvals, sizeof(pfxdb_val_t))
+			|| !pfxdb_section_ok(hdr, hdr->strs_off, hdr->strs_size, 1)) {
+		LM_ERR("file [%s] has invalid sections\n", path);
+		goto error;
+	}
+
+	db = (pfxdb_t *)pkg_malloc(sizeof(pfxdb_t));
+	if(db == NULL) {
+		PKG_MEM_ERROR;
+		goto error;
+	}
+	db->map = map;
+	db->size = st.st_size;
+	db->hdr = hdr;
+	db->tables = (pfxdb_table_t *)((char *)map + hdr->tables_off);
+	db->nodes = (pfxdb_node_t *)((char *)map + hdr->nodes_off);
+	db->refs = (uint32_t *)((char *)map + hdr->refs_off);
+	db->vals = (pfxdb_val_t *)((char *)map + hdr->vals_off);
+	db->strs = (char *)map + hdr->strs_off;
+
+	for(i = 0; i < hdr->ntables; i++) {
+		if(db->tables[i].root >= hdr->nnodes
+				|| (uint64_t)db->tables[i].name + db->tables[i].namelen
+						   >= hdr->strs_size) {
+			LM_ERR("file [%s] has invalid table %u\n", path, i);
+			pkg_free(db);
+			goto error;
+		}
+	}
+
+	LM_DBG("mapped [%s]: %u tables, %u nodes, %u values (%lu bytes)\n", path,
+			hdr->ntables, hdr->nnodes, hdr->nrefs, (unsigned long)db->size);
+
+	return db;
+
+error:
+	munmap(map, st.st_size);
+	return NULL;
+}
+
+/**
+ * unmap a pfxdb file
+ */
+void pfxdb_close(pfxdb_t *db)
+{
+	if(db == NULL)
+		return;
+	munmap(db->map, db->size);
+	pkg_free(db);
+}
+
+/**
+ * index of the table with the given name, -1 if not found
+ */
+int pfxdb_table_get(pfxdb_t *db, str *name)
+{
+	pfxdb_table_t *t;
+	int l, h, m, ret;
+
+	l = 0;
+	h = db->hdr->ntables;
+	while(l < h) {
+		m = (l + h) >> 1;
+		t = &db->tables[m];
+		ret = memcmp(db->strs + t->name, name->s,
+				(t->namelen < name->len) ? t->namelen : name->len);
+		if(ret == 0 && t->namelen != name->len)
+			ret = (t->namelen < name->len) ? -1 : 1;
+		if(ret == 0)
+			return m;
+		if(ret < 0)
+			l = m + 1;
+		else
+			h = m;
+	}
+	return -1;
+}
+
+/**
+ * root node of a table
+ */
+pfxdb_node_t *pfxdb_root(pfxdb_t *db, int table)
+{
+	if(table < 0 || table >= db->hdr->ntables)
+		return NULL;
+	return &db->nodes[db->tables[table].root];
+}
+
+/**
+ * get the value i of a node
+ */
+int pfxdb_node_val(pfxdb_t *db, pfxdb_node_t *node, unsigned int i, str *val)
+{
+	pfxdb_val_t *v;
+	uint32_t r;
+
+	if(i >= pfxdb_node_nvals(db, node))
+		return -1;
+	r = db->refs[node->values + i];
+	if(r >= db->hdr->nvals)
+		return -1;
+	v = &db->vals[r];
+	if((uint64_t)v->off + v->len >= db->hdr->strs_size)
+		return -1;
+	val->s = db->strs + v->off;
+	val->len = v->len;
+	return 0;
+}
+
+/**
+ * map the file of a handle - to be done before forking the processes, the
+ * handle itself being private to each process afterwards
+ */
+int pfxdb_handle_init(pfxdb_handle_t *h, char *path)
+{
+	memset(h, 0, sizeof(pfxdb_handle_t));
+	h->version = (int *)shm_malloc(sizeof(int));
+	if(h->version == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	*h->version = 0;
+	h->path = path;
+	h->db = pfxdb_open(path);
+	if(h->db == NULL) {
+		shm_free(h->version);
+		h->version = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * get the mapping of the current process, mapping the file again if it
+ * was reloaded - the mapping returned is valid until the next call
+ */
+pfxdb_t *pfxdb_handle_get(pfxdb_handle_t *h)
+{
+	pfxdb_t *db;
+	int v;
+
+	if(h->version == NULL)
+		return NULL;
+	v = mb_atomic_get_int(h->version);
+	if(v != h->lversion) {
+		/* on failure keep the old mapping until the next reload */
+		h->lversion = v;
+		db = pfxdb_open(h->path);
+		if(db != NULL) {
+			pfxdb_close(h->db);
+			h->db = db;
+		} else {
+			LM_ERR("cannot map [%s] again - keeping old data\n", h->path);
+		}
+	}
+	return h->db;
+}
+
+/**
+ * check the new file and ask all processes to map it
+ */
+int pfxdb_handle_reload(pfxdb_handle_t *h)
+{
+	pfxdb_t *db;
+
+	if(h->version == NULL)
+		return -1;
+	db = pfxdb_open(h->path);
+	if(db == NULL)
+		return -1;
+	pfxdb_close(h->db);
+	h->db = db;
+	h->lversion = mb_atomic_add_int(h->version, 1);
+	return 0;
+}
+
+/**
+ * release the mapping of the current process and the shared version - to
+ * be done at shutdown
+ */
+void pfxdb_handle_destroy(pfxdb_handle_t *h)
+{
+	pfxdb_close(h->db);
+	h->db = NULL;
+	if(h->version != NULL) {
+		shm_free(h->version);
+		h->version = NULL;
+	}
+}
@@ -0,0 +1,157 @@
+/*
+ * pfxdb - read-only memory mapped prefix databases
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*!
+* \file
+* \brief core/utils :: Read-only memory mapped prefix databases
+* \ingroup core/utils
+* Module: \ref core/utils
+*
+* A pfxdb file holds one or more named tables of (prefix, value) records,
+* compiled offline into prefix trees that are used directly from the
+* mapped file. The file is never modified once written, a new version is
+* written to a temporary file and renamed over the old one. All sections
+* are referenced by offsets, so the mapping can be shared through the page
+* cache by all processes and instances using the same file.
+*/
+
+#ifndef _PFXDB_H_
+#define _PFXDB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../../core/str.h"
+#include "pfxtree.h"
+
+#define PFXDB_MAGIC "KPFXDB\r\n"
+#define PFXDB_MAGIC_LEN 8
+#define PFXDB_VERSION 1
+
+/* max length of a prefix */
+#define PFXDB_MAX_DEPTH KSR_PFXTREE_MAX_DEPTH
+
+/* file header, followed by the sections, each aligned to 8 bytes */
+typedef struct pfxdb_hdr
+{
+	char magic[PFXDB_MAGIC_LEN];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t size;		 /* size of the file */
+	uint32_t ntables;	 /* pfxdb_table_t[ntables] at tables_off */
+	uint32_t nnodes;	 /* pfxdb_node_t[nnodes + 1] at nodes_off */
+	uint32_t nrefs;		 /* uint32_t[nrefs] at refs_off */
+	uint32_t nvals;		 /* pfxdb_val_t[nvals] at vals_off */
+	uint64_t tables_off;
+	uint64_t nodes_off;
+	uint64_t refs_off;
+	uint64_t vals_off;
+	uint64_t strs_off; /* string pool, each string ends with '\0' */
+	uint64_t strs_size;
+	uint64_t ctime; /* creation time (seconds since epoch) */
+} pfxdb_hdr_t;
+
+/* table, sorted by name in the table section */
+typedef struct pfxdb_table
+{
+	uint32_t name; /* offset in string pool */
+	uint32_t namelen;
+	uint32_t root; /* index of the root node (empty prefix) */
+	uint32_t nrecs;
+} pfxdb_table_t;
+
+/* prefix tree node, see pfxtree.h */
+typedef ksr_pfxtree_node_t pfxdb_node_t;
+
+typedef struct pfxdb_val
+{
+	uint32_t off; /* offset in string pool */
+	uint32_t len;
+} pfxdb_val_t;
+
+/* file mapped in the address space of the current process */
+typedef struct pfxdb
+{
+	void *map;
+	size_t size;
+	pfxdb_hdr_t *hdr;
+	pfxdb_table_t *tables;
+	pfxdb_node_t *nodes;
+	uint32_t *refs;
+	pfxdb_val_t *vals;
+	char *strs;
+} pfxdb_t;
+
+/*
+ * Per process reference to a pfxdb file. A reload bumps the shared
+ * version and each process maps the file again on its next access.
+ */
+typedef struct pfxdb_handle
+{
+	char *path;
+	int *version; /* in shm */
+	int lversion;
+	pfxdb_t *db;
+} pfxdb_handle_t;
+
+pfxdb_t *pfxdb_open(char *path);
+void pfxdb_close(pfxdb_t *db);
+
+int pfxdb_table_get(pfxdb_t *db, str *name);
+
+/* 1 if the children of node are inside the nodes array - checked so that
+ * it does not overflow on a corrupted file */
+static inline int pfxdb_children_ok(pfxdb_t *db, pfxdb_node_t *node)
+{
+	return (node->child <= db->hdr->nnodes
+				   && node->nchild <= db->hdr->nnodes - node->child)
+				   ? 1
+				   : 0;
+}
+
+/* child of node for char c, NULL if not found */
+static inline pfxdb_node_t *pfxdb_child(
+		pfxdb_t *db, pfxdb_node_t *node, unsigned char c)
+{
+	if(node->nchild == 0 || !pfxdb_children_ok(db, node))
+		return NULL;
+	return ksr_pfxtree_child(db->nodes, node, c);
+}
+
+/* number of values of a node */
+static inline unsigned int pfxdb_node_nvals(pfxdb_t *db, pfxdb_node_t *node)
+{
+	if(node[1].values < node->values || node[1].values > db->hdr->nrefs)
+		return 0;
+	return node[1].values - node->values;
+}
+
+int pfxdb_node_val(pfxdb_t *db, pfxdb_node_t *node, unsigned int i, str *val);
+pfxdb_node_t *pfxdb_root(pfxdb_t *db, int table);
+
+int pfxdb_handle_init(pfxdb_handle_t *h, char *path);
+pfxdb_t *pfxdb_handle_get(pfxdb_handle_t *h);
+int pfxdb_handle_reload(pfxdb_handle_t *h);
+void pfxdb_handle_destroy(pfxdb_handle_t *h);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * pfxtree - prefix trees packed in a single array
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*!
+* \file
+* \brief core/utils :: Prefix trees packed in a single array
+* \ingroup core/utils
+* Module: \ref core/utils
+*/
+
+#include "pfxtree.h"
+
+/* length of the common prefix of two keys */
+static inline unsigned int ksr_pfxtree_lcp(
+		ksr_pfxtree_key_t *k1, ksr_pfxtree_key_t *k2)
+{
+	unsigned int i;
+
+	for(i = 0; i < k1->len && i < k2->len; i++) {
+		if(k1->s[i] != k2->s[i])
+			break;
+	}
+	return i;
+}
+
+/**
+ * each key adds a node for every char after the common prefix with the
+ * previous key in sorted order
+ */
+unsigned int ksr_pfxtree_nodes(ksr_pfxtree_key_t *keys, unsigned int n)
+{
+	unsigned int i, nnodes;
+
+	nnodes = 1;
+	for(i = 0; i < n; i++) {
+		nnodes += keys[i].len
+				  - ((i > 0) ? ksr_pfxtree_lcp(&keys[i - 1], &keys[i]) : 0);
+	}
+	return nnodes;
+}
+
+/**
+ * the nodes are filled in breadth first order, the range of keys under a
+ * node being kept in its values (first key) and child (end) fields until
+ * the node is reached
+ */
+int ksr_pfxtree_fill(ksr_pfxtree_key_t *keys, unsigned int n,
+		ksr_pfxtree_node_t *nodes, unsigned int nnodes, unsigned int *refs)
+{
+	ksr_pfxtree_node_t *node;
+	unsigned int i, j, k, lo, hi, next, m;
+	unsigned char c;
+
+	if(nnodes == 0)
+		return -1;
+	nodes[0].child = n;
+	nodes[0].values = 0;
+	nodes[0].nchild = 0;
+	nodes[0].key = 0;
+	nodes[0].depth = 0;
+	next = 1;
+	m = 0;
+	for(i = 0; i < next; i++) {
+		node = &nodes[i];
+		lo = node->values;
+		hi = node->child;
+		node->values = m;
+		for(j = lo; j < hi && keys[j].len == node->depth; j++)
+			refs[m++] = j;
+		node->child = next;
+		while(j < hi) {
+			c = keys[j].s[node->depth];
+			for(k = j + 1; k < hi && keys[k].s[node->depth] == c; k++)
+				;
+			if(next >= nnodes || node->depth == KSR_PFXTREE_MAX_DEPTH)
+				return -1;
+			nodes[next].child = k;
+			nodes[next].values = j;
+			nodes[next].nchild = 0;
+			nodes[next].key = c;
+			nodes[next].depth = node->depth + 1;
+			next++;
+			node->nchild++;
+			j = k;
+		}
+	}
+	if(next != nnodes || m != n)
+		return -1;
+	nodes[nnodes].values = m;
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * pfxtree - prefix trees packed in a single array
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*!
+* \file
+* \brief core/utils :: Prefix trees packed in a single array
+* \ingroup core/utils
+* Module: \ref core/utils
+*
+* Read-only prefix tree compiled from a sorted list of keys, with one node
+* per distinct prefix laid out in breadth first order. The owner keeps the
+* values of the keys in its own array, the tree giving for each node the
+* range of them having exactly the prefix of the node. Used for the rule
+* tries of lcr, the compact trees of mtree and the pfxdb files, so it does
+* not depend on the memory manager or the logging of the core.
+*/
+
+#ifndef _PFXTREE_H_
+#define _PFXTREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* max length of a key */
+#define KSR_PFXTREE_MAX_DEPTH 255
+
+/*
+ * Node of the tree. The children of a node are stored next to each other
+ * starting at index child, sorted by key (the next char of the prefix).
+ * The values of a node are in range [values, values of the next node),
+ * the node array having one extra node closing the last range. This is
+ * also the node layout of the pfxdb files, it must not be changed.
+ */
+typedef struct ksr_pfxtree_node
+{
+	uint32_t child;
+	uint32_t values;
+	uint16_t nchild;
+	uint8_t key;
+	uint8_t depth;
+} ksr_pfxtree_node_t;
+
+typedef struct ksr_pfxtree_key
+{
+	const unsigned char *s;
+	unsigned int len; /* at most KSR_PFXTREE_MAX_DEPTH */
+} ksr_pfxtree_key_t;
+
+#define KSR_PFXTREE_NVALUES(node) ((node)[1].values - (node)->values)
+
+/*!
+ * \brief Number of nodes of the tree of sorted keys, with the root
+ *
+ * The keys must be sorted by ksr_pfxtree_key_cmp(), the same key can be
+ * given more than once.
+ */
+unsigned int ksr_pfxtree_nodes(ksr_pfxtree_key_t *keys, unsigned int n);
+
+/*!
+ * \brief Fill the nodes of the tree of sorted keys
+ *
+ * Node 0 is the root (empty prefix). The value slots of the nodes are
+ * numbered from 0 to n - 1, refs[slot] being set to the index in keys
+ * of the key giving the value, so that equal keys keep their order.
+ * \param keys keys, sorted by ksr_pfxtree_key_cmp()
+ * \param n number of keys
+ * \param nodes array of nnodes + 1 nodes
+ * \param nnodes number of nodes, as returned by ksr_pfxtree_nodes()
+ * \param refs array of n items
+ * \return 0 on success, -1 if nnodes does not match the keys
+ */
+int ksr_pfxtree_fill(ksr_pfxtree_key_t *keys, unsigned int n,
+		ksr_pfxtree_node_t *nodes, unsigned int nnodes, unsigned int *refs);
+
+/*!
+ * \brief Order of the keys in a tree - a prefix before its extensions
+ */
+static inline int ksr_pfxtree_key_cmp(
+		const ksr_pfxtree_key_t *k1, const ksr_pfxtree_key_t *k2)
+{
+	unsigned int i, len;
+
+	len = (k1->len < k2->len) ? k1->len : k2->len;
+	for(i = 0; i < len; i++) {
+		if(k1->s[i] != k2->s[i])
+			return (k1->s[i] < k2->s[i]) ? -1 : 1;
+	}
+	return (k1->len < k2->len) ? -1 : (k1->len > k2->len);
+}
+
+/* child of node for char c, NULL if not found */
+static inline ksr_pfxtree_node_t *ksr_pfxtree_child(
+		ksr_pfxtree_node_t *nodes, ksr_pfxtree_node_t *node, unsigned char c)
+{
+	ksr_pfxtree_node_t *child;
+	unsigned int l, h, m;
+
+	child = &nodes[node->child];
+	l = 0;
+	h = node->nchild;
+	while(l < h) {
+		m = (l + h) >> 1;
+		if(child[m].key < c)
+			l = m + 1;
+		else
+			h = m;
+	}
+	if(l == node->nchild || child[l].key != c)
+		return NULL;
+	return &child[l];
+}
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \file lib/srdb1/db_changelog.c
+ * \ingroup db1
+ * \brief Reading of change log tables for incremental reloads.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "db_changelog.h"
+#include "../../core/dprint.h"
+
+#define db_changelog_bit(_id) ((unsigned long long)(_id) % DB_CHANGELOG_WINDOW)
+#define db_changelog_byte(_log, _id) ((_log)->seen[db_changelog_bit(_id) >> 3])
+#define db_changelog_mask(_id) (1 << (db_changelog_bit(_id) & 7))
+
+
+/**
+ * Get the value of an integer id column, whatever integer type the
+ * database driver returned
+ */
+static int db_changelog_id(db_val_t *val, long long *id)
+{
+	char buf[32];
+	char *end;
+	int len;
+
+	if(VAL_NULL(val))
+		return -1;
+	switch(VAL_TYPE(val)) {
+		case DB1_INT:
+			*id = VAL_INT(val);
+			return 0;
+		case DB1_UINT:
+			*id = VAL_UINT(val);
+			return 0;
+		case DB1_BIGINT:
+			*id = VAL_BIGINT(val);
+			return 0;
+		case DB1_UBIGINT:
+			*id = (long long)VAL_UBIGINT(val);
+			return 0;
+		case DB1_STRING:
+		case DB1_STR:
+			/* result of an aggregate function with some drivers */
+			if(VAL_TYPE(val) == DB1_STRING) {
+				len = (VAL_STRING(val)) ? strlen(VAL_STRING(val)) : 0;
+				if(len > 0 && len < sizeof(buf))
+					memcpy(buf, VAL_STRING(val), len);
+			} else {
+				len = VAL_STR(val).len;
+				if(len > 0 && len < sizeof(buf))
+					memcpy(buf, VAL_STR(val).s, len);
+			}
+			if(len <= 0 || len >= sizeof(buf))
+				return -1;
+			buf[len] = '\0';
+			*id = strtoll(buf, &end, 10);
+			return (*end == '\0') ? 0 : -1;
+		default:
+			return -1;
+	}
+}
+
+
+/**
+ * Get the highest id of a change log table with a raw query, the table
+ * has to be the current one of the connection
+ * \return 0 on success (*id not changed for an empty table), 1 if raw
+ * queries are not supported, -1 on error
+ */
+static int db_changelog_max_id(db_func_t *dbf, db1_con_t *dbh, str *table,
+		str *id_col, long long *id)
+{
+	char buf[256];
+	str query;
+	db1_res_t *res = NULL;
+	int ret = 0;
+
+	if(!DB_CAPABILITY(*dbf, DB_CAP_RAW_QUERY))
+		return 1;
+	query.len = snprintf(buf, sizeof(buf), "select max(%.*s) from %.*s",
+			id_col->len, id_col->s, table->len, table->s);
+	if(query.len < 0 || query.len >= sizeof(buf)) {
+		LM_ERR("change log table or id column name too long\n");
+		return -1;
+	}
+	query.s = buf;
+	if(dbf->raw_query(dbh, &query, &res) < 0 || res == NULL) {
+		LM_ERR("failed to query max id of change log table %.*s\n",
+				table->len, table->s);
+		return -1;
+	}
+	if(RES_ROW_N(res) == 1 && ROW_N(RES_ROWS(res)) == 1
+			&& !VAL_NULL(ROW_VALUES(RES_ROWS(res)))) {
+		if(db_changelog_id(ROW_VALUES(RES_ROWS(res)), id) < 0) {
+			LM_ERR("invalid max id of change log table %.*s\n", table->len,
+					table->s);
+			ret = -1;
+		}
+	}
+	dbf->free_result(dbh, res);
+	return ret;
+}
+
+
+int db_changelog_fetch(db_func_t *dbf, db1_con_t *dbh, str *table,
+		str *id_col, str *key_col, db_changelog_t *log, db_changelog_f f,
+		void *param)
+{
+	db_key_t keys[1];
+	db_op_t ops[1];
+	db_val_t vals[1];
+	db_key_t cols[2];
+	db1_res_t *res = NULL;
+	db_row_t *row;
+	long long id, max_id, from_id;
+	int i, n, ret;
+
+	if(dbf == NULL || dbh == NULL || table == NULL || table->len <= 0
+			|| log == NULL) {
+		LM_ERR("invalid parameters\n");
+		return -1;
+	}
+
+	if(dbf->use_table(dbh, table) < 0) {
+		LM_ERR("failed to use change log table %.*s\n", table->len, table->s);
+		return -1;
+	}
+
+	if(f == NULL) {
+		/* full load - only the position is needed */
+		max_id = log->last_id;
+		ret = db_changelog_max_id(dbf, dbh, table, id_col, &max_id);
+		if(ret < 0)
+			return -1;
+		if(ret == 0) {
+			LM_DBG("position of change log table %.*s set to %lld\n",
+					table->len, table->s, max_id);
+			log->last_id = max_id;
+			memset(log->seen, 0, sizeof(log->seen));
+			return 0;
+		}
+		/* no raw queries - read the new rows */
+	}
+
+	/* the rows of the window can be committed after the last one read */
+	from_id = (f == NULL) ? log->last_id : log->last_id - DB_CHANGELOG_WINDOW;
+	keys[0] = id_col;
+	ops[0] = OP_GT;
+	VAL_TYPE(vals) = DB1_BIGINT;
+	VAL_NULL(vals) = 0;
+	VAL_BIGINT(vals) = from_id;
+	cols[0] = id_col;
+	cols[1] = key_col;
+
+	if(dbf->query(dbh, keys, ops, vals, cols, 1, 2, id_col, &res) < 0) {
+		LM_ERR("failed to query change log table %.*s\n", table->len,
+				table->s);
+		return -1;
+	}
+
+	max_id = log->last_id;
+	n = 0;
+	row = RES_ROWS(res);
+	for(i = 0; i < RES_ROW_N(res); i++) {
+		if(ROW_N(row + i) != 2
+				|| db_changelog_id(ROW_VALUES(row + i), &id) < 0) {
+			LM_ERR("invalid id in row %d of change log table %.*s\n", i,
+					table->len, table->s);
+			goto error;
+		}
+		if(id <= from_id) {
+			/* driver not honoring the query operator */
+			continue;
+		}
+		if(id > max_id)
+			max_id = id;
+		if(id <= log->last_id
+				&& (db_changelog_byte(log, id) & db_changelog_mask(id))) {
+			/* already applied */
+			continue;
+		}
+		if(f != NULL && !VAL_NULL(ROW_VALUES(row + i) + 1)) {
+			if(f(ROW_VALUES(row + i) + 1, param) < 0) {
+				goto error;
+			}
+		}
+		n++;
+	}
+
+	/* move the window and mark the rows read in it */
+	if(f == NULL || max_id - log->last_id >= DB_CHANGELOG_WINDOW) {
+		memset(log->seen, 0, sizeof(log->seen));
+	} else {
+		for(id = log->last_id + 1; id <= max_id; id++)
+			db_changelog_byte(log, id) &= ~db_changelog_mask(id);
+	}
+	if(f != NULL) {
+		for(i = 0; i < RES_ROW_N(res); i++) {
+			db_changelog_id(ROW_VALUES(row + i), &id);
+			if(id > from_id && id > max_id - DB_CHANGELOG_WINDOW)
+				db_changelog_byte(log, id) |= db_changelog_mask(id);
+		}
+	}
+	dbf->free_result(dbh, res);
+
+	LM_DBG("read %d rows from change log table %.*s (ids %lld..%lld)\n", n,
+			table->len, table->s, from_id, max_id);
+	log->last_id = max_id;
+	return n;
+
+error:
+	dbf->free_result(dbh, res);
+	return -1;
+}
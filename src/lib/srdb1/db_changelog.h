@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \file lib/srdb1/db_changelog.h
+ * \brief Reading of change log tables for incremental reloads.
+ *
+ * A change log table has an increasing integer id column and a key
+ * column, each row telling that the records of a data table with that
+ * key (e.g., a set or an address) were added, updated or deleted. It is
+ * filled by the provisioning side, usually with triggers on the data
+ * table. Modules caching the data table remember the id of the last log
+ * row they applied and reload only the records of the keys logged after
+ * it, instead of the whole table.
+ *
+ * The ids are usually given by an auto increment column or a sequence
+ * when the row is inserted, so a transaction can commit its row after
+ * rows with higher ids were committed and read. To apply such rows, the
+ * last DB_CHANGELOG_WINDOW ids are read again each time and the rows read
+ * before are skipped. A row committed later than that is not applied;
+ * ids assigned in commit order (e.g., by a trigger serialized with a
+ * table lock) avoid the issue.
+ * \ingroup db1
+ */
+
+#ifndef DB1_CHANGELOG_H
+#define DB1_CHANGELOG_H
+
+#include "db.h"
+
+/** number of ids before the last one read again to get late commits */
+#define DB_CHANGELOG_WINDOW 1024
+
+/**
+ * Position of a module in a change log table, kept across reloads
+ */
+typedef struct db_changelog
+{
+	long long last_id; /*!< highest id read */
+	/*! ids of the window already read, bit id % DB_CHANGELOG_WINDOW */
+	unsigned char seen[DB_CHANGELOG_WINDOW / 8];
+} db_changelog_t;
+
+
+/**
+ * Callback for the rows of a change log table.
+ *
+ * \param key value of the key column of the row
+ * \param param parameter given to db_changelog_fetch()
+ * \return zero on success, negative to stop reading the log
+ */
+typedef int (*db_changelog_f)(db_val_t *key, void *param);
+
+
+/**
+ * Read the rows of a change log table not applied yet.
+ *
+ * The rows with an id greater than log->last_id, and the ones of the
+ * window before it not read yet, are read in the order of their id and
+ * the value of their key column is given to f, then the position is
+ * updated. The same key can be given several times. With f set to NULL,
+ * the position is set to the highest id in the table (with a max() query
+ * when the driver supports raw queries), as needed before a full load of
+ * the data table; the rows of the window are then given once more by the
+ * next call. The current table of the connection is changed.
+ *
+ * \param dbf database module callbacks
+ * \param dbh database connection
+ * \param table name of the change log table
+ * \param id_col name of the id column
+ * \param key_col name of the key column
+ * \param log position in the change log, updated on success
+ * \param f callback for each row, can be NULL
+ * \param param parameter given to f
+ * \return number of rows read on success, negative on error
+ */
+int db_changelog_fetch(db_func_t *dbf, db1_con_t *dbh, str *table,
+		str *id_col, str *key_col, db_changelog_t *log, db_changelog_f f,
+		void *param);
+
+#endif /* DB1_CHANGELOG_H */
@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \ingroup ptrie
+ * \brief Path compressed trie with pooled memory
+ *
+ * - Module: \ref carrierroute
+ * @{
+ */
+
+#include <string.h>
+
+#include "ptrie.h"
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/mem/mem.h"
+
+
+/*! size of the first pool chunk, doubled for each new chunk */
+#define PTRIE_CHUNK_MIN 4096
+/*! max size of a pool chunk, unless needed for a single allocation */
+#define PTRIE_CHUNK_MAX (1024 * 1024)
+
+/*! number of children from which a node gets an index, for 10 and 128
+ * branches */
+#define PTRIE_INDEX_MIN(b) (((b) == 10) ? 1 : 2)
+
+#define PTRIE_ALIGN(x) \
+	(((x) + sizeof(void *) - 1) & ~((unsigned long)sizeof(void *) - 1))
+
+
+/*!
+ * \brief Gets size bytes from the pool of the trie
+ * \param align if not 0 the memory is aligned for a node
+ */
+static void *ptrie_pool_alloc(
+		struct ptrie_t *trie, unsigned long size, int align)
+{
+	struct ptrie_chunk_t *chunk;
+	unsigned long csize, hsize, pad = 0;
+	void *p;
+
+	if(align)
+		pad = PTRIE_ALIGN((unsigned long)trie->pfree)
+			  - (unsigned long)trie->pfree;
+	if(trie->pfree == NULL || trie->pavail < size + pad) {
+		hsize = PTRIE_ALIGN(sizeof(struct ptrie_chunk_t));
+		csize = PTRIE_CHUNK_MIN;
+		if(trie->chunks) {
+			csize = trie->chunks->size * 2;
+			if(csize > PTRIE_CHUNK_MAX)
+				csize = PTRIE_CHUNK_MAX;
+		}
+		if(csize < hsize + size)
+			csize = hsize + size;
+		chunk = shm_malloc(csize);
+		if(chunk == NULL) {
+			SHM_MEM_ERROR;
+			return NULL;
+		}
+		LM_DBG("allocate %lu bytes for pool chunk at %p\n", csize, chunk);
+		chunk->size = csize;
+		chunk->next = trie->chunks;
+		trie->chunks = chunk;
+		trie->pfree = (char *)chunk + hsize;
+		trie->pavail = csize - hsize;
+		trie->psize += csize;
+		pad = 0;
+	}
+	p = trie->pfree + pad;
+	trie->pfree += pad + size;
+	trie->pavail -= pad + size;
+	return p;
+}
+
+
+static struct ptrie_node_t *ptrie_node_new(
+		struct ptrie_t *trie, const char *label, unsigned int len)
+{
+	struct ptrie_node_t *node;
+	char *l;
+
+	node = ptrie_pool_alloc(trie, sizeof(struct ptrie_node_t), 1);
+	if(node == NULL)
+		return NULL;
+	l = ptrie_pool_alloc(trie, len, 0);
+	if(l == NULL)
+		return NULL;
+	memcpy(l, label, len);
+	memset(node, 0, sizeof(struct ptrie_node_t));
+	node->label = l;
+	node->len = len;
+	node->key = l[0];
+	trie->nodes++;
+	return node;
+}
+
+
+/*! position of char c in the index of a node, -1 if out of the charset */
+static inline int ptrie_slot(const struct ptrie_t *trie, unsigned char c)
+{
+	if(trie->branches == 10)
+		return ((unsigned char)(c - '0') > 9) ? -1 : c - '0';
+	return (c > 127) ? -1 : c;
+}
+
+
+/*! adds a new child to the index of a node, creating it if needed */
+static int ptrie_index_add(
+		struct ptrie_t *trie, struct ptrie_node_t *node, struct ptrie_node_t *c)
+{
+	struct ptrie_node_t *n;
+
+	node->nchild++;
+	if(node->index != NULL) {
+		node->index[ptrie_slot(trie, c->key)] = c;
+		return 0;
+	}
+	if(node->nchild < PTRIE_INDEX_MIN(trie->branches))
+		return 0;
+	node->index = ptrie_pool_alloc(
+			trie, sizeof(struct ptrie_node_t *) * trie->branches, 1);
+	if(node->index == NULL)
+		return -1;
+	memset(node->index, 0, sizeof(struct ptrie_node_t *) * trie->branches);
+	for(n = node->child; n != NULL; n = n->next)
+		node->index[ptrie_slot(trie, n->key)] = n;
+	return 0;
+}
+
+
+struct ptrie_t *ptrie_init(const unsigned int branches)
+{
+	struct ptrie_t *trie;
+
+	if(branches != 10 && branches != 128) {
+		LM_ERR("invalid number of branches %u\n", branches);
+		return NULL;
+	}
+	trie = shm_malloc(sizeof(struct ptrie_t));
+	if(trie == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(trie, 0, sizeof(struct ptrie_t));
+	trie->branches = branches;
+	trie->nodes = 1;
+	return trie;
+}
+
+
+/*! calls delete_payload for the nodes of a subtree */
+static void ptrie_delete_payload(
+		struct ptrie_node_t *node, pt_delete_func_t delete_payload)
+{
+	for(; node != NULL; node = node->next) {
+		ptrie_delete_payload(node->child, delete_payload);
+		if(node->data != NULL)
+			delete_payload(node->data);
+		node->data = NULL;
+	}
+}
+
+
+void ptrie_destroy(struct ptrie_t **trie, pt_delete_func_t delete_payload)
+{
+	struct ptrie_chunk_t *chunk;
+
+	if(trie == NULL || *trie == NULL)
+		return;
+	if(delete_payload)
+		ptrie_delete_payload(&(*trie)->root, delete_payload);
+	while((*trie)->chunks) {
+		chunk = (*trie)->chunks;
+		(*trie)->chunks = chunk->next;
+		shm_free(chunk);
+	}
+	LM_DBG("free trie at %p\n", *trie);
+	shm_free(*trie);
+	*trie = NULL;
+}
+
+
+int ptrie_insert(struct ptrie_t *trie, const char *number,
+		const unsigned int numberlen, void *data)
+{
+	struct ptrie_node_t *node, *c, *n, **link;
+	unsigned char ch;
+	unsigned int i, k;
+
+	if(trie == NULL)
+		return -1;
+	if(number == NULL)
+		return -1;
+
+	for(i = 0; i < numberlen; i++) {
+		ch = number[i];
+		if(trie->branches == 10) {
+			if((unsigned char)(ch - '0') > 9) {
+				LM_ERR("cannot insert non-numerical character\n");
+				return -1;
+			}
+		} else if(ch > 127) {
+			LM_ERR("cannot insert extended ascii character\n");
+			return -1;
+		}
+	}
+
+	node = &trie->root;
+	i = 0;
+	while(i < numberlen) {
+		ch = number[i];
+		link = &node->child;
+		while(*link != NULL && (*link)->key < ch)
+			link = &(*link)->next;
+		c = *link;
+		if(c == NULL || c->key != ch) {
+			/* new leaf with the rest of the number */
+			n = ptrie_node_new(trie, number + i, numberlen - i);
+			if(n == NULL)
+				return -1;
+			n->next = c;
+			*link = n;
+			if(ptrie_index_add(trie, node, n) < 0) {
+				/* the node is in the list, only the lookup is slower */
+				LM_ERR("cannot create child index\n");
+			}
+			node = n;
+			break;
+		}
+		for(k = 1; k < c->len && i + k < numberlen
+				   && c->label[k] == number[i + k];
+				k++)
+			;
+		if(k < c->len) {
+			/* split the edge, the existing node keeps its address so the
+			 * payload pointers given out before remain valid */
+			n = ptrie_node_new(trie, c->label, k);
+			if(n == NULL)
+				return -1;
+			n->next = c->next;
+			n->child = c;
+			n->nchild = 1;
+			c->next = NULL;
+			c->label += k;
+			c->len -= k;
+			c->key = c->label[0];
+			*link = n;
+			if(node->index != NULL)
+				node->index[ptrie_slot(trie, n->key)] = n;
+			c = n;
+		}
+		node = c;
+		i += k;
+	}
+
+	if(node->data == NULL && data != NULL)
+		trie->loaded++;
+	else if(node->data != NULL && data == NULL)
+		trie->loaded--;
+	node->data = data;
+	if(numberlen > trie->maxlen)
+		trie->maxlen = numberlen;
+	return 0;
+}
+
+
+/*! size of a node in the pool, with its index and label */
+static unsigned long ptrie_node_size(
+		struct ptrie_t *trie, struct ptrie_node_t *node)
+{
+	unsigned long size;
+
+	size = PTRIE_ALIGN(sizeof(struct ptrie_node_t));
+	if(node->index != NULL)
+		size += sizeof(struct ptrie_node_t *) * trie->branches;
+	return PTRIE_ALIGN(size + node->len);
+}
+
+
+/*! size of the pool needed for the children of a node */
+static unsigned long ptrie_pack_size(
+		struct ptrie_t *trie, struct ptrie_node_t *node)
+{
+	unsigned long size = 0;
+
+	for(node = node->child; node != NULL; node = node->next)
+		size += ptrie_node_size(trie, node) + ptrie_pack_size(trie, node);
+	return size;
+}
+
+
+/*!
+ * copies the children of node after p, node being already in the new
+ * pool, and returns the end of the copied data
+ */
+static char *ptrie_pack_children(
+		struct ptrie_t *trie, struct ptrie_node_t *node, char *p)
+{
+	struct ptrie_node_t *c, *n, **link;
+	char *l;
+
+	link = &node->child;
+	for(c = node->child; c != NULL; c = c->next) {
+		n = (struct ptrie_node_t *)p;
+		*n = *c;
+		l = p + PTRIE_ALIGN(sizeof(struct ptrie_node_t));
+		if(c->index != NULL) {
+			/* filled when the children of n are copied */
+			n->index = (struct ptrie_node_t **)l;
+			memset(n->index, 0, sizeof(struct ptrie_node_t *) * trie->branches);
+			l += sizeof(struct ptrie_node_t *) * trie->branches;
+		}
+		memcpy(l, c->label, c->len);
+		n->label = l;
+		p += ptrie_node_size(trie, c);
+		*link = n;
+		link = &n->next;
+		if(node->index != NULL)
+			node->index[ptrie_slot(trie, n->key)] = n;
+	}
+	return p;
+}
+
+
+int ptrie_pack(struct ptrie_t *trie)
+{
+	struct ptrie_chunk_t *chunk, *old;
+	struct ptrie_node_t *node;
+	unsigned long hsize, size;
+	char *p, *end;
+
+	if(trie == NULL)
+		return -1;
+	if(trie->chunks == NULL)
+		return 0;
+	hsize = PTRIE_ALIGN(sizeof(struct ptrie_chunk_t));
+	size = ptrie_pack_size(trie, &trie->root);
+	if(trie->root.index != NULL)
+		size += sizeof(struct ptrie_node_t *) * trie->branches;
+	chunk = shm_malloc(hsize + size);
+	if(chunk == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	LM_DBG("allocate %lu bytes for packed pool at %p\n", hsize + size, chunk);
+	chunk->size = hsize + size;
+	chunk->next = NULL;
+	p = (char *)chunk + hsize;
+	if(trie->root.index != NULL) {
+		trie->root.index = (struct ptrie_node_t **)p;
+		memset(p, 0, sizeof(struct ptrie_node_t *) * trie->branches);
+		p += sizeof(struct ptrie_node_t *) * trie->branches;
+	}
+
+	/* breadth first, so that the children of a node are next to each
+	 * other, the nodes copied still have the old child list until they
+	 * are reached */
+	end = ptrie_pack_children(trie, &trie->root, p);
+	while(p < end) {
+		node = (struct ptrie_node_t *)p;
+		p += ptrie_node_size(trie, node);
+		end = ptrie_pack_children(trie, node, end);
+	}
+
+	old = trie->chunks;
+	while(old) {
+		trie->chunks = old->next;
+		shm_free(old);
+		old = trie->chunks;
+	}
+	trie->chunks = chunk;
+	trie->pfree = NULL;
+	trie->pavail = 0;
+	trie->psize = chunk->size;
+	return 0;
+}
+
+
+void **ptrie_longest_match(struct ptrie_t *trie, const char *number,
+		const unsigned int numberlen, int *nmatchptr)
+{
+	struct ptrie_node_t *node;
+	unsigned char ch;
+	unsigned int i = 0, k, slot, branches;
+	int nmatch = -1;
+	void **ret = NULL;
+
+	if(trie == NULL)
+		return NULL;
+	if(number == NULL)
+		return NULL;
+
+	node = &trie->root;
+	branches = trie->branches;
+	if(node->data != NULL) {
+		nmatch = 0;
+		ret = &node->data;
+	}
+	while(i < numberlen) {
+		ch = number[i];
+		if(node->index != NULL) {
+			slot = (branches == 10) ? (unsigned char)(ch - '0') : ch;
+			if(slot >= branches)
+				break;
+			node = node->index[slot];
+			if(node == NULL)
+				break;
+		} else {
+			/* chars out of the charset are never part of a label, so they
+			 * end the match like in the dtrie */
+			for(node = node->child; node != NULL && node->key < ch;
+					node = node->next)
+				;
+			if(node == NULL || node->key != ch)
+				break;
+		}
+		if(node->len > numberlen - i)
+			break;
+		for(k = 1; k < node->len; k++) {
+			if(node->label[k] != number[i + k])
+				goto done;
+		}
+		i += node->len;
+		if(node->data != NULL) {
+			nmatch = i;
+			ret = &node->data;
+		}
+	}
+
+done:
+	if(nmatchptr)
+		*nmatchptr = nmatch;
+	return ret;
+}
+
+
+void **ptrie_contains(struct ptrie_t *trie, const char *number,
+		const unsigned int numberlen)
+{
+	int nmatch = 0;
+	void **ret;
+	ret = ptrie_longest_match(trie, number, numberlen, &nmatch);
+
+	if(nmatch == numberlen)
+		return ret;
+	return NULL;
+}
+
+
+static int ptrie_walk_node(struct ptrie_node_t *node, char *key,
+		unsigned int len, pt_walk_func_t func, void *param, int post)
+{
+	for(; node != NULL; node = node->next) {
+		if(node->len > 0)
+			memcpy(key + len, node->label, node->len);
+		key[len + node->len] = '\0';
+		if(!post && node->data != NULL
+				&& func(&node->data, key, len + node->len, param) < 0)
+			return -1;
+		if(node->child
+				&& ptrie_walk_node(node->child, key, len + node->len, func,
+						   param, post)
+						   < 0)
+			return -1;
+		if(post && node->data != NULL) {
+			key[len + node->len] = '\0';
+			if(func(&node->data, key, len + node->len, param) < 0)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+
+int ptrie_walk(struct ptrie_t *trie, pt_walk_func_t func, void *param, int post)
+{
+	char *key;
+	int ret;
+
+	if(trie == NULL || func == NULL)
+		return -1;
+	key = pkg_malloc(trie->maxlen + 1);
+	if(key == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	key[0] = '\0';
+	/* the root has no siblings */
+	ret = ptrie_walk_node(&trie->root, key, 0, func, param, post);
+	pkg_free(key);
+	return ret;
+}
+
+/** @} */
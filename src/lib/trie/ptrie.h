@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \defgroup ptrie Kamailio path compressed trie data structure
+ * \brief Path compressed trie with pooled memory
+ *
+ * Variant of the \ref dtrie for large, mostly static prefix sets. Chains
+ * of nodes with a single child and no data are merged into one node
+ * whose edge holds the whole chain of characters, and the children of
+ * a node are kept in a list sorted by their first character instead of
+ * a full array of branch pointers. Only the nodes with many children,
+ * usually close to the root, get an array indexed by the next char to
+ * keep the lookup as fast as in the \ref dtrie. Nodes and edge labels
+ * are taken from a pool of shared memory chunks owned by the trie, so
+ * loading does not hit the shared memory allocator for every character
+ * and the tree is released at once. Nodes are never moved or freed before the whole
+ * trie is destroyed, the payload addresses returned by the lookup
+ * functions stay valid until then.
+ * The same branches values as for the \ref dtrie are supported, 10 for
+ * digits only and 128 for the standard ascii charset.
+ * - Module: \ref carrierroute
+ * @{
+ */
+
+#ifndef _PTRIE_H_
+#define _PTRIE_H_
+
+
+/*! Trie node */
+struct ptrie_node_t
+{
+	struct ptrie_node_t *child;	  /*!< first child */
+	struct ptrie_node_t *next;	  /*!< next sibling, by first label char */
+	struct ptrie_node_t **index; /*!< children by first label char, if many */
+	void *data;					  /*!< custom data */
+	const char *label;			  /*!< chars of the edge to this node */
+	unsigned int len;			  /*!< number of chars in label */
+	unsigned short nchild;		  /*!< number of children */
+	unsigned char key;			  /*!< first char of label */
+};
+
+
+/*! Memory chunk of the node pool */
+struct ptrie_chunk_t
+{
+	struct ptrie_chunk_t *next;
+	unsigned long size; /*!< size of the chunk, including this header */
+};
+
+
+/*! Trie */
+struct ptrie_t
+{
+	struct ptrie_node_t root;	  /*!< root node, empty label */
+	unsigned int branches;		  /*!< 10 or 128, see \ref dtrie */
+	unsigned int nodes;			  /*!< number of nodes, with the root */
+	unsigned int loaded;		  /*!< number of nodes with data */
+	unsigned int maxlen;		  /*!< length of the longest key */
+	struct ptrie_chunk_t *chunks; /*!< pool chunks, last allocated first */
+	char *pfree;				  /*!< free space in the current chunk */
+	unsigned long pavail;		  /*!< bytes available at pfree */
+	unsigned long psize;		  /*!< bytes allocated for the pool */
+};
+
+
+/*! Function signature for destroying the payload. First parameter is the payload. */
+typedef void (*pt_delete_func_t)(void *);
+
+
+/*!
+ * Function signature for the callback of ptrie_walk(). It gets the
+ * address of the payload, the zero terminated key of the node and its
+ * length and the parameter given to ptrie_walk(). A negative return
+ * value stops the walk.
+ */
+typedef int (*pt_walk_func_t)(
+		void **data, const char *key, unsigned int len, void *param);
+
+
+/*!
+ * \brief Allocates memory for the trie and initializes it
+ * \param branches number of branches in the trie, 10 or 128
+ * \return pointer to an initialized empty trie on success, NULL otherwise.
+ */
+struct ptrie_t *ptrie_init(const unsigned int branches);
+
+
+/*!
+ * \brief Deletes the whole trie and frees all its memory
+ * \param trie trie to destroy, set to NULL
+ * \param delete_payload pointer to a function for deleting payload. If NULL, it will not be used.
+ */
+void ptrie_destroy(struct ptrie_t **trie, pt_delete_func_t delete_payload);
+
+
+/*!
+ * \brief Insert a number with a corresponding id
+ *
+ * Insert a number with a corresponding id. Nodes are created or split
+ * if necessary and the node ending with the last char is marked with the
+ * given id, replacing the previous one.
+ * \param trie trie
+ * \param number inserted number string
+ * \param numberlen number of individual numbers in number
+ * \param data pointer to some custom data
+ * \return 0 on success, -1 otherwise.
+ */
+int ptrie_insert(struct ptrie_t *trie, const char *number,
+		const unsigned int numberlen, void *data);
+
+
+/*!
+ * \brief Copies all nodes to a single pool chunk, in breadth first order
+ *
+ * To be called once the trie is loaded, the children of each node are
+ * then next to each other and its index and label are next to it. The
+ * nodes are moved, payload addresses obtained before are not valid
+ * anymore. Nodes inserted afterwards are added to new chunks as usual.
+ * \param trie trie
+ * \return 0 on success, -1 otherwise, the trie being unchanged.
+ */
+int ptrie_pack(struct ptrie_t *trie);
+
+
+/*!
+ *\brief Find the longest prefix match of number in the trie.
+ *
+ * Same semantic as dtrie_longest_match(), the match stops at the first
+ * char that is not in the charset of the trie.
+ * \param trie trie
+ * \param number matched prefix
+ * \param numberlen length of number
+ * \param nmatchptr if not NULL store the number of matched digits or -1 if not found.
+ * \return the address of the pointer in the tree node if number is found, NULL if the number is not found.
+ */
+void **ptrie_longest_match(struct ptrie_t *trie, const char *number,
+		const unsigned int numberlen, int *nmatchptr);
+
+
+/*!
+ * \brief Check if the trie contains a number
+ * \param trie trie
+ * \param number searched number
+ * \param numberlen length of number
+ * \return the address of the pointer in the tree node if number is found, NULL if the number is not found.
+ */
+void **ptrie_contains(struct ptrie_t *trie, const char *number,
+		const unsigned int numberlen);
+
+
+/*!
+ * \brief Calls func for each node with data, in key order
+ * \param trie trie
+ * \param func callback function
+ * \param param parameter given to func
+ * \param post if not 0 the nodes are given after their children (post
+ * order), otherwise before them
+ * \return 0 on success, -1 on error or if func returned a negative value.
+ */
+int ptrie_walk(
+		struct ptrie_t *trie, pt_walk_func_t func, void *param, int post);
+
+
+/*!
+ * \brief Returns the number of nodes in the trie, at least 1
+ */
+static inline unsigned int ptrie_size(const struct ptrie_t *trie)
+{
+	return trie ? trie->nodes : 0;
+}
+
+
+/*!
+ * \brief Returns the number of nodes in the trie that hold custom data
+ */
+static inline unsigned int ptrie_loaded_nodes(const struct ptrie_t *trie)
+{
+	return trie ? trie->loaded : 0;
+}
+
+
+/*!
+ * \brief Returns the size of the shared memory used by the trie
+ */
+static inline unsigned long ptrie_mem_size(const struct ptrie_t *trie)
+{
+	return trie ? trie->psize + sizeof(struct ptrie_t) : 0;
+}
+
+
+/** @} */
+#endif
@@ -129,6 +129,10 @@
 #ifdef USE_DST_BLOCKLIST
 #include "core/dst_blocklist.h"
 #endif
+#include "core/overload_ctl.h"
+#include "core/rcv_stats.h"
+#include "core/cfg_prof.h"
+#include "core/kemi_prof.h"
 #include "core/rand/fastrand.h" /* seed */
 #include "core/rand/kam_rand.h"
 #include "core/rand/cryptorand.h"
@@ -606,6 +610,9 @@ void cleanup(int show_status)
 #ifdef USE_DST_BLOCKLIST
 	destroy_dst_blocklist();
 #endif
+	ksr_ovl_destroy();
+	ksr_cfgprof_destroy();
+	sr_kemi_prof_destroy();
 	/* restore the original core configuration before the
 	 * config block is freed, otherwise even logging is unusable,
 	 * it can case segfault */
@@ -3388,6 +3395,22 @@ int main(int argc, char **argv)
 		goto error;
 	}
 #endif
+	if(ksr_ovl_init() < 0) {
+		LM_CRIT("could not initialize the overload control\n");
+		goto error;
+	}
+	if(ksr_rcv_stats_init() < 0) {
+		LM_CRIT("could not initialize the receive statistics\n");
+		goto error;
+	}
+	if(ksr_cfgprof_init() < 0) {
+		LM_CRIT("could not initialize the config profiler\n");
+		goto error;
+	}
+	if(sr_kemi_prof_init() < 0) {
+		LM_CRIT("could not initialize the kemi profiler\n");
+		goto error;
+	}
 
 	if(ksr_tcp_main_threads != 0) {
 		if(ksr_tcpx_proc_list_init() < 0) {
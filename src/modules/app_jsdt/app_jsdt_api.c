@@ -898,11 +898,10 @@ int sr_kemi_jsdt_exec_func_ex(duk_context *J, sr_kemi_t *ket)
 
 	argc = duk_get_top(J);
 	if(argc == 0 && ket->ptypes[0] == SR_KEMIP_NONE) {
+		ret = sr_kemi_exec_func_noparams(ket, env_J->msg, &xret);
 		if(ket->rtype == SR_KEMIP_XVAL) {
-			xret = ((sr_kemi_xfm_f)(ket->func))(env_J->msg);
 			return sr_kemi_jsdt_return_xval(J, ket, xret);
 		} else {
-			ret = ((sr_kemi_fm_f)(ket->func))(env_J->msg);
 			return sr_kemi_jsdt_return_int(J, ket, ret);
 		}
 	}
@@ -976,11 +976,10 @@ int sr_kemi_lua_exec_func_ex(lua_State *L, sr_kemi_t *ket, int pdelta)
 
 	argc = lua_gettop(L);
 	if(argc == pdelta && ket->ptypes[0] == SR_KEMIP_NONE) {
+		ret = sr_kemi_exec_func_noparams(ket, env_L->msg, &xret);
 		if(ket->rtype == SR_KEMIP_XVAL) {
-			xret = ((sr_kemi_xfm_f)(ket->func))(env_L->msg);
 			return sr_kemi_lua_return_xval(L, ket, xret);
 		} else {
-			ret = ((sr_kemi_fm_f)(ket->func))(env_L->msg);
 			return sr_kemi_lua_return_int(L, ket, ret);
 		}
 	}
@@ -249,11 +249,10 @@ PyObject *sr_apy_kemi_exec_func_ex(
 	fname = ket->fname;
 
 	if(ket->ptypes[0] == SR_KEMIP_NONE) {
+		ret = sr_kemi_exec_func_noparams(ket, lmsg, &xret);
 		if(ket->rtype == SR_KEMIP_XVAL) {
-			xret = ((sr_kemi_xfm_f)(ket->func))(lmsg);
 			return sr_kemi_apy_return_xval(ket, xret);
 		} else {
-			ret = ((sr_kemi_fm_f)(ket->func))(lmsg);
 			return sr_kemi_apy_return_int(ket, ret);
 		}
 	}
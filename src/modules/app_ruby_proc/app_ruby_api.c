@@ -818,11 +818,10 @@ VALUE sr_kemi_ruby_exec_func_ex(ksr_ruby_context_t *R, sr_kemi_t *ket, int argc,
 	}
 
 	if(argc == 0 && ket->ptypes[0] == SR_KEMIP_NONE) {
+		ret = sr_kemi_exec_func_noparams(ket, env_R->msg, &xret);
 		if(ket->rtype == SR_KEMIP_XVAL) {
-			xret = ((sr_kemi_xfm_f)(ket->func))(env_R->msg);
 			return sr_kemi_ruby_return_xval(ket, xret);
 		} else {
-			ret = ((sr_kemi_fm_f)(ket->func))(env_R->msg);
 			return sr_kemi_ruby_return_int(ket, ret);
 		}
 	}
@@ -511,16 +511,20 @@ errclose:
 }
 
 /**
- * Does the work for save_config, traverses the routing data tree
- * and writes each rule to file.
+ * Does the work for save_config, called for each node of the routing
+ * data tree, writes each rule to file.
  *
- * @param node the current prefix tree node
- * @param outfile the filehandle to which the config data is written
+ * @param data the payload of the current prefix tree node
+ * @param prefix the prefix of the node
+ * @param len the length of the prefix
+ * @param param the filehandle to which the config data is written
  *
  * @return 0 on success, -1 on failure
  */
-static int save_route_data_recursor(struct dtrie_node_t *node, FILE *outfile)
+static int save_route_data_node(
+		void **data, const char *prefix, unsigned int len, void *param)
 {
+	FILE *outfile = (FILE *)param;
 	int i;
 	struct route_flags *rf;
 	struct route_rule *rr;
@@ -529,7 +533,7 @@ static int save_route_data_recursor(struct dtrie_node_t *node, FILE *outfile)
 	str null_str = str_init("NULL");
 
 	/* no support for flag lists in route config */
-	rf = (struct route_flags *)(node->data);
+	rf = (struct route_flags *)(*data);
 	if(rf && rf->rule_list) {
 		rr = rf->rule_list;
 		tmp_str = (rr->prefix.len ? &rr->prefix : &null_str);
@@ -578,13 +582,6 @@ static int save_route_data_recursor(struct dtrie_node_t *node, FILE *outfile)
 		}
 		fprintf(outfile, "\t}\n");
 	}
-	for(i = 0; i < cr_match_mode; i++) {
-		if(node->child[i]) {
-			if(save_route_data_recursor(node->child[i], outfile) < 0) {
-				return -1;
-			}
-		}
-	}
 	return 0;
 }
 
@@ -616,8 +613,8 @@ int save_config(struct route_data_t *rd)
 			fprintf(outfile, "domain %.*s {\n",
 					rd->carriers[i]->domains[j]->name->len,
 					rd->carriers[i]->domains[j]->name->s);
-			if(save_route_data_recursor(
-					   rd->carriers[i]->domains[j]->tree, outfile)
+			if(ptrie_walk(rd->carriers[i]->domains[j]->tree,
+					   save_route_data_node, outfile, 0)
 					< 0) {
 				goto errout;
 			}
@@ -64,6 +64,36 @@ static int carrier_data_fixup(struct route_data_t *rd)
 }
 
 
+/**
+ * Moves the nodes of each prefix tree next to each other once the
+ * routing data is loaded, for faster lookups. The trees are still
+ * usable if this fails.
+ */
+static void route_data_pack(struct route_data_t *rd)
+{
+	int i, j;
+	struct domain_data_t *dd;
+
+	for(i = 0; i < rd->carrier_num; i++) {
+		if(rd->carriers[i] == NULL)
+			continue;
+		for(j = 0; j < rd->carriers[i]->domain_num; j++) {
+			dd = rd->carriers[i]->domains[j];
+			if(dd == NULL)
+				continue;
+			if(ptrie_pack(dd->tree) < 0 || ptrie_pack(dd->failure_tree) < 0) {
+				LM_WARN("could not pack trees of domain %.*s\n",
+						dd->name->len, dd->name->s);
+			}
+			LM_DBG("domain %.*s: %u nodes, %lu bytes\n", dd->name->len,
+					dd->name->s,
+					ptrie_size(dd->tree) + ptrie_size(dd->failure_tree),
+					ptrie_mem_size(dd->tree) + ptrie_mem_size(dd->failure_tree));
+		}
+	}
+}
+
+
 /**
  * initialises the routing data, initialises the global data pointer
  *
@@ -226,6 +256,8 @@ int reload_route_data(void)
 		goto errout;
 	}
 
+	route_data_pack(new_data);
+
 	new_data->proc_cnt = 0;
 
 	if(*global_data == NULL) {
@@ -588,22 +620,26 @@ static int fixup_rule_backup(struct route_flags *rf, struct route_rule *rr)
 
 
 /**
- * Does the work for rule_fixup recursively.
+ * Does the work for rule_fixup for each prefix of the tree.
  * First, it tries to set a pointer the rules with an existing hash index
  * at the marching array index. Afterward, remaining rules are populated
  * with incrementing hash indices.
  *
- * @param node the prefix tree node to be fixed up
+ * @param data the payload of the prefix tree node to be fixed up
+ * @param prefix the prefix of the node
+ * @param len the length of the prefix
+ * @param param points to the sum of the backup fixup results
  *
  * @return 0 on success, -1 on failure
  */
-static int rule_fixup_recursor(struct dtrie_node_t *node)
+static int rule_fixup_node(
+		void **data, const char *prefix, unsigned int len, void *param)
 {
 	struct route_rule *rr;
 	struct route_flags *rf;
 	int i, p_dice, ret = 0;
 
-	for(rf = (struct route_flags *)(node->data); rf != NULL; rf = rf->next) {
+	for(rf = (struct route_flags *)(*data); rf != NULL; rf = rf->next) {
 		p_dice = 0;
 		if(rf->rule_list) {
 			rr = rf->rule_list;
@@ -686,13 +722,8 @@ static int rule_fixup_recursor(struct dtrie_node_t *node)
 		}
 	}
 
-	for(i = 0; i < cr_match_mode; i++) {
-		if(node->child[i]) {
-			ret += rule_fixup_recursor(node->child[i]);
-		}
-	}
-
-	return ret;
+	*(int *)param += ret;
+	return 0;
 }
 
 
@@ -706,7 +737,7 @@ static int rule_fixup_recursor(struct dtrie_node_t *node)
  */
 int rule_fixup(struct route_data_t *rd)
 {
-	int i, j;
+	int i, j, ret;
 	for(i = 0; i < rd->carrier_num; i++) {
 		for(j = 0; j < rd->carriers[i]->domain_num; j++) {
 			if(rd->carriers[i]->domains[j]
@@ -714,7 +745,13 @@ int rule_fixup(struct route_data_t *rd)
 				LM_INFO("fixing tree %.*s\n",
 						rd->carriers[i]->domains[j]->name->len,
 						rd->carriers[i]->domains[j]->name->s);
-				if(rule_fixup_recursor(rd->carriers[i]->domains[j]->tree) < 0) {
+				ret = 0;
+				if(ptrie_walk(rd->carriers[i]->domains[j]->tree,
+						   rule_fixup_node, &ret, 0)
+						< 0) {
+					return -1;
+				}
+				if(ret < 0) {
 					return -1;
 				}
 			} else {
@@ -90,12 +90,12 @@ struct domain_data_t *create_domain_data(int domain_id, str *domain_name)
 	memset(tmp, 0, sizeof(struct domain_data_t));
 	tmp->id = domain_id;
 	tmp->name = domain_name;
-	if((tmp->tree = dtrie_init(cr_match_mode)) == NULL) {
+	if((tmp->tree = ptrie_init(cr_match_mode)) == NULL) {
 		shm_free(tmp);
 		return NULL;
 	}
-	if((tmp->failure_tree = dtrie_init(cr_match_mode)) == NULL) {
-		dtrie_destroy(&tmp->tree, NULL, cr_match_mode);
+	if((tmp->failure_tree = ptrie_init(cr_match_mode)) == NULL) {
+		ptrie_destroy(&tmp->tree, NULL);
 		shm_free(tmp);
 		return NULL;
 	}
@@ -111,10 +111,9 @@ struct domain_data_t *create_domain_data(int domain_id, str *domain_name)
 void destroy_domain_data(struct domain_data_t *domain_data)
 {
 	if(domain_data) {
-		dtrie_destroy(
-				&domain_data->tree, destroy_route_flags_list, cr_match_mode);
-		dtrie_destroy(&domain_data->failure_tree,
-				destroy_failure_route_rule_list, cr_match_mode);
+		ptrie_destroy(&domain_data->tree, destroy_route_flags_list);
+		ptrie_destroy(
+				&domain_data->failure_tree, destroy_failure_route_rule_list);
 		shm_free(domain_data);
 	}
 }
@@ -127,7 +126,7 @@ void destroy_domain_data(struct domain_data_t *domain_data)
  * prob gives the probability with which this rule applies if there are
  * more than one for a given prefix.
  *
- * @param node the root of the routing tree
+ * @param node the routing tree
  * @param scan_prefix the prefix for which to add the rule (must not contain non-digits)
  * @param flags user defined flags
  * @param mask mask for user defined flags
@@ -151,7 +150,7 @@ void destroy_domain_data(struct domain_data_t *domain_data)
  *
  * @see add_route()
  */
-int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
+int add_route_to_tree(struct ptrie_t *node, const str *scan_prefix,
 		flag_t flags, flag_t mask, const str *full_prefix, int max_targets,
 		double prob, const str *rewrite_hostpart, int strip,
 		const str *rewrite_local_prefix, const str *rewrite_local_suffix,
@@ -161,7 +160,7 @@ int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
 	void **ret;
 	struct route_flags *rf;
 
-	ret = dtrie_contains(node, scan_prefix->s, scan_prefix->len, cr_match_mode);
+	ret = ptrie_contains(node, scan_prefix->s, scan_prefix->len);
 
 	rf = add_route_flags((struct route_flags **)ret, flags, mask);
 	if(rf == NULL) {
@@ -171,10 +170,8 @@ int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
 
 	if(ret == NULL) {
 		/* node does not exist */
-		if(dtrie_insert(
-				   node, scan_prefix->s, scan_prefix->len, rf, cr_match_mode)
-				!= 0) {
-			LM_ERR("cannot insert route flags into d-trie\n");
+		if(ptrie_insert(node, scan_prefix->s, scan_prefix->len, rf) != 0) {
+			LM_ERR("cannot insert route flags into trie\n");
 			return -1;
 		}
 	}
@@ -192,7 +189,7 @@ int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
  * the information is and the next_domain parameters defines where to continue
  * routing in case of a match.
  *
- * @param failure_node the root of the failure routing tree
+ * @param failure_node the failure routing tree
  * @param scan_prefix the prefix for which to add the rule (must not contain non-digits)
  * @param full_prefix the whole scan prefix
  * @param host the hostname last tried
@@ -206,7 +203,7 @@ int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
  *
  * @see add_route()
  */
-int add_failure_route_to_tree(struct dtrie_node_t *failure_node,
+int add_failure_route_to_tree(struct ptrie_t *failure_node,
 		const str *scan_prefix, const str *full_prefix, const str *host,
 		const str *reply_code, const flag_t flags, const flag_t mask,
 		const int next_domain, const str *comment)
@@ -214,8 +211,7 @@ int add_failure_route_to_tree(struct dtrie_node_t *failure_node,
 	void **ret;
 	struct failure_route_rule *frr;
 
-	ret = dtrie_contains(
-			failure_node, scan_prefix->s, scan_prefix->len, cr_match_mode);
+	ret = ptrie_contains(failure_node, scan_prefix->s, scan_prefix->len);
 
 	frr = add_failure_route_rule((struct failure_route_rule **)ret, full_prefix,
 			host, reply_code, flags, mask, next_domain, comment);
@@ -226,10 +222,9 @@ int add_failure_route_to_tree(struct dtrie_node_t *failure_node,
 
 	if(ret == NULL) {
 		/* node does not exist */
-		if(dtrie_insert(failure_node, scan_prefix->s, scan_prefix->len, frr,
-				   cr_match_mode)
+		if(ptrie_insert(failure_node, scan_prefix->s, scan_prefix->len, frr)
 				!= 0) {
-			LM_ERR("cannot insert failure route rule into d-trie\n");
+			LM_ERR("cannot insert failure route rule into trie\n");
 			return -1;
 		}
 	}
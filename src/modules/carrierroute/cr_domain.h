@@ -32,7 +32,7 @@
 
 #include "../../core/str.h"
 #include "../../core/flags.h"
-#include "../../lib/trie/dtrie.h"
+#include "../../lib/trie/ptrie.h"
 
 
 /**
@@ -44,10 +44,10 @@ struct domain_data_t
 	int id;	   /*!< the numerical id of the routing tree */
 	str *name; /*!< the name of the routing tree. This points to the name in domain_map to avoid duplication. */
 	double sum_prob; /*!< sums the probabilities of all entries in the normal tree. Used to warn that (carrier, domain) has only routes with probability 0. */
-	struct dtrie_node_t *
-			tree; /*!< the root node of the routing tree. Payload is of type (struct route_flags *) */
-	struct dtrie_node_t *
-			failure_tree; /*!< the root node of the failure routing tree. Payload is of type (struct failure_route_rule *) */
+	struct ptrie_t *
+			tree; /*!< the routing tree. Payload is of type (struct route_flags *) */
+	struct ptrie_t *
+			failure_tree; /*!< the failure routing tree. Payload is of type (struct failure_route_rule *) */
 };
 
 
@@ -78,7 +78,7 @@ void destroy_domain_data(struct domain_data_t *domain_data);
  * prob gives the probability with which this rule applies if there are
  * more than one for a given prefix.
  *
- * @param node the root of the routing tree
+ * @param node the routing tree
  * @param scan_prefix the prefix for which to add the rule (must not contain non-digits)
  * @param flags user defined flags
  * @param mask mask for user defined flags
@@ -102,7 +102,7 @@ void destroy_domain_data(struct domain_data_t *domain_data);
  *
  * @see add_route()
  */
-int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
+int add_route_to_tree(struct ptrie_t *node, const str *scan_prefix,
 		flag_t flags, flag_t mask, const str *full_prefix, int max_targets,
 		double prob, const str *rewrite_hostpart, int strip,
 		const str *rewrite_local_prefix, const str *rewrite_local_suffix,
@@ -116,7 +116,7 @@ int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
  * the information is and the next_domain parameters defines where to continue
  * routing in case of a match.
  *
- * @param failure_node the root of the failure routing tree
+ * @param failure_node the failure routing tree
  * @param scan_prefix the prefix for which to add the rule (must not contain non-digits)
  * @param full_prefix the whole scan prefix
  * @param host the hostname last tried
@@ -130,7 +130,7 @@ int add_route_to_tree(struct dtrie_node_t *node, const str *scan_prefix,
  *
  * @see add_route()
  */
-int add_failure_route_to_tree(struct dtrie_node_t *failure_node,
+int add_failure_route_to_tree(struct ptrie_t *failure_node,
 		const str *scan_prefix, const str *full_prefix, const str *host,
 		const str *reply_code, const flag_t flags, const flag_t mask,
 		const int next_domain, const str *comment);
@@ -150,11 +150,10 @@ void cr_rpc_dump_routes(rpc_t *rpc, void *ctx)
 								ctx, 500, "Internal error - domain structure");
 						goto error;
 					}
-					if(dump_tree_recursor(rpc, ctx, gh,
-							   rd->carriers[i]->domains[j]->tree, "")
+					if(dump_tree(rpc, ctx, gh,
+							   rd->carriers[i]->domains[j]->tree)
 							< 0) {
-						LM_ERR("dump tree recursor failure at count %d/%d\n", i,
-								j);
+						LM_ERR("dump tree failure at count %d/%d\n", i, j);
 						goto error;
 					}
 				}
@@ -30,7 +30,7 @@
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
 #include "../../core/str.h"
-#include "../../lib/trie/dtrie.h"
+#include "../../lib/trie/ptrie.h"
 
 #define E_MISC -1
 #define E_NOOPT -2
@@ -125,8 +125,7 @@ typedef struct rpc_opt
 
 extern rpc_export_t cr_rpc_methods[];
 
-int dump_tree_recursor(rpc_t *rpc, void *ctx, void *gh,
-		struct dtrie_node_t *node, char *prefix);
+int dump_tree(rpc_t *rpc, void *ctx, void *gh, struct ptrie_t *tree);
 
 int get_rpc_opts(str *buf, rpc_opt_t *opts, unsigned int opt_set[]);
 int update_route_data(rpc_opt_t *opts);
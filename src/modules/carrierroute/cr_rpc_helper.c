@@ -51,27 +51,35 @@ static int str_toklen(str *str, const char *delims)
 	return len;
 }
 
+/** parameters of update_route_data_node */
+typedef struct update_route_param
+{
+	str *act_domain; /*!< routing domain which is currently searched */
+	rpc_opt_t *opts; /*!< the fifo command option structure */
+} update_route_param_t;
+
 /**
- * Does the work for update_route_data by recursively
- * traversing the routing tree
+ * Does the work for update_route_data for each node of the routing tree
  *
- * @param node points to the current routing tree node
- * @param act_domain routing domain which is currently
- * searched
- * @param opts points to the fifo command option structure
+ * @param data points to the payload of the current routing tree node
+ * @param prefix the prefix of the node
+ * @param len the length of the prefix
+ * @param param points to the update_route_param_t structure
  *
  * @see update_route_data()
  *
  * @return 0 on success, -1 on failure
  */
-static int update_route_data_recursor(
-		struct dtrie_node_t *node, str *act_domain, rpc_opt_t *opts)
+static int update_route_data_node(
+		void **data, const char *prefix, unsigned int len, void *param)
 {
-	int i, hash = 0;
+	str *act_domain = ((update_route_param_t *)param)->act_domain;
+	rpc_opt_t *opts = ((update_route_param_t *)param)->opts;
+	int hash = 0;
 	struct route_rule *rr, *prev = NULL, *tmp, *backup;
 	struct route_flags *rf;
 
-	rf = (struct route_flags *)(node->data);
+	rf = (struct route_flags *)(*data);
 	if(rf && rf->rule_list) {
 		rr = rf->rule_list;
 		while(rr) {
@@ -249,59 +257,42 @@ static int update_route_data_recursor(
 			}
 		}
 	}
-	for(i = 0; i < cr_match_mode; i++) {
-		if(node->child[i]) {
-			if(update_route_data_recursor(node->child[i], act_domain, opts)
-					< 0) {
-				return -1;
-			}
-		}
-	}
 	return 0;
 }
 
 
+/** parameters of dump_tree_node */
+typedef struct dump_tree_param
+{
+	rpc_t *rpc; /*!< RPC API structure */
+	void *ctx;	/*!< RPC context */
+	void *gh;	/*!< RPC structure pointer */
+} dump_tree_param_t;
+
 /**
- * Traverses the routing tree and prints route rules if present.
+ * Prints the route rules of a routing tree node if present.
  *
- * @param rpc - RPC API structure
- * @param ctx - RPC context
- * @param gh - RPC structure pointer
- * @param node pointer to the routing tree node
- * @param prefix carries the current scan prefix
+ * @param data points to the payload of the routing tree node
+ * @param prefix the scan prefix of the node
+ * @param len the length of the prefix
+ * @param param points to the dump_tree_param_t structure
  *
  * @return 0 for success, negative result for error
  */
-int dump_tree_recursor(rpc_t *rpc, void *ctx, void *gh,
-		struct dtrie_node_t *node, char *prefix)
+static int dump_tree_node(
+		void **data, const char *prefix, unsigned int len, void *param)
 {
-	char s[256];
-	char *p;
-	int i, len;
+	rpc_t *rpc = ((dump_tree_param_t *)param)->rpc;
+	void *ctx = ((dump_tree_param_t *)param)->ctx;
+	void *gh = ((dump_tree_param_t *)param)->gh;
+	int i;
 	struct route_flags *rf;
 	struct route_rule *rr;
 	struct route_rule_p_list *rl;
 	double prob;
 	void *hh, *ih;
 
-	len = strlen(prefix);
-	if(len > 254) {
-		LM_ERR("prefix too large");
-		return -1;
-	}
-	strcpy(s, prefix);
-	p = s + len;
-	p[1] = '\0';
-	for(i = 0; i < cr_match_mode; ++i) {
-		if(node->child[i] != NULL) {
-			*p = i + '0';
-			/* if there is a problem in processing the child nodes .. return an error */
-			if(dump_tree_recursor(rpc, ctx, gh, node->child[i], s) < 0)
-				return -1;
-		}
-	}
-	*p = '\0';
-	for(rf = (struct route_flags *)(node->data); rf != NULL; rf = rf->next) {
+	for(rf = (struct route_flags *)(*data); rf != NULL; rf = rf->next) {
 		for(rr = rf->rule_list; rr != NULL; rr = rr->next) {
 			if(rf->dice_max) {
 				prob = (double)(rr->prob * DICE_MAX) / (double)rf->dice_max;
@@ -358,6 +349,28 @@ int dump_tree_recursor(rpc_t *rpc, void *ctx, void *gh,
 	return 0;
 }
 
+
+/**
+ * Traverses the routing tree and prints route rules if present, the
+ * longer prefixes first.
+ *
+ * @param rpc - RPC API structure
+ * @param ctx - RPC context
+ * @param gh - RPC structure pointer
+ * @param tree the routing tree
+ *
+ * @return 0 for success, negative result for error
+ */
+int dump_tree(rpc_t *rpc, void *ctx, void *gh, struct ptrie_t *tree)
+{
+	dump_tree_param_t dp;
+
+	dp.rpc = rpc;
+	dp.ctx = ctx;
+	dp.gh = gh;
+	return ptrie_walk(tree, dump_tree_node, &dp, 1);
+}
+
 /**
  * parses the command line argument for options
  *
@@ -533,6 +546,7 @@ int update_route_data(rpc_opt_t *opts)
 	struct route_data_t *rd;
 	int i, j;
 	int domain_id;
+	update_route_param_t up;
 	str tmp_domain;
 	str tmp_prefix;
 	str tmp_host;
@@ -611,9 +625,10 @@ int update_route_data(rpc_opt_t *opts)
 				for(j = 0; j < rd->carriers[i]->domain_num; j++) {
 					if(rd->carriers[i]->domains[j]
 							&& rd->carriers[i]->domains[j]->tree) {
-						if(update_route_data_recursor(
-								   rd->carriers[i]->domains[j]->tree,
-								   rd->carriers[i]->domains[j]->name, opts)
+						up.act_domain = rd->carriers[i]->domains[j]->name;
+						up.opts = opts;
+						if(ptrie_walk(rd->carriers[i]->domains[j]->tree,
+								   update_route_data_node, &up, 0)
 								< 0) {
 							goto errout;
 						}
@@ -31,6 +31,8 @@
 #include "../../core/dprint.h"
 #include "../../core/compiler_opt.h"
 #include "../../core/counters.h"
+#include "../../core/mem/mem.h"
+#include "../../core/ut.h"
 #include "../../core/kemi.h"
 
 MODULE_VERSION
@@ -39,11 +41,14 @@ MODULE_VERSION
 static char *cnt_script_grp = "script";
 
 static int add_script_counter(modparam_t type, void *val);
+static int add_script_histogram(modparam_t type, void *val);
 static int cnt_inc_f(struct sip_msg *, char *, char *);
 static int cnt_add_f(struct sip_msg *, char *, char *);
 static int cnt_reset_f(struct sip_msg *, char *, char *);
+static int cnt_observe_f(struct sip_msg *, char *, char *);
 static int cnt_fixup1(void **param, int param_no);
 static int cnt_int_fixup(void **param, int param_no);
+static int cnt_hist_fixup(void **param, int param_no);
 
 
 static cmd_export_t cmds[] = {
@@ -53,11 +58,15 @@ static cmd_export_t cmds[] = {
 				REQUEST_ROUTE | ONREPLY_ROUTE | FAILURE_ROUTE | ONSEND_ROUTE},
 		{"cnt_reset", cnt_reset_f, 1, cnt_fixup1, 0,
 				REQUEST_ROUTE | ONREPLY_ROUTE | FAILURE_ROUTE | ONSEND_ROUTE},
+		{"cnt_observe", cnt_observe_f, 2, cnt_hist_fixup, 0,
+				REQUEST_ROUTE | ONREPLY_ROUTE | FAILURE_ROUTE | ONSEND_ROUTE},
 		{0, 0, 0, 0, 0, 0}};
 
 static param_export_t params[] = {
 		{"script_cnt_grp_name", PARAM_STRING, &cnt_script_grp},
 		{"script_counter", PARAM_STRING | PARAM_USE_FUNC, add_script_counter},
+		{"script_histogram", PARAM_STRING | PARAM_USE_FUNC,
+				add_script_histogram},
 		{0, 0, 0}};
 
 
@@ -170,6 +179,105 @@ error:
 }
 
 
+/** parse the script_histogram modparam.
+ *  Format:   [grp.]name=bounds[ desc]
+ *  where bounds is either a comma separated list of increasing bucket
+ *  upper bounds or log:min:max:steps for log-linear buckets.
+ *  E.g.:
+ *           "rtime=10,50,100,500" => histogram *cnt_script_grp."rtime"
+ *           "grp.rtime=log:1:100000:2 desc" => "grp"."rtime", log-linear
+ *                   buckets 1, 5, 10, 55, ..., 100000, desc = "desc".
+ */
+static int add_script_histogram(modparam_t type, void *val)
+{
+	counter_val_t bounds[CNT_HIST_MAX_BOUNDS];
+	counter_hist_t hist;
+	char *name;
+	char *grp;
+	char *desc;
+	char *b;
+	char *p;
+	char *e;
+	long v[3];
+	int n;
+	int ret;
+
+	if((type & PARAM_STRING) == 0) {
+		BUG("bad parameter type %d\n", type);
+		goto error;
+	}
+	name = (char *)val;
+	grp = cnt_script_grp;			   /* default group */
+	desc = "custom script histogram."; /* default desc. */
+	if((b = strchr(name, '=')) == 0) {
+		ERR("missing bounds in histogram definition: %s\n", name);
+		goto error;
+	}
+	*b = 0;
+	b++;
+	if((p = strchr(b, ' ')) != 0 || (p = strchr(b, '\t')) != 0) {
+		/* found desc. */
+		*p = 0;
+		for(p = p + 1; *p && (*p == ' ' || *p == '\t'); p++)
+			;
+		if(*p)
+			desc = p;
+	}
+	if((p = strchr(name, '.')) != 0) {
+		/* found group */
+		grp = name;
+		*p = 0;
+		name = p + 1;
+	}
+	if(strncmp(b, "log:", 4) == 0) {
+		p = b + 4;
+		for(n = 0; n < 3; n++) {
+			v[n] = strtol(p, &e, 10);
+			if(e == p || (n < 2 && *e != ':') || (n == 2 && *e != 0)) {
+				ERR("invalid log-linear bounds for histogram %s.%s: %s\n",
+						grp, name, b);
+				goto error;
+			}
+			p = e + 1;
+		}
+		n = counter_hist_loglinear(
+				bounds, CNT_HIST_MAX_BOUNDS, v[0], v[1], (int)v[2]);
+		if(n <= 0) {
+			ERR("invalid log-linear bounds for histogram %s.%s: %s\n", grp,
+					name, b);
+			goto error;
+		}
+	} else {
+		p = b;
+		for(n = 0; *p; n++) {
+			if(n >= CNT_HIST_MAX_BOUNDS) {
+				ERR("too many bounds for histogram %s.%s (max %d)\n", grp,
+						name, CNT_HIST_MAX_BOUNDS);
+				goto error;
+			}
+			bounds[n] = strtol(p, &e, 10);
+			if(e == p || (*e != ',' && *e != 0)) {
+				ERR("invalid bounds for histogram %s.%s: %s\n", grp, name, b);
+				goto error;
+			}
+			p = (*e) ? e + 1 : e;
+		}
+	}
+	ret = counter_hist_register(&hist, grp, name, bounds, n, desc);
+	if(ret < 0) {
+		if(ret == -2) {
+			ERR("histogram %s.%s already registered\n", grp, name);
+			return 0;
+		}
+		ERR("failed to register histogram %s.%s\n", grp, name);
+		goto error;
+	}
+	return 0;
+error:
+	return -1;
+}
+
+
 static int cnt_fixup1(void **param, int param_no)
 {
 	char *name;
@@ -222,6 +330,40 @@ static int cnt_int_fixup(void **param, int param_no)
 }
 
 
+static int cnt_hist_fixup(void **param, int param_no)
+{
+	char *name;
+	char *grp;
+	char *p;
+	counter_hist_t *hist;
+
+	if(param_no == 1) {
+		name = (char *)*param;
+		grp = cnt_script_grp; /* default group */
+		if((p = strchr(name, '.')) != 0) {
+			/* found group */
+			grp = name;
+			name = p + 1;
+			*p = 0;
+		}
+		hist = pkg_malloc(sizeof(counter_hist_t));
+		if(hist == 0) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		if(counter_hist_lookup(hist, grp, name) < 0) {
+			ERR("histogram %s.%s does not exist (forgot to define it?)\n",
+					grp, name);
+			pkg_free(hist);
+			return -1;
+		}
+		*param = (void *)hist;
+	} else
+		return fixup_var_int_2(param, param_no);
+	return 0;
+}
+
+
 /**
  *
  */
@@ -321,15 +463,74 @@ static int ki_cnt_reset(sip_msg_t *msg, str *sname)
 }
 
 
+/**
+ *
+ */
+static int cnt_observe_f(struct sip_msg *msg, char *hist, char *val)
+{
+	int v;
+
+	if(unlikely(get_int_fparam(&v, msg, (fparam_t *)val) < 0)) {
+		ERR("non integer parameter\n");
+		return -1;
+	}
+	counter_hist_observe((counter_hist_t *)hist, v);
+	return 1;
+}
+
+
+static int ki_cnt_observe(sip_msg_t *msg, str *sname, int v)
+{
+	char *name;
+	char *grp;
+	char *p;
+	counter_hist_t hist;
+
+	name = sname->s;
+	grp = cnt_script_grp; /* default group */
+	if((p = strchr(name, '.')) != 0) {
+		/* found group */
+		grp = name;
+		name = p + 1;
+		*p = 0;
+	}
+	if(counter_hist_lookup(&hist, grp, name) < 0) {
+		ERR("histogram %s.%s does not exist (forgot to define it?)\n", grp,
+				name);
+		return -1;
+	}
+
+	counter_hist_observe(&hist, v);
+	return 1;
+}
+
+
 static void cnt_grp_get_all(rpc_t *rpc, void *c, char *group);
 
 
+/* add the histogram values to a rpc struct */
+static void cnt_hist_rpc_fill(rpc_t *rpc, void *s, counter_hist_val_t *hval)
+{
+	char bname[INT2STR_MAX_LEN + 4];
+	int i;
+
+	rpc->struct_add(s, "dd", "count", (int)hval->count, "sum", (int)hval->sum);
+	for(i = 0; i < hval->nbounds; i++) {
+		snprintf(bname, sizeof(bname), "le_%ld", (long)hval->bounds[i]);
+		rpc->struct_add(s, "d", bname, (int)hval->buckets[i]);
+	}
+	rpc->struct_add(s, "d", "le_inf", (int)hval->buckets[hval->nbounds]);
+}
+
+
 static void cnt_get_rpc(rpc_t *rpc, void *c)
 {
 	char *group;
 	char *name;
 	counter_val_t v;
 	counter_handle_t h;
+	counter_hist_val_t hval;
+	void *s;
 
 	if(rpc->scan(c, "s", &group) < 1)
 		return;
@@ -342,6 +543,12 @@ static void cnt_get_rpc(rpc_t *rpc, void *c)
 		rpc->fault(c, 400, "non-existent counter %s.%s\n", group, name);
 		return;
 	}
+	if(counter_hist_get_val(h, &hval) == 0) {
+		if(rpc->add(c, "{", &s) < 0)
+			return;
+		cnt_hist_rpc_fill(rpc, s, &hval);
+		return;
+	}
 	v = counter_get_val(h);
 	rpc->add(c, "d", (int)v);
 	return;
@@ -413,12 +620,20 @@ static void rpc_print_name(void *param, str *n)
 static void rpc_print_name_val(void *param, str *g, str *n, counter_handle_t h)
 {
 	struct rpc_list_params *p;
+	counter_hist_val_t hval;
 	rpc_t *rpc;
 	void *s;
+	void *hs;
 
 	p = param;
 	rpc = p->rpc;
 	s = p->ctx;
+	if(counter_hist_get_val(h, &hval) == 0) {
+		if(rpc->struct_add(s, "{", n->s, &hs) < 0)
+			return;
+		cnt_hist_rpc_fill(rpc, hs, &hval);
+		return;
+	}
 	rpc->struct_add(s, "d", n->s, (int)counter_get_val(h));
 }
 
@@ -516,6 +731,11 @@ static sr_kemi_t sr_kemi_counters_exports[] = {
 		{ SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
 			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
 	},
+	{ str_init("counters"), str_init("observe"),
+		SR_KEMIP_INT, ki_cnt_observe,
+		{ SR_KEMIP_STR, SR_KEMIP_INT, SR_KEMIP_NONE,
+			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+	},
 
 	{ {0, 0}, {0, 0}, 0, NULL, { 0, 0, 0, 0, 0, 0 } }
 };
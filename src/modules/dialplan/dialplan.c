@@ -96,6 +96,7 @@ int dp_fetch_rows = 1000;
 int dp_match_dynamic = 0;
 int dp_append_branch = 1;
 int dp_reload_delta = 5;
+int dp_match_engine = 0;
 
 static time_t *dp_rpc_reload_time = NULL;
 /* clang-format off */
@@ -115,6 +116,7 @@ static param_export_t mod_params[]={
 	{ "match_dynamic",	PARAM_INT,	&dp_match_dynamic },
 	{ "append_branch",	PARAM_INT,	&dp_append_branch },
 	{ "reload_delta",	PARAM_INT,	&dp_reload_delta },
+	{ "match_engine",	PARAM_INT,	&dp_match_engine },
 	{0,0,0}
 };
 
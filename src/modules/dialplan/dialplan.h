@@ -48,6 +48,7 @@
 
 extern pcre2_general_context *dpl_gctx;
 extern pcre2_compile_context *dpl_ctx;
+extern int dp_match_engine;
 
 typedef struct dpl_node
 {
@@ -104,6 +105,7 @@ void destroy_data();
 int dp_load_db();
 
 dpl_id_p select_dpid(int id);
+int dpl_data_version(void);
 
 struct subst_expr *repl_exp_parse(str subst);
 void repl_expr_free(struct subst_expr *se);
@@ -81,6 +81,7 @@ void list_hash(int h_index);
 static dpl_id_p *dp_rules_hash = NULL;
 static int *dp_crt_idx = NULL;
 static int *dp_next_idx = NULL;
+static int *dp_data_version = NULL;
 
 
 /**
@@ -232,14 +233,15 @@ int init_data(void)
 	}
 	dp_rules_hash[0] = dp_rules_hash[1] = 0;
 
-	p = (int *)shm_malloc(2 * sizeof(int));
+	p = (int *)shm_malloc(3 * sizeof(int));
 	if(!p) {
 		LM_ERR("out of shm memory\n");
 		return -1;
 	}
 	dp_crt_idx = p;
 	dp_next_idx = p + 1;
-	*dp_crt_idx = *dp_next_idx = 0;
+	dp_data_version = p + 2;
+	*dp_crt_idx = *dp_next_idx = *dp_data_version = 0;
 
 	LM_DBG("trying to initialize data from db\n");
 	if(init_db_data() != 0)
@@ -360,7 +362,9 @@ int dp_load_db(void)
 
 
 end:
-	/*update data*/
+	/*update data - version first, so that per process data built for the
+	 * new rules is never tagged with the old version*/
+	(*dp_data_version)++;
 	*dp_crt_idx = *dp_next_idx;
 	list_hash(*dp_crt_idx);
 	dp_dbf.free_result(dp_db_handle, res);
@@ -761,6 +765,15 @@ dpl_id_p select_dpid(int id)
 }
 
 
+/* version of the rules data, changed by each reload */
+int dpl_data_version(void)
+{
+	if(!dp_data_version)
+		return 0;
+	return *dp_data_version;
+}
+
+
 /*FOR DEBUG PURPOSE*/
 void list_hash(int h_index)
 {
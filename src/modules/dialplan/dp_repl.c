@@ -31,6 +31,7 @@
  */
 
 
+#include <ctype.h>
 #include <fnmatch.h>
 
 #include "../../core/re.h"
@@ -593,6 +594,504 @@ error:
 	return -1;
 }
 
+/* check if one rule matches the input
+ * - return: 1 - match; 0 - no match; -1 - error */
+static int dpl_rule_match(sip_msg_t *msg, dpl_node_p rulep, str *input,
+		pcre2_match_data *pcre_md)
+{
+	int rez;
+	char b;
+	dpl_dyn_pcre_p re_list = NULL;
+	dpl_dyn_pcre_p rt = NULL;
+
+	switch(rulep->matchop) {
+
+		case DP_REGEX_OP:
+			LM_DBG("regex operator testing over [%.*s]\n", input->len,
+					input->s);
+			if(rulep->tflags & DP_TFLAGS_PV_MATCH) {
+				re_list = dpl_dynamic_pcre_list(msg, &rulep->match_exp);
+				if(re_list == NULL) {
+					/* failed to compile dynamic pcre -- ignore */
+					LM_DBG("failed to compile dynamic pcre[%.*s]\n",
+							rulep->match_exp.len, rulep->match_exp.s);
+					return 0;
+				}
+				rez = -1;
+				do {
+					if(rez < 0) {
+						rez = pcre2_match(re_list->re, (PCRE2_SPTR)input->s,
+								(PCRE2_SIZE)input->len, 0, 0, pcre_md, NULL);
+						LM_DBG("match check: [%.*s] %d\n", re_list->expr.len,
+								re_list->expr.s, rez);
+					} else
+						LM_DBG("match check skipped: [%.*s] %d\n",
+								re_list->expr.len, re_list->expr.s, rez);
+					rt = re_list->next;
+					pcre2_code_free(re_list->re);
+					pkg_free(re_list);
+					re_list = rt;
+				} while(re_list);
+			} else {
+				rez = pcre2_match(rulep->match_comp, (PCRE2_SPTR)input->s,
+						(PCRE2_SIZE)input->len, 0, 0, pcre_md, 0);
+			}
+			break;
+
+		case DP_EQUAL_OP:
+			LM_DBG("equal operator testing\n");
+			if(rulep->match_exp.s == NULL
+					|| rulep->match_exp.len != input->len) {
+				rez = -1;
+			} else {
+				rez = strncmp(rulep->match_exp.s, input->s, input->len);
+				rez = (rez == 0) ? 0 : -1;
+			}
+			break;
+
+		case DP_FNMATCH_OP:
+			LM_DBG("fnmatch operator testing\n");
+			if(rulep->match_exp.s != NULL) {
+				b = input->s[input->len];
+				input->s[input->len] = '\0';
+				rez = fnmatch(rulep->match_exp.s, input->s, 0);
+				input->s[input->len] = b;
+				rez = (rez == 0) ? 0 : -1;
+			} else {
+				rez = -1;
+			}
+			break;
+
+		default:
+			LM_ERR("bogus match operator code %i\n", rulep->matchop);
+			return -1;
+	}
+	return (rez >= 0) ? 1 : 0;
+}
+
+/*
+ * Multi-pattern match engine (match_engine = 1)
+ *
+ * Each process compiles, on first use after a reload, a private program for
+ * every rule list (dpl_index) it matches against. Consecutive static regex
+ * rules are joined into one anchored pattern of the form
+ *   (?:(*MARK:0)(?s:.*?)(?:re0))|(?:(*MARK:1)(?s:.*?)(?:re1))|...
+ * Backtracking tries the alternatives in order, each one at every position
+ * of the input (the .*? is left out for anchored expressions), so the first
+ * rule in priority order that matches is the one whose mark is returned, in
+ * a single pcre2_match() call. Rules that cannot be joined (other
+ * operators, dynamic expressions, back references, ...) are matched on
+ * their own. The private patterns, joined or not, are JIT compiled, which
+ * cannot be done for the patterns kept in shared memory.
+ */
+
+#define DPL_MRUN_MAX_RULES 256
+#define DPL_MRUN_MAX_LEN 32768
+#define DPL_MPROG_HSIZE 64
+
+typedef struct dpl_mseg
+{
+	dpl_node_p first;  /* first rule of the segment */
+	int nrules;		   /* number of rules in the segment */
+	pcre2_code *re;	   /* private pattern, NULL to match rules one by one */
+	dpl_node_p *rules; /* rules indexed by mark, for joined patterns */
+	struct dpl_mseg *next;
+} dpl_mseg_t, *dpl_mseg_p;
+
+typedef struct dpl_mprog
+{
+	dpl_index_p indexp; /* rule list the program was built for */
+	dpl_mseg_p segs;
+	struct dpl_mprog *next;
+} dpl_mprog_t, *dpl_mprog_p;
+
+static dpl_mprog_p _dpl_mprog_hash[DPL_MPROG_HSIZE];
+static int _dpl_mprog_version = -1;
+static pcre2_match_data *_dpl_mprog_md = NULL;
+static pcre2_general_context *_dpl_mprog_gctx = NULL;
+static pcre2_compile_context *_dpl_mprog_ctx = NULL;
+
+static void *dpl_mprog_malloc(size_t size, void *ext)
+{
+	return pkg_malloc(size);
+}
+
+static void dpl_mprog_free_mem(void *ptr, void *ext)
+{
+	if(ptr)
+		pkg_free(ptr);
+}
+
+/* pkg memory contexts for the private patterns and match data */
+static int dpl_mprog_ctx_init(void)
+{
+	if(_dpl_mprog_ctx != NULL)
+		return 0;
+	if(_dpl_mprog_gctx == NULL) {
+		_dpl_mprog_gctx = pcre2_general_context_create(
+				dpl_mprog_malloc, dpl_mprog_free_mem, NULL);
+		if(_dpl_mprog_gctx == NULL) {
+			LM_ERR("pcre2 general context creation failed\n");
+			return -1;
+		}
+	}
+	_dpl_mprog_ctx = pcre2_compile_context_create(_dpl_mprog_gctx);
+	if(_dpl_mprog_ctx == NULL) {
+		LM_ERR("pcre2 compile context creation failed\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* can the match expression of the rule be joined with other ones */
+static int dpl_rule_joinable(dpl_node_p rulep)
+{
+	uint32_t v;
+	char *p, *end, *q;
+
+	if(rulep->matchop != DP_REGEX_OP || (rulep->tflags & DP_TFLAGS_PV_MATCH)
+			|| rulep->match_comp == NULL || rulep->match_exp.s == NULL)
+		return 0;
+	/* group numbers and names change in a joined pattern */
+	if(pcre2_pattern_info(rulep->match_comp, PCRE2_INFO_BACKREFMAX, &v) != 0
+			|| v > 0)
+		return 0;
+	if(pcre2_pattern_info(rulep->match_comp, PCRE2_INFO_NAMECOUNT, &v) != 0
+			|| v > 0)
+		return 0;
+	p = rulep->match_exp.s;
+	end = p + rulep->match_exp.len;
+	for(; p < end - 1; p++) {
+		if(p[0] == '\\') {
+			/* unterminated quoting, back references, subroutine calls */
+			if(strchr("Qgk123456789", p[1]) != NULL)
+				return 0;
+			p++;
+			continue;
+		}
+		/* verbs, start options */
+		if(p[0] == '(' && p[1] == '*')
+			return 0;
+		if(p[0] == '(' && p[1] == '?') {
+			/* conditionals, recursion, named references, subroutine calls */
+			if(p + 2 < end && strchr("(R&P+0123456789", p[2]) != NULL)
+				return 0;
+			if(p + 3 < end && p[2] == '-' && isdigit((unsigned char)p[3]))
+				return 0;
+			/* extended mode comments could swallow the group end */
+			for(q = p + 2; q < end && (isalpha((unsigned char)*q) || *q == '-'
+										   || *q == '^');
+					q++) {
+				if(*q == 'x')
+					return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/* compile a private pattern, JIT compiled when available */
+static pcre2_code *dpl_mprog_comp(char *pattern, int len, uint32_t options)
+{
+	pcre2_code *re;
+	int err = 0;
+	PCRE2_SIZE erroffset;
+
+	if(dpl_mprog_ctx_init() < 0)
+		return NULL;
+	re = pcre2_compile((PCRE2_SPTR)pattern, (PCRE2_SIZE)len, options, &err,
+			&erroffset, _dpl_mprog_ctx);
+	if(re == NULL) {
+		LM_DBG("failed to compile pattern (error %d at offset %zu)\n", err,
+				erroffset);
+		return NULL;
+	}
+	if(pcre2_jit_compile(re, PCRE2_JIT_COMPLETE) != 0) {
+		LM_DBG("pattern is not JIT compiled\n");
+	}
+	return re;
+}
+
+/* build segments for a run of n joinable rules starting at first */
+static int dpl_mprog_add_run(dpl_mseg_p **tail, dpl_node_p first, int n)
+{
+	dpl_mseg_p seg;
+	dpl_node_p rulep;
+	char *buf = NULL;
+	uint32_t opts;
+	int i, len, h;
+
+	seg = (dpl_mseg_p)pkg_malloc(sizeof(dpl_mseg_t));
+	if(seg == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memset(seg, 0, sizeof(dpl_mseg_t));
+	seg->first = first;
+	seg->nrules = n;
+
+	if(n == 1) {
+		seg->re = dpl_mprog_comp(first->match_exp.s, first->match_exp.len, 0);
+		goto done;
+	}
+
+	len = 0;
+	for(i = 0, rulep = first; i < n; i++, rulep = rulep->next)
+		len += rulep->match_exp.len + 32 + INT2STR_MAX_LEN;
+	if(len <= DPL_MRUN_MAX_LEN) {
+		buf = (char *)pkg_malloc(len);
+		seg->rules = (dpl_node_p *)pkg_malloc(n * sizeof(dpl_node_p));
+		if(buf == NULL || seg->rules == NULL) {
+			PKG_MEM_ERROR;
+			goto error;
+		}
+		len = 0;
+		for(i = 0, rulep = first; i < n; i++, rulep = rulep->next) {
+			seg->rules[i] = rulep;
+			/* anchored expressions can match only at the start */
+			if(pcre2_pattern_info(
+					   rulep->match_comp, PCRE2_INFO_ALLOPTIONS, &opts)
+					!= 0)
+				opts = 0;
+			len += sprintf(buf + len, "%s(?:(*MARK:%d)%s(?:",
+					(i > 0) ? "|" : "", i,
+					(opts & PCRE2_ANCHORED) ? "" : "(?s:.*?)");
+			memcpy(buf + len, rulep->match_exp.s, rulep->match_exp.len);
+			len += rulep->match_exp.len;
+			buf[len++] = ')';
+			buf[len++] = ')';
+		}
+		seg->re = dpl_mprog_comp(buf, len, PCRE2_ANCHORED);
+		pkg_free(buf);
+		buf = NULL;
+		if(seg->re != NULL)
+			goto done;
+		pkg_free(seg->rules);
+		seg->rules = NULL;
+	}
+	/* too long or failed to compile - split the run */
+	pkg_free(seg);
+	h = n / 2;
+	for(i = 0, rulep = first; i < h; i++)
+		rulep = rulep->next;
+	if(dpl_mprog_add_run(tail, first, h) < 0)
+		return -1;
+	return dpl_mprog_add_run(tail, rulep, n - h);
+
+done:
+	**tail = seg;
+	*tail = &seg->next;
+	return 0;
+
+error:
+	if(buf)
+		pkg_free(buf);
+	if(seg->rules)
+		pkg_free(seg->rules);
+	pkg_free(seg);
+	return -1;
+}
+
+static void dpl_mprog_free(dpl_mprog_p prog)
+{
+	dpl_mseg_p seg, next;
+
+	for(seg = prog->segs; seg != NULL; seg = next) {
+		next = seg->next;
+		if(seg->re)
+			pcre2_code_free(seg->re);
+		if(seg->rules)
+			pkg_free(seg->rules);
+		pkg_free(seg);
+	}
+	pkg_free(prog);
+}
+
+static dpl_mprog_p dpl_mprog_build(dpl_index_p indexp)
+{
+	dpl_mprog_p prog;
+	dpl_mseg_p seg, *tail;
+	dpl_node_p rulep, first;
+	int n;
+
+	prog = (dpl_mprog_p)pkg_malloc(sizeof(dpl_mprog_t));
+	if(prog == NULL) {
+		PKG_MEM_ERROR;
+		return NULL;
+	}
+	memset(prog, 0, sizeof(dpl_mprog_t));
+	prog->indexp = indexp;
+	tail = &prog->segs;
+
+	rulep = indexp->first_rule;
+	while(rulep != NULL) {
+		if(!dpl_rule_joinable(rulep)) {
+			seg = (dpl_mseg_p)pkg_malloc(sizeof(dpl_mseg_t));
+			if(seg == NULL) {
+				PKG_MEM_ERROR;
+				goto error;
+			}
+			memset(seg, 0, sizeof(dpl_mseg_t));
+			seg->first = rulep;
+			seg->nrules = 1;
+			if(rulep->matchop == DP_REGEX_OP
+					&& !(rulep->tflags & DP_TFLAGS_PV_MATCH)
+					&& rulep->match_exp.s != NULL)
+				seg->re = dpl_mprog_comp(
+						rulep->match_exp.s, rulep->match_exp.len, 0);
+			*tail = seg;
+			tail = &seg->next;
+			rulep = rulep->next;
+			continue;
+		}
+		first = rulep;
+		n = 0;
+		while(rulep != NULL && n < DPL_MRUN_MAX_RULES
+				&& dpl_rule_joinable(rulep)) {
+			n++;
+			rulep = rulep->next;
+		}
+		if(dpl_mprog_add_run(&tail, first, n) < 0)
+			goto error;
+	}
+	return prog;
+
+error:
+	dpl_mprog_free(prog);
+	return NULL;
+}
+
+/* get the program of a rule list, building it if needed */
+static dpl_mprog_p dpl_mprog_get(dpl_index_p indexp)
+{
+	dpl_mprog_p prog;
+	unsigned int h;
+	int version;
+
+	version = dpl_data_version();
+	if(version != _dpl_mprog_version) {
+		/* rules reloaded - drop programs */
+		for(h = 0; h < DPL_MPROG_HSIZE; h++) {
+			while(_dpl_mprog_hash[h] != NULL) {
+				prog = _dpl_mprog_hash[h];
+				_dpl_mprog_hash[h] = prog->next;
+				dpl_mprog_free(prog);
+			}
+		}
+		_dpl_mprog_version = version;
+	}
+
+	h = (unsigned int)(((unsigned long)indexp) >> 4) % DPL_MPROG_HSIZE;
+	for(prog = _dpl_mprog_hash[h]; prog != NULL; prog = prog->next) {
+		if(prog->indexp == indexp)
+			return prog;
+	}
+	prog = dpl_mprog_build(indexp);
+	if(prog == NULL)
+		return NULL;
+	prog->next = _dpl_mprog_hash[h];
+	_dpl_mprog_hash[h] = prog;
+	return prog;
+}
+
+/* match the rules of a segment one by one */
+static dpl_node_p dpl_mseg_match_rules(sip_msg_t *msg, dpl_mseg_p seg,
+		str *input, pcre2_match_data *pcre_md, int *err)
+{
+	dpl_node_p rulep;
+	int i, rez;
+
+	for(i = 0, rulep = seg->first; i < seg->nrules; i++, rulep = rulep->next) {
+		rez = dpl_rule_match(msg, rulep, input, pcre_md);
+		if(rez < 0) {
+			*err = 1;
+			return NULL;
+		}
+		if(rez > 0)
+			return rulep;
+	}
+	return NULL;
+}
+
+/* find the first matching rule of a rule list with the multi-pattern engine
+ * - return the rule, NULL if none matched (err is set on error) */
+static dpl_node_p dpl_mprog_match(sip_msg_t *msg, dpl_index_p indexp,
+		str *input, pcre2_match_data *pcre_md, int *err)
+{
+	dpl_mprog_p prog;
+	dpl_mseg_p seg;
+	dpl_node_p rulep;
+	PCRE2_SPTR mark;
+	int rez, i;
+
+	*err = 0;
+	prog = dpl_mprog_get(indexp);
+	if(prog == NULL) {
+		/* cannot build the program - match the rules one by one */
+		for(rulep = indexp->first_rule; rulep != NULL; rulep = rulep->next) {
+			rez = dpl_rule_match(msg, rulep, input, pcre_md);
+			if(rez < 0) {
+				*err = 1;
+				return NULL;
+			}
+			if(rez > 0)
+				return rulep;
+		}
+		return NULL;
+	}
+
+	if(_dpl_mprog_md == NULL) {
+		if(dpl_mprog_ctx_init() < 0) {
+			*err = 1;
+			return NULL;
+		}
+		_dpl_mprog_md = pcre2_match_data_create(1, _dpl_mprog_gctx);
+		if(_dpl_mprog_md == NULL) {
+			LM_ERR("failed to allocate pcre2_match_data\n");
+			*err = 1;
+			return NULL;
+		}
+	}
+
+	for(seg = prog->segs; seg != NULL; seg = seg->next) {
+		if(seg->re == NULL) {
+			rulep = dpl_mseg_match_rules(msg, seg, input, pcre_md, err);
+			if(rulep != NULL || *err)
+				return rulep;
+			continue;
+		}
+		rez = pcre2_match(seg->re, (PCRE2_SPTR)input->s,
+				(PCRE2_SIZE)input->len, 0, 0, _dpl_mprog_md, NULL);
+		if(rez == PCRE2_ERROR_NOMATCH)
+			continue;
+		if(rez < 0) {
+			/* match limits reached - fall back to the shared patterns */
+			LM_DBG("multi-pattern match failed (%d)\n", rez);
+			rulep = dpl_mseg_match_rules(msg, seg, input, pcre_md, err);
+			if(rulep != NULL || *err)
+				return rulep;
+			continue;
+		}
+		if(seg->rules == NULL)
+			return seg->first;
+		mark = pcre2_get_mark(_dpl_mprog_md);
+		if(mark == NULL) {
+			LM_BUG("no mark for joined pattern match\n");
+			*err = 1;
+			return NULL;
+		}
+		for(i = 0; *mark >= '0' && *mark <= '9'; mark++)
+			i = i * 10 + (*mark - '0');
+		if(i >= seg->nrules) {
+			LM_BUG("invalid mark %d for joined pattern match\n", i);
+			*err = 1;
+			return NULL;
+		}
+		return seg->rules[i];
+	}
+	return NULL;
+}
+
 #define DP_MAX_ATTRS_LEN 255
 static char dp_attrs_buf[DP_MAX_ATTRS_LEN + 1];
 int dp_translate_helper(
@@ -602,7 +1101,6 @@ int dp_translate_helper(
 	dpl_node_p rulep;
 	dpl_index_p indexp;
 	int user_len, rez;
-	char b;
 	dpl_dyn_pcre_p re_list = NULL;
 	dpl_dyn_pcre_p rt = NULL;
 
@@ -630,72 +1128,20 @@ int dp_translate_helper(
 	}
 
 search_rule:
-	for(rulep = indexp->first_rule; rulep != NULL; rulep = rulep->next) {
-		switch(rulep->matchop) {
-
-			case DP_REGEX_OP:
-				LM_DBG("regex operator testing over [%.*s]\n", input->len,
-						input->s);
-				if(rulep->tflags & DP_TFLAGS_PV_MATCH) {
-					re_list = dpl_dynamic_pcre_list(msg, &rulep->match_exp);
-					if(re_list == NULL) {
-						/* failed to compile dynamic pcre -- ignore */
-						LM_DBG("failed to compile dynamic pcre[%.*s]\n",
-								rulep->match_exp.len, rulep->match_exp.s);
-						continue;
-					}
-					rez = -1;
-					do {
-						if(rez < 0) {
-							rez = pcre2_match(re_list->re, (PCRE2_SPTR)input->s,
-									(PCRE2_SIZE)input->len, 0, 0, pcre_md,
-									NULL);
-							LM_DBG("match check: [%.*s] %d\n",
-									re_list->expr.len, re_list->expr.s, rez);
-						} else
-							LM_DBG("match check skipped: [%.*s] %d\n",
-									re_list->expr.len, re_list->expr.s, rez);
-						rt = re_list->next;
-						pcre2_code_free(re_list->re);
-						pkg_free(re_list);
-						re_list = rt;
-					} while(re_list);
-				} else {
-					rez = pcre2_match(rulep->match_comp, (PCRE2_SPTR)input->s,
-							(PCRE2_SIZE)input->len, 0, 0, pcre_md, 0);
-				}
-				break;
-
-			case DP_EQUAL_OP:
-				LM_DBG("equal operator testing\n");
-				if(rulep->match_exp.s == NULL
-						|| rulep->match_exp.len != input->len) {
-					rez = -1;
-				} else {
-					rez = strncmp(rulep->match_exp.s, input->s, input->len);
-					rez = (rez == 0) ? 0 : -1;
-				}
-				break;
-
-			case DP_FNMATCH_OP:
-				LM_DBG("fnmatch operator testing\n");
-				if(rulep->match_exp.s != NULL) {
-					b = input->s[input->len];
-					input->s[input->len] = '\0';
-					rez = fnmatch(rulep->match_exp.s, input->s, 0);
-					input->s[input->len] = b;
-					rez = (rez == 0) ? 0 : -1;
-				} else {
-					rez = -1;
-				}
-				break;
-
-			default:
-				LM_ERR("bogus match operator code %i\n", rulep->matchop);
+	if(dp_match_engine == 1) {
+		rulep = dpl_mprog_match(msg, indexp, input, pcre_md, &rez);
+		if(rez)
+			return -1;
+		if(rulep != NULL)
+			goto repl;
+	} else {
+		for(rulep = indexp->first_rule; rulep != NULL; rulep = rulep->next) {
+			rez = dpl_rule_match(msg, rulep, input, pcre_md);
+			if(rez < 0)
 				return -1;
+			if(rez > 0)
+				goto repl;
 		}
-		if(rez >= 0)
-			goto repl;
 	}
 	/*test the rules with len 0*/
 	if(indexp->len) {
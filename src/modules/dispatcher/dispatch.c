@@ -53,6 +53,7 @@
 #include "../../modules/tm/tm_load.h"
 #include "../../lib/srdb1/db.h"
 #include "../../lib/srdb1/db_res.h"
+#include "../../lib/srdb1/db_changelog.h"
 #include "../../core/str.h"
 #include "../../core/script_cb.h"
 #include "../../core/kemi.h"
@@ -83,6 +84,7 @@
 #define DS_ALG_PARALLEL 12
 #define DS_ALG_LATENCY 13
 #define DS_ALG_RRSERIAL 14
+#define DS_ALG_LEASTOREQ 15
 #define DS_ALG_OVERLOAD 64 /* 2^6 - can be also used as a flag */
 
 #define DS_HN_SIZE 256
@@ -116,6 +118,8 @@ static ds_ht_t *_dsht_load = NULL;
 
 static int *_ds_ping_active = NULL;
 
+static ds_ping_stats_t *_ds_ping_stats = NULL;
+
 extern int ds_force_dst;
 extern str ds_event_callback;
 extern int ds_ping_latency_stats;
@@ -127,6 +131,7 @@ extern param_t *ds_db_extra_attrs_list;
 extern int ds_load_mode;
 extern uint32_t ds_dns_mode;
 extern int ds_dns_ttl;
+extern int ds_weight_mode;
 extern int ds_event_callback_mode;
 
 static db_func_t ds_dbf;
@@ -137,6 +142,7 @@ static ds_set_t **ds_lists = NULL;
 static int *ds_list_nr = NULL;
 static int *ds_crt_idx = NULL;
 static int *ds_next_idx = NULL;
+static db_changelog_t *ds_log = NULL; /* position in the change log */
 
 static ds_set_t *ds_strictest_node = NULL;
 static int ds_strictest_idx = 0;
@@ -205,6 +211,67 @@ int ds_ping_active_set(int v)
 	return 0;
 }
 
+/**
+ *
+ */
+int ds_ping_stats_init(void)
+{
+	if(_ds_ping_stats != NULL)
+		return 0;
+	_ds_ping_stats = (ds_ping_stats_t *)shm_malloc(sizeof(ds_ping_stats_t));
+	if(_ds_ping_stats == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_ds_ping_stats, 0, sizeof(ds_ping_stats_t));
+	return 0;
+}
+
+/**
+ *
+ */
+ds_ping_stats_t *ds_ping_stats_get(void)
+{
+	return _ds_ping_stats;
+}
+
+/**
+ * keepalive completed - update the pending counter and response time
+ */
+static void ds_ping_stats_update(int group, str *uri, int timeout)
+{
+	ds_latency_stats_t *latency_stats;
+	struct timeval now;
+	long ms;
+	int i;
+	int v;
+
+	if(_ds_ping_stats == NULL)
+		return;
+
+	do {
+		v = atomic_get(&_ds_ping_stats->pending);
+		if(v <= 0)
+			break;
+	} while(atomic_cmpxchg(&_ds_ping_stats->pending, v, v - 1) != v);
+
+	if(timeout) {
+		atomic_inc(&_ds_ping_stats->timeouts);
+		return;
+	}
+	latency_stats = latency_stats_find(group, uri);
+	if(latency_stats == NULL || latency_stats->start.tv_sec == 0)
+		return;
+	gettimeofday(&now, NULL);
+	ms = (now.tv_sec - latency_stats->start.tv_sec) * 1000
+		 + (now.tv_usec - latency_stats->start.tv_usec) / 1000;
+	for(i = 0; i < DS_PING_HIST_SIZE - 1; i++) {
+		if(ms <= (1L << i))
+			break;
+	}
+	atomic_inc(&_ds_ping_stats->hist[i]);
+}
+
 /**
  *
  */
@@ -332,6 +399,15 @@ int ds_init_data(void)
 	ds_list_nr = p + 2;
 	*ds_crt_idx = *ds_next_idx = 0;
 
+	ds_log = (db_changelog_t *)shm_malloc(sizeof(db_changelog_t));
+	if(!ds_log) {
+		shm_free(p);
+		shm_free(ds_lists);
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(ds_log, 0, sizeof(db_changelog_t));
+
 	return 0;
 }
 
@@ -642,6 +718,13 @@ ds_dest_t *pack_dest(str iuri, int flags, int priority, str *attrs, int dload)
 		goto err;
 	}
 
+	/* identity of the destination for consistent hashing */
+	if(dp->attrs.duid.s != NULL && dp->attrs.duid.len > 0) {
+		dp->chash = ds_get_hash(&dp->attrs.duid, NULL);
+	} else {
+		dp->chash = ds_get_hash(&dp->uri, NULL);
+	}
+
 	/* set send socket by name or address */
 	if(dp->attrs.sockname.s && dp->attrs.sockname.len > 0) {
 		dp->sock = ksr_get_socket_by_name(&dp->attrs.sockname);
@@ -1013,6 +1096,133 @@ randomize:
 	return 0;
 }
 
+/**
+ * Update the relative weight alias table with the active destinations
+ * - the table is rebuilt in place, with rwgen odd meanwhile, so the
+ *   readers not taking the lock can detect that it changed under them
+ * - to be called with the lock of the set, apart when it is loaded
+ */
+static void ds_rwalias_update(ds_set_t *dset)
+{
+	ds_walias_t *wa;
+	int j;
+	int n;
+
+	wa = dset->rwalias;
+	if(wa == NULL)
+		return;
+	dset->rwgen++;
+	membar_write();
+	n = 0;
+	for(j = 0; j < dset->nr; j++) {
+		if(ds_skip_dst(dset->dlist[j].flags)
+				|| (ds_use_default != 0 && j == dset->nr - 1)) {
+			continue;
+		}
+		wa->dst[n] = j;
+		wa->w[n] = dset->dlist[j].attrs.rweight;
+		n++;
+	}
+	wa->n = n;
+	ds_walias_build(wa);
+	membar_write();
+	dset->rwgen++;
+}
+
+/**
+ * Pick an active destination from the relative weight alias table
+ * - without the lock of the set, done again with it if the table was
+ *   updated meanwhile
+ * - slot and gen are set for ds_manage_routes_fill_rwxavp()
+ * - return the index of the destination, -1 if no active destination
+ *   has a relative weight
+ */
+static int ds_rwalias_pick(ds_set_t *dset, int *slot, unsigned int *gen)
+{
+	ds_walias_t *wa;
+	unsigned int g;
+	int n;
+	int s;
+	int d;
+
+	wa = dset->rwalias;
+	g = dset->rwgen;
+	membar_read();
+	if(likely((g & 1) == 0)) {
+		s = -1;
+		d = -1;
+		n = wa->n;
+		if(n > 0) {
+			s = ds_walias_pick(wa, n);
+			d = wa->dst[s];
+		}
+		membar_read();
+		if(likely(dset->rwgen == g))
+			goto done;
+	}
+	lock_get(&dset->lock);
+	g = dset->rwgen;
+	s = -1;
+	d = -1;
+	n = wa->n;
+	if(n > 0) {
+		s = ds_walias_pick(wa, n);
+		d = wa->dst[s];
+	}
+	lock_release(&dset->lock);
+done:
+	*slot = s;
+	*gen = g;
+	return d;
+}
+
+/**
+ * Initialize the alias tables for weight based selection
+ */
+int ds_init_walias(ds_set_t *dset)
+{
+	int j;
+	int rw;
+
+	if(dset == NULL || dset->nr <= 0)
+		return -1;
+
+	ds_walias_free(dset->walias);
+	dset->walias = NULL;
+	ds_walias_free(dset->rwalias);
+	dset->rwalias = NULL;
+	if(ds_weight_mode == 0)
+		return 0;
+
+	dset->walias = ds_walias_new(dset->nr);
+	if(dset->walias != NULL) {
+		for(j = 0; j < dset->nr; j++) {
+			dset->walias->dst[j] = j;
+			dset->walias->w[j] = dset->dlist[j].attrs.weight;
+		}
+		dset->walias->n = dset->nr;
+		if(ds_walias_build(dset->walias) < 0) {
+			ds_walias_free(dset->walias);
+			dset->walias = NULL;
+		}
+	}
+
+	rw = 0;
+	for(j = 0; j < dset->nr; j++) {
+		if(dset->dlist[j].attrs.rweight > 0)
+			rw = 1;
+	}
+	if(rw == 0)
+		return 0;
+	dset->rwalias = ds_walias_new(dset->nr);
+	if(dset->rwalias == NULL)
+		return 0;
+	dset->rwgen = 0;
+	ds_rwalias_update(dset);
+
+	return 0;
+}
+
 /*! \brief  compact destinations from sets for fast access */
 int reindex_dests(ds_set_t *node)
 {
@@ -1055,6 +1265,7 @@ int reindex_dests(ds_set_t *node)
 	node->dlist = dp0;
 	dp_init_weights(node);
 	dp_init_relative_weights(node);
+	ds_init_walias(node);
 
 	return 0;
 
@@ -1315,27 +1526,11 @@ int ds_reload_db(void)
 	return ret;
 }
 
-/*! \brief load groups of destinations from DB*/
-int ds_load_db(void)
+/*! \brief columns to query from dispatcher table, returns their number */
+static int ds_db_query_cols(db_key_t *query_cols, int max_cols)
 {
-	int i, id, nr_rows, setn;
-	int flags;
-	int priority;
-	int nrcols;
-	int dest_errs = 0;
-	str uri;
-	str attrs = {0, 0};
-	db1_res_t *res;
-	db_val_t *values;
-	db_row_t *rows;
-#define DS_DB_MAX_COLS 32
-	db_key_t query_cols[DS_DB_MAX_COLS];
 	param_t *pit = NULL;
-	int nc;
-	int plen;
-#define DS_ATTRS_MAXSIZE 1024
-	char ds_attrs_buf[DS_ATTRS_MAXSIZE];
-	ds_latency_stats_t *latency_stats;
+	int nrcols;
 
 	query_cols[0] = &ds_set_id_col;
 	query_cols[1] = &ds_dest_uri_col;
@@ -1351,47 +1546,37 @@ int ds_load_db(void)
 	} else if(_ds_table_version == DS_TABLE_VERSION4) {
 		nrcols = 5;
 		for(pit = ds_db_extra_attrs_list; pit != NULL; pit = pit->next) {
-			if(nrcols >= DS_DB_MAX_COLS) {
+			if(nrcols >= max_cols) {
 				LM_ERR("too many db columns: %d\n", nrcols);
 				return -1;
 			}
 			query_cols[nrcols++] = &pit->body;
 		}
 	}
+	return nrcols;
+}
 
-	if((*ds_crt_idx) != (*ds_next_idx)) {
-		LM_WARN("load command already generated, aborting reload...\n");
-		return 0;
-	}
-
-	if(ds_db_handle == NULL) {
-		LM_ERR("invalid DB handler\n");
-		return -1;
-	}
-
-	if(ds_dbf.use_table(ds_db_handle, &ds_table_name) < 0) {
-		LM_ERR("error in use_table\n");
-		return -1;
-	}
-
-	LM_DBG("loading dispatcher db records - nrcols: %d\n", nrcols);
-
-	/*select the whole table and all the columns*/
-	if(ds_dbf.query(ds_db_handle, 0, 0, 0, query_cols, 0, nrcols, 0, &res)
-			< 0) {
-		LM_ERR("error while querying database\n");
-		return -1;
-	}
+/*! \brief add destinations of dispatcher table rows to the next list,
+ * returns the number of destinations that could not be added or -1 */
+static int ds_load_db_rows(db1_res_t *res, int nrcols, int *setn)
+{
+	int i, id, nr_rows;
+	int flags;
+	int priority;
+	int dest_errs = 0;
+	str uri;
+	str attrs = {0, 0};
+	db_val_t *values;
+	db_row_t *rows;
+	param_t *pit = NULL;
+	int nc;
+	int plen;
+#define DS_ATTRS_MAXSIZE 1024
+	char ds_attrs_buf[DS_ATTRS_MAXSIZE];
+	ds_latency_stats_t *latency_stats;
 
 	nr_rows = RES_ROW_N(res);
 	rows = RES_ROWS(res);
-	if(nr_rows == 0) {
-		LM_WARN("no dispatching data in the db -- empty destination set\n");
-	}
-
-	setn = 0;
-	*ds_next_idx = (*ds_crt_idx + 1) % 2;
-	ds_avl_destroy(&ds_lists[*ds_next_idx]);
 
 	for(i = 0; i < nr_rows; i++) {
 		values = ROW_VALUES(rows + i);
@@ -1433,7 +1618,7 @@ int ds_load_db(void)
 						if(plen <= 0
 								|| plen >= DS_ATTRS_MAXSIZE - attrs.len - 1) {
 							LM_ERR("cannot build attrs buffer\n");
-							goto err2;
+							return -1;
 						}
 						attrs.len += plen;
 					}
@@ -1447,17 +1632,85 @@ int ds_load_db(void)
 		if(ds_ping_latency_stats && ds_retain_latency_stats) {
 			latency_stats = latency_stats_find(id, &uri);
 		}
-		if(add_dest2list(id, uri, flags, priority, &attrs, *ds_next_idx, &setn,
+		if(add_dest2list(id, uri, flags, priority, &attrs, *ds_next_idx, setn,
 				   0, latency_stats)
 				== NULL) {
 			dest_errs++;
 			LM_WARN("unable to add destination %.*s to set %d -- skipping\n",
 					uri.len, uri.s, id);
 			if(ds_load_mode == 1) {
-				goto err2;
+				return -1;
 			}
 		}
 	}
+	return dest_errs;
+}
+
+/*! \brief load groups of destinations from DB*/
+int ds_load_db(void)
+{
+	int nr_rows, setn;
+	int nrcols;
+	int dest_errs = 0;
+	db_changelog_t clog;
+	db1_res_t *res;
+#define DS_DB_MAX_COLS 32
+	db_key_t query_cols[DS_DB_MAX_COLS];
+
+	nrcols = ds_db_query_cols(query_cols, DS_DB_MAX_COLS);
+	if(nrcols < 0) {
+		return -1;
+	}
+
+	if((*ds_crt_idx) != (*ds_next_idx)) {
+		LM_WARN("load command already generated, aborting reload...\n");
+		return 0;
+	}
+
+	if(ds_db_handle == NULL) {
+		LM_ERR("invalid DB handler\n");
+		return -1;
+	}
+
+	/* changes logged from now on are applied by next reload of changes */
+	memset(&clog, 0, sizeof(db_changelog_t));
+	if(ds_log_table_name.len > 0) {
+		clog = *ds_log;
+		if(db_changelog_fetch(&ds_dbf, ds_db_handle, &ds_log_table_name,
+				   &ds_log_id_col, &ds_set_id_col, &clog, NULL, NULL)
+				< 0) {
+			LM_ERR("failed to read the change log\n");
+			return -1;
+		}
+	}
+
+	if(ds_dbf.use_table(ds_db_handle, &ds_table_name) < 0) {
+		LM_ERR("error in use_table\n");
+		return -1;
+	}
+
+	LM_DBG("loading dispatcher db records - nrcols: %d\n", nrcols);
+
+	/*select the whole table and all the columns*/
+	if(ds_dbf.query(ds_db_handle, 0, 0, 0, query_cols, 0, nrcols, 0, &res)
+			< 0) {
+		LM_ERR("error while querying database\n");
+		return -1;
+	}
+
+	nr_rows = RES_ROW_N(res);
+	if(nr_rows == 0) {
+		LM_WARN("no dispatching data in the db -- empty destination set\n");
+	}
+
+	setn = 0;
+	*ds_next_idx = (*ds_crt_idx + 1) % 2;
+	ds_avl_destroy(&ds_lists[*ds_next_idx]);
+
+	dest_errs = ds_load_db_rows(res, nrcols, &setn);
+	if(dest_errs < 0) {
+		goto err2;
+	}
 	if(reindex_dests(ds_lists[*ds_next_idx]) != 0) {
 		LM_ERR("error on reindex\n");
 		goto err2;
@@ -1468,6 +1721,8 @@ int ds_load_db(void)
 	/* update data - should it be sync'ed? */
 	_ds_list_nr = setn;
 	*ds_crt_idx = *ds_next_idx;
+	if(ds_log_table_name.len > 0)
+		*ds_log = clog;
 
 	LM_DBG("found [%d] dest sets\n", _ds_list_nr);
 
@@ -1485,6 +1740,227 @@ err2:
 	return -1;
 }
 
+/*! \brief set ids read from the change log and state of the copy */
+typedef struct ds_changed_sets
+{
+	int *ids;
+	int nr;
+	int size;
+	int *setn;
+	int errs;
+} ds_changed_sets_t;
+
+static int ds_changed_set(ds_changed_sets_t *cs, int id)
+{
+	int i;
+
+	for(i = 0; i < cs->nr; i++) {
+		if(cs->ids[i] == id)
+			return 1;
+	}
+	return 0;
+}
+
+/*! \brief collect the set ids of the change log rows, once each */
+static int ds_log_setid_cb(db_val_t *val, void *param)
+{
+	ds_changed_sets_t *cs = (ds_changed_sets_t *)param;
+	int *ids;
+	int id;
+
+	if(VAL_TYPE(val) == DB1_INT) {
+		id = VAL_INT(val);
+	} else if(VAL_TYPE(val) == DB1_UINT) {
+		id = (int)VAL_UINT(val);
+	} else {
+		LM_ERR("invalid type of set id in change log\n");
+		return -1;
+	}
+	if(ds_changed_set(cs, id))
+		return 0;
+	if(cs->nr == cs->size) {
+		ids = (int *)pkg_realloc(
+				cs->ids, (cs->size ? 2 * cs->size : 16) * sizeof(int));
+		if(ids == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		cs->ids = ids;
+		cs->size = cs->size ? 2 * cs->size : 16;
+	}
+	cs->ids[cs->nr++] = id;
+	return 0;
+}
+
+/*! \brief callback copying the destinations of the sets that are not
+ * reloaded, keeping their state and resolved address */
+static void ds_copy_dest_cb(ds_set_t *node, int i, void *arg)
+{
+	ds_changed_sets_t *cs = (ds_changed_sets_t *)arg;
+	ds_dest_t *odst = &node->dlist[i];
+	ds_dest_t *ndst = NULL;
+
+	if(ds_changed_set(cs, node->id))
+		return;
+
+	ndst = add_dest2list(node->id, odst->uri, odst->flags | DS_NODNSARES_DST,
+			odst->priority, &odst->attrs.body, *ds_next_idx, cs->setn,
+			odst->dload, &odst->latency_stats);
+	if(ndst == NULL) {
+		LM_ERR("failed to copy destination in group %d - %.*s\n", node->id,
+				odst->uri.len, odst->uri.s);
+		cs->errs++;
+		return;
+	}
+	ndst->flags = odst->flags;
+	ndst->irmode = odst->irmode;
+	memcpy(&ndst->ip_address, &odst->ip_address, sizeof(struct ip_addr));
+	ndst->port = odst->port;
+	ndst->proto = odst->proto;
+	ndst->dnstime = odst->dnstime;
+	ndst->probing_count = odst->probing_count;
+	atomic_set(&ndst->oreqs, atomic_get(&odst->oreqs));
+	memcpy(&ndst->ocdata, &odst->ocdata, sizeof(ds_ocdata_t));
+	memcpy(ndst->buid, odst->suid.s, odst->suid.len);
+	ndst->suid.s = ndst->buid;
+	ndst->suid.len = odst->suid.len;
+}
+
+/*! \brief reload from DB the sets listed in the change log since the last
+ * reload, the other sets are copied from the current list without
+ * querying the database or resolving their addresses again. Returns
+ * the number of reloaded sets, -2 if some destinations were skipped,
+ * -1 on error */
+int ds_load_db_changes(void)
+{
+	int i, setn;
+	int nrcols;
+	int dest_errs = 0;
+	int ret;
+	db_changelog_t clog;
+	ds_changed_sets_t cs;
+	db1_res_t *res = NULL;
+	db_key_t query_cols[DS_DB_MAX_COLS];
+	db_key_t key_cols[1];
+	db_op_t key_ops[1];
+	db_val_t key_vals[1];
+
+	nrcols = ds_db_query_cols(query_cols, DS_DB_MAX_COLS);
+	if(nrcols < 0) {
+		return -1;
+	}
+
+	if((*ds_crt_idx) != (*ds_next_idx)) {
+		LM_WARN("load command already generated, aborting reload...\n");
+		return 0;
+	}
+
+	if(ds_db_handle == NULL) {
+		LM_ERR("invalid DB handler\n");
+		return -1;
+	}
+
+	memset(&cs, 0, sizeof(ds_changed_sets_t));
+	clog = *ds_log;
+	if(db_changelog_fetch(&ds_dbf, ds_db_handle, &ds_log_table_name,
+			   &ds_log_id_col, &ds_set_id_col, &clog, ds_log_setid_cb,
+			   &cs)
+			< 0) {
+		LM_ERR("failed to read the change log\n");
+		ret = -1;
+		goto done;
+	}
+	if(cs.nr == 0) {
+		*ds_log = clog;
+		ret = 0;
+		goto done;
+	}
+
+	if(ds_dbf.use_table(ds_db_handle, &ds_table_name) < 0) {
+		LM_ERR("error in use_table\n");
+		ret = -1;
+		goto done;
+	}
+
+	setn = 0;
+	cs.setn = &setn;
+	*ds_next_idx = (*ds_crt_idx + 1) % 2;
+	ds_avl_destroy(&ds_lists[*ds_next_idx]);
+
+	ds_iter_set(_ds_list, &ds_copy_dest_cb, &cs);
+	if(cs.errs > 0) {
+		goto err;
+	}
+
+	key_cols[0] = &ds_set_id_col;
+	key_ops[0] = OP_EQ;
+	VAL_TYPE(key_vals) = DB1_INT;
+	VAL_NULL(key_vals) = 0;
+	for(i = 0; i < cs.nr; i++) {
+		VAL_INT(key_vals) = cs.ids[i];
+		if(ds_dbf.query(ds_db_handle, key_cols, key_ops, key_vals, query_cols,
+				   1, nrcols, 0, &res)
+				< 0) {
+			LM_ERR("error while querying database for set %d\n", cs.ids[i]);
+			goto err;
+		}
+		ret = ds_load_db_rows(res, nrcols, &setn);
+		ds_dbf.free_result(ds_db_handle, res);
+		if(ret < 0) {
+			goto err;
+		}
+		dest_errs += ret;
+	}
+
+	if(reindex_dests(ds_lists[*ds_next_idx]) != 0) {
+		LM_ERR("error on reindex\n");
+		goto err;
+	}
+
+	_ds_list_nr = setn;
+	*ds_crt_idx = *ds_next_idx;
+	*ds_log = clog;
+
+	LM_DBG("reloaded [%d] changed sets, found [%d] dest sets\n", cs.nr,
+			_ds_list_nr);
+
+	ds_log_sets();
+
+	ret = (dest_errs > 0) ? -2 : cs.nr;
+	goto done;
+
+err:
+	ds_avl_destroy(&ds_lists[*ds_next_idx]);
+	*ds_next_idx = *ds_crt_idx;
+	ret = -1;
+done:
+	if(cs.ids)
+		pkg_free(cs.ids);
+	return ret;
+}
+
+/*! \brief reload from DB the sets listed in the change log */
+int ds_reload_db_changes(void)
+{
+	int ret;
+
+	if(ds_log_table_name.len <= 0) {
+		LM_ERR("change log table not set\n");
+		return -1;
+	}
+	if(ds_connect_db() != 0) {
+		LM_ERR("unable to connect to the database\n");
+		return -1;
+	}
+	ret = ds_load_db_changes();
+	if(ret == -2) {
+		LM_WARN("failure while loading one or more dispatcher entries\n");
+	}
+	ds_disconnect_db();
+
+	return ret;
+}
+
 /*! \brief called from dispatcher.c: free all*/
 int ds_destroy_list(void)
 {
@@ -1497,6 +1973,9 @@ int ds_destroy_list(void)
 	if(ds_crt_idx)
 		shm_free(ds_crt_idx);
 
+	if(ds_log)
+		shm_free(ds_log);
+
 	return 0;
 }
 
@@ -1788,104 +2267,393 @@ int ds_hash_authusername(struct sip_msg *msg, unsigned int *hash)
 
 	*hash = ds_get_hash(&username, NULL);
 
-	return 0;
+	return 0;
+}
+
+
+/**
+ *
+ */
+int ds_hash_pvar(struct sip_msg *msg, unsigned int *hash)
+{
+	/* The String to create the hash */
+	str hash_str = {0, 0};
+
+	if(msg == NULL || hash == NULL || hash_param_model == NULL) {
+		LM_ERR("bad parameters\n");
+		return -1;
+	}
+	if(pv_printf_s(msg, hash_param_model, &hash_str) < 0) {
+		LM_ERR("error - cannot print the format\n");
+		return -1;
+	}
+
+	/* Remove empty spaces */
+	trim(&hash_str);
+	if(hash_str.len <= 0) {
+		LM_ERR("String is empty!\n");
+		return -1;
+	}
+
+	*hash = ds_get_hash(&hash_str, NULL);
+	LM_DBG("Hashing of '%.*s' resulted in %u !\n", hash_str.len, hash_str.s,
+			*hash);
+
+	return 0;
+}
+
+/*
+ * Check if a destination set exists
+ */
+int ds_list_exist(int set)
+{
+	ds_set_t *si = NULL;
+	LM_DBG("looking for destination set [%d]\n", set);
+
+	/* get the index of the set */
+	si = ds_avl_find(_ds_list, set);
+
+	if(si == NULL) {
+		LM_DBG("destination set [%d] not found\n", set);
+		return -1; /* False */
+	}
+	LM_DBG("destination set [%d] found\n", set);
+	return 1; /* True */
+}
+
+/*
+ * Return a destination set
+ */
+ds_set_t *ds_list_lookup(int set)
+{
+	ds_set_t *si = NULL;
+	LM_DBG("looking for destination set [%d]\n", set);
+
+	/* get the index of the set */
+	si = ds_avl_find(_ds_list, set);
+
+	if(si == NULL) {
+		LM_DBG("destination set [%d] not found\n", set);
+		return NULL;
+	}
+	LM_DBG("destination set [%d] found\n", set);
+	return si;
+}
+
+/**
+ *
+ */
+int ds_get_leastloaded(ds_set_t *dset)
+{
+	int j;
+	int k;
+	int t;
+
+	k = -1;
+	t = 0x7fffffff; /* high load */
+	lock_get(&dset->lock);
+	for(j = 0; j < dset->nr; j++) {
+		if(!ds_skip_dst(dset->dlist[j].flags)
+				&& (dset->dlist[j].attrs.maxload == 0
+						|| dset->dlist[j].dload
+								   < dset->dlist[j].attrs.maxload)) {
+			if(dset->dlist[j].dload < t) {
+				k = j;
+				t = dset->dlist[k].dload;
+			}
+		}
+	}
+	lock_release(&dset->lock);
+	return k;
+}
+
+/**
+ * return the index of the active destination with the least outstanding
+ * requests, or of the less loaded out of two random choices
+ */
+int ds_get_leastoreq(ds_set_t *dset)
+{
+	int j;
+	int k;
+	int n;
+	int a;
+	int b;
+	int sel;
+	int oreqs;
+	int omin;
+
+	n = dset->nr;
+	if(ds_use_default != 0 && n != 1) {
+		/* last destination is used only as default */
+		n--;
+	}
+	if(ds_oreq_mode == 1 && n > 2) {
+		/* power of two choices */
+		a = ksr_xrand() % n;
+		b = ksr_xrand() % (n - 1);
+		if(b >= a) {
+			b++;
+		}
+		if(ds_skip_dst(dset->dlist[a].flags)) {
+			a = b;
+		} else if(!ds_skip_dst(dset->dlist[b].flags)
+				  && atomic_get(&dset->dlist[b].oreqs)
+							 < atomic_get(&dset->dlist[a].oreqs)) {
+			a = b;
+		}
+		if(!ds_skip_dst(dset->dlist[a].flags)) {
+			return a;
+		}
+		/* both inactive - look through all destinations */
+	}
+
+	/* start from a random position to spread the ties */
+	k = ksr_xrand() % n;
+	sel = -1;
+	omin = 0;
+	for(j = 0; j < n; j++) {
+		if(ds_skip_dst(dset->dlist[k].flags) == 0) {
+			oreqs = atomic_get(&dset->dlist[k].oreqs);
+			if(sel < 0 || oreqs < omin) {
+				sel = k;
+				omin = oreqs;
+			}
+		}
+		k = (k + 1) % n;
+	}
+	return sel;
+}
+
+/**
+ * outstanding request attributes stored with the transaction
+ */
+typedef struct ds_oreq_cell
+{
+	int setid;
+	int dst;
+	atomic_t counted;
+	atomic_t done;
+	str uri;
+} ds_oreq_cell_t;
+
+/* set once the outstanding requests of a destination are counted */
+static int *_ds_oreq_active = NULL;
+
+/**
+ * init the outstanding requests tracking
+ */
+int ds_oreq_init(void)
+{
+	if(_ds_oreq_active != NULL)
+		return 0;
+	_ds_oreq_active = (int *)shm_malloc(sizeof(int));
+	if(_ds_oreq_active == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	*_ds_oreq_active = 0;
+	return 0;
+}
+
+/**
+ * return 1 if outstanding requests were tracked, 0 otherwise
+ */
+int ds_oreq_active(void)
+{
+	return (_ds_oreq_active != NULL && *_ds_oreq_active != 0) ? 1 : 0;
+}
+
+/**
+ * return the destination of the outstanding request
+ */
+static ds_dest_t *ds_oreq_dest(ds_oreq_cell_t *oc)
+{
+	ds_set_t *idx = NULL;
+	ds_dest_t *dp = NULL;
+	int i;
+
+	if(_ds_list == NULL
+			|| ds_get_index(oc->setid, *ds_crt_idx, &idx) != 0) {
+		return NULL;
+	}
+	/* the list may have been reloaded meanwhile - match by uri */
+	if(oc->dst < idx->nr && idx->dlist[oc->dst].uri.len == oc->uri.len
+			&& memcmp(idx->dlist[oc->dst].uri.s, oc->uri.s, oc->uri.len)
+					   == 0) {
+		dp = &idx->dlist[oc->dst];
+	} else {
+		for(i = 0; i < idx->nr; i++) {
+			if(idx->dlist[i].uri.len == oc->uri.len
+					&& memcmp(idx->dlist[i].uri.s, oc->uri.s, oc->uri.len)
+							   == 0) {
+				dp = &idx->dlist[i];
+				break;
+			}
+		}
+	}
+	return dp;
 }
 
-
 /**
- *
+ * increment the outstanding requests of the destination, once the request
+ * is forwarded statefully
  */
-int ds_hash_pvar(struct sip_msg *msg, unsigned int *hash)
+static void ds_oreq_count(ds_oreq_cell_t *oc)
 {
-	/* The String to create the hash */
-	str hash_str = {0, 0};
+	ds_dest_t *dp = NULL;
 
-	if(msg == NULL || hash == NULL || hash_param_model == NULL) {
-		LM_ERR("bad parameters\n");
-		return -1;
+	if(atomic_get(&oc->done) != 0
+			|| atomic_get_and_set(&oc->counted, 1) != 0) {
+		return;
 	}
-	if(pv_printf_s(msg, hash_param_model, &hash_str) < 0) {
-		LM_ERR("error - cannot print the format\n");
-		return -1;
+	dp = ds_oreq_dest(oc);
+	if(dp == NULL) {
+		return;
 	}
-
-	/* Remove empty spaces */
-	trim(&hash_str);
-	if(hash_str.len <= 0) {
-		LM_ERR("String is empty!\n");
-		return -1;
+	atomic_inc(&dp->oreqs);
+	if(_ds_oreq_active != NULL && *_ds_oreq_active == 0) {
+		*_ds_oreq_active = 1;
 	}
-
-	*hash = ds_get_hash(&hash_str, NULL);
-	LM_DBG("Hashing of '%.*s' resulted in %u !\n", hash_str.len, hash_str.s,
-			*hash);
-
-	return 0;
 }
 
-/*
- * Check if a destination set exists
+/**
+ * decrement the outstanding requests of the destination
  */
-int ds_list_exist(int set)
+static void ds_oreq_done(ds_oreq_cell_t *oc)
 {
-	ds_set_t *si = NULL;
-	LM_DBG("looking for destination set [%d]\n", set);
+	ds_dest_t *dp = NULL;
+	int v;
 
-	/* get the index of the set */
-	si = ds_avl_find(_ds_list, set);
+	if(atomic_get_and_set(&oc->done, 1) != 0) {
+		return;
+	}
+	if(atomic_get(&oc->counted) == 0) {
+		/* not forwarded statefully */
+		return;
+	}
+	dp = ds_oreq_dest(oc);
+	if(dp == NULL) {
+		return;
+	}
+	/* counters are reset on reload - do not go below zero */
+	do {
+		v = atomic_get(&dp->oreqs);
+		if(v <= 0) {
+			return;
+		}
+	} while(atomic_cmpxchg(&dp->oreqs, v, v - 1) != v);
+}
 
-	if(si == NULL) {
-		LM_DBG("destination set [%d] not found\n", set);
-		return -1; /* False */
+/**
+ * tm callback - request forwarded, final response or failure for the
+ * transaction
+ */
+static void ds_oreq_tmcb(struct cell *t, int type, struct tmcb_params *ps)
+{
+	if(ps->param == NULL || *ps->param == NULL) {
+		return;
 	}
-	LM_DBG("destination set [%d] found\n", set);
-	return 1; /* True */
+	if(type & TMCB_REQUEST_FWDED) {
+		ds_oreq_count((ds_oreq_cell_t *)(*ps->param));
+		return;
+	}
+	if((type & TMCB_RESPONSE_IN) && ps->code < 200) {
+		return;
+	}
+	ds_oreq_done((ds_oreq_cell_t *)(*ps->param));
 }
 
-/*
- * Return a destination set
+/**
+ * tm callback param release - transaction destroyed or not created
  */
-ds_set_t *ds_list_lookup(int set)
+static void ds_oreq_tmcb_release(void *param)
 {
-	ds_set_t *si = NULL;
-	LM_DBG("looking for destination set [%d]\n", set);
+	if(param == NULL) {
+		return;
+	}
+	ds_oreq_done((ds_oreq_cell_t *)param);
+	shm_free(param);
+}
 
-	/* get the index of the set */
-	si = ds_avl_find(_ds_list, set);
+/**
+ * track the outstanding requests of the destination with the transaction
+ * - the counter is incremented when the request is forwarded statefully
+ *   and decremented on completion, a stateless forward is not counted
+ */
+int ds_oreq_add(sip_msg_t *msg, ds_set_t *dset, int setid, int dst)
+{
+	ds_oreq_cell_t *oc = NULL;
+	ds_dest_t *dp = NULL;
 
-	if(si == NULL) {
-		LM_DBG("destination set [%d] not found\n", set);
-		return NULL;
+	if(tmb.register_tmcb == NULL) {
+		LM_ERR("tm module not loaded - outstanding requests not tracked\n");
+		return -1;
 	}
-	LM_DBG("destination set [%d] found\n", set);
-	return si;
+	dp = &dset->dlist[dst];
+	oc = (ds_oreq_cell_t *)shm_malloc(sizeof(ds_oreq_cell_t) + dp->uri.len);
+	if(oc == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(oc, 0, sizeof(ds_oreq_cell_t));
+	oc->setid = setid;
+	oc->dst = dst;
+	oc->uri.s = (char *)oc + sizeof(ds_oreq_cell_t);
+	memcpy(oc->uri.s, dp->uri.s, dp->uri.len);
+	oc->uri.len = dp->uri.len;
+
+	/* callbacks are attached to the transaction when it is created, or to
+	 * the current one in failure route */
+	if(tmb.register_tmcb(msg, 0,
+			   TMCB_REQUEST_FWDED | TMCB_RESPONSE_IN | TMCB_ON_FAILURE,
+			   ds_oreq_tmcb, (void *)oc, ds_oreq_tmcb_release)
+			< 0) {
+		LM_ERR("cannot register tm callbacks\n");
+		shm_free(oc);
+		return -1;
+	}
+
+	return 0;
 }
 
 /**
- *
+ * track the outstanding requests of the destination from the xavp record
  */
-int ds_get_leastloaded(ds_set_t *dset)
+static int ds_oreq_add_xavp(sip_msg_t *msg, sr_xavp_t *rxavp, str *uri)
 {
-	int j;
-	int k;
-	int t;
+	ds_set_t *idx = NULL;
+	sr_xavp_t *lxavp = NULL;
+	int setid;
+	int pos;
 
-	k = -1;
-	t = 0x7fffffff; /* high load */
-	lock_get(&dset->lock);
-	for(j = 0; j < dset->nr; j++) {
-		if(!ds_skip_dst(dset->dlist[j].flags)
-				&& (dset->dlist[j].attrs.maxload == 0
-						|| dset->dlist[j].dload
-								   < dset->dlist[j].attrs.maxload)) {
-			if(dset->dlist[j].dload < t) {
-				k = j;
-				t = dset->dlist[k].dload;
+	lxavp = xavp_get(&ds_xavp_dst_oreq, rxavp);
+	if(lxavp == NULL || lxavp->val.type != SR_XTYPE_LONG) {
+		/* not selected by least outstanding requests */
+		return 0;
+	}
+	pos = (int)lxavp->val.v.l;
+	lxavp = xavp_get(&ds_xavp_dst_grp, rxavp);
+	if(lxavp == NULL || lxavp->val.type != SR_XTYPE_LONG) {
+		return -1;
+	}
+	setid = (int)lxavp->val.v.l;
+	if(_ds_list == NULL || ds_get_index(setid, *ds_crt_idx, &idx) != 0) {
+		return -1;
+	}
+	/* the list may have been reloaded since the selection */
+	if(pos < 0 || pos >= idx->nr || idx->dlist[pos].uri.len != uri->len
+			|| memcmp(idx->dlist[pos].uri.s, uri->s, uri->len) != 0) {
+		for(pos = 0; pos < idx->nr; pos++) {
+			if(idx->dlist[pos].uri.len == uri->len
+					&& memcmp(idx->dlist[pos].uri.s, uri->s, uri->len) == 0) {
+				break;
 			}
 		}
+		if(pos == idx->nr) {
+			return -1;
+		}
 	}
-	lock_release(&dset->lock);
-	return k;
+	return ds_oreq_add(msg, idx, setid, pos);
 }
 
 /**
@@ -2338,6 +3106,18 @@ int ds_add_xavp_record(
 		}
 	}
 
+	if(alg == DS_ALG_LEASTOREQ) {
+		/* position to track the outstanding requests on failover */
+		memset(&nxval, 0, sizeof(sr_xval_t));
+		nxval.type = SR_XTYPE_LONG;
+		nxval.v.l = pos;
+		if(xavp_add_value(&ds_xavp_dst_oreq, &nxval, &nxavp) == NULL) {
+			xavp_destroy_list(&nxavp);
+			LM_ERR("failed to add destination oreq xavp field\n");
+			return -1;
+		}
+	}
+
 	/* add xavp in root list */
 	memset(&nxval, 0, sizeof(sr_xval_t));
 	nxval.type = SR_XTYPE_XAVP;
@@ -2506,6 +3286,63 @@ int ds_manage_routes_fill_xavp(
 	return 0;
 }
 
+/**
+ * Add to xavp the selected destination and the ones after it in the
+ * relative weight alias table, which holds only the active destinations
+ * - slot is the position of the selected destination in the table at
+ *   update count gen, as set by ds_rwalias_pick()
+ */
+static int ds_manage_routes_fill_rwxavp(unsigned int hash, int slot,
+		unsigned int gen, ds_set_t *idx, ds_select_state_t *rstate)
+{
+	ds_walias_t *wa;
+	int ret;
+	int i;
+	int k;
+	int n;
+
+	LM_DBG("using first entry [%d/%d]\n", rstate->setid, hash);
+	if(ds_add_xavp_record(idx, hash, rstate->setid, rstate->alg, &rstate->lxavp)
+			< 0) {
+		LM_ERR("failed to add destination in the xavp (%d/%d)\n", hash,
+				rstate->setid);
+		return -1;
+	}
+	rstate->cnt++;
+	if(slot < 0)
+		return 0;
+
+	/* the table does not change while the lock is held */
+	ret = 0;
+	wa = idx->rwalias;
+	lock_get(&idx->lock);
+	n = wa->n;
+	if(idx->rwgen != gen) {
+		/* updated after the pick - start after the selected destination
+		 * in the new table, if it is still there */
+		for(slot = 0; slot < n && wa->dst[slot] != hash; slot++)
+			;
+	}
+	for(k = 1; k <= n && rstate->cnt < rstate->limit; k++) {
+		i = wa->dst[(slot + k) % n];
+		if(i == hash || ds_skip_dst(idx->dlist[i].flags)) {
+			/* state changed after the table was built */
+			continue;
+		}
+		LM_DBG("using entry [%d/%d]\n", rstate->setid, i);
+		if(ds_add_xavp_record(
+				   idx, i, rstate->setid, rstate->alg, &rstate->lxavp)
+				< 0) {
+			LM_ERR("failed to add destination in the xavp (%d/%d)\n", i,
+					rstate->setid);
+			ret = -1;
+			break;
+		}
+		rstate->cnt++;
+	}
+	lock_release(&idx->lock);
+	return ret;
+}
 
 void ds_sorted_by_priority(sorted_ds_t *sorted_ds, int size)
 {
@@ -2597,6 +3434,79 @@ int ds_manage_route_algo13(ds_set_t *idx, ds_select_state_t *rstate)
 	return hash;
 }
 
+/**
+ * return 1 if the algorithm selects the destination based on a hash value
+ */
+static inline int ds_alg_hashing(int alg)
+{
+	switch(alg) {
+		case DS_ALG_HASHCALLID:
+		case DS_ALG_HASHFROMURI:
+		case DS_ALG_HASHTOURI:
+		case DS_ALG_HASHRURI:
+		case DS_ALG_HASHAUTHUSER:
+		case DS_ALG_HASHPV:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * 64bit mixing function (splitmix64 finalizer)
+ */
+static inline uint64_t ds_hash_mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+ * weighted rendezvous (highest random weight) hashing
+ * - select the active destination with the highest score for the hash value,
+ *   so only the keys mapped to a destination that is added, removed or
+ *   changes the state are moved to other destinations
+ * - the weight attribute scales the share of the keys for each destination
+ * - return the index of the selected destination or -1 if none is active
+ */
+static int ds_hash_rendezvous(ds_set_t *dset, unsigned int hash)
+{
+	int j;
+	int n;
+	int w;
+	int sel = -1;
+	uint64_t h;
+	double u;
+	double score;
+	double smax = 0;
+
+	n = dset->nr;
+	if(ds_use_default != 0 && n != 1) {
+		/* last destination is used only as default */
+		n--;
+	}
+	for(j = 0; j < n; j++) {
+		if(ds_skip_dst(dset->dlist[j].flags)) {
+			continue;
+		}
+		h = ds_hash_mix64(((uint64_t)hash << 32) | dset->dlist[j].chash);
+		/* uniform value in (0, 1) from the top 53 bits */
+		u = ((double)(h >> 11) + 0.5) / 9007199254740992.0;
+		w = (dset->dlist[j].attrs.weight > 0) ? dset->dlist[j].attrs.weight
+											   : 1;
+		score = -(double)w / log(u);
+		if(sel < 0 || score > smax) {
+			sel = j;
+			smax = score;
+		}
+	}
+	return sel;
+}
+
 /**
  *
  */
@@ -2609,6 +3519,9 @@ int ds_manage_routes(sip_msg_t *msg, ds_select_state_t *rstate)
 	int vlast = 0;
 	int valg = 0;
 	int xavp_filled = 0;
+	unsigned int rwgen = 0;
+	int rwslot = -1;
+	int rwpick = 0;
 
 	if(msg == NULL) {
 		LM_ERR("bad parameters\n");
@@ -2713,6 +3626,11 @@ int ds_manage_routes(sip_msg_t *msg, ds_select_state_t *rstate)
 			hash = 0;
 			break;
 		case DS_ALG_WEIGHT: /* 9 - weight based distribution */
+			if(idx->walias != NULL) {
+				hash = idx->walias->dst[ds_walias_pick(
+						idx->walias, idx->walias->n)];
+				break;
+			}
 			lock_get(&idx->lock);
 			hash = idx->wlist[idx->wlast];
 			idx->wlast = (idx->wlast + 1) % 100;
@@ -2746,6 +3664,23 @@ int ds_manage_routes(sip_msg_t *msg, ds_select_state_t *rstate)
 			}
 			break;
 		case DS_ALG_RELWEIGHT: /* 11 - relative weight based distribution */
+			if(idx->rwalias != NULL) {
+				/* only the active destinations are in the table */
+				i = ds_rwalias_pick(idx, &rwslot, &rwgen);
+				if(i >= 0) {
+					hash = i;
+					if(!ds_skip_dst(idx->dlist[hash].flags)) {
+						rwpick = 1;
+						break;
+					}
+					/* state changed meanwhile - search the next active */
+					rwslot = -1;
+					break;
+				}
+				/* no active destination with a relative weight - the next
+				 * active one after the array entry is used, as without the
+				 * alias table */
+			}
 			lock_get(&idx->lock);
 			hash = idx->rwlist[idx->rwlast];
 			idx->rwlast = (idx->rwlast + 1) % 100;
@@ -2763,6 +3698,18 @@ int ds_manage_routes(sip_msg_t *msg, ds_select_state_t *rstate)
 			xavp_filled = 1;
 			break;
 		/* case DS_ALG_RRSERIAL: // 14 - round-robin or serial decided above */
+		case DS_ALG_LEASTOREQ: /* 15 - least outstanding requests */
+			i = ds_get_leastoreq(idx);
+			if(i < 0) {
+				/* no active destination */
+				if(ds_use_default == 0
+						|| ds_skip_dst(idx->dlist[idx->nr - 1].flags)) {
+					return -1;
+				}
+				i = idx->nr - 1;
+			}
+			hash = i;
+			break;
 		case DS_ALG_OVERLOAD: /* 64 - round robin with overload control */
 			lock_get(&idx->lock);
 			hash = idx->last;
@@ -2779,30 +3726,48 @@ int ds_manage_routes(sip_msg_t *msg, ds_select_state_t *rstate)
 
 	LM_DBG("using alg [%d] hash [%u]\n", rstate->alg, hash);
 
-	if(ds_use_default != 0 && idx->nr != 1)
-		hash = hash % (idx->nr - 1);
-	else
-		hash = hash % idx->nr;
-	i = hash;
-
-	/* if selected address is inactive, find next active */
-	while(!xavp_filled
-			&& (ds_skip_dst(idx->dlist[i].flags)
-					|| ds_oc_skip(idx, rstate->alg, i))) {
+	if((ds_flags & DS_HASH_CONSISTENT) && ulast == 0
+			&& ds_alg_hashing(valg)) {
+		i = ds_hash_rendezvous(idx, hash);
+		if(i < 0) {
+			/* no active dst -- try default */
+			if(ds_use_default == 0) {
+				return -1;
+			}
+			i = idx->nr - 1;
+			if(ds_skip_dst(idx->dlist[i].flags)) {
+				return -1;
+			}
+		}
+	} else if(rwpick) {
+		/* active destination taken from the relative weight table */
+		i = hash;
+	} else {
 		if(ds_use_default != 0 && idx->nr != 1)
-			i = (i + 1) % (idx->nr - 1);
+			hash = hash % (idx->nr - 1);
 		else
-			i = (i + 1) % idx->nr;
-		if(i == hash) {
-			/* back to start -- looks like no active dst */
-			if(ds_use_default != 0) {
-				i = idx->nr - 1;
-				if(ds_skip_dst(idx->dlist[i].flags)
-						|| ds_oc_skip(idx, rstate->alg, i))
+			hash = hash % idx->nr;
+		i = hash;
+
+		/* if selected address is inactive, find next active */
+		while(!xavp_filled
+				&& (ds_skip_dst(idx->dlist[i].flags)
+						|| ds_oc_skip(idx, rstate->alg, i))) {
+			if(ds_use_default != 0 && idx->nr != 1)
+				i = (i + 1) % (idx->nr - 1);
+			else
+				i = (i + 1) % idx->nr;
+			if(i == hash) {
+				/* back to start -- looks like no active dst */
+				if(ds_use_default != 0) {
+					i = idx->nr - 1;
+					if(ds_skip_dst(idx->dlist[i].flags)
+							|| ds_oc_skip(idx, rstate->alg, i))
+						return -1;
+					break;
+				} else {
 					return -1;
-				break;
-			} else {
-				return -1;
+				}
 			}
 		}
 	}
@@ -2818,6 +3783,12 @@ int ds_manage_routes(sip_msg_t *msg, ds_select_state_t *rstate)
 			return -1;
 		}
 		rstate->emode = 1;
+		if(rstate->alg == DS_ALG_LEASTOREQ) {
+			if(ds_oreq_add(msg, idx, rstate->setid, hash) < 0) {
+				LM_WARN("outstanding requests for [%.*s] not tracked\n",
+						idx->dlist[hash].uri.len, idx->dlist[hash].uri.s);
+			}
+		}
 	}
 
 	/* update last field for next select to point after the current active used,
@@ -2849,7 +3820,12 @@ int ds_manage_routes(sip_msg_t *msg, ds_select_state_t *rstate)
 		return 1;
 	}
 
-	if(!xavp_filled) {
+	if(rwpick) {
+		if(ds_manage_routes_fill_rwxavp(hash, rwslot, rwgen, idx, rstate)
+				== -1) {
+			return -1;
+		}
+	} else if(!xavp_filled) {
 		if(ds_manage_routes_fill_xavp(hash, idx, rstate) == -1) {
 			return -1;
 		}
@@ -2927,6 +3903,14 @@ next_dst:
 	}
 	LM_DBG("using next dst uri [%.*s]\n", lxavp->val.v.s.len, lxavp->val.v.s.s);
 
+	if(upos == DS_USE_NEXT) {
+		/* track outstanding requests if oreq field is set */
+		if(ds_oreq_add_xavp(msg, rxavp, &lxavp->val.v.s) < 0) {
+			LM_WARN("outstanding requests for [%.*s] not tracked\n",
+					lxavp->val.v.s.len, lxavp->val.v.s.s);
+		}
+	}
+
 	/* call load update if dstid field is set */
 	lxavp = xavp_get(&ds_xavp_dst_dstid, rxavp);
 	if(lxavp == NULL || lxavp->val.type != SR_XTYPE_STR) {
@@ -3381,6 +4365,9 @@ int ds_update_latency(int group, str *address, int code)
 		}
 	}
 
+	if(cc.enabled && cc.apply_rweights && idx->rwalias != NULL) {
+		ds_rwalias_update(idx);
+	}
 	lock_release(&idx->lock);
 	if(cc.enabled && cc.apply_rweights)
 		dp_init_relative_weights(idx);
@@ -3655,6 +4642,22 @@ static void ds_run_route(sip_msg_t *msg, str *uri, char *route, ds_rctx_t *rctx)
 }
 
 
+/**
+ * recalculate relative weights of the active destinations
+ */
+static void ds_reinit_rweight(ds_set_t *dset)
+{
+	if(dset->rwalias != NULL) {
+		/* the alias table holds only the active destinations */
+		lock_get(&dset->lock);
+		ds_rwalias_update(dset);
+		lock_release(&dset->lock);
+	} else {
+		dp_init_relative_weights(dset);
+	}
+}
+
+
 /**
  * recalculate relative states if some destination state was changed
  */
@@ -3667,7 +4670,7 @@ int ds_reinit_rweight_on_state_change(
 	}
 	if((!ds_skip_dst(old_state) && ds_skip_dst(new_state))
 			|| (ds_skip_dst(old_state) && !ds_skip_dst(new_state))) {
-		dp_init_relative_weights(dset);
+		ds_reinit_rweight(dset);
 	}
 
 	return 0;
@@ -3770,6 +4773,7 @@ int ds_reinit_duid_state(int group, str *vduid, int state)
 int ds_reinit_state_all(int group, int state)
 {
 	int i = 0;
+	int rwchanged = 0;
 	ds_set_t *idx = NULL;
 
 	if(_ds_list == NULL || _ds_list_nr <= 0) {
@@ -3789,11 +4793,15 @@ int ds_reinit_state_all(int group, int state)
 		idx->dlist[i].flags &= ~(DS_STATES_ALL);
 		/* set the new states */
 		idx->dlist[i].flags |= state;
-		if(idx->dlist[i].attrs.rweight > 0) {
-			ds_reinit_rweight_on_state_change(
-					old_state, idx->dlist[i].flags, idx);
+		if(idx->dlist[i].attrs.rweight > 0
+				&& !ds_skip_dst(old_state)
+						   != !ds_skip_dst(idx->dlist[i].flags)) {
+			rwchanged = 1;
 		}
 	}
+	/* relative weights recalculated once for all destinations */
+	if(rwchanged)
+		ds_reinit_rweight(idx);
 	return 0;
 }
 
@@ -4209,6 +5217,8 @@ static void ds_options_callback(
 	uri.len = t->to_hdr.len - 8;
 	LM_DBG("OPTIONS-Request was finished with code %d (to %.*s, group %d)\n",
 			ps->code, uri.len, uri.s, group);
+	ds_ping_stats_update(
+			group, &uri, (ps->rpl == NULL || ps->rpl == FAKED_REPLY));
 	if(ds_ping_latency_stats) {
 		ds_update_latency(group, &uri, ps->code);
 	}
@@ -4311,6 +5321,32 @@ char *ds_rand_str4(void)
 	return obuf;
 }
 
+/**
+ * Check if the destination has to be pinged now when spreading the pings
+ * over the interval
+ * - inactive and trying destinations use ds_ping_inactive_interval if set
+ */
+static int ds_ping_due(ds_dest_t *dp, time_t now)
+{
+	int ival;
+
+	ival = ds_ping_interval;
+	if(ds_ping_inactive_interval > 0
+			&& (dp->flags & (DS_INACTIVE_DST | DS_TRYING_DST))) {
+		ival = ds_ping_inactive_interval;
+	}
+	if(dp->ping_next == 0 || dp->ping_next > now + ival) {
+		/* first round or interval shortened - random offset */
+		dp->ping_next = now + ksr_xrand() % ival;
+	}
+	if(dp->ping_next > now) {
+		return 0;
+	}
+	/* next ping with jitter of +/-10% to keep the pings spread */
+	dp->ping_next = now + ival - ival / 10 + ksr_xrand() % (ival / 5 + 1);
+	return 1;
+}
+
 /**
  *
  */
@@ -4324,6 +5360,7 @@ void ds_ping_set(ds_set_t *node)
 	ds_rctx_t rctx;
 	char ftbuf[64];
 	str ftag;
+	time_t now;
 
 	if(!node)
 		return;
@@ -4331,6 +5368,8 @@ void ds_ping_set(ds_set_t *node)
 	for(i = 0; i < 2; ++i)
 		ds_ping_set(node->next[i]);
 
+	now = time(NULL);
+
 	for(j = 0; j < node->nr; j++) {
 		/* skip addresses set in disabled state by admin */
 		if((node->dlist[j].flags & DS_DISABLED_DST) != 0)
@@ -4341,6 +5380,17 @@ void ds_ping_set(ds_set_t *node)
 		/* skip addresses with no-DNS-A flag */
 		if((node->dlist[j].flags & DS_NODNSARES_DST) != 0)
 			continue;
+		if(ds_ping_spread != 0) {
+			/* limit the keepalives waiting for response */
+			if(ds_ping_max_pending > 0
+					&& atomic_get(&_ds_ping_stats->pending)
+							   >= ds_ping_max_pending) {
+				continue;
+			}
+			if(ds_ping_due(&node->dlist[j], now) == 0) {
+				continue;
+			}
+		}
 		/* If the Flag of the entry has "Probing set, send a probe:	*/
 		if(ds_ping_result_helper(node, j)) {
 			LM_DBG("probing set #%d, URI %.*s\n", node->id,
@@ -4405,10 +5455,13 @@ void ds_ping_set(ds_set_t *node)
 			}
 
 			gettimeofday(&node->dlist[j].latency_stats.start, NULL);
+			atomic_inc(&_ds_ping_stats->pending);
+			atomic_inc(&_ds_ping_stats->sent);
 
 			if(tmb.t_request(&uac_r, &node->dlist[j].uri, &node->dlist[j].uri,
 					   &ping_from, &obproxy)
 					< 0) {
+				atomic_dec(&_ds_ping_stats->pending);
 				LM_ERR("unable to ping [%.*s] in group [%d]\n",
 						node->dlist[j].uri.len, node->dlist[j].uri.s, node->id);
 				state = DS_TRYING_DST;
@@ -4656,6 +5709,8 @@ void ds_avl_destroy(ds_set_t **node_ptr)
 	}
 	if(node->dlist != NULL)
 		shm_free(node->dlist);
+	ds_walias_free(node->walias);
+	ds_walias_free(node->rwalias);
 	shm_free(node);
 
 	*node_ptr = NULL;
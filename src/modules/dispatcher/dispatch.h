@@ -33,15 +33,18 @@
 #include <stdio.h>
 #include <sys/time.h>
 #include "../../core/pvar.h"
+#include "../../core/atomic_ops.h"
 #include "../../core/xavp.h"
 #include "../../core/parser/msg_parser.h"
 #include "../../core/utils/sruid.h"
 #include "../../modules/tm/tm_load.h"
+#include "ds_walias.h"
 
 
 /* clang-format off */
 #define DS_HASH_USER_ONLY	1  /*!< use only the uri user part for hashing */
 #define DS_FAILOVER_ON		2  /*!< store the other dest in avps */
+#define DS_HASH_CONSISTENT	4  /*!< consistent hashing for hash algorithms */
 
 #define DS_INACTIVE_DST		1  /*!< inactive destination */
 #define DS_TRYING_DST		2  /*!< temporary trying destination */
@@ -105,6 +108,8 @@ extern str ds_dest_uri_col;
 extern str ds_dest_flags_col;
 extern str ds_dest_priority_col;
 extern str ds_dest_attrs_col;
+extern str ds_log_table_name;
+extern str ds_log_id_col;
 
 extern int ds_flags;
 extern int ds_use_default;
@@ -117,6 +122,7 @@ extern int ds_xavp_ctx_mode;
 extern str ds_xavp_dst_addr;
 extern str ds_xavp_dst_grp;
 extern str ds_xavp_dst_dstid;
+extern str ds_xavp_dst_oreq;
 extern str ds_xavp_dst_attrs;
 extern str ds_xavp_dst_sock;
 extern str ds_xavp_dst_socket;
@@ -140,6 +146,11 @@ extern int probing_threshold;  /*!< number of failed requests,
 extern int inactive_threshold; /*!< number of successful requests,
 								before a destination is taken into active */
 extern int ds_probing_mode;
+extern int ds_oreq_mode;
+extern int ds_ping_interval;
+extern int ds_ping_spread;
+extern int ds_ping_inactive_interval;
+extern int ds_ping_max_pending;
 extern str ds_outbound_proxy;
 extern str ds_default_socket;
 extern str ds_default_sockname;
@@ -153,6 +164,8 @@ int ds_connect_db(void);
 void ds_disconnect_db(void);
 int ds_load_db(void);
 int ds_reload_db(void);
+int ds_load_db_changes(void);
+int ds_reload_db_changes(void);
 int ds_destroy_list(void);
 int ds_select_dst_limit(
 		sip_msg_t *msg, int set, int alg, uint32_t limit, int mode);
@@ -262,6 +275,9 @@ typedef struct _ds_dest {
 	ds_ocdata_t ocdata;	/*!< overload control attributes */
 	char buid[SRUID_SIZE]; /*!< buffer for internal uid */
 	str suid; /*!< str shortcut for internal uid */
+	unsigned int chash; /*!< hash of duid or uri for consistent hashing */
+	atomic_t oreqs;   /*!< outstanding requests (transactions) */
+	time_t ping_next; /*!< time of next keepalive when spreading pings */
 	struct _ds_dest *next;
 } ds_dest_t;
 
@@ -274,6 +290,9 @@ typedef struct _ds_set {
 	ds_dest_t *dlist;
 	unsigned int wlist[100];
 	unsigned int rwlist[100];
+	ds_walias_t *walias;	/*!< alias table by weight */
+	ds_walias_t *rwalias;	/*!< alias table by relative weight, active dsts */
+	volatile unsigned int rwgen; /*!< rwalias update count, odd while updated */
 	struct _ds_set *next[2];
 	int longer;
 	int rrserial;		/*!< round-robin or serial flag */
@@ -308,10 +327,25 @@ int ds_get_list_nr(void);
 
 ds_set_t *ds_list_lookup(int set);
 
+int ds_oreq_init(void);
+int ds_oreq_active(void);
+
 int ds_ping_active_init(void);
 int ds_ping_active_get(void);
 int ds_ping_active_set(int v);
 
+#define DS_PING_HIST_SIZE 16
+typedef struct _ds_ping_stats {
+	atomic_t pending;  /*!< keepalives waiting for the response */
+	atomic_t sent;     /*!< keepalives sent */
+	atomic_t timeouts; /*!< keepalives without response */
+	atomic_t hist[DS_PING_HIST_SIZE]; /*!< response time buckets
+										(up to 2^i ms, last unbound) */
+} ds_ping_stats_t;
+
+int ds_ping_stats_init(void);
+ds_ping_stats_t *ds_ping_stats_get(void);
+
 int ds_sruid_init(void);
 
 /* Create if not exist and return ds_set_t by id */
@@ -85,6 +85,7 @@ str hash_pvar_param = STR_NULL;
 str ds_xavp_dst_addr = str_init("uri");
 str ds_xavp_dst_grp = str_init("grp");
 str ds_xavp_dst_dstid = str_init("dstid");
+str ds_xavp_dst_oreq = str_init("oreq");
 str ds_xavp_dst_attrs = str_init("attrs");
 str ds_xavp_dst_sock = str_init("sock");
 str ds_xavp_dst_socket = str_init("socket");
@@ -101,7 +102,10 @@ int inactive_threshold = 1; /* number of replied requests, before a destination
 							 * is taken into back in active state */
 str ds_ping_method = str_init("OPTIONS");
 str ds_ping_from   = str_init("sip:dispatcher@localhost");
-static int ds_ping_interval = 0;
+int ds_ping_interval = 0;
+int ds_ping_spread = 0;
+int ds_ping_inactive_interval = 0;
+int ds_ping_max_pending = 0;
 int ds_ping_latency_stats = 0;
 int ds_ping_fr_timeout = 0;
 int ds_retain_latency_stats = 0;
@@ -128,6 +132,8 @@ int ds_load_mode = 0;
 uint32_t ds_dns_mode = DS_DNS_MODE_INIT;
 static int ds_dns_interval = 600;
 int ds_dns_ttl = 0;
+int ds_weight_mode = 0;
+int ds_oreq_mode = 0;
 
 str ds_outbound_proxy = STR_NULL;
 
@@ -142,6 +148,8 @@ str ds_dest_flags_col    = str_init(DS_DEST_FLAGS_COL);
 str ds_dest_priority_col = str_init(DS_DEST_PRIORITY_COL);
 str ds_dest_attrs_col    = str_init(DS_DEST_ATTRS_COL);
 str ds_table_name        = str_init(DS_TABLE_NAME);
+str ds_log_table_name    = STR_NULL;
+str ds_log_id_col        = str_init("id");
 
 str ds_setid_pvname   = STR_NULL;
 pv_spec_t ds_setid_pv;
@@ -288,6 +296,8 @@ static param_export_t params[]={
 	{"db_url",		    PARAM_STR, &ds_db_url},
 	{"table_name", 	    PARAM_STR, &ds_table_name},
 	{"setid_col",       PARAM_STR, &ds_set_id_col},
+	{"log_table_name",  PARAM_STR, &ds_log_table_name},
+	{"log_id_col",      PARAM_STR, &ds_log_id_col},
 	{"destination_col", PARAM_STR, &ds_dest_uri_col},
 	{"flags_col",       PARAM_STR, &ds_dest_flags_col},
 	{"priority_col",    PARAM_STR, &ds_dest_priority_col},
@@ -307,6 +317,9 @@ static param_export_t params[]={
 	{"ds_ping_method",     PARAM_STR, &ds_ping_method},
 	{"ds_ping_from",       PARAM_STR, &ds_ping_from},
 	{"ds_ping_interval",   PARAM_INT, &ds_ping_interval},
+	{"ds_ping_spread",     PARAM_INT, &ds_ping_spread},
+	{"ds_ping_inactive_interval", PARAM_INT, &ds_ping_inactive_interval},
+	{"ds_ping_max_pending", PARAM_INT, &ds_ping_max_pending},
 	{"ds_ping_fr_timeout", PARAM_INT, &ds_ping_fr_timeout},
 	{"ds_ping_latency_stats", PARAM_INT, &ds_ping_latency_stats},
 	{"ds_retain_latency_stats", PARAM_INT, &ds_retain_latency_stats},
@@ -331,6 +344,8 @@ static param_export_t params[]={
 	{"ds_dns_mode",        PARAM_INT, &ds_dns_mode},
 	{"ds_dns_interval",    PARAM_INT, &ds_dns_interval},
 	{"ds_dns_ttl",         PARAM_INT, &ds_dns_ttl},
+	{"ds_weight_mode",     PARAM_INT, &ds_weight_mode},
+	{"ds_oreq_mode",       PARAM_INT, &ds_oreq_mode},
 	{0,0,0}
 };
 
@@ -375,6 +390,12 @@ static int mod_init(void)
 	if(ds_ping_active_init() < 0) {
 		return -1;
 	}
+	if(ds_oreq_init() < 0) {
+		return -1;
+	}
+	if(ds_ping_stats_init() < 0) {
+		return -1;
+	}
 	if(ds_sruid_init() < 0) {
 		return -1;
 	}
@@ -395,11 +416,21 @@ static int mod_init(void)
 			LM_ERR("could not load the TM-functions - disable DS ping\n");
 			return -1;
 		}
-		if(ds_timer_mode == 1) {
-			if(sr_wtimer_add(ds_check_timer, NULL, ds_ping_interval) < 0)
+		if(ds_ping_spread != 0 && ds_ping_inactive_interval > ds_ping_interval) {
+			LM_WARN("ping inactive interval greater than ping interval\n");
+		}
+		if(ds_timer_mode == 2) {
+			/* dedicated timer process forked in child init */
+			register_basic_timers(1);
+		} else if(ds_timer_mode == 1) {
+			if(sr_wtimer_add(ds_check_timer, NULL,
+					   (ds_ping_spread) ? 1 : ds_ping_interval)
+					< 0)
 				return -1;
 		} else {
-			if(register_timer(ds_check_timer, NULL, ds_ping_interval) < 0)
+			if(register_timer(ds_check_timer, NULL,
+					   (ds_ping_spread) ? 1 : ds_ping_interval)
+					< 0)
 				return -1;
 		}
 	}
@@ -539,7 +570,7 @@ static int mod_init(void)
 				   1 << ds_hash_size, ds_hash_expire, ds_hash_initexpire)
 				< 0)
 			return -1;
-		if(ds_timer_mode == 1) {
+		if(ds_timer_mode == 1 || ds_timer_mode == 2) {
 			if(sr_wtimer_add(ds_ht_timer, NULL, ds_hash_check_interval) < 0)
 				return -1;
 		} else {
@@ -574,6 +605,15 @@ static int mod_init(void)
  */
 static int child_init(int rank)
 {
+	if(rank == PROC_MAIN && ds_ping_interval > 0 && ds_timer_mode == 2) {
+		if(fork_basic_timer(PROC_TIMER, "DISPATCHER KEEPALIVE", 1 /*socks*/,
+				   ds_check_timer, NULL,
+				   (ds_ping_spread) ? 1 : ds_ping_interval)
+				< 0) {
+			LM_ERR("failed to start keepalive timer process\n");
+			return -1;
+		}
+	}
 	return 0;
 }
 
@@ -1968,6 +2008,48 @@ static void dispatcher_rpc_reload(rpc_t *rpc, void *ctx)
 }
 
 
+static const char *dispatcher_rpc_reload_changes_doc[2] = {
+		"Reload dispatcher destination sets listed in the change log", 0};
+
+
+/*
+ * RPC command to reload the changed dispatcher destination sets
+ */
+static void dispatcher_rpc_reload_changes(rpc_t *rpc, void *ctx)
+{
+	int n;
+
+	if(!ds_db_url.s || ds_log_table_name.len <= 0) {
+		rpc->fault(ctx, 500, "No change log table");
+		return;
+	}
+	if(ds_rpc_reload_time == NULL) {
+		LM_ERR("not ready for reload\n");
+		rpc->fault(ctx, 500, "Not ready for reload");
+		return;
+	}
+	if(*ds_rpc_reload_time != 0
+			&& *ds_rpc_reload_time > time(NULL) - ds_reload_delta) {
+		LM_ERR("ongoing reload\n");
+		rpc->fault(ctx, 500, "Ongoing reload");
+		return;
+	}
+	*ds_rpc_reload_time = time(NULL);
+
+	n = ds_reload_db_changes();
+	if(n == -1) {
+		rpc->fault(ctx, 500, "Reload Failed");
+		return;
+	}
+	if(n == -2) {
+		rpc->rpl_printf(ctx, "Ok. Changed sets reloaded with errors.");
+		return;
+	}
+	rpc->rpl_printf(ctx, "Ok. %d changed sets reloaded.", n);
+	return;
+}
+
+
 static const char *dispatcher_rpc_list_doc[2] = {
 		"Return the content of dispatcher sets", 0};
 
@@ -2118,16 +2200,26 @@ int ds_rpc_print_set(
 				return -1;
 			}
 		}
-		if(ds_hash_size > 0) {
+		if(ds_hash_size > 0 || ds_oreq_active()) {
 			if(rpc->struct_add(vh, "{", "RUNTIME", &dh) < 0) {
 				rpc->fault(ctx, 500, "Internal error creating runtime struct");
 				return -1;
 			}
+		}
+		if(ds_hash_size > 0) {
 			if(rpc->struct_add(dh, "d", "DLGLOAD", node->dlist[j].dload) < 0) {
 				rpc->fault(ctx, 500, "Internal error creating runtime attrs");
 				return -1;
 			}
 		}
+		if(ds_oreq_active()) {
+			if(rpc->struct_add(
+					   dh, "d", "OREQS", atomic_get(&node->dlist[j].oreqs))
+					< 0) {
+				rpc->fault(ctx, 500, "Internal error creating runtime attrs");
+				return -1;
+			}
+		}
 	}
 
 	return 0;
@@ -2308,6 +2400,54 @@ static void dispatcher_rpc_ping_active(rpc_t *rpc, void *ctx)
 	return;
 }
 
+static const char *dispatcher_rpc_ping_stats_doc[2] = {
+		"Print the statistics of pinging (keepalive) destinations", 0};
+
+
+/*
+ * RPC command to print the statistics of keepalives
+ */
+static void dispatcher_rpc_ping_stats(rpc_t *rpc, void *ctx)
+{
+	ds_ping_stats_t *pst;
+	void *th;
+	void *hh;
+	char kbuf[16];
+	int i;
+
+	pst = ds_ping_stats_get();
+	if(pst == NULL) {
+		rpc->fault(ctx, 500, "No ping statistics");
+		return;
+	}
+	if(rpc->add(ctx, "{", &th) < 0) {
+		rpc->fault(ctx, 500, "Internal error root reply");
+		return;
+	}
+	if(rpc->struct_add(th, "ddd", "PENDING", atomic_get(&pst->pending),
+			   "SENT", atomic_get(&pst->sent), "TIMEOUTS",
+			   atomic_get(&pst->timeouts))
+			< 0) {
+		rpc->fault(ctx, 500, "Internal error reply structure");
+		return;
+	}
+	if(rpc->struct_add(th, "{", "RESPONSE_MS", &hh) < 0) {
+		rpc->fault(ctx, 500, "Internal error histogram structure");
+		return;
+	}
+	for(i = 0; i < DS_PING_HIST_SIZE; i++) {
+		if(i < DS_PING_HIST_SIZE - 1) {
+			snprintf(kbuf, 16, "LE%d", 1 << i);
+		} else {
+			snprintf(kbuf, 16, "INF");
+		}
+		if(rpc->struct_add(hh, "d", kbuf, atomic_get(&pst->hist[i])) < 0) {
+			rpc->fault(ctx, 500, "Internal error histogram bucket");
+			return;
+		}
+	}
+}
+
 static const char *dispatcher_rpc_add_doc[2] = {
 		"Add a destination address in memory", 0};
 
@@ -2490,6 +2630,8 @@ static void dispatcher_rpc_oclist(rpc_t *rpc, void *ctx)
 rpc_export_t dispatcher_rpc_cmds[] = {
 	{"dispatcher.reload", dispatcher_rpc_reload,
 		dispatcher_rpc_reload_doc, 0},
+	{"dispatcher.reload_changes", dispatcher_rpc_reload_changes,
+		dispatcher_rpc_reload_changes_doc, 0},
 	{"dispatcher.list",   dispatcher_rpc_list,
 		dispatcher_rpc_list_doc,   0},
 	{"dispatcher.set_state",   dispatcher_rpc_set_state,
@@ -2498,6 +2640,8 @@ rpc_export_t dispatcher_rpc_cmds[] = {
 		dispatcher_rpc_set_duid_state_doc,   0},
 	{"dispatcher.ping_active",   dispatcher_rpc_ping_active,
 		dispatcher_rpc_ping_active_doc, 0},
+	{"dispatcher.ping_stats",   dispatcher_rpc_ping_stats,
+		dispatcher_rpc_ping_stats_doc, 0},
 	{"dispatcher.add",   dispatcher_rpc_add,
 		dispatcher_rpc_add_doc, 0},
 	{"dispatcher.remove",   dispatcher_rpc_remove,
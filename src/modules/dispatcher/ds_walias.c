@@ -0,0 +1,135 @@
+/**
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+
+#include "ds_walias.h"
+
+/**
+ * Create an alias table with space for size slots, none in use
+ */
+ds_walias_t *ds_walias_new(int size)
+{
+	ds_walias_t *wa = NULL;
+	unsigned long msize;
+
+	msize = sizeof(ds_walias_t)
+			+ size
+					  * (sizeof(double) + sizeof(ds_walias_slot_t)
+							  + 3 * sizeof(int));
+	wa = (ds_walias_t *)shm_malloc(msize);
+	if(wa == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(wa, 0, msize);
+	wa->size = size;
+	wa->pw = (double *)(wa + 1);
+	wa->slots = (ds_walias_slot_t *)(wa->pw + size);
+	wa->dst = (int *)(wa->slots + size);
+	wa->w = wa->dst + size;
+	wa->stk = wa->w + size;
+	return wa;
+}
+
+/**
+ * Free an alias table
+ */
+void ds_walias_free(ds_walias_t *wa)
+{
+	if(wa != NULL)
+		shm_free(wa);
+}
+
+/**
+ * Build the alias table from the destination and the weight of the n
+ * slots in use
+ * - the weights are not limited to a sum of 100
+ * - return -1 if no weight is set, with no slot in use
+ */
+int ds_walias_build(ds_walias_t *wa)
+{
+	int j;
+	int n;
+	int ns;
+	int nl;
+	int sidx;
+	int lidx;
+	double wsum;
+	double *pw;
+	int *stk;
+
+	n = wa->n;
+	wsum = 0;
+	for(j = 0; j < n; j++) {
+		if(wa->w[j] > 0)
+			wsum += wa->w[j];
+	}
+	if(n <= 0 || wsum <= 0) {
+		wa->n = 0;
+		return -1;
+	}
+
+	pw = wa->pw;
+	stk = wa->stk;
+
+	/* small probabilities are stacked from the start of the array,
+	 * the large ones from the end */
+	ns = 0;
+	nl = n;
+	for(j = 0; j < n; j++) {
+		pw[j] = (wa->w[j] > 0) ? ((double)wa->w[j] * n / wsum) : 0;
+		if(pw[j] < 1.0) {
+			stk[ns++] = j;
+		} else {
+			stk[--nl] = j;
+		}
+	}
+	while(ns > 0 && nl < n) {
+		sidx = stk[--ns];
+		lidx = stk[nl];
+		wa->slots[sidx].prob = (uint32_t)(pw[sidx] * 4294967295.0);
+		wa->slots[sidx].alias = lidx;
+		pw[lidx] = (pw[lidx] + pw[sidx]) - 1.0;
+		if(pw[lidx] < 1.0) {
+			nl++;
+			stk[ns++] = lidx;
+		}
+	}
+	/* left over slots (including rounding errors) keep their index */
+	while(nl < n) {
+		lidx = stk[nl++];
+		wa->slots[lidx].prob = UINT32_MAX;
+		wa->slots[lidx].alias = lidx;
+	}
+	while(ns > 0) {
+		sidx = stk[--ns];
+		wa->slots[sidx].prob = UINT32_MAX;
+		wa->slots[sidx].alias = sidx;
+	}
+
+	return 0;
+}
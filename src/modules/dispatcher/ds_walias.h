@@ -0,0 +1,72 @@
+/**
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _DS_WALIAS_H_
+#define _DS_WALIAS_H_
+
+#include <stdint.h>
+
+#include "../../core/rand/ksrxrand.h"
+
+typedef struct _ds_walias_slot {
+	uint32_t prob;  /*!< threshold to select the slot index */
+	int alias;      /*!< index to select otherwise */
+} ds_walias_slot_t;
+
+/**
+ * Alias table (Vose's method) for weighted selection in O(1) over a list
+ * of destinations. For the relative weight it holds only the active
+ * destinations and it is rebuilt when one changes the state, so a pick
+ * never has to skip inactive ones. The rebuild is not done incrementally:
+ * any slot can have any destination as alias, so removing or adding one
+ * can change all of them. It is O(n) and does not allocate memory, the
+ * scratch space being part of the table.
+ */
+typedef struct _ds_walias {
+	int n;                   /*!< number of slots in use */
+	int size;                /*!< number of slots allocated */
+	int *dst;                /*!< destination index of each slot */
+	int *w;                  /*!< weight of each slot */
+	ds_walias_slot_t *slots; /*!< alias table over the slots */
+	double *pw;              /*!< scratch space for the build */
+	int *stk;                /*!< scratch space for the build */
+} ds_walias_t;
+
+ds_walias_t *ds_walias_new(int size);
+void ds_walias_free(ds_walias_t *wa);
+int ds_walias_build(ds_walias_t *wa);
+
+/**
+ * Select a slot of the alias table, n being the number of slots in use
+ */
+static inline int ds_walias_pick(ds_walias_t *wa, int n)
+{
+	int j;
+	uint32_t r;
+
+	j = ksr_xrand() % n;
+	r = ((uint32_t)ksr_xrand() << 1) ^ (uint32_t)ksr_xrand();
+	return (r < wa->slots[j].prob) ? j : wa->slots[j].alias;
+}
+
+#endif
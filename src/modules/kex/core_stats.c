@@ -549,8 +549,10 @@ struct rpc_list_params
 static void rpc_get_grp_vars_cbk(void *p, str *g, str *n, counter_handle_t h)
 {
 	struct rpc_list_params *packed_params;
+	counter_hist_val_t hval;
 	rpc_t *rpc;
 	void *ctx;
+	int i;
 
 	packed_params = p;
 	rpc = packed_params->rpc;
@@ -558,6 +560,18 @@ static void rpc_get_grp_vars_cbk(void *p, str *g, str *n, counter_handle_t h)
 
 	rpc->rpl_printf(ctx, "%.*s:%.*s = %lu", g->len, g->s, n->len, n->s,
 			counter_get_val(h));
+	if(counter_hist_get_val(h, &hval) < 0)
+		return;
+	/* histogram - print also the sum and the cumulative buckets */
+	rpc->rpl_printf(ctx, "%.*s:%.*s_sum = %lu", g->len, g->s, n->len, n->s,
+			(unsigned long)hval.sum);
+	for(i = 0; i < hval.nbounds; i++) {
+		rpc->rpl_printf(ctx, "%.*s:%.*s_bucket_le_%ld = %lu", g->len, g->s,
+				n->len, n->s, (long)hval.bounds[i],
+				(unsigned long)hval.buckets[i]);
+	}
+	rpc->rpl_printf(ctx, "%.*s:%.*s_bucket_le_inf = %lu", g->len, g->s,
+			n->len, n->s, (unsigned long)hval.buckets[hval.nbounds]);
 }
 
 /**
@@ -646,10 +660,30 @@ static void rpc_fetch_add_stat(rpc_t *rpc, void *ctx, void *hst, char *g,
 static void rpc_fetch_grp_vars_cbk(void *p, str *g, str *n, counter_handle_t h)
 {
 	struct rpc_list_params *packed_params = p;
+	counter_hist_val_t hval;
+	char hname[128];
+	int i;
 
 	rpc_fetch_add_stat(packed_params->rpc, packed_params->ctx,
 			packed_params->hst, g->s, n->s, counter_get_val(h),
 			packed_params->numeric);
+	if(counter_hist_get_val(h, &hval) < 0)
+		return;
+	/* histogram - add also the sum and the cumulative buckets */
+	snprintf(hname, sizeof(hname), "%s_sum", n->s);
+	rpc_fetch_add_stat(packed_params->rpc, packed_params->ctx,
+			packed_params->hst, g->s, hname, (unsigned long)hval.sum,
+			packed_params->numeric);
+	for(i = 0; i <= hval.nbounds; i++) {
+		if(i < hval.nbounds)
+			snprintf(hname, sizeof(hname), "%s_bucket_le_%ld", n->s,
+					(long)hval.bounds[i]);
+		else
+			snprintf(hname, sizeof(hname), "%s_bucket_le_inf", n->s);
+		rpc_fetch_add_stat(packed_params->rpc, packed_params->ctx,
+				packed_params->hst, g->s, hname,
+				(unsigned long)hval.buckets[i], packed_params->numeric);
+	}
 }
 
 /**
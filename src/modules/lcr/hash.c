@@ -182,21 +182,6 @@ int rule_hash_table_insert_target(struct rule_info **hash_table,
 }
 
 
-/*
- * Return pointer to lcr hash table entry to which given prefix hashes to.
- */
-struct rule_info *rule_hash_table_lookup(
-		struct rule_info **hash_table, unsigned short prefix_len, char *prefix)
-{
-	str prefix_str;
-
-	prefix_str.len = prefix_len;
-	prefix_str.s = prefix;
-
-	return (hash_table)[rule_hash(&prefix_str)];
-}
-
-
 /* Free contents of lcr hash table */
 void rule_hash_table_contents_free(struct rule_info **hash_table)
 {
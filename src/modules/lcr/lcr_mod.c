@@ -44,6 +44,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <arpa/inet.h>
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
@@ -55,6 +56,7 @@
 #include "../../core/mem/mem.h"
 #include "../../core/mem/shm_mem.h"
 #include "../../lib/srdb1/db.h"
+#include "../../lib/srdb1/db_changelog.h"
 #include "../../core/usr_avp.h"
 #include "../../core/parser/parse_from.h"
 #include "../../core/parser/msg_parser.h"
@@ -68,7 +70,9 @@
 #include "../../core/pvar.h"
 #include "../../core/rand/kam_rand.h"
 #include "../../core/kemi.h"
+#include "../../core/counters.h"
 #include "hash.h"
+#include "lcr_trie.h"
 #include "lcr_rpc.h"
 #include "../../core/rpc_lookup.h"
 #include "../../modules/tm/tm_load.h"
@@ -141,6 +145,7 @@ static str lcr_db_url       = str_init(DEFAULT_RODB_URL);
 static str lcr_rule_table   = str_init(LCR_RULE_TABLE);
 static str lcr_rule_target_table = str_init(LCR_RULE_TARGET_TABLE);
 static str lcr_gw_table     = str_init(LCR_GW_TABLE);
+static str lcr_log_table    = STR_NULL;
 static str id_col           = str_init(ID_COL);
 static str lcr_id_col       = str_init(LCR_ID_COL);
 static str prefix_col       = str_init(PREFIX_COL);
@@ -241,6 +246,56 @@ struct gw_info **gw_pt = (struct gw_info **)NULL;
 /* Pointer to rule_id info hash table */
 struct rule_id_info **rule_id_hash_table = (struct rule_id_info **)NULL;
 
+/* Reload statistics, updated by reload_tables() */
+struct lcr_stats
+{
+	unsigned long reload_us;
+	unsigned long trie_us;
+	unsigned long rules;
+	unsigned long trie_nodes;
+	unsigned long trie_size;
+};
+
+static struct lcr_stats *lcr_stats = NULL;
+
+/* position in the change log table */
+static db_changelog_t *lcr_log = NULL;
+
+/* load_gws() rule matching time histogram */
+static counter_hist_t lcr_load_gws_hist;
+
+enum lcr_stat_id
+{
+	LCR_STAT_RELOAD_US = 0,
+	LCR_STAT_TRIE_US,
+	LCR_STAT_RULES,
+	LCR_STAT_TRIE_NODES,
+	LCR_STAT_TRIE_SIZE
+};
+
+static counter_val_t lcr_stats_get(counter_handle_t h, void *what);
+
+/* clang-format off */
+static counter_def_t lcr_cnt_defs[] = {
+	{0, "reload_us", CNT_F_NO_RESET, lcr_stats_get,
+		(void *)(long)LCR_STAT_RELOAD_US,
+		"duration of the last reload of the lcr tables in microseconds"},
+	{0, "trie_build_us", CNT_F_NO_RESET, lcr_stats_get,
+		(void *)(long)LCR_STAT_TRIE_US,
+		"time spent building the rule prefix tries in the last reload"},
+	{0, "rules", CNT_F_NO_RESET, lcr_stats_get,
+		(void *)(long)LCR_STAT_RULES,
+		"number of rules of all lcr instances"},
+	{0, "trie_nodes", CNT_F_NO_RESET, lcr_stats_get,
+		(void *)(long)LCR_STAT_TRIE_NODES,
+		"number of nodes of the rule prefix tries"},
+	{0, "trie_size", CNT_F_NO_RESET, lcr_stats_get,
+		(void *)(long)LCR_STAT_TRIE_SIZE,
+		"shared memory used by the rule prefix tries in bytes"},
+	{0, 0, 0, 0, 0, 0}
+};
+/* clang-format on */
+
 /* Pinging related vars */
 struct tm_binds _lcr_tmb;
 void ping_timer(unsigned int ticks, void *param);
@@ -319,6 +374,7 @@ static param_export_t params[] = {
     {"lcr_rule_table",           PARAM_STR, &lcr_rule_table},
     {"lcr_rule_target_table",    PARAM_STR, &lcr_rule_target_table},
     {"lcr_gw_table",             PARAM_STR, &lcr_gw_table},
+    {"lcr_log_table",            PARAM_STR, &lcr_log_table},
     {"lcr_id_column",            PARAM_STR, &lcr_id_col},
     {"id_column",                PARAM_STR, &id_col},
     {"prefix_column",            PARAM_STR, &prefix_col},
@@ -451,6 +507,8 @@ static int mod_init(void)
 	avp_flags_t avp_flags;
 	unsigned int i;
 	char *at, *past, *sep;
+	counter_val_t hbounds[CNT_HIST_MAX_BOUNDS];
+	int nbounds;
 
 	/* Register RPC commands */
 	if(rpc_register_array(lcr_rpc) != 0) {
@@ -740,6 +798,15 @@ static int mod_init(void)
 	}
 	memset(rule_pt, 0, sizeof(struct rule_info **) * (lcr_count_param + 1));
 
+	/* rule trie pointer table, index 0 points to temp rule trie */
+	trie_pt = (struct lcr_trie **)shm_malloc(
+			sizeof(struct lcr_trie *) * (lcr_count_param + 1));
+	if(trie_pt == 0) {
+		SHM_MEM_ERROR_FMT("for rule trie pointer table\n");
+		goto err;
+	}
+	memset(trie_pt, 0, sizeof(struct lcr_trie *) * (lcr_count_param + 1));
+
 	/* rules hash tables */
 	/* last entry in hash table contains list of different prefix lengths */
 	for(i = 0; i <= lcr_count_param; i++) {
@@ -779,6 +846,34 @@ static int mod_init(void)
 		memset(gw_pt[i], 0, sizeof(struct gw_info) * (lcr_gw_count_param + 1));
 	}
 
+	/* statistics */
+	lcr_stats = (struct lcr_stats *)shm_malloc(sizeof(struct lcr_stats));
+	if(lcr_stats == 0) {
+		SHM_MEM_ERROR_FMT("for lcr statistics\n");
+		goto err;
+	}
+	memset(lcr_stats, 0, sizeof(struct lcr_stats));
+	lcr_log = (db_changelog_t *)shm_malloc(sizeof(db_changelog_t));
+	if(lcr_log == 0) {
+		SHM_MEM_ERROR_FMT("for change log position\n");
+		goto err;
+	}
+	memset(lcr_log, 0, sizeof(db_changelog_t));
+	if(counter_register_array("lcr", lcr_cnt_defs) < 0) {
+		LM_ERR("failed to register counters\n");
+		goto err;
+	}
+	nbounds = counter_hist_loglinear(
+			hbounds, CNT_HIST_MAX_BOUNDS, 1, 100000, 3);
+	if(nbounds < 0
+			|| counter_hist_register(&lcr_load_gws_hist, "lcr", "load_gws_us",
+					   hbounds, nbounds,
+					   "load_gws() rule matching time in microseconds")
+					   < 0) {
+		LM_ERR("failed to register load_gws_us histogram\n");
+		goto err;
+	}
+
 	/* Allocate and initialize locks */
 	reload_lock = lock_alloc();
 	if(reload_lock == NULL) {
@@ -852,6 +947,24 @@ static void free_shared_memory(void)
 		shm_free(rule_pt);
 		rule_pt = 0;
 	}
+	for(i = 0; i <= lcr_count_param; i++) {
+		if(trie_pt && trie_pt[i]) {
+			lcr_trie_free(trie_pt[i]);
+			trie_pt[i] = 0;
+		}
+	}
+	if(trie_pt) {
+		shm_free(trie_pt);
+		trie_pt = 0;
+	}
+	if(lcr_stats) {
+		shm_free(lcr_stats);
+		lcr_stats = 0;
+	}
+	if(lcr_log) {
+		shm_free(lcr_log);
+		lcr_log = 0;
+	}
 	for(i = 0; i <= lcr_count_param; i++) {
 		if(gw_pt && gw_pt[i]) {
 			shm_free(gw_pt[i]);
@@ -869,6 +982,36 @@ static void free_shared_memory(void)
 	}
 }
 
+/* Return value of a reload statistic */
+static counter_val_t lcr_stats_get(counter_handle_t h, void *what)
+{
+	if(lcr_stats == NULL)
+		return 0;
+	switch((int)(long)what) {
+		case LCR_STAT_RELOAD_US:
+			return lcr_stats->reload_us;
+		case LCR_STAT_TRIE_US:
+			return lcr_stats->trie_us;
+		case LCR_STAT_RULES:
+			return lcr_stats->rules;
+		case LCR_STAT_TRIE_NODES:
+			return lcr_stats->trie_nodes;
+		case LCR_STAT_TRIE_SIZE:
+			return lcr_stats->trie_size;
+	}
+	return 0;
+}
+
+/* Microseconds elapsed since start (monotonic clock) */
+static inline unsigned long lcr_elapsed_us(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long)((now.tv_sec - start->tv_sec) * 1000000L
+						   + (now.tv_nsec - start->tv_nsec) / 1000);
+}
+
 /*
  * Compare matched gateways based on prefix_len, priority, and randomized
  * weight.
@@ -1431,12 +1574,38 @@ static int insert_gws(db1_res_t *res, struct gw_info *gws,
 }
 
 
+/*
+ * Mark the lcr instance of a change log row
+ */
+static int lcr_log_key(db_val_t *val, void *param)
+{
+	unsigned char *ids = (unsigned char *)param;
+	int lcr_id;
+
+	if(VAL_TYPE(val) == DB1_INT) {
+		lcr_id = VAL_INT(val);
+	} else if(VAL_TYPE(val) == DB1_UINT) {
+		lcr_id = (int)VAL_UINT(val);
+	} else {
+		LM_ERR("invalid type of lcr_id in change log\n");
+		return -1;
+	}
+	if((lcr_id < 1) || (lcr_id > lcr_count_param)) {
+		LM_WARN("ignoring change of unknown lcr_id <%d>\n", lcr_id);
+		return 0;
+	}
+	ids[lcr_id] = 1;
+	return 0;
+}
+
+
 /*
  * Reload gws to unused gw table, rules to unused lcr hash table, and
  * prefix lens to a new prefix_len list.  When done, make these tables
- * and list the current ones.
+ * and list the current ones. With changes set, only the lcr instances
+ * listed in the change log since last reload are reloaded.
  */
-int reload_tables()
+static int reload_lcr_tables(int changes)
 {
 	unsigned int i, n, lcr_id, rule_id, gw_id, from_uri_len, mt_tvalue_len,
 			request_uri_len, stopper, prefix_len, enabled, gw_cnt,
@@ -1453,6 +1622,17 @@ int reload_tables()
 	pcre2_code *from_uri_re, *request_uri_re;
 	struct gw_info *gws, *gw_pt_tmp;
 	struct rule_info **rules, **rule_pt_tmp;
+	struct lcr_trie *trie_pt_tmp;
+	struct lcr_stats stats;
+	struct timespec reload_start, trie_start;
+	unsigned long trie_us;
+	unsigned char *ids = NULL;
+	db_changelog_t clog;
+	int nreloaded = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &reload_start);
+	memset(&stats, 0, sizeof(struct lcr_stats));
+	memset(&clog, 0, sizeof(db_changelog_t));
 
 	key_cols[0] = &lcr_id_col;
 	op[0] = OP_EQ;
@@ -1493,6 +1673,25 @@ int reload_tables()
 		return -1;
 	}
 
+	if(lcr_log_table.len > 0) {
+		if(changes) {
+			ids = (unsigned char *)pkg_malloc(lcr_count_param + 1);
+			if(ids == NULL) {
+				PKG_MEM_ERROR_FMT("for changed lcr ids\n");
+				goto err;
+			}
+			memset(ids, 0, lcr_count_param + 1);
+		}
+		/* changes logged from now on are applied by next reload */
+		clog = *lcr_log;
+		if(db_changelog_fetch(&lcr_dbf, dbh, &lcr_log_table, &id_col,
+				   &lcr_id_col, &clog, (ids) ? lcr_log_key : NULL, ids)
+				< 0) {
+			LM_ERR("failed to read lcr change log\n");
+			goto err;
+		}
+	}
+
 	rule_id_hash_table = pkg_malloc(
 			sizeof(struct rule_id_info *) * lcr_rule_hash_size_param);
 	if(!rule_id_hash_table) {
@@ -1504,11 +1703,17 @@ int reload_tables()
 
 	for(lcr_id = 1; lcr_id <= lcr_count_param; lcr_id++) {
 
+		if(changes && (ids == NULL || ids[lcr_id] == 0))
+			continue;
+		nreloaded++;
+
 		/* Reload rules */
 
 		rules = rule_pt[0];
 		rule_hash_table_contents_free(rules);
 		rule_id_hash_table_contents_free();
+		lcr_trie_free(trie_pt[0]);
+		trie_pt[0] = NULL;
 
 		if(lcr_dbf.use_table(dbh, &lcr_rule_table) < 0) {
 			LM_ERR("error while trying to use lcr_rule table\n");
@@ -1886,20 +2091,60 @@ int reload_tables()
 		lcr_dbf.free_result(dbh, res);
 		res = NULL;
 
+		/* Compile rule prefixes into trie */
+		clock_gettime(CLOCK_MONOTONIC, &trie_start);
+		trie_pt[0] = lcr_trie_build(rules);
+		if(trie_pt[0] == NULL) {
+			LM_ERR("failed to build rule trie of lcr_id <%u>\n", lcr_id);
+			goto err;
+		}
+		trie_us = lcr_elapsed_us(&trie_start);
+		LM_DBG("lcr_id <%u>: rule trie with <%u> nodes for <%u> rules built "
+			   "in <%lu> us\n",
+				lcr_id, trie_pt[0]->nnodes, trie_pt[0]->nrules, trie_us);
+		stats.trie_us += trie_us;
+
 		/* Swap tables */
 		rule_pt_tmp = rule_pt[lcr_id];
 		gw_pt_tmp = gw_pt[lcr_id];
+		trie_pt_tmp = trie_pt[lcr_id];
 		rule_pt[lcr_id] = rules;
 		gw_pt[lcr_id] = gws;
+		trie_pt[lcr_id] = trie_pt[0];
 		rule_pt[0] = rule_pt_tmp;
 		gw_pt[0] = gw_pt_tmp;
+		trie_pt[0] = trie_pt_tmp;
 	}
 
 	lcr_db_close();
 	rule_id_hash_table_contents_free();
 	if(rule_id_hash_table)
 		pkg_free(rule_id_hash_table);
-	return 1;
+	if(ids)
+		pkg_free(ids);
+	if(lcr_log_table.len > 0)
+		*lcr_log = clog;
+
+	if(changes && nreloaded == 0) {
+		LM_DBG("no changed lcr instances\n");
+		return 0;
+	}
+	/* totals of all instances, a reload of changes updating only some */
+	for(i = 1; i <= lcr_count_param; i++) {
+		if(trie_pt[i] == NULL)
+			continue;
+		stats.rules += trie_pt[i]->nrules;
+		stats.trie_nodes += trie_pt[i]->nnodes;
+		stats.trie_size += trie_pt[i]->size;
+	}
+	stats.reload_us = lcr_elapsed_us(&reload_start);
+	*lcr_stats = stats;
+	LM_INFO("loaded <%d> lcr instances in <%lu> us, rule tries built in "
+			"<%lu> us (all instances: <%lu> rules, <%lu> nodes, <%lu> "
+			"bytes)\n",
+			nreloaded, stats.reload_us, stats.trie_us, stats.rules,
+			stats.trie_nodes, stats.trie_size);
+	return (changes) ? nreloaded : 1;
 
 err:
 	lcr_dbf.free_result(dbh, res);
@@ -1907,10 +2152,32 @@ err:
 	rule_id_hash_table_contents_free();
 	if(rule_id_hash_table)
 		pkg_free(rule_id_hash_table);
+	if(ids)
+		pkg_free(ids);
 	return -1;
 }
 
 
+int reload_tables()
+{
+	return reload_lcr_tables(0);
+}
+
+
+/*
+ * Reload the lcr instances listed in the change log since last reload.
+ * Returns the number of reloaded instances or -1 on error.
+ */
+int reload_changed_tables()
+{
+	if(lcr_log_table.len <= 0) {
+		LM_ERR("lcr_log_table parameter is not set\n");
+		return -1;
+	}
+	return reload_lcr_tables(1);
+}
+
+
 static inline int encode_avp_value(char *value, unsigned int gw_index,
 		char *scheme, unsigned int scheme_len, unsigned int strip, char *prefix,
 		unsigned int prefix_len, char *tag, unsigned int tag_len,
@@ -2165,9 +2432,11 @@ void add_gws_into_avps(struct gw_info *gws, struct matched_gw_info *matched_gws,
 int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 		unsigned int *gw_indexes)
 {
-	int i, j, rc;
-	unsigned int gw_index, now, dex;
-	struct rule_info **rules, *rule, *pl;
+	int i, j, rc, n;
+	unsigned int gw_index, now, dex, k;
+	struct rule_info *rule;
+	struct lcr_trie *trie;
+	lcr_trie_node_t *path[LCR_TRIE_MAX_PATH];
 	struct gw_info *gws;
 	struct target *t;
 	pcre2_match_data *pcre_md = NULL;
@@ -2189,9 +2458,8 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 			ruri_user->s, from_uri->len, from_uri->s, request_uri->len,
 			request_uri->s);
 
-	rules = rule_pt[lcr_id];
+	trie = trie_pt[lcr_id];
 	gws = gw_pt[lcr_id];
-	pl = rules[lcr_rule_hash_size_param];
 	gw_index = 0;
 
 	if((from_uri->len > 0) && mt_pv_values_param) {
@@ -2203,17 +2471,10 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 
 	now = time((time_t *)NULL);
 
-	while(pl) {
-		if(ruri_user->len < pl->prefix_len) {
-			pl = pl->next;
-			continue;
-		}
-		rule = rule_hash_table_lookup(rules, pl->prefix_len, ruri_user->s);
-		while(rule) {
-
-			if((rule->prefix_len != pl->prefix_len)
-					|| strncmp(rule->prefix, ruri_user->s, pl->prefix_len))
-				goto next;
+	n = lcr_trie_match(trie, ruri_user, path);
+	while(n-- > 0) {
+		for(k = path[n]->values; k < path[n][1].values; k++) {
+			rule = trie->rules[k];
 
 			if(rule->from_uri_len != 0) {
 				pcre_md = pcre2_match_data_create_from_pattern(
@@ -2279,12 +2540,12 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 					goto skip_gw;
 				matched_gws[gw_index].gw_index = t->gw_index;
 				matched_gws[gw_index].rule_id = rule->rule_id;
-				matched_gws[gw_index].prefix_len = pl->prefix_len;
+				matched_gws[gw_index].prefix_len = rule->prefix_len;
 				matched_gws[gw_index].priority = t->priority;
 				matched_gws[gw_index].weight = t->weight * (kam_rand() >> 8);
 				matched_gws[gw_index].duplicate = 0;
 				LM_DBG("added matched_gws[%d]=[%u, %u, %u, %u]\n", gw_index,
-						t->gw_index, pl->prefix_len, t->priority,
+						t->gw_index, rule->prefix_len, t->priority,
 						matched_gws[gw_index].weight);
 				gw_index++;
 			skip_gw:
@@ -2293,10 +2554,8 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 			if(rule->stopper == 1)
 				goto done;
 
-		next:
-			rule = rule->next;
+		next:;
 		}
-		pl = pl->next;
 	}
 
 done:
@@ -2337,12 +2596,19 @@ static int ki_load_gws_furi(
 	int_str val;
 	pcre2_match_data *pcre_md = NULL;
 	struct matched_gw_info matched_gws[MAX_NO_OF_GWS + 1];
-	struct rule_info **rules, *rule, *pl;
+	struct rule_info *rule;
+	struct lcr_trie *trie;
+	lcr_trie_node_t *path[LCR_TRIE_MAX_PATH];
 	struct gw_info *gws;
 	struct target *t;
 	struct sip_uri furi;
 	struct usr_avp *avp;
 	struct search_state st;
+	struct timespec start;
+	int n;
+	unsigned int k;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
 	LM_DBG("load_gws(%u, %.*s, %.*s)\n", lcr_id, ruri_user->len,
 			ZSW(ruri_user->s), from_uri->len, ZSW(from_uri->s));
@@ -2362,7 +2628,7 @@ static int ki_load_gws_furi(
 	}
 
 	/* Use rules and gws with index lcr_id */
-	rules = rule_pt[lcr_id];
+	trie = trie_pt[lcr_id];
 	gws = gw_pt[lcr_id];
 
 	/*
@@ -2371,7 +2637,6 @@ static int ki_load_gws_furi(
      * gateway appears in the array only once.
      */
 
-	pl = rules[lcr_rule_hash_size_param];
 	gw_index = 0;
 
 	if(defunct_capability_param > 0) {
@@ -2380,18 +2645,12 @@ static int ki_load_gws_furi(
 
 	now = time((time_t *)NULL);
 
-	/* check prefixes in from longest to shortest */
-	while(pl) {
-		if(ruri_user->len < pl->prefix_len) {
-			pl = pl->next;
-			continue;
-		}
-		rule = rule_hash_table_lookup(rules, pl->prefix_len, ruri_user->s);
-		while(rule) {
-			/* Match prefix */
-			if((rule->prefix_len != pl->prefix_len)
-					|| (strncmp(rule->prefix, ruri_user->s, pl->prefix_len)))
-				goto next;
+	/* Get trie nodes with rules matching prefix, check prefixes from
+	 * longest to shortest */
+	n = lcr_trie_match(trie, ruri_user, path);
+	while(n-- > 0) {
+		for(k = path[n]->values; k < path[n][1].values; k++) {
+			rule = trie->rules[k];
 
 			/* Match from uri */
 			if(rule->from_uri_len != 0) {
@@ -2466,12 +2725,12 @@ static int ki_load_gws_furi(
 					goto skip_gw;
 				matched_gws[gw_index].gw_index = t->gw_index;
 				matched_gws[gw_index].rule_id = rule->rule_id;
-				matched_gws[gw_index].prefix_len = pl->prefix_len;
+				matched_gws[gw_index].prefix_len = rule->prefix_len;
 				matched_gws[gw_index].priority = t->priority;
 				matched_gws[gw_index].weight = t->weight * (kam_rand() >> 8);
 				matched_gws[gw_index].duplicate = 0;
 				LM_DBG("added matched_gws[%d]=[%u, %u, %u, %u]\n", gw_index,
-						t->gw_index, pl->prefix_len, t->priority,
+						t->gw_index, rule->prefix_len, t->priority,
 						matched_gws[gw_index].weight);
 				gw_index++;
 			skip_gw:
@@ -2481,10 +2740,8 @@ static int ki_load_gws_furi(
 			if(rule->stopper == 1)
 				goto done;
 
-		next:
-			rule = rule->next;
+		next:;
 		}
-		pl = pl->next;
 	}
 
 done:
@@ -2514,6 +2771,8 @@ done:
 		add_avp(lcr_id_avp_type, lcr_id_avp, val);
 	}
 
+	counter_hist_observe(&lcr_load_gws_hist, lcr_elapsed_us(&start));
+
 	if(gw_index > 0) {
 		return 1;
 	} else {
@@ -47,6 +47,25 @@ static void reload(rpc_t *rpc, void *c)
 }
 
 
+static const char *reload_changes_doc[2] = {
+		"Reload the lcr instances listed in lcr change log table.", 0};
+
+
+static void reload_changes(rpc_t *rpc, void *c)
+{
+	int n;
+
+	lock_get(reload_lock);
+	n = reload_changed_tables();
+	lock_release(reload_lock);
+	if(n < 0) {
+		rpc->fault(c, 500, "LCR Module Reload Failed");
+		return;
+	}
+	rpc->rpl_printf(c, "Reloaded %d lcr instances", n);
+}
+
+
 static const char *dump_gws_doc[2] = {"Dump the contents of lcr_gws table.", 0};
 
 
@@ -308,6 +327,7 @@ static void load_gws(rpc_t *rpc, void *c)
 /* clang-format off */
 rpc_export_t lcr_rpc[] = {
     {"lcr.reload", reload, reload_doc, 0},
+    {"lcr.reload_changes", reload_changes, reload_changes_doc, 0},
     {"lcr.dump_gws", dump_gws, dump_gws_doc, 0},
     {"lcr.dump_rules", dump_rules, dump_rules_doc, 0},
     {"lcr.defunct_gw", defunct_gw, defunct_gw_doc, 0},
@@ -0,0 +1,197 @@
+/*
+ * Prefix trie over lcr rules
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief Kamailio lcr :: Prefix trie functions
+ * \ingroup lcr
+ * Module: \ref lcr
+ *
+ * The trie is compiled from the rule hash table of an lcr instance at
+ * reload time, so that all rules whose prefix matches a given uri user
+ * are found in a single walk over the user instead of one hash table
+ * lookup and one bucket scan per distinct prefix length.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+#include "lcr_trie.h"
+
+/* Pointer to rule trie pointer table (index 0 is the temp trie) */
+struct lcr_trie **trie_pt = (struct lcr_trie **)NULL;
+
+struct trie_item
+{
+	struct rule_info *rule;
+	unsigned int seq;
+};
+
+/*
+ * Order rules by prefix (a prefix before its extensions) and keep the
+ * hash table order of the rules having the same prefix.
+ */
+static int trie_item_cmp(const void *i1, const void *i2)
+{
+	const struct trie_item *t1 = (const struct trie_item *)i1;
+	const struct trie_item *t2 = (const struct trie_item *)i2;
+	int len, ret;
+
+	len = (t1->rule->prefix_len < t2->rule->prefix_len)
+				  ? t1->rule->prefix_len
+				  : t2->rule->prefix_len;
+	ret = memcmp(t1->rule->prefix, t2->rule->prefix, len);
+	if(ret != 0)
+		return ret;
+	if(t1->rule->prefix_len != t2->rule->prefix_len)
+		return (t1->rule->prefix_len < t2->rule->prefix_len) ? -1 : 1;
+	return (t1->seq < t2->seq) ? -1 : (t1->seq > t2->seq);
+}
+
+/*
+ * Compile the rules of a hash table into a trie. Returns the trie or
+ * NULL on error.
+ */
+struct lcr_trie *lcr_trie_build(struct rule_info **hash_table)
+{
+	struct lcr_trie *trie = NULL;
+	struct trie_item *items = NULL;
+	ksr_pfxtree_key_t *keys = NULL;
+	unsigned int *refs = NULL;
+	struct rule_info *rule;
+	unsigned int i, n, nnodes;
+	unsigned long size;
+
+	n = 0;
+	for(i = 0; i < lcr_rule_hash_size_param; i++) {
+		for(rule = hash_table[i]; rule; rule = rule->next)
+			n++;
+	}
+
+	if(n > 0) {
+		items = (struct trie_item *)pkg_malloc(sizeof(struct trie_item) * n);
+		keys = (ksr_pfxtree_key_t *)pkg_malloc(sizeof(ksr_pfxtree_key_t) * n);
+		refs = (unsigned int *)pkg_malloc(sizeof(unsigned int) * n);
+		if(items == NULL || keys == NULL || refs == NULL) {
+			PKG_MEM_ERROR_FMT("for trie items\n");
+			goto error;
+		}
+		n = 0;
+		for(i = 0; i < lcr_rule_hash_size_param; i++) {
+			for(rule = hash_table[i]; rule; rule = rule->next) {
+				items[n].rule = rule;
+				items[n].seq = n;
+				n++;
+			}
+		}
+		qsort(items, n, sizeof(struct trie_item), trie_item_cmp);
+		for(i = 0; i < n; i++) {
+			keys[i].s = (unsigned char *)items[i].rule->prefix;
+			keys[i].len = items[i].rule->prefix_len;
+		}
+	}
+	nnodes = ksr_pfxtree_nodes(keys, n);
+
+	size = sizeof(struct lcr_trie) + sizeof(lcr_trie_node_t) * (nnodes + 1)
+		   + sizeof(struct rule_info *) * n;
+	trie = (struct lcr_trie *)shm_malloc(size);
+	if(trie == NULL) {
+		SHM_MEM_ERROR_FMT("for rule trie\n");
+		goto error;
+	}
+	memset(trie, 0, size);
+	trie->nnodes = nnodes;
+	trie->nrules = n;
+	trie->size = size;
+	trie->nodes = (lcr_trie_node_t *)(trie + 1);
+	trie->rules = (struct rule_info **)(trie->nodes + nnodes + 1);
+
+	if(ksr_pfxtree_fill(keys, n, trie->nodes, nnodes, refs) < 0) {
+		LM_BUG("trie node count mismatch\n");
+		goto error;
+	}
+	for(i = 0; i < n; i++)
+		trie->rules[i] = items[refs[i]].rule;
+
+	if(items) {
+		pkg_free(items);
+		pkg_free(keys);
+		pkg_free(refs);
+	}
+
+	LM_DBG("built rule trie with <%u> nodes for <%u> rules (%lu bytes)\n",
+			nnodes, n, size);
+
+	return trie;
+
+error:
+	if(items)
+		pkg_free(items);
+	if(keys)
+		pkg_free(keys);
+	if(refs)
+		pkg_free(refs);
+	if(trie)
+		shm_free(trie);
+	return NULL;
+}
+
+/*
+ * Find the trie nodes having rules whose prefix matches user. The nodes
+ * are stored into path from the shortest to the longest prefix. Returns
+ * the number of nodes found.
+ */
+int lcr_trie_match(struct lcr_trie *trie, str *user, lcr_trie_node_t **path)
+{
+	lcr_trie_node_t *node;
+	int i, n;
+
+	if(trie == NULL)
+		return 0;
+
+	n = 0;
+	node = trie->nodes;
+	if(KSR_PFXTREE_NVALUES(node))
+		path[n++] = node;
+
+	for(i = 0; i < user->len && node->nchild > 0; i++) {
+		node = ksr_pfxtree_child(
+				trie->nodes, node, (unsigned char)user->s[i]);
+		if(node == NULL)
+			break;
+		if(KSR_PFXTREE_NVALUES(node))
+			path[n++] = node;
+	}
+
+	return n;
+}
+
+/* Free a rule trie (the rules are owned by the hash table) */
+void lcr_trie_free(struct lcr_trie *trie)
+{
+	if(trie)
+		shm_free(trie);
+}
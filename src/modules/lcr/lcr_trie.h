@@ -0,0 +1,70 @@
+/*
+ * Prefix trie over lcr rules
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief Kamailio lcr :: Header file for prefix trie functions
+ * \ingroup lcr
+ * Module: \ref lcr
+ */
+
+#ifndef _LCR_TRIE_H_
+#define _LCR_TRIE_H_
+
+#include "../../core/str.h"
+#include "../../core/utils/pfxtree.h"
+#include "lcr_mod.h"
+
+/*
+ * Trie node, see pfxtree.h. The rules having exactly the prefix of the
+ * node are in range [values, values of the next node) of the trie rule
+ * array, in the order they were found in the rule hash table.
+ */
+typedef ksr_pfxtree_node_t lcr_trie_node_t;
+
+/*
+ * Trie compiled from a rule hash table, kept in a single shm block.
+ */
+struct lcr_trie
+{
+	unsigned int nnodes;
+	unsigned int nrules;
+	unsigned long size;
+	lcr_trie_node_t *nodes;
+	struct rule_info **rules;
+};
+
+/* max number of trie nodes with rules on the path of a lookup */
+#define LCR_TRIE_MAX_PATH (MAX_PREFIX_LEN + 1)
+
+extern struct lcr_trie **trie_pt;
+
+struct lcr_trie *lcr_trie_build(struct rule_info **hash_table);
+
+int lcr_trie_match(struct lcr_trie *trie, str *user,
+		lcr_trie_node_t **path);
+
+void lcr_trie_free(struct lcr_trie *trie);
+
+#endif
@@ -37,6 +37,7 @@
 #include "../../core/shm_init.h"
 
 #include "mtree.h"
+#include "mtree_compact.h"
 
 //extern str mt_char_list = {"1234567890*",11};
 extern str mt_char_list;
@@ -48,6 +49,7 @@ extern pv_spec_t pv_count;
 extern int _mt_tree_type;
 extern int _mt_ignore_duplicates;
 extern int _mt_allow_duplicates;
+extern int _mt_compact_trees;
 
 /** structures containing prefix-value pairs */
 static m_tree_t **_ptree = NULL;
@@ -199,6 +201,7 @@ int mt_add_to_tree(m_tree_t *pt, str *sp, str *svalue)
 	mt_node_t *itn, *itn0;
 	mt_is_t *tvalues;
 	unsigned char mtch;
+	unsigned char idx[MT_MAX_DEPTH];
 
 	if(pt == NULL || sp == NULL || sp->s == NULL || svalue == NULL
 			|| svalue->s == NULL) {
@@ -219,6 +222,18 @@ int mt_add_to_tree(m_tree_t *pt, str *sp, str *svalue)
 		return -1;
 	}
 
+	if(_mt_compact_trees != 0) {
+		for(l = 0; l < sp->len; l++) {
+			idx[l] = _mt_char_table[(unsigned char)sp->s[l]];
+			if(idx[l] == MT_CHAR_TABLE_NOTSET) {
+				LM_ERR("invalid char at %d in [%.*s] [%c (0x%x)]\n", l, sp->len,
+						sp->s, sp->s[l], sp->s[l]);
+				return -1;
+			}
+		}
+		return mt_ctree_add(pt, idx, sp->len, svalue);
+	}
+
 	l = 0;
 	if(pt->head == NULL) {
 		pt->head = (mt_node_t *)shm_malloc(MT_NODE_SIZE * sizeof(mt_node_t));
@@ -339,6 +354,115 @@ m_tree_t *mt_get_first_tree()
 }
 
 
+/* mapping and root node of a tree loaded from a pfxdb file */
+pfxdb_t *mt_file_root(m_tree_t *pt, pfxdb_node_t **root)
+{
+	pfxdb_t *db;
+
+	db = pfxdb_handle_get(pt->dbh);
+	if(db == NULL)
+		return NULL;
+	*root = pfxdb_root(db, pfxdb_table_get(db, &pt->tname));
+	if(*root == NULL) {
+		LM_DBG("no table [%.*s] in [%.*s]\n", pt->tname.len, pt->tname.s,
+				pt->dbfile.len, pt->dbfile.s);
+		return NULL;
+	}
+	return db;
+}
+
+/* value i of a node of a pfxdb file, valid until the next call */
+is_t *mt_file_tvalue(
+		m_tree_t *pt, pfxdb_t *db, pfxdb_node_t *node, unsigned int i)
+{
+	static is_t tvalue;
+	str val;
+
+	if(pfxdb_node_val(db, node, i, &val) < 0) {
+		LM_ERR("invalid value in [%.*s]\n", pt->dbfile.len, pt->dbfile.s);
+		return NULL;
+	}
+	if(pt->type == MT_TREE_IVAL) {
+		if(str2sint(&val, &tvalue.n) < 0) {
+			LM_ERR("invalid integer value [%.*s] in [%.*s]\n", val.len, val.s,
+					pt->dbfile.len, pt->dbfile.s);
+			return NULL;
+		}
+	} else {
+		tvalue.s = val;
+	}
+	return &tvalue;
+}
+
+static is_t *mt_file_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
+{
+	int l;
+	pfxdb_t *db;
+	pfxdb_node_t *node;
+	is_t *tvalue;
+
+	db = mt_file_root(pt, &node);
+	if(db == NULL)
+		return NULL;
+
+	l = 0;
+	tvalue = NULL;
+
+	while(node != NULL && node->nchild > 0 && l < tomatch->len
+			&& l < MT_MAX_DEPTH) {
+		/* check validity */
+		if(_mt_char_table[(unsigned char)tomatch->s[l]]
+				== MT_CHAR_TABLE_NOTSET) {
+			LM_DBG("not matching char at %d in [%.*s]\n", l, tomatch->len,
+					tomatch->s);
+			return NULL;
+		}
+
+		node = pfxdb_child(db, node, (unsigned char)tomatch->s[l]);
+		if(node != NULL && pfxdb_node_nvals(db, node) > 0) {
+			tvalue = mt_file_tvalue(pt, db, node, 0);
+		}
+		l++;
+	}
+
+	*len = l;
+
+	return tvalue;
+}
+
+static is_t *mt_ctree_get_tvalue(mt_ctree_t *ct, str *tomatch, int *len)
+{
+	int l;
+	mt_cnode_t *cn;
+	is_t *tvalue;
+
+	l = 0;
+	cn = ct->nodes;
+	tvalue = NULL;
+
+	while(cn != NULL && cn->nchild > 0 && l < tomatch->len
+			&& l < MT_MAX_DEPTH) {
+		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
+
+		/* check validity */
+		if(mtch == MT_CHAR_TABLE_NOTSET) {
+			LM_DBG("not matching char at %d in [%.*s]\n", l, tomatch->len,
+					tomatch->s);
+			return NULL;
+		}
+
+		cn = mt_ctree_child(ct, cn, mtch);
+		if(cn != NULL && MT_CNODE_NVALUES(cn) > 0) {
+			tvalue = &ct->vals[ct->refs[cn->values]];
+		}
+		l++;
+	}
+
+	*len = l;
+
+	return tvalue;
+}
+
 is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
 {
 	int l;
@@ -350,6 +474,11 @@ is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
 		return NULL;
 	}
 
+	if(pt->dbh != NULL)
+		return mt_file_get_tvalue(pt, tomatch, len);
+	if(pt->ctree != NULL)
+		return mt_ctree_get_tvalue(pt->ctree, tomatch, len);
+
 	l = 0;
 	itn = pt->head;
 	tvalue = NULL;
@@ -377,11 +506,35 @@ is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
 	return tvalue;
 }
 
+static void mt_add_tvalue_avp(m_tree_t *pt, avp_flags_t values_name_type,
+		avp_name_t values_avp_name, is_t *tvalue)
+{
+	avp_value_t val;
+
+	if(pt->type == MT_TREE_IVAL) {
+		val.n = tvalue->n;
+		LM_DBG("adding avp <%.*s> with value <i:%ld>\n", values_avp_name.s.len,
+				values_avp_name.s.s, val.n);
+		add_avp(values_name_type, values_avp_name, val);
+	} else { /* pt->type == MT_TREE_SVAL */
+		val.s = tvalue->s;
+		LM_DBG("adding avp <%.*s> with value <s:%.*s>\n",
+				values_avp_name.s.len, values_avp_name.s.s, val.s.len,
+				val.s.s);
+		add_avp(values_name_type | AVP_VAL_STR, values_avp_name, val);
+	}
+}
+
 int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 {
 	int l, n;
+	unsigned int i;
 	mt_node_t *itn;
-	avp_value_t val;
+	mt_cnode_t *cn;
+	mt_ctree_t *ct;
+	pfxdb_t *db;
+	pfxdb_node_t *node;
+	is_t *tvalue;
 	avp_name_t values_avp_name;
 	avp_flags_t values_name_type;
 	mt_is_t *tvalues;
@@ -400,6 +553,60 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 	destroy_avps(values_name_type, values_avp_name, 1);
 
 	l = n = 0;
+
+	if(pt->dbh != NULL) {
+		db = mt_file_root(pt, &node);
+		while(db != NULL && node != NULL && node->nchild > 0
+				&& l < tomatch->len && l < MT_MAX_DEPTH) {
+			/* check validity */
+			if(_mt_char_table[(unsigned char)tomatch->s[l]]
+					== MT_CHAR_TABLE_NOTSET) {
+				LM_ERR("invalid char at %d in [%.*s]\n", l, tomatch->len,
+						tomatch->s);
+				return -1;
+			}
+			node = pfxdb_child(db, node, (unsigned char)tomatch->s[l]);
+			if(node != NULL) {
+				for(i = 0; i < pfxdb_node_nvals(db, node); i++) {
+					tvalue = mt_file_tvalue(pt, db, node, i);
+					if(tvalue == NULL)
+						continue;
+					mt_add_tvalue_avp(
+							pt, values_name_type, values_avp_name, tvalue);
+					n++;
+				}
+			}
+			l++;
+		}
+		return (n > 0) ? 0 : -1;
+	}
+
+	if(pt->ctree != NULL) {
+		ct = pt->ctree;
+		cn = ct->nodes;
+		while(cn != NULL && cn->nchild > 0 && l < tomatch->len
+				&& l < MT_MAX_DEPTH) {
+			unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
+
+			/* check validity */
+			if(mtch == MT_CHAR_TABLE_NOTSET) {
+				LM_ERR("invalid char at %d in [%.*s]\n", l, tomatch->len,
+						tomatch->s);
+				return -1;
+			}
+			cn = mt_ctree_child(ct, cn, mtch);
+			if(cn != NULL) {
+				for(i = cn->values; i < cn[1].values; i++) {
+					mt_add_tvalue_avp(pt, values_name_type, values_avp_name,
+							&ct->vals[ct->refs[i]]);
+					n++;
+				}
+			}
+			l++;
+		}
+		return (n > 0) ? 0 : -1;
+	}
+
 	itn = pt->head;
 
 	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
@@ -413,18 +620,8 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 		}
 		tvalues = itn[mtch].tvalues;
 		while(tvalues != NULL) {
-			if(pt->type == MT_TREE_IVAL) {
-				val.n = tvalues->tvalue.n;
-				LM_DBG("adding avp <%.*s> with value <i:%ld>\n",
-						values_avp_name.s.len, values_avp_name.s.s, val.n);
-				add_avp(values_name_type, values_avp_name, val);
-			} else { /* pt->type == MT_TREE_SVAL */
-				val.s = tvalues->tvalue.s;
-				LM_DBG("adding avp <%.*s> with value <s:%.*s>\n",
-						values_avp_name.s.len, values_avp_name.s.s, val.s.len,
-						val.s.s);
-				add_avp(values_name_type | AVP_VAL_STR, values_avp_name, val);
-			}
+			mt_add_tvalue_avp(
+					pt, values_name_type, values_avp_name, &tvalues->tvalue);
 			n++;
 			tvalues = tvalues->next;
 		}
@@ -439,6 +636,50 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 		return -1;
 }
 
+#define MT_MAX_DST_LIST 64
+
+/* collect the dw pairs along the match path of a compact tree */
+static int mt_ctree_get_dw(
+		mt_ctree_t *ct, str *tomatch, unsigned int *tmp_list, int *len)
+{
+	int l, n;
+	unsigned int u, i;
+	mt_cnode_t *cn;
+
+	l = n = 0;
+	cn = ct->nodes;
+
+	while(cn != NULL && cn->nchild > 0 && l < tomatch->len
+			&& l < MT_MAX_DEPTH) {
+		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
+
+		/* check validity */
+		if(mtch == MT_CHAR_TABLE_NOTSET) {
+			LM_ERR("invalid char at %d in [%.*s]\n", l, tomatch->len,
+					tomatch->s);
+			return -1;
+		}
+
+		cn = mt_ctree_child(ct, cn, mtch);
+		if(cn != NULL && MT_CNODE_NVALUES(cn) > 0) {
+			u = ct->refs[cn->values];
+			for(i = ct->dwidx[u]; i < ct->dwidx[u + 1]; i++) {
+				tmp_list[2 * n] = ct->dws[i].dstid;
+				tmp_list[2 * n + 1] = ct->dws[i].weight;
+				n++;
+				if(n == MT_MAX_DST_LIST)
+					break;
+			}
+			*len = l + 1;
+		}
+		if(n == MT_MAX_DST_LIST)
+			break;
+		l++;
+	}
+
+	return n;
+}
+
 int mt_match_prefix(struct sip_msg *msg, m_tree_t *it, str *tomatch, int mode)
 {
 	int l, len, n;
@@ -504,9 +745,14 @@ int mt_match_prefix(struct sip_msg *msg, m_tree_t *it, str *tomatch, int mode)
 		return -1;
 	}
 
-	itn = it->head;
 	memset(tmp_list, 0, sizeof(unsigned int) * 2 * (MT_MAX_DST_LIST + 1));
 
+	if(it->ctree != NULL) {
+		n = mt_ctree_get_dw(it->ctree, tomatch, tmp_list, &len);
+		if(n < 0)
+			return -1;
+	}
+	itn = (it->ctree != NULL) ? NULL : it->head;
 	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
 		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
 
@@ -619,6 +865,13 @@ void mt_free_tree(m_tree_t *pt)
 
 	if(pt->head != NULL)
 		mt_free_node(pt->head, pt->type);
+	mt_ctree_reset(pt);
+	if(pt->dbh != NULL) {
+		pfxdb_handle_destroy(pt->dbh);
+		pkg_free(pt->dbh);
+	}
+	if(pt->dbfile.s != NULL)
+		shm_free(pt->dbfile.s);
 	if(pt->next != NULL)
 		mt_free_tree(pt->next);
 	if(pt->dbtable.s != NULL)
@@ -657,10 +910,67 @@ int mt_print_node(mt_node_t *pn, char *code, int len, int type)
 	return 0;
 }
 
+static int mt_print_cnode(mt_ctree_t *ct, mt_cnode_t *cn, char *code, int type)
+{
+	unsigned int i;
+	is_t *tvalue;
+
+	if(cn->depth > 0) {
+		code[cn->depth - 1] = mt_char_list.s[cn->key];
+		for(i = cn->values; i < cn[1].values; i++) {
+			tvalue = &ct->vals[ct->refs[i]];
+			if(type == MT_TREE_IVAL) {
+				LM_INFO("[%.*s] [i:%d]\n", cn->depth, code, tvalue->n);
+			} else {
+				LM_INFO("[%.*s] [s:%.*s]\n", cn->depth, code, tvalue->s.len,
+						tvalue->s.s);
+			}
+		}
+	}
+	for(i = 0; i < cn->nchild; i++)
+		mt_print_cnode(ct, &ct->nodes[cn->child + i], code, type);
+
+	return 0;
+}
+
+static int mt_print_fnode(m_tree_t *pt, pfxdb_t *db, pfxdb_node_t *node,
+		char *code)
+{
+	unsigned int i;
+	is_t *tvalue;
+	pfxdb_node_t *child;
+
+	if(node->depth > 0) {
+		code[node->depth - 1] = (char)node->key;
+		for(i = 0; i < pfxdb_node_nvals(db, node); i++) {
+			tvalue = mt_file_tvalue(pt, db, node, i);
+			if(tvalue == NULL)
+				continue;
+			if(pt->type == MT_TREE_IVAL) {
+				LM_INFO("[%.*s] [i:%d]\n", node->depth, code, tvalue->n);
+			} else {
+				LM_INFO("[%.*s] [s:%.*s]\n", node->depth, code,
+						tvalue->s.len, tvalue->s.s);
+			}
+		}
+	}
+	if(node->depth >= MT_MAX_DEPTH || !pfxdb_children_ok(db, node))
+		return 0;
+	for(i = 0; i < node->nchild; i++) {
+		child = &db->nodes[node->child + i];
+		if(child->depth == node->depth + 1)
+			mt_print_fnode(pt, db, child, code);
+	}
+
+	return 0;
+}
+
 static char mt_code_buf[MT_MAX_DEPTH + 1];
 int mt_print_tree(m_tree_t *pt)
 {
 	int len;
+	pfxdb_t *db;
+	pfxdb_node_t *node;
 
 	if(pt == NULL) {
 		LM_DBG("tree is empty\n");
@@ -669,7 +979,14 @@ int mt_print_tree(m_tree_t *pt)
 
 	LM_INFO("[%.*s]\n", pt->tname.len, pt->tname.s);
 	len = 0;
-	mt_print_node(pt->head, mt_code_buf, len, pt->type);
+	if(pt->dbh != NULL) {
+		db = mt_file_root(pt, &node);
+		if(db != NULL)
+			mt_print_fnode(pt, db, node, mt_code_buf);
+	} else if(pt->ctree != NULL)
+		mt_print_cnode(pt->ctree, pt->ctree->nodes, mt_code_buf, pt->type);
+	else
+		mt_print_node(pt->head, mt_code_buf, len, pt->type);
 	return mt_print_tree(pt->next);
 }
 
@@ -777,6 +1094,9 @@ int mt_table_spec(char *val)
 				  && strncasecmp(pit->name.s, "cols", 4) == 0) {
 			tmp.ncols = 1;
 			tmp.scols[0] = pit->body;
+		} else if(pit->name.len == 6
+				  && strncasecmp(pit->name.s, "dbfile", 6) == 0) {
+			tmp.dbfile = pit->body;
 		}
 	}
 	if(tmp.tname.s == NULL) {
@@ -796,6 +1116,10 @@ int mt_table_spec(char *val)
 		LM_ERR("unknown multi value <%d>\n", tmp.multi);
 		goto error;
 	}
+	if(tmp.dbfile.len > 0 && tmp.type == MT_TREE_DW) {
+		LM_ERR("dbfile not supported for tree type <%d>\n", tmp.type);
+		goto error;
+	}
 
 	/* check for same tree */
 	if(_ptree == 0) {
@@ -830,6 +1154,17 @@ int mt_table_spec(char *val)
 			LM_ERR("cannot init the tree [%.*s]\n", tmp.tname.len, tmp.tname.s);
 			goto error;
 		}
+		if(tmp.dbfile.len > 0) {
+			ndl->dbfile.s = (char *)shm_malloc(tmp.dbfile.len + 1);
+			if(ndl->dbfile.s == NULL) {
+				SHM_MEM_ERROR;
+				mt_free_tree(ndl);
+				goto error;
+			}
+			memcpy(ndl->dbfile.s, tmp.dbfile.s, tmp.dbfile.len);
+			ndl->dbfile.s[tmp.dbfile.len] = '\0';
+			ndl->dbfile.len = tmp.dbfile.len;
+		}
 
 		ndl->next = it;
 
@@ -906,10 +1241,41 @@ int mt_defined_trees(void)
 	return 0;
 }
 
+static int mt_rpc_add_tvalue(rpc_t *rpc, void *ctx, m_tree_t *pt,
+		str *prefix, is_t *tvalue, void **vstruct)
+{
+	if(rpc->add(ctx, "{", vstruct) < 0) {
+		rpc->fault(ctx, 500, "Internal error adding struct");
+		return -1;
+	}
+	if(rpc->struct_add(*vstruct, "S", "PREFIX", prefix) < 0) {
+		rpc->fault(ctx, 500, "Internal error adding prefix");
+		return -1;
+	}
+	if(pt->type == MT_TREE_IVAL) {
+		if(rpc->struct_add(*vstruct, "d", "TVALUE", tvalue->n) < 0) {
+			rpc->fault(ctx, 500, "Internal error adding tvalue");
+			return -1;
+		}
+	} else { /* pt->type == MT_TREE_SVAL */
+		if(rpc->struct_add(*vstruct, "S", "TVALUE", &tvalue->s) < 0) {
+			rpc->fault(ctx, 500, "Internal error adding tvalue");
+			return -1;
+		}
+	}
+	return 0;
+}
+
 int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 {
 	int l;
+	unsigned int i;
 	mt_node_t *itn;
+	mt_cnode_t *cn;
+	mt_ctree_t *ct;
+	pfxdb_t *db;
+	pfxdb_node_t *node;
+	is_t *tvalue;
 	mt_is_t *tvalues;
 	void *vstruct = NULL;
 	str prefix = STR_NULL;
@@ -921,6 +1287,64 @@ int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 	prefix = *tomatch;
 
 	l = 0;
+
+	if(pt->dbh != NULL) {
+		db = mt_file_root(pt, &node);
+		while(db != NULL && node != NULL && node->nchild > 0
+				&& l < tomatch->len && l < MT_MAX_DEPTH) {
+			/* check validity */
+			if(_mt_char_table[(unsigned char)tomatch->s[l]]
+					== MT_CHAR_TABLE_NOTSET) {
+				LM_ERR("invalid char at %d in [%.*s]\n", l, tomatch->len,
+						tomatch->s);
+				return -1;
+			}
+			node = pfxdb_child(db, node, (unsigned char)tomatch->s[l]);
+			if(node != NULL) {
+				prefix.len = l + 1;
+				for(i = 0; i < pfxdb_node_nvals(db, node); i++) {
+					tvalue = mt_file_tvalue(pt, db, node, i);
+					if(tvalue == NULL)
+						continue;
+					if(mt_rpc_add_tvalue(
+							   rpc, ctx, pt, &prefix, tvalue, &vstruct)
+							< 0)
+						return -1;
+				}
+			}
+			l++;
+		}
+		return (vstruct != NULL) ? 0 : -1;
+	}
+
+	if(pt->ctree != NULL) {
+		ct = pt->ctree;
+		cn = ct->nodes;
+		while(cn != NULL && cn->nchild > 0 && l < tomatch->len
+				&& l < MT_MAX_DEPTH) {
+			unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
+
+			/* check validity */
+			if(mtch == MT_CHAR_TABLE_NOTSET) {
+				LM_ERR("invalid char at %d in [%.*s]\n", l, tomatch->len,
+						tomatch->s);
+				return -1;
+			}
+			cn = mt_ctree_child(ct, cn, mtch);
+			if(cn != NULL) {
+				prefix.len = l + 1;
+				for(i = cn->values; i < cn[1].values; i++) {
+					if(mt_rpc_add_tvalue(rpc, ctx, pt, &prefix,
+							   &ct->vals[ct->refs[i]], &vstruct)
+							< 0)
+						return -1;
+				}
+			}
+			l++;
+		}
+		return (vstruct != NULL) ? 0 : -1;
+	}
+
 	itn = pt->head;
 
 	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
@@ -935,27 +1359,10 @@ int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 		tvalues = itn[mtch].tvalues;
 		while(tvalues != NULL) {
 			prefix.len = l + 1;
-			if(rpc->add(ctx, "{", &vstruct) < 0) {
-				rpc->fault(ctx, 500, "Internal error adding struct");
-				return -1;
-			}
-			if(rpc->struct_add(vstruct, "S", "PREFIX", &prefix) < 0) {
-				rpc->fault(ctx, 500, "Internal error adding prefix");
+			if(mt_rpc_add_tvalue(
+					   rpc, ctx, pt, &prefix, &tvalues->tvalue, &vstruct)
+					< 0)
 				return -1;
-			}
-			if(pt->type == MT_TREE_IVAL) {
-				if(rpc->struct_add(vstruct, "d", "TVALUE", tvalues->tvalue.n)
-						< 0) {
-					rpc->fault(ctx, 500, "Internal error adding tvalue");
-					return -1;
-				}
-			} else { /* pt->type == MT_TREE_SVAL */
-				if(rpc->struct_add(vstruct, "S", "TVALUE", &tvalues->tvalue.s)
-						< 0) {
-					rpc->fault(ctx, 500, "Internal error adding tvalue");
-					return -1;
-				}
-			}
 			tvalues = tvalues->next;
 		}
 
@@ -1033,9 +1440,14 @@ int mt_rpc_match_prefix(
 	if(it->type != MT_TREE_DW)
 		return -1; /* wrong tree type */
 
-	itn = it->head;
 	memset(tmp_list, 0, sizeof(unsigned int) * 2 * (MT_MAX_DST_LIST + 1));
 
+	if(it->ctree != NULL) {
+		n = mt_ctree_get_dw(it->ctree, tomatch, tmp_list, &len);
+		if(n < 0)
+			return -1;
+	}
+	itn = (it->ctree != NULL) ? NULL : it->head;
 	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
 		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
 
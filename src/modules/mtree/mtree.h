@@ -30,6 +30,7 @@
 #include "../../core/str.h"
 #include "../../core/parser/msg_parser.h"
 #include "../../core/rpc.h"
+#include "../../core/utils/pfxdb.h"
 
 #define MT_TREE_SVAL 0
 #define MT_TREE_DW 1
@@ -65,6 +66,8 @@ typedef struct _mt_node
 
 #define MT_NODE_SIZE mt_char_list.len
 
+struct _mt_ctree;
+
 #define MT_MAX_COLS 8
 typedef struct _m_tree
 {
@@ -81,6 +84,10 @@ typedef struct _m_tree
 	unsigned int reload_count;
 	uint64_t reload_time;
 	mt_node_t *head;
+	struct _mt_ctree *ctree; /* compact form, used instead of head */
+	void *cload;			 /* records staged for the compact form */
+	str dbfile;				 /* pfxdb file used instead of the database */
+	pfxdb_handle_t *dbh;	 /* mapping of dbfile, in pkg of each process */
 	struct _m_tree *next;
 } m_tree_t;
 
@@ -92,6 +99,9 @@ m_tree_t *mt_get_tree(str *tname);
 m_tree_t *mt_get_first_tree();
 
 is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len);
+pfxdb_t *mt_file_root(m_tree_t *pt, pfxdb_node_t **root);
+is_t *mt_file_tvalue(
+		m_tree_t *pt, pfxdb_t *db, pfxdb_node_t *node, unsigned int i);
 int mt_match_prefix(struct sip_msg *msg, m_tree_t *pt, str *tomatch, int mode);
 
 m_tree_t *mt_init_tree(
@@ -0,0 +1,486 @@
+/*
+ * Compact representation of mtree prefix trees
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * The records of a tree are staged in large shm blocks while the tree is
+ * loaded and compiled at the end of the load into one shm block holding
+ * only the prefixes that exist, so the memory used no longer depends on
+ * the size of char_list. Equal values are stored once.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/parser/parse_param.h"
+#include "../../core/hashes.h"
+#include "../../core/ut.h"
+
+#include "mtree_compact.h"
+
+extern str mt_char_list;
+extern int _mt_ignore_duplicates;
+extern int _mt_allow_duplicates;
+
+/* staged record: plen prefix char indexes followed by the value */
+typedef struct _mt_crec
+{
+	unsigned int seq;
+	unsigned short vlen;
+	unsigned char plen;
+	unsigned char pad;
+	unsigned char data[];
+} mt_crec_t;
+
+#define MT_CREC_PREFIX(r) ((r)->data)
+#define MT_CREC_VALUE(r) ((char *)(r)->data + (r)->plen)
+#define MT_CREC_SIZE(plen, vlen) \
+	((sizeof(mt_crec_t) + (plen) + (vlen) + 1 + 7) & ~7UL)
+
+#define MT_CBLOCK_SIZE (1024 * 1024)
+
+typedef struct _mt_cblock
+{
+	struct _mt_cblock *next;
+	unsigned long used;
+	char data[];
+} mt_cblock_t;
+
+typedef struct _mt_cload
+{
+	mt_cblock_t *first;
+	mt_cblock_t *last;
+	unsigned int nrecs;
+} mt_cload_t;
+
+/**
+ * stage a record for the compact form of the tree
+ * - idx holds the indexes in char_list of the prefix chars
+ */
+int mt_ctree_add(m_tree_t *pt, unsigned char *idx, int len, str *svalue)
+{
+	mt_cload_t *cl;
+	mt_cblock_t *cb;
+	mt_crec_t *rec;
+	unsigned long rsize;
+
+	if(svalue->len > 65535) {
+		LM_ERR("too large value [%.*s...] (%d)\n", 16, svalue->s, svalue->len);
+		return -1;
+	}
+	rsize = MT_CREC_SIZE(len, svalue->len);
+
+	cl = (mt_cload_t *)pt->cload;
+	if(cl == NULL) {
+		cl = (mt_cload_t *)shm_malloc(sizeof(mt_cload_t));
+		if(cl == NULL) {
+			SHM_MEM_ERROR_FMT("for tree records\n");
+			return -1;
+		}
+		memset(cl, 0, sizeof(mt_cload_t));
+		pt->cload = cl;
+	}
+	cb = cl->last;
+	if(cb == NULL || cb->used + rsize > MT_CBLOCK_SIZE) {
+		cb = (mt_cblock_t *)shm_malloc(sizeof(mt_cblock_t) + MT_CBLOCK_SIZE);
+		if(cb == NULL) {
+			SHM_MEM_ERROR_FMT("for tree records block\n");
+			return -1;
+		}
+		cb->next = NULL;
+		cb->used = 0;
+		if(cl->last)
+			cl->last->next = cb;
+		else
+			cl->first = cb;
+		cl->last = cb;
+	}
+	rec = (mt_crec_t *)(cb->data + cb->used);
+	rec->seq = cl->nrecs;
+	rec->plen = (unsigned char)len;
+	rec->vlen = (unsigned short)svalue->len;
+	rec->pad = 0;
+	memcpy(MT_CREC_PREFIX(rec), idx, len);
+	memcpy(MT_CREC_VALUE(rec), svalue->s, svalue->len);
+	MT_CREC_VALUE(rec)[svalue->len] = '\0';
+	cb->used += rsize;
+	cl->nrecs++;
+	return 0;
+}
+
+static void mt_cload_free(mt_cload_t *cl)
+{
+	mt_cblock_t *cb, *next;
+
+	if(cl == NULL)
+		return;
+	for(cb = cl->first; cb; cb = next) {
+		next = cb->next;
+		shm_free(cb);
+	}
+	shm_free(cl);
+}
+
+/**
+ * free a compact tree
+ */
+void mt_ctree_free(mt_ctree_t *ct)
+{
+	if(ct != NULL)
+		shm_free(ct);
+}
+
+/**
+ * free the compact form and the staged records of a tree
+ */
+void mt_ctree_reset(m_tree_t *pt)
+{
+	if(pt->ctree != NULL) {
+		mt_ctree_free(pt->ctree);
+		pt->ctree = NULL;
+	}
+	if(pt->cload != NULL) {
+		mt_cload_free((mt_cload_t *)pt->cload);
+		pt->cload = NULL;
+	}
+}
+
+/*
+ * Order records by prefix (a prefix before its extensions, chars in the
+ * order of char_list) and keep the load order of equal prefixes.
+ */
+static int mt_crec_cmp(const void *v1, const void *v2)
+{
+	const mt_crec_t *r1 = *(const mt_crec_t **)v1;
+	const mt_crec_t *r2 = *(const mt_crec_t **)v2;
+	int ret;
+
+	ret = memcmp(MT_CREC_PREFIX(r1), MT_CREC_PREFIX(r2),
+			(r1->plen < r2->plen) ? r1->plen : r2->plen);
+	if(ret != 0)
+		return ret;
+	if(r1->plen != r2->plen)
+		return (r1->plen < r2->plen) ? -1 : 1;
+	return (r1->seq < r2->seq) ? -1 : (r1->seq > r2->seq);
+}
+
+static char *mt_crec_prefix_str(mt_crec_t *rec)
+{
+	static char buf[MT_MAX_DEPTH + 1];
+	int i;
+
+	for(i = 0; i < rec->plen; i++)
+		buf[i] = mt_char_list.s[MT_CREC_PREFIX(rec)[i]];
+	buf[i] = '\0';
+	return buf;
+}
+
+/*
+ * Parse the destinations of a dw value into dws (if not NULL), in the
+ * same order as the pointer tree keeps them. Returns their number.
+ */
+static int mt_ctree_parse_dw(mt_crec_t *rec, mt_cdw_t *dws)
+{
+	param_t *list = NULL;
+	param_t *it;
+	param_hooks_t hooks;
+	str s;
+	int n, i;
+
+	s.s = MT_CREC_VALUE(rec);
+	s.len = rec->vlen;
+	if(s.len > 0 && s.s[s.len - 1] == ';')
+		s.len--;
+	if(parse_params(&s, CLASS_ANY, &hooks, &list) < 0) {
+		LM_ERR("cannot parse tvalue payload [%.*s]\n", s.len, s.s);
+		return 0;
+	}
+	n = 0;
+	for(it = list; it; it = it->next)
+		n++;
+	if(dws != NULL) {
+		i = n;
+		for(it = list; it; it = it->next) {
+			i--;
+			str2int(&it->name, &dws[i].dstid);
+			str2int(&it->body, &dws[i].weight);
+		}
+	}
+	free_params(list);
+	return n;
+}
+
+/**
+ * compile the staged records of a tree into its compact form
+ */
+int mt_ctree_build(m_tree_t *pt)
+{
+	mt_cload_t *cl;
+	mt_cblock_t *cb;
+	mt_crec_t *rec;
+	mt_crec_t **recs = NULL;
+	mt_crec_t **uniq = NULL;
+	unsigned int *vid = NULL;
+	unsigned int *hnext = NULL;
+	unsigned int *htable = NULL;
+	ksr_pfxtree_key_t *keys = NULL;
+	mt_ctree_t *ct = NULL;
+	unsigned long off, size, strsize, tsize;
+	unsigned int i, j, k, m, n, hsize, h, u, nvals, ndws, nnodes;
+	unsigned int nrefs, narrays;
+	char *p;
+	str sv;
+	int ival;
+
+	cl = (mt_cload_t *)pt->cload;
+	if(cl == NULL || cl->nrecs == 0) {
+		mt_ctree_reset(pt);
+		return 0;
+	}
+	n = cl->nrecs;
+
+	recs = (mt_crec_t **)shm_malloc(n * sizeof(mt_crec_t *));
+	if(recs == NULL) {
+		SHM_MEM_ERROR_FMT("for tree records index\n");
+		goto error;
+	}
+	i = 0;
+	for(cb = cl->first; cb; cb = cb->next) {
+		for(off = 0; off < cb->used;
+				off += MT_CREC_SIZE(rec->plen, rec->vlen)) {
+			rec = (mt_crec_t *)(cb->data + off);
+			recs[i++] = rec;
+		}
+	}
+	qsort(recs, n, sizeof(mt_crec_t *), mt_crec_cmp);
+
+	/* same prefix more than once - same handling as for the pointer tree,
+	 * the values of a prefix being kept from the last to the first loaded */
+	m = 0;
+	for(i = 0; i < n; i = j) {
+		for(j = i + 1; j < n && recs[j]->plen == recs[i]->plen
+					   && memcmp(MT_CREC_PREFIX(recs[i]), MT_CREC_PREFIX(recs[j]),
+								  recs[i]->plen)
+								  == 0;
+				j++)
+			;
+		if(j - i > 1) {
+			if(_mt_ignore_duplicates != 0) {
+				for(k = i + 1; k < j; k++) {
+					LM_NOTICE("prefix already allocated [%s/%.*s]\n",
+							mt_crec_prefix_str(recs[k]), recs[k]->vlen,
+							MT_CREC_VALUE(recs[k]));
+				}
+				recs[m++] = recs[i];
+				continue;
+			} else if(_mt_allow_duplicates == 0) {
+				LM_ERR("prefix already allocated [%s/%.*s]\n",
+						mt_crec_prefix_str(recs[i + 1]), recs[i + 1]->vlen,
+						MT_CREC_VALUE(recs[i + 1]));
+				goto error;
+			}
+			for(k = 0; k < (j - i) / 2; k++) {
+				rec = recs[i + k];
+				recs[i + k] = recs[j - 1 - k];
+				recs[j - 1 - k] = rec;
+			}
+		}
+		for(k = i; k < j; k++)
+			recs[m++] = recs[k];
+	}
+	nrefs = m;
+
+	/* store equal values once */
+	for(hsize = 16; hsize < nrefs; hsize <<= 1)
+		;
+	vid = (unsigned int *)shm_malloc(
+			(2 * nrefs + hsize) * sizeof(unsigned int));
+	uniq = (mt_crec_t **)shm_malloc(nrefs * sizeof(mt_crec_t *));
+	if(vid == NULL || uniq == NULL) {
+		SHM_MEM_ERROR_FMT("for tree values index\n");
+		goto error;
+	}
+	hnext = vid + nrefs;
+	htable = hnext + nrefs;
+	memset(htable, 0, hsize * sizeof(unsigned int));
+	nvals = 0;
+	strsize = 0;
+	ndws = 0;
+	tsize = 0;
+	for(i = 0; i < nrefs; i++) {
+		rec = recs[i];
+		h = get_hash1_raw(MT_CREC_VALUE(rec), rec->vlen) & (hsize - 1);
+		for(u = htable[h]; u != 0; u = hnext[u - 1]) {
+			if(uniq[u - 1]->vlen == rec->vlen
+					&& memcmp(MT_CREC_VALUE(uniq[u - 1]), MT_CREC_VALUE(rec),
+							   rec->vlen)
+							   == 0)
+				break;
+		}
+		if(u == 0) {
+			if(pt->type == MT_TREE_IVAL) {
+				sv.s = MT_CREC_VALUE(rec);
+				sv.len = rec->vlen;
+				if(str2sint(&sv, &ival) != 0) {
+					LM_ERR("bad integer string <%.*s>\n", sv.len, sv.s);
+					goto error;
+				}
+			} else {
+				strsize += rec->vlen + 1;
+			}
+			if(pt->type == MT_TREE_DW)
+				ndws += mt_ctree_parse_dw(rec, NULL);
+			uniq[nvals] = rec;
+			hnext[nvals] = htable[h];
+			htable[h] = nvals + 1;
+			nvals++;
+			u = nvals;
+		}
+		vid[i] = u - 1;
+		if(pt->type != MT_TREE_IVAL)
+			tsize += rec->vlen + 1;
+	}
+
+	keys = (ksr_pfxtree_key_t *)shm_malloc(
+			(nrefs + 1) * sizeof(ksr_pfxtree_key_t));
+	if(keys == NULL) {
+		SHM_MEM_ERROR_FMT("for tree keys\n");
+		goto error;
+	}
+	for(i = 0; i < nrefs; i++) {
+		keys[i].s = MT_CREC_PREFIX(recs[i]);
+		keys[i].len = recs[i]->plen;
+	}
+	nnodes = ksr_pfxtree_nodes(keys, nrefs);
+
+	size = sizeof(mt_ctree_t) + nvals * sizeof(is_t)
+		   + (nnodes + 1) * sizeof(mt_cnode_t) + nrefs * sizeof(unsigned int)
+		   + strsize;
+	if(pt->type == MT_TREE_DW)
+		size += (nvals + 1) * sizeof(unsigned int) + ndws * sizeof(mt_cdw_t);
+	ct = (mt_ctree_t *)shm_malloc(size);
+	if(ct == NULL) {
+		SHM_MEM_ERROR_FMT("for compact tree (%lu bytes)\n", size);
+		goto error;
+	}
+	memset(ct, 0, size);
+	ct->nnodes = nnodes;
+	ct->nrefs = nrefs;
+	ct->nvals = nvals;
+	ct->ndws = ndws;
+	ct->strsize = strsize;
+	ct->size = size;
+	ct->vals = (is_t *)(ct + 1);
+	ct->nodes = (mt_cnode_t *)(ct->vals + nvals);
+	ct->refs = (unsigned int *)(ct->nodes + nnodes + 1);
+	p = (char *)(ct->refs + nrefs);
+	if(pt->type == MT_TREE_DW) {
+		ct->dwidx = (unsigned int *)p;
+		ct->dws = (mt_cdw_t *)(ct->dwidx + nvals + 1);
+		p = (char *)(ct->dws + ndws);
+	}
+
+	/* values */
+	k = 0;
+	for(u = 0; u < nvals; u++) {
+		rec = uniq[u];
+		if(pt->type == MT_TREE_IVAL) {
+			sv.s = MT_CREC_VALUE(rec);
+			sv.len = rec->vlen;
+			str2sint(&sv, &ct->vals[u].n);
+			continue;
+		}
+		memcpy(p, MT_CREC_VALUE(rec), rec->vlen + 1);
+		ct->vals[u].s.s = p;
+		ct->vals[u].s.len = rec->vlen;
+		p += rec->vlen + 1;
+		if(pt->type == MT_TREE_DW) {
+			ct->dwidx[u] = k;
+			k += mt_ctree_parse_dw(rec, ct->dws + k);
+		}
+	}
+	if(pt->type == MT_TREE_DW)
+		ct->dwidx[nvals] = k;
+
+	if(ksr_pfxtree_fill(keys, nrefs, ct->nodes, nnodes, ct->refs) < 0) {
+		LM_BUG("compact tree node count mismatch\n");
+		goto error;
+	}
+	shm_free(keys);
+	keys = NULL;
+	narrays = 0;
+	for(i = 0; i < nnodes; i++) {
+		if(ct->nodes[i].nchild > 0)
+			narrays++;
+	}
+	for(i = 0; i < nrefs; i++)
+		ct->refs[i] = vid[ct->refs[i]];
+
+	/* same data in the pointer tree, for comparison */
+	ct->tree_size = narrays * MT_NODE_SIZE * sizeof(mt_node_t)
+					+ nrefs * sizeof(mt_is_t) + tsize;
+	if(pt->type == MT_TREE_DW) {
+		for(i = 0; i < nnodes; i++) {
+			if(MT_CNODE_NVALUES(&ct->nodes[i]) > 0) {
+				u = ct->refs[ct->nodes[i].values];
+				ct->tree_size += (ct->dwidx[u + 1] - ct->dwidx[u])
+								 * sizeof(mt_dw_t);
+			}
+		}
+	}
+
+	shm_free(vid);
+	shm_free(uniq);
+	shm_free(recs);
+	mt_cload_free(cl);
+	pt->cload = NULL;
+
+	pt->ctree = ct;
+	pt->nrnodes = nnodes;
+	pt->nritems = (pt->type == MT_TREE_IVAL) ? 0 : nrefs;
+	pt->memsize = size;
+
+	LM_INFO("compact tree [%.*s]: %u nodes, %u values (%u distinct),"
+			" %lu bytes (%lu as pointer tree)\n",
+			pt->tname.len, pt->tname.s, nnodes, nrefs, nvals, size,
+			ct->tree_size);
+
+	return 0;
+
+error:
+	if(keys)
+		shm_free(keys);
+	if(ct)
+		mt_ctree_free(ct);
+	if(vid)
+		shm_free(vid);
+	if(uniq)
+		shm_free(uniq);
+	if(recs)
+		shm_free(recs);
+	mt_ctree_reset(pt);
+	return -1;
+}
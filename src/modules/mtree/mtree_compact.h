@@ -0,0 +1,79 @@
+/*
+ * Compact representation of mtree prefix trees
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#ifndef _MTREE_COMPACT_H_
+#define _MTREE_COMPACT_H_
+
+#include "../../core/utils/pfxtree.h"
+#include "mtree.h"
+
+/*
+ * Node of a compact tree, one per distinct prefix, see pfxtree.h. The keys
+ * of the nodes are the indexes of their char in char_list.
+ */
+typedef ksr_pfxtree_node_t mt_cnode_t;
+
+typedef struct _mt_cdw
+{
+	unsigned int dstid;
+	unsigned int weight;
+} mt_cdw_t;
+
+/*
+ * Compact tree, kept in a single shm block. Node 0 is the root (empty
+ * prefix). Refs are indexes in the array of distinct values; for dw trees
+ * the destinations of value i are in range [dwidx[i], dwidx[i+1]) of dws.
+ */
+typedef struct _mt_ctree
+{
+	unsigned int nnodes;
+	unsigned int nrefs;
+	unsigned int nvals;
+	unsigned int ndws;
+	unsigned long strsize;
+	unsigned long size;
+	unsigned long tree_size;
+	is_t *vals;
+	mt_cnode_t *nodes;
+	unsigned int *refs;
+	unsigned int *dwidx;
+	mt_cdw_t *dws;
+} mt_ctree_t;
+
+#define MT_CNODE_NVALUES(cn) KSR_PFXTREE_NVALUES(cn)
+
+/* child of node for the char with index key, NULL if not found */
+static inline mt_cnode_t *mt_ctree_child(
+		mt_ctree_t *ct, mt_cnode_t *node, unsigned char key)
+{
+	return ksr_pfxtree_child(ct->nodes, node, key);
+}
+
+int mt_ctree_add(m_tree_t *pt, unsigned char *idx, int len, str *svalue);
+int mt_ctree_build(m_tree_t *pt);
+void mt_ctree_free(mt_ctree_t *ct);
+void mt_ctree_reset(m_tree_t *pt);
+
+#endif
@@ -44,6 +44,7 @@
 #include "../../core/kemi.h"
 
 #include "mtree.h"
+#include "mtree_compact.h"
 #include "api.h"
 
 MODULE_VERSION
@@ -100,6 +101,10 @@ pv_spec_t pv_count;
 int _mt_tree_type = MT_TREE_SVAL;
 int _mt_ignore_duplicates = 0;
 int _mt_allow_duplicates = 0;
+int _mt_compact_trees = 0;
+
+/* set when some tree is loaded from the database and not from a file */
+static int mt_use_db = 1;
 
 /* lock, ref counter and flag used for reloading the date */
 static gen_lock_t *mt_lock = 0;
@@ -121,6 +126,7 @@ static int mt_match(sip_msg_t *msg, str *tname, str *tomatch, int mval);
 
 static int mt_load_db(m_tree_t *pt);
 static int mt_load_db_trees();
+static int mt_load_dbfile(m_tree_t *pt);
 
 /* clang-format off */
 static cmd_export_t cmds[] = {
@@ -148,6 +154,7 @@ static param_export_t params[] = {
 	{"mt_tree_type", PARAM_INT, &_mt_tree_type},
 	{"mt_ignore_duplicates", PARAM_INT, &_mt_ignore_duplicates},
 	{"mt_allow_duplicates", PARAM_INT, &_mt_allow_duplicates},
+	{"compact_trees", PARAM_INT, &_mt_compact_trees},
 	{0, 0, 0}
 };
 
@@ -214,26 +221,38 @@ static int mod_init(void)
 	LM_DBG("mt_char_list=%s \n", mt_char_list.s);
 	mt_char_table_init();
 
-	/* binding to database module */
-	if(db_bind_mod(&db_url, &mt_dbf)) {
-		LM_ERR("database module not found\n");
-		return -1;
+	if(mt_defined_trees()) {
+		mt_use_db = 0;
+		for(pt = mt_get_first_tree(); pt != NULL; pt = pt->next) {
+			if(pt->dbfile.s == NULL) {
+				mt_use_db = 1;
+				break;
+			}
+		}
 	}
 
-	if(!DB_CAPABILITY(mt_dbf, DB_CAP_ALL)) {
-		LM_ERR("database module does not "
-			   "implement all functions needed by the module\n");
-		return -1;
-	}
+	if(mt_use_db) {
+		/* binding to database module */
+		if(db_bind_mod(&db_url, &mt_dbf)) {
+			LM_ERR("database module not found\n");
+			return -1;
+		}
 
-	/* open a connection with the database */
-	db_con = mt_dbf.init(&db_url);
-	if(db_con == NULL) {
-		LM_ERR("failed to connect to the database\n");
-		return -1;
-	}
+		if(!DB_CAPABILITY(mt_dbf, DB_CAP_ALL)) {
+			LM_ERR("database module does not "
+				   "implement all functions needed by the module\n");
+			return -1;
+		}
 
-	LM_DBG("database connection opened successfully\n");
+		/* open a connection with the database */
+		db_con = mt_dbf.init(&db_url);
+		if(db_con == NULL) {
+			LM_ERR("failed to connect to the database\n");
+			return -1;
+		}
+
+		LM_DBG("database connection opened successfully\n");
+	}
 
 	if((mt_lock = lock_alloc()) == 0) {
 		LM_CRIT("failed to alloc lock\n");
@@ -277,7 +296,8 @@ static int mod_init(void)
 			goto error1;
 		}
 	}
-	mt_dbf.close(db_con);
+	if(db_con != NULL)
+		mt_dbf.close(db_con);
 	db_con = 0;
 
 #if 0
@@ -309,6 +329,9 @@ static int child_init(int rank)
 	if(rank == PROC_INIT || rank == PROC_MAIN || rank == PROC_TCP_MAIN)
 		return 0;
 
+	if(mt_use_db == 0)
+		return 0;
+
 	db_con = mt_dbf.init(&db_url);
 	if(db_con == NULL) {
 		LM_ERR("failed to connect to database\n");
@@ -499,6 +522,7 @@ static int mt_load_db(m_tree_t *pt)
 	m_tree_t new_tree;
 	m_tree_t *old_tree = NULL;
 	mt_node_t *bk_head = NULL;
+	mt_ctree_t *bk_ctree = NULL;
 
 	if(pt->ncols > 0) {
 		for(c = 0; c < pt->ncols; c++) {
@@ -514,6 +538,9 @@ static int mt_load_db(m_tree_t *pt)
 	VAL_NULL(vals) = 0;
 	VAL_STRING(vals) = pt->tname.s;
 
+	if(pt->dbfile.s != NULL)
+		return mt_load_dbfile(pt);
+
 	if(db_con == NULL) {
 		LM_ERR("no db connection\n");
 		return -1;
@@ -527,6 +554,8 @@ static int mt_load_db(m_tree_t *pt)
 	}
 	memcpy(&new_tree, old_tree, sizeof(m_tree_t));
 	new_tree.head = 0;
+	new_tree.ctree = 0;
+	new_tree.cload = 0;
 	new_tree.next = 0;
 	new_tree.nrnodes = 0;
 	new_tree.nritems = 0;
@@ -622,6 +651,11 @@ static int mt_load_db(m_tree_t *pt)
 dbreloaded:
 	mt_dbf.free_result(db_con, db_res);
 
+	if(_mt_compact_trees != 0 && mt_ctree_build(&new_tree) < 0) {
+		LM_ERR("cannot build compact tree [%.*s]\n", pt->tname.len,
+				pt->tname.s);
+		return -1;
+	}
 
 	/* block all readers */
 	lock_get(mt_lock);
@@ -633,7 +667,9 @@ dbreloaded:
 	}
 
 	bk_head = old_tree->head;
+	bk_ctree = old_tree->ctree;
 	old_tree->head = new_tree.head;
+	old_tree->ctree = new_tree.ctree;
 	old_tree->nrnodes = new_tree.nrnodes;
 	old_tree->nritems = new_tree.nritems;
 	old_tree->memsize = new_tree.memsize;
@@ -645,6 +681,7 @@ dbreloaded:
 	/* free old data */
 	if(bk_head != NULL)
 		mt_free_node(bk_head, new_tree.type);
+	mt_ctree_free(bk_ctree);
 
 	return 0;
 
@@ -652,9 +689,61 @@ error:
 	mt_dbf.free_result(db_con, db_res);
 	if(new_tree.head != NULL)
 		mt_free_node(new_tree.head, new_tree.type);
+	mt_ctree_reset(&new_tree);
 	return -1;
 }
 
+/**
+ * map the pfxdb file of a tree - on reload the file is checked here and
+ * mapped again by the other processes on their next lookup
+ */
+static int mt_load_dbfile(m_tree_t *pt)
+{
+	pfxdb_t *db;
+	unsigned int nrnodes;
+	int t;
+
+	if(pt->dbh == NULL) {
+		pt->dbh = (pfxdb_handle_t *)pkg_malloc(sizeof(pfxdb_handle_t));
+		if(pt->dbh == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		if(pfxdb_handle_init(pt->dbh, pt->dbfile.s) < 0) {
+			pkg_free(pt->dbh);
+			pt->dbh = NULL;
+			return -1;
+		}
+	} else if(pfxdb_handle_reload(pt->dbh) < 0) {
+		LM_ERR("cannot reload tree [%.*s] from [%.*s]\n", pt->tname.len,
+				pt->tname.s, pt->dbfile.len, pt->dbfile.s);
+		return -1;
+	}
+
+	db = pt->dbh->db;
+	nrnodes = 0;
+	t = pfxdb_table_get(db, &pt->tname);
+	if(t < 0) {
+		LM_WARN("no records for tree [%.*s] in [%.*s]\n", pt->tname.len,
+				pt->tname.s, pt->dbfile.len, pt->dbfile.s);
+	} else {
+		/* the tables are stored one after the other */
+		nrnodes = ((t + 1 < db->hdr->ntables) ? db->tables[t + 1].root
+											  : db->hdr->nnodes)
+				  - db->tables[t].root;
+	}
+
+	lock_get(mt_lock);
+	pt->nrnodes = nrnodes;
+	pt->nritems = (t < 0) ? 0 : db->tables[t].nrecs;
+	pt->memsize = 0;
+	pt->reload_count++;
+	pt->reload_time = (uint64_t)time(NULL);
+	lock_release(mt_lock);
+
+	return 0;
+}
+
 static int mt_load_db_trees()
 {
 	db_key_t db_cols[3] = {&tname_column, &tprefix_column, &tvalue_column};
@@ -748,6 +837,17 @@ static int mt_load_db_trees()
 	} while(RES_ROW_N(db_res) > 0);
 	mt_dbf.free_result(db_con, db_res);
 
+	if(_mt_compact_trees != 0) {
+		for(new_tree = new_head; new_tree != NULL; new_tree = new_tree->next) {
+			if(mt_ctree_build(new_tree) < 0) {
+				LM_ERR("cannot build compact tree [%.*s]\n",
+						new_tree->tname.len, new_tree->tname.s);
+				mt_free_tree(new_head);
+				return -1;
+			}
+		}
+	}
+
 	/* block all readers */
 	lock_get(mt_lock);
 	mt_reload_flag = 1;
@@ -1025,6 +1125,117 @@ error:
 	return -1;
 }
 
+int rpc_mtree_print_cnode(rpc_t *rpc, void *ctx, m_tree_t *tree,
+		mt_cnode_t *cn, char *code)
+{
+	mt_ctree_t *ct = tree->ctree;
+	unsigned int i;
+	is_t *tvalue;
+	str val;
+	void *th = NULL;
+	void *ih = NULL;
+
+	if(cn->depth > 0) {
+		code[cn->depth - 1] = mt_char_list.s[cn->key];
+		if(MT_CNODE_NVALUES(cn) > 0) {
+			/* add structure node */
+			if(rpc->add(ctx, "{", &th) < 0) {
+				rpc->fault(ctx, 500, "Internal error - node structure");
+				return -1;
+			}
+
+			val.s = code;
+			val.len = cn->depth;
+			if(rpc->struct_add(th, "SS[", "tname", &tree->tname, "tprefix",
+					   &val, "tvalue", &ih)
+					< 0) {
+				rpc->fault(ctx, 500, "Internal error - attribute fields");
+				return -1;
+			}
+
+			for(i = cn->values; i < cn[1].values; i++) {
+				tvalue = &ct->vals[ct->refs[i]];
+				if(tree->type == MT_TREE_IVAL) {
+					if(rpc->array_add(ih, "u", (unsigned long)tvalue->n) < 0) {
+						rpc->fault(ctx, 500, "Internal error - int val");
+						return -1;
+					}
+				} else {
+					if(rpc->array_add(ih, "S", &tvalue->s) < 0) {
+						rpc->fault(ctx, 500, "Internal error - str val");
+						return -1;
+					}
+				}
+			}
+		}
+	}
+	for(i = 0; i < cn->nchild; i++) {
+		if(rpc_mtree_print_cnode(
+				   rpc, ctx, tree, &ct->nodes[cn->child + i], code)
+				< 0)
+			return -1;
+	}
+	return 0;
+}
+
+int rpc_mtree_print_fnode(rpc_t *rpc, void *ctx, m_tree_t *tree, pfxdb_t *db,
+		pfxdb_node_t *node, char *code)
+{
+	unsigned int i;
+	is_t *tvalue;
+	pfxdb_node_t *child;
+	str val;
+	void *th = NULL;
+	void *ih = NULL;
+
+	if(node->depth > 0) {
+		code[node->depth - 1] = (char)node->key;
+		if(pfxdb_node_nvals(db, node) > 0) {
+			/* add structure node */
+			if(rpc->add(ctx, "{", &th) < 0) {
+				rpc->fault(ctx, 500, "Internal error - node structure");
+				return -1;
+			}
+
+			val.s = code;
+			val.len = node->depth;
+			if(rpc->struct_add(th, "SS[", "tname", &tree->tname, "tprefix",
+					   &val, "tvalue", &ih)
+					< 0) {
+				rpc->fault(ctx, 500, "Internal error - attribute fields");
+				return -1;
+			}
+
+			for(i = 0; i < pfxdb_node_nvals(db, node); i++) {
+				tvalue = mt_file_tvalue(tree, db, node, i);
+				if(tvalue == NULL)
+					continue;
+				if(tree->type == MT_TREE_IVAL) {
+					if(rpc->array_add(ih, "u", (unsigned long)tvalue->n) < 0) {
+						rpc->fault(ctx, 500, "Internal error - int val");
+						return -1;
+					}
+				} else {
+					if(rpc->array_add(ih, "S", &tvalue->s) < 0) {
+						rpc->fault(ctx, 500, "Internal error - str val");
+						return -1;
+					}
+				}
+			}
+		}
+	}
+	if(node->depth >= MT_MAX_DEPTH || !pfxdb_children_ok(db, node))
+		return 0;
+	for(i = 0; i < node->nchild; i++) {
+		child = &db->nodes[node->child + i];
+		if(child->depth != node->depth + 1)
+			continue;
+		if(rpc_mtree_print_fnode(rpc, ctx, tree, db, child, code) < 0)
+			return -1;
+	}
+	return 0;
+}
+
 /**
  * "mtree.list" syntax :
  *    tname
@@ -1037,6 +1248,8 @@ void rpc_mtree_list(rpc_t *rpc, void *ctx)
 	m_tree_t *pt;
 	static char code_buf[MT_MAX_DEPTH + 1];
 	int len;
+	pfxdb_t *db;
+	pfxdb_node_t *node;
 
 	if(!mt_defined_trees()) {
 		rpc->fault(ctx, 500, "Empty tree list.");
@@ -1056,8 +1269,23 @@ void rpc_mtree_list(rpc_t *rpc, void *ctx)
 						&& strncmp(pt->tname.s, tname.s, tname.len) == 0)) {
 			len = 0;
 			code_buf[0] = '\0';
-			if(rpc_mtree_print_node(rpc, ctx, pt, pt->head, code_buf, len)
-					< 0) {
+			if(pt->dbh != NULL) {
+				db = mt_file_root(pt, &node);
+				if(db != NULL
+						&& rpc_mtree_print_fnode(
+								   rpc, ctx, pt, db, node, code_buf)
+								   < 0) {
+					goto error;
+				}
+			} else if(pt->ctree != NULL) {
+				if(rpc_mtree_print_cnode(
+						   rpc, ctx, pt, pt->ctree->nodes, code_buf)
+						< 0) {
+					goto error;
+				}
+			} else if(rpc_mtree_print_node(
+							  rpc, ctx, pt, pt->head, code_buf, len)
+					  < 0) {
 				goto error;
 			}
 		}
@@ -1076,11 +1304,117 @@ static const char *rpc_mtree_list_doc[6] = {
 		"Parameters:", "tname - tree name (optional)", 0};
 
 
+/**
+ * "mtree.memory" syntax :
+ *    tname
+ *
+ * 	- tname is optional, all trees are listed if missing
+ */
+void rpc_mtree_memory(rpc_t *rpc, void *ctx)
+{
+	str tname = {0, 0};
+	m_tree_t *pt;
+	mt_ctree_t *ct;
+	pfxdb_t *db;
+	unsigned long nsize, vsize, dsize;
+	void *th;
+	void *ih;
+	int found;
+
+	if(!mt_defined_trees()) {
+		rpc->fault(ctx, 500, "Empty tree list");
+		return;
+	}
+
+	if(rpc->scan(ctx, "*S", &tname) != 1) {
+		tname.s = NULL;
+		tname.len = 0;
+	}
+
+again:
+	lock_get(mt_lock);
+	if(mt_reload_flag) {
+		lock_release(mt_lock);
+		sleep_us(5);
+		goto again;
+	}
+	mt_tree_refcnt++;
+	lock_release(mt_lock);
+
+	found = 0;
+	for(pt = mt_get_first_tree(); pt != NULL; pt = pt->next) {
+		if(tname.s != NULL
+				&& (pt->tname.len < tname.len
+						|| strncmp(pt->tname.s, tname.s, tname.len) != 0))
+			continue;
+		found = 1;
+		ct = pt->ctree;
+		if(rpc->add(ctx, "{", &th) < 0) {
+			rpc->fault(ctx, 500, "Internal error creating rpc");
+			goto done;
+		}
+		if(rpc->struct_add(th, "S{", "table", &pt->tname, "memory", &ih) < 0) {
+			rpc->fault(ctx, 500, "Internal error creating rpc ih");
+			goto done;
+		}
+		if(rpc->struct_add(ih, "sddd", "format",
+				   (pt->dbh != NULL) ? "file"
+				   : (ct != NULL)	 ? "compact"
+									 : "tree",
+				   "memsize", pt->memsize, "nrnodes", pt->nrnodes, "nritems",
+				   pt->nritems)
+				< 0) {
+			rpc->fault(ctx, 500, "Internal error adding memory fields");
+			goto done;
+		}
+		if(pt->dbh != NULL) {
+			db = pfxdb_handle_get(pt->dbh);
+			if(rpc->struct_add(ih, "Sj", "file", &pt->dbfile, "file_size",
+					   (db != NULL) ? (unsigned long)db->size : 0UL)
+					< 0) {
+				rpc->fault(ctx, 500, "Internal error adding file fields");
+				goto done;
+			}
+			continue;
+		}
+		if(ct == NULL)
+			continue;
+		nsize = (ct->nnodes + 1) * sizeof(mt_cnode_t);
+		vsize = ct->nvals * sizeof(is_t) + ct->nrefs * sizeof(unsigned int);
+		dsize = 0;
+		if(ct->dws != NULL)
+			dsize = (ct->nvals + 1) * sizeof(unsigned int)
+					+ ct->ndws * sizeof(mt_cdw_t);
+		if(rpc->struct_add(ih, "dddjjjjj", "values", ct->nrefs,
+				   "distinct_values", ct->nvals, "dw_items", ct->ndws,
+				   "nodes_size", nsize, "values_size", vsize, "strings_size",
+				   ct->strsize, "dw_size", dsize, "tree_size", ct->tree_size)
+				< 0) {
+			rpc->fault(ctx, 500, "Internal error adding compact fields");
+			goto done;
+		}
+	}
+
+	if(found == 0)
+		rpc->fault(ctx, 404, "Tree not found");
+
+done:
+	lock_get(mt_lock);
+	mt_tree_refcnt--;
+	lock_release(mt_lock);
+}
+
+static const char *rpc_mtree_memory_doc[3] = {
+		"Print the memory used by the loaded mtree tables",
+		"tname - tree name (optional)", 0};
+
+
 rpc_export_t mtree_rpc[] = {
 		{"mtree.summary", rpc_mtree_summary, rpc_mtree_summary_doc, RET_ARRAY},
 		{"mtree.reload", rpc_mtree_reload, rpc_mtree_reload_doc, 0},
 		{"mtree.match", rpc_mtree_match, rpc_mtree_match_doc, 0},
 		{"mtree.list", rpc_mtree_list, rpc_mtree_list_doc, RET_ARRAY},
+		{"mtree.memory", rpc_mtree_memory, rpc_mtree_memory_doc, RET_ARRAY},
 		{0, 0, 0, 0}};
 
 static int mtree_init_rpc(void)
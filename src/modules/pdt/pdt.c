@@ -47,6 +47,7 @@
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
 #include "../../core/kemi.h"
+#include "../../core/utils/pfxdb.h"
 
 #include "pdtree.h"
 
@@ -73,6 +74,10 @@ static str sdomain_column = str_init("sdomain");
 static str prefix_column = str_init("prefix");
 static str domain_column = str_init("domain");
 static int pdt_check_domain = 1;
+static str pdt_db_file = STR_NULL;
+
+/** mapping of db_file, private to each process */
+static pfxdb_handle_t pdt_dbh;
 
 /** translation prefix */
 str pdt_prefix = {"", 0};
@@ -123,6 +128,7 @@ static param_export_t params[] = {
 	{"fetch_rows", PARAM_INT, &pdt_fetch_rows},
 	{"check_domain", PARAM_INT, &pdt_check_domain},
 	{"mode", PARAM_INT, &_pdt_mode},
+	{"db_file", PARAM_STR, &pdt_db_file},
 	{0, 0, 0}
 };
 
@@ -160,6 +166,16 @@ static int mod_init(void)
 	}
 	LM_INFO("pdt_char_list=%s \n", pdt_char_list.s);
 
+	if(pdt_db_file.len > 0) {
+		/* records are looked up in the mapped file, no database */
+		if(pfxdb_handle_init(&pdt_dbh, pdt_db_file.s) < 0) {
+			LM_ERR("cannot load records from file [%.*s]\n", pdt_db_file.len,
+					pdt_db_file.s);
+			return -1;
+		}
+		return 0;
+	}
+
 	/* binding to mysql module */
 	if(db_bind_mod(&db_url, &pdt_dbf)) {
 		LM_ERR("database module not found\n");
@@ -242,6 +258,9 @@ static int child_init(int rank)
 	if(rank == PROC_INIT || rank == PROC_MAIN || rank == PROC_TCP_MAIN)
 		return 0; /* do nothing for the main process */
 
+	if(pdt_db_file.len > 0)
+		return 0;
+
 	if(pdt_init_db() < 0) {
 		LM_ERR("cannot initialize database connection\n");
 		return -1;
@@ -261,6 +280,7 @@ static void mod_destroy(void)
 	}
 	if(db_con != NULL && pdt_dbf.close != NULL)
 		pdt_dbf.close(db_con);
+	pfxdb_handle_destroy(&pdt_dbh);
 	/* destroy lock */
 	if(pdt_lock) {
 		lock_destroy(pdt_lock);
@@ -334,6 +354,46 @@ static int w_prefix2domain_2(struct sip_msg *msg, char *mode, char *sdm)
 	return ki_prefix2domain(msg, m, s);
 }
 
+/**
+ * @brief get the domain for the longest prefix of code from db_file
+ *
+ * @param sdomain the source domain
+ * @param code the string to match
+ * @param plen set to the length of the matched prefix
+ * @return the domain, valid until the next call; NULL if not found
+ */
+static str *pdt_file_get_domain(str *sdomain, str *code, int *plen)
+{
+	static str domain;
+	pfxdb_t *db;
+	pfxdb_node_t *node;
+	int l, found;
+
+	db = pfxdb_handle_get(&pdt_dbh);
+	if(db == NULL)
+		return NULL;
+	node = pfxdb_root(db, pfxdb_table_get(db, sdomain));
+
+	l = found = 0;
+	while(node != NULL && node->nchild > 0 && l < code->len
+			&& l < PDT_MAX_DEPTH) {
+		/* check validity */
+		if(strpos(pdt_char_list.s, code->s[l]) < 0) {
+			LM_ERR("invalid char at %d in [%.*s]\n", l, code->len, code->s);
+			return NULL;
+		}
+
+		node = pfxdb_child(db, node, (unsigned char)code->s[l]);
+		if(node != NULL && pfxdb_node_val(db, node, 0, &domain) == 0) {
+			found = 1;
+			*plen = l + 1;
+		}
+		l++;
+	}
+
+	return (found) ? &domain : NULL;
+}
+
 /**
  * @brief change the r-uri domain based on source domain and prefix
  *
@@ -380,6 +440,23 @@ static int pd_translate(sip_msg_t *msg, str *sdomain, int rmode, int fmode)
 	p.s = msg->parsed_uri.user.s + pdt_prefix.len;
 	p.len = msg->parsed_uri.user.len - pdt_prefix.len;
 
+	if(pdt_db_file.len > 0) {
+		plen = 0;
+		if((d = pdt_file_get_domain(sdomain, &p, &plen)) == NULL) {
+			plen = 0;
+			if((fmode == 0)
+					|| (d = pdt_file_get_domain(&sdall, &p, &plen)) == NULL) {
+				LM_INFO("no prefix PDT prefix matched [%.*s]\n", p.len, p.s);
+				return -1;
+			}
+		}
+		if(update_new_uri(msg, plen, d, rmode) < 0) {
+			LM_ERR("new_uri cannot be updated\n");
+			return -1;
+		}
+		return 1;
+	}
+
 again:
 	lock_get(pdt_lock);
 	if(pdt_reload_flag) {
@@ -685,6 +762,13 @@ static const char *pdt_rpc_reload_doc[2] = {"Reload PDT database records", 0};
  */
 static void pdt_rpc_reload(rpc_t *rpc, void *ctx)
 {
+	if(pdt_db_file.len > 0) {
+		if(pfxdb_handle_reload(&pdt_dbh) < 0) {
+			LM_ERR("cannot re-load pdt records from file\n");
+			rpc->fault(ctx, 500, "Reload Failed");
+		}
+		return;
+	}
 	if(pdt_load_db() < 0) {
 		LM_ERR("cannot re-load pdt records from database\n");
 		rpc->fault(ctx, 500, "Reload Failed");
@@ -789,6 +873,11 @@ static void pdt_rpc_list(rpc_t *rpc, void *ctx)
 	void *th;
 	void *ih;
 
+	if(pdt_db_file.len > 0) {
+		rpc->fault(ctx, 500, "Records loaded from file - use pfxdb utility");
+		return;
+	}
+
 	ptree = pdt_get_ptree();
 
 	if(ptree == NULL || *ptree == NULL) {
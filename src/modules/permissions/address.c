@@ -426,6 +426,11 @@ int reload_address_table(void)
 		return ret;
 	}
 
+	/* index the subnets - on failure they are matched with a linear scan */
+	if(subnet_table_build_lpm(atg.subnet_table) < 0) {
+		LM_WARN("failed to build the subnets prefix match index\n");
+	}
+
 	*perm_addr_table = atg.address_table;
 	*perm_subnet_table = atg.subnet_table;
 	*perm_domain_table = atg.domain_table;
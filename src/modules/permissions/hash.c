@@ -32,6 +32,7 @@
 #include "../../core/usr_avp.h"
 #include "../../core/ip_addr.h"
 #include "../../core/pvar.h"
+#include "../../core/atomic_ops.h"
 #include "hash.h"
 #include "trusted.h"
 #include "address.h"
@@ -51,6 +52,129 @@ extern int _perm_subnet_match_mode;
 
 #define PERM_MAX_SUBNETS _perm_max_subnets
 
+/*
+ * Per process cache of compiled regular expressions - regex_t structures
+ * cannot be shared between processes, so each pattern is compiled once
+ * in every process when it is used first, instead of on every match.
+ * The same pattern used by many rows is compiled and evaluated only once
+ * for a matching pass.
+ */
+#define PERM_RE_CACHE_SIZE 64	/* hash slots */
+#define PERM_RE_CACHE_MAX 4096 /* max items before flushing */
+
+typedef struct perm_re_item
+{
+	unsigned int hashid;
+	char *pattern;		  /* pkg copy of the pattern */
+	int valid;			  /* 1 if the pattern was compiled */
+	regex_t re;			  /* compiled pattern */
+	unsigned int mcall[2]; /* matching pass of cached result per subject */
+	int mres[2];		  /* cached result per subject */
+	struct perm_re_item *next;
+} perm_re_item_t;
+
+static perm_re_item_t *_perm_re_cache[PERM_RE_CACHE_SIZE];
+static int _perm_re_cache_no = 0;
+static void *_perm_re_cache_tag = NULL;
+static unsigned int _perm_re_call = 0;
+
+/*
+ * Free all items in the regular expressions cache
+ */
+static void perm_re_cache_flush(void)
+{
+	int i;
+	perm_re_item_t *it, *next;
+
+	for(i = 0; i < PERM_RE_CACHE_SIZE; i++) {
+		for(it = _perm_re_cache[i]; it != NULL; it = next) {
+			next = it->next;
+			if(it->valid)
+				regfree(&it->re);
+			pkg_free(it);
+		}
+		_perm_re_cache[i] = NULL;
+	}
+	_perm_re_cache_no = 0;
+}
+
+/*
+ * Start a matching pass. The cache is flushed when the patterns source
+ * (tag, e.g., the current trusted hash table after a reload) changed.
+ */
+void perm_re_pass_start(void *tag)
+{
+	if(tag != _perm_re_cache_tag || _perm_re_cache_no >= PERM_RE_CACHE_MAX) {
+		perm_re_cache_flush();
+		_perm_re_cache_tag = tag;
+	}
+	_perm_re_call++;
+	if(_perm_re_call == 0)
+		_perm_re_call = 1;
+}
+
+/*
+ * Check if a pattern is a valid regular expression
+ */
+int perm_re_check(char *pattern)
+{
+	regex_t re;
+
+	if(regcomp(&re, pattern, REG_NOSUB)) {
+		return -1;
+	}
+	regfree(&re);
+	return 0;
+}
+
+/*
+ * Match subject against pattern, using the compiled pattern from cache.
+ * sidx (0 or 1) identifies the subject within current matching pass.
+ * Returns 1 on match, 0 on no match and -1 for invalid pattern.
+ */
+int perm_re_match(char *pattern, char *subject, int sidx)
+{
+	str sp;
+	unsigned int hashid;
+	perm_re_item_t *it;
+
+	sp.s = pattern;
+	sp.len = strlen(pattern);
+	hashid = get_hash1_raw(sp.s, sp.len);
+	for(it = _perm_re_cache[hashid & (PERM_RE_CACHE_SIZE - 1)]; it != NULL;
+			it = it->next) {
+		if(it->hashid == hashid && strcmp(it->pattern, pattern) == 0)
+			break;
+	}
+	if(it == NULL) {
+		it = (perm_re_item_t *)pkg_malloc(sizeof(perm_re_item_t) + sp.len + 1);
+		if(it == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		memset(it, 0, sizeof(perm_re_item_t));
+		it->hashid = hashid;
+		it->pattern = (char *)it + sizeof(perm_re_item_t);
+		memcpy(it->pattern, pattern, sp.len + 1);
+		if(regcomp(&it->re, pattern, REG_NOSUB)) {
+			LM_ERR("invalid regular expression: %s\n", pattern);
+		} else {
+			it->valid = 1;
+		}
+		it->next = _perm_re_cache[hashid & (PERM_RE_CACHE_SIZE - 1)];
+		_perm_re_cache[hashid & (PERM_RE_CACHE_SIZE - 1)] = it;
+		_perm_re_cache_no++;
+	}
+	if(!it->valid)
+		return -1;
+	if(it->mcall[sidx] != _perm_re_call) {
+		it->mres[sidx] =
+				(regexec(&it->re, subject, 0, (regmatch_t *)0, 0) == 0) ? 1 : 0;
+		it->mcall[sidx] = _perm_re_call;
+	}
+	return it->mres[sidx];
+}
+
 /*
  * Parse and set tag AVP specs
  */
@@ -125,11 +249,11 @@ void free_hash_table(struct trusted_list **table)
 
 
 /*
- * Add <src_ip, proto, pattern, ruri_pattern, tag, priority> into hash table, where proto is integer
- * representation of string argument proto.
+ * Add an entry with an already parsed protocol into hash table, keeping
+ * the entries of a slot ordered by priority
  */
-int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
-		char *pattern, char *ruri_pattern, char *tag, int priority)
+static int hash_table_add(struct trusted_list **table, char *src_ip,
+		int proto, char *pattern, char *ruri_pattern, char *tag, int priority)
 {
 	struct trusted_list *np;
 	struct trusted_list *np0 = NULL;
@@ -142,29 +266,7 @@ int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
 		return -1;
 	}
 
-	if(strcasecmp(proto, "any") == 0) {
-		np->proto = PROTO_NONE;
-	} else if(strcasecmp(proto, "udp") == 0) {
-		np->proto = PROTO_UDP;
-	} else if(strcasecmp(proto, "tcp") == 0) {
-		np->proto = PROTO_TCP;
-	} else if(strcasecmp(proto, "tls") == 0) {
-		np->proto = PROTO_TLS;
-	} else if(strcasecmp(proto, "sctp") == 0) {
-		np->proto = PROTO_SCTP;
-	} else if(strcasecmp(proto, "ws") == 0) {
-		np->proto = PROTO_WS;
-	} else if(strcasecmp(proto, "wss") == 0) {
-		np->proto = PROTO_WSS;
-	} else if(strcasecmp(proto, "none") == 0) {
-		shm_free(np);
-		return 1;
-	} else {
-		LM_CRIT("unknown protocol\n");
-		shm_free(np);
-		return -1;
-	}
-
+	np->proto = proto;
 	np->src_ip.len = strlen(src_ip);
 	np->src_ip.s = (char *)shm_malloc(np->src_ip.len + 1);
 
@@ -249,6 +351,49 @@ int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
 }
 
 
+/*
+ * Add <src_ip, proto, pattern, ruri_pattern, tag, priority> into hash table, where proto is integer
+ * representation of string argument proto.
+ */
+int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
+		char *pattern, char *ruri_pattern, char *tag, int priority)
+{
+	int proto_int;
+
+	if(strcasecmp(proto, "any") == 0) {
+		proto_int = PROTO_NONE;
+	} else if(strcasecmp(proto, "udp") == 0) {
+		proto_int = PROTO_UDP;
+	} else if(strcasecmp(proto, "tcp") == 0) {
+		proto_int = PROTO_TCP;
+	} else if(strcasecmp(proto, "tls") == 0) {
+		proto_int = PROTO_TLS;
+	} else if(strcasecmp(proto, "sctp") == 0) {
+		proto_int = PROTO_SCTP;
+	} else if(strcasecmp(proto, "ws") == 0) {
+		proto_int = PROTO_WS;
+	} else if(strcasecmp(proto, "wss") == 0) {
+		proto_int = PROTO_WSS;
+	} else if(strcasecmp(proto, "none") == 0) {
+		return 1;
+	} else {
+		LM_CRIT("unknown protocol\n");
+		return -1;
+	}
+
+	if(pattern && perm_re_check(pattern) < 0) {
+		LM_ERR("invalid regular expression for %s: %s\n", src_ip, pattern);
+	}
+	if(ruri_pattern && perm_re_check(ruri_pattern) < 0) {
+		LM_ERR("invalid regular expression for %s: %s\n", src_ip,
+				ruri_pattern);
+	}
+
+	return hash_table_add(
+			table, src_ip, proto_int, pattern, ruri_pattern, tag, priority);
+}
+
+
 /*
  * Check if an entry exists in hash table that has given src_ip and protocol
  * value and pattern that matches to From URI.  If an entry exists and tag_avp
@@ -262,7 +407,6 @@ int match_hash_table(struct trusted_list **table, struct sip_msg *msg,
 			proto, from_uri);
 	str ruri;
 	char ruri_string[MAX_URI_SIZE + 1];
-	regex_t preg;
 	struct trusted_list *np;
 	str src_ip;
 	int_str val;
@@ -279,6 +423,7 @@ int match_hash_table(struct trusted_list **table, struct sip_msg *msg,
 		}
 		memcpy(ruri_string, ruri.s, ruri.len);
 		ruri_string[ruri.len] = (char)0;
+		perm_re_pass_start((void *)table);
 	}
 
 	for(np = table[perm_hash(src_ip)]; np != NULL; np = np->next) {
@@ -293,29 +438,12 @@ int match_hash_table(struct trusted_list **table, struct sip_msg *msg,
 					(np->tag.s ? np->tag.s : "null"));
 
 			if(IS_SIP(msg)) {
-				if(np->pattern) {
-					if(regcomp(&preg, np->pattern, REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
-						if(!np->pattern) {
-							continue;
-						}
-					}
-					if(regexec(&preg, from_uri, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
-						continue;
-					}
-					regfree(&preg);
+				if(np->pattern && perm_re_match(np->pattern, from_uri, 0) <= 0) {
+					continue;
 				}
-				if(np->ruri_pattern) {
-					if(regcomp(&preg, np->ruri_pattern, REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
-						continue;
-					}
-					if(regexec(&preg, ruri_string, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
-						continue;
-					}
-					regfree(&preg);
+				if(np->ruri_pattern
+						&& perm_re_match(np->ruri_pattern, ruri_string, 1) <= 0) {
+					continue;
 				}
 			}
 			/* Found a match */
@@ -388,28 +516,117 @@ int hash_table_rpc_print(struct trusted_list **hash_table, rpc_t *rpc, void *c)
 void empty_hash_table(struct trusted_list **table)
 {
 	int i;
-	struct trusted_list *np, *next;
 
 	for(i = 0; i < PERM_HASH_SIZE; i++) {
-		np = table[i];
-		while(np) {
-			if(np->src_ip.s)
-				shm_free(np->src_ip.s);
-			if(np->pattern)
-				shm_free(np->pattern);
-			if(np->ruri_pattern)
-				shm_free(np->ruri_pattern);
-			if(np->tag.s)
-				shm_free(np->tag.s);
-			next = np->next;
-			shm_free(np);
-			np = next;
-		}
+		free_hash_chain(table[i]);
 		table[i] = 0;
 	}
 }
 
 
+/*
+ * Free a chain of hash table entries
+ */
+void free_hash_chain(struct trusted_list *np)
+{
+	struct trusted_list *next;
+
+	while(np) {
+		if(np->src_ip.s)
+			shm_free(np->src_ip.s);
+		if(np->pattern)
+			shm_free(np->pattern);
+		if(np->ruri_pattern)
+			shm_free(np->ruri_pattern);
+		if(np->tag.s)
+			shm_free(np->tag.s);
+		next = np->next;
+		shm_free(np);
+		np = next;
+	}
+}
+
+
+/*
+ * Check if a source address is in a list of addresses
+ */
+static int hash_key_in(str *src_ip, str *keys, int nkeys)
+{
+	int i;
+
+	for(i = 0; i < nkeys; i++) {
+		if(keys[i].len == src_ip->len
+				&& memcmp(keys[i].s, src_ip->s, src_ip->len) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*
+ * Replace the entries of the source addresses in keys by the ones in
+ * ntable. The slots of these addresses are rebuilt in ntable, by adding
+ * copies of the entries of the other addresses, and then set in table
+ * one by one, so that a reader walks either the old or the new chain of
+ * a slot without locking. The old chains are added to old, they can be
+ * freed only once no reader uses them anymore. On error table is not
+ * changed. Returns number of replaced slots or -1 on error.
+ */
+int hash_table_replace(struct trusted_list **table, struct trusted_list **ntable,
+		str *keys, int nkeys, struct trusted_chain **old)
+{
+	struct trusted_chain *hold[PERM_HASH_SIZE];
+	struct trusted_list *np;
+	unsigned int hash_val;
+	int i, n;
+
+	memset(hold, 0, sizeof(hold));
+	for(i = 0; i < nkeys; i++) {
+		hash_val = perm_hash(keys[i]);
+		if(hold[hash_val] != NULL)
+			continue;
+		hold[hash_val] =
+				(struct trusted_chain *)shm_malloc(sizeof(struct trusted_chain));
+		if(hold[hash_val] == NULL) {
+			SHM_MEM_ERROR;
+			goto error;
+		}
+		for(np = table[hash_val]; np != NULL; np = np->next) {
+			if(hash_key_in(&np->src_ip, keys, nkeys))
+				continue;
+			if(hash_table_add(ntable, np->src_ip.s, np->proto, np->pattern,
+					   np->ruri_pattern, np->tag.s, np->priority)
+					< 0) {
+				goto error;
+			}
+		}
+	}
+
+	n = 0;
+	for(i = 0; i < PERM_HASH_SIZE; i++) {
+		if(hold[i] == NULL)
+			continue;
+		hold[i]->list = table[i];
+		hold[i]->time = time(NULL);
+		hold[i]->next = *old;
+		*old = hold[i];
+		/* new chain must be complete before it is visible to readers */
+		membar_write();
+		table[i] = ntable[i];
+		ntable[i] = NULL;
+		n++;
+	}
+	return n;
+
+error:
+	for(i = 0; i < PERM_HASH_SIZE; i++) {
+		if(hold[i] != NULL)
+			shm_free(hold[i]);
+	}
+	return -1;
+}
+
+
 /*
  * Create and initialize an address hash table
  */
@@ -640,6 +857,260 @@ struct subnet *new_subnet_table(void)
 }
 
 
+/*
+ * Longest prefix match index of a subnet table - path compressed binary
+ * radix trees (at most two nodes per prefix), one per group and address
+ * family, plus one per address family over all groups. Subnet records
+ * with the same prefix are chained in table order. A record with mask 0
+ * matches any address, like with ip_addr_match_net(), so it is inserted in
+ * the trees of both families. Everything is kept in one shm block, built
+ * on reload before the table is made current.
+ */
+typedef struct subnet_lpm_node
+{
+	unsigned char key[16]; /* prefix, bits after prefix length are 0 */
+	int bits;			   /* prefix length */
+	int rec;			   /* first subnet record with this prefix or -1 */
+	int child[2];		   /* child nodes or -1 */
+} subnet_lpm_node_t;
+
+typedef struct subnet_lpm_root
+{
+	unsigned int grp;
+	int root[2]; /* IPv4 and IPv6 trees */
+} subnet_lpm_root_t;
+
+struct subnet_lpm
+{
+	int nroots;
+	subnet_lpm_root_t *roots; /* per group roots, sorted by group */
+	int all[2];				  /* IPv4 and IPv6 trees for all groups */
+	int nnodes;
+	subnet_lpm_node_t *nodes;
+	int *next_grp; /* next record with same prefix in group tree */
+	int *next_all; /* next record with same prefix in all groups tree */
+};
+
+#define subnet_lpm_bit(_k, _i) (((_k)[(_i) >> 3] >> (7 - ((_i)&7))) & 1)
+#define subnet_lpm_af(_af) (((_af) == AF_INET6) ? 1 : 0)
+
+
+/*
+ * Number of leading bits that are equal in two keys, up to maxbits
+ */
+static int subnet_lpm_common(unsigned char *a, unsigned char *b, int maxbits)
+{
+	int i;
+	int n;
+	unsigned char x;
+
+	for(i = 0; i * 8 < maxbits; i++) {
+		x = a[i] ^ b[i];
+		if(x) {
+			n = i * 8;
+			while(!(x & 0x80)) {
+				x <<= 1;
+				n++;
+			}
+			return (n < maxbits) ? n : maxbits;
+		}
+	}
+	return maxbits;
+}
+
+
+/*
+ * Get a new node for the prefix key/bits
+ */
+static int subnet_lpm_node_new(
+		struct subnet_lpm *lpm, unsigned char *key, int bits, int rec)
+{
+	subnet_lpm_node_t *n;
+	int i;
+
+	n = &lpm->nodes[lpm->nnodes];
+	memset(n, 0, sizeof(subnet_lpm_node_t));
+	memcpy(n->key, key, (bits + 7) / 8);
+	if(bits % 8)
+		n->key[bits / 8] &= (unsigned char)(0xff << (8 - bits % 8));
+	n->bits = bits;
+	n->rec = rec;
+	n->child[0] = n->child[1] = -1;
+	i = lpm->nnodes++;
+	return i;
+}
+
+
+/*
+ * Insert subnet record rec in the tree with root at *root
+ */
+static void subnet_lpm_insert(struct subnet_lpm *lpm, int *root, int *next,
+		unsigned char *key, int bits, int rec)
+{
+	int *ref;
+	int c;
+	int m;
+	int k;
+	subnet_lpm_node_t *n;
+
+	ref = root;
+	while(*ref >= 0) {
+		n = &lpm->nodes[*ref];
+		c = subnet_lpm_common(key, n->key, (bits < n->bits) ? bits : n->bits);
+		if(c < n->bits) {
+			/* split the node at the common prefix */
+			m = subnet_lpm_node_new(lpm, key, c, (c == bits) ? rec : -1);
+			lpm->nodes[m].child[subnet_lpm_bit(n->key, c)] = *ref;
+			if(c < bits) {
+				k = subnet_lpm_node_new(lpm, key, bits, rec);
+				lpm->nodes[m].child[subnet_lpm_bit(key, c)] = k;
+			}
+			*ref = m;
+			return;
+		}
+		if(bits == n->bits) {
+			/* same prefix - append to the chain, keeping table order,
+			 * a record with mask 0 is already chained by the other family */
+			if(n->rec < 0) {
+				n->rec = rec;
+			} else {
+				for(k = n->rec; k != rec && next[k] >= 0; k = next[k])
+					;
+				if(k != rec)
+					next[k] = rec;
+			}
+			return;
+		}
+		ref = &n->child[subnet_lpm_bit(key, n->bits)];
+	}
+	*ref = subnet_lpm_node_new(lpm, key, bits, rec);
+}
+
+
+/*
+ * Free the longest prefix match index of a subnet table
+ */
+static void subnet_table_free_lpm(struct subnet *table)
+{
+	if(table[PERM_MAX_SUBNETS].lpm != NULL) {
+		shm_free(table[PERM_MAX_SUBNETS].lpm);
+		table[PERM_MAX_SUBNETS].lpm = NULL;
+	}
+}
+
+
+/*
+ * Build the longest prefix match index of a subnet table
+ */
+int subnet_table_build_lpm(struct subnet *table)
+{
+	struct subnet_lpm *lpm;
+	unsigned int count;
+	unsigned int i;
+	int nroots;
+	int nzero;
+	int maxnodes;
+	int af;
+	int *root;
+	char *p;
+
+	subnet_table_free_lpm(table);
+	count = table[PERM_MAX_SUBNETS].grp;
+	if(count == 0)
+		return 0;
+
+	nroots = 1;
+	nzero = 0;
+	for(i = 0; i < count; i++) {
+		if(i > 0 && table[i].grp != table[i - 1].grp)
+			nroots++;
+		if(table[i].mask == 0)
+			nzero++;
+	}
+	/* each insert adds at most two nodes, in group and all groups trees,
+	 * records with mask 0 are inserted for both families */
+	maxnodes = 4 * (count + nzero);
+	p = (char *)shm_malloc(sizeof(struct subnet_lpm)
+						   + nroots * sizeof(subnet_lpm_root_t)
+						   + maxnodes * sizeof(subnet_lpm_node_t)
+						   + 2 * count * sizeof(int));
+	if(p == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	lpm = (struct subnet_lpm *)p;
+	memset(lpm, 0, sizeof(struct subnet_lpm));
+	p += sizeof(struct subnet_lpm);
+	lpm->roots = (subnet_lpm_root_t *)p;
+	p += nroots * sizeof(subnet_lpm_root_t);
+	lpm->nodes = (subnet_lpm_node_t *)p;
+	p += maxnodes * sizeof(subnet_lpm_node_t);
+	lpm->next_grp = (int *)p;
+	p += count * sizeof(int);
+	lpm->next_all = (int *)p;
+	lpm->all[0] = lpm->all[1] = -1;
+
+	for(i = 0; i < count; i++) {
+		if(i == 0 || table[i].grp != table[i - 1].grp) {
+			lpm->roots[lpm->nroots].grp = table[i].grp;
+			lpm->roots[lpm->nroots].root[0] = -1;
+			lpm->roots[lpm->nroots].root[1] = -1;
+			lpm->nroots++;
+		}
+		lpm->next_grp[i] = -1;
+		lpm->next_all[i] = -1;
+		for(af = 0; af < 2; af++) {
+			if(table[i].mask != 0 && af != subnet_lpm_af(table[i].subnet.af))
+				continue;
+			root = &lpm->roots[lpm->nroots - 1].root[af];
+			subnet_lpm_insert(lpm, root, lpm->next_grp, table[i].subnet.u.addr,
+					table[i].mask, i);
+			subnet_lpm_insert(lpm, &lpm->all[af], lpm->next_all,
+					table[i].subnet.u.addr, table[i].mask, i);
+		}
+	}
+	table[PERM_MAX_SUBNETS].lpm = lpm;
+
+	LM_DBG("subnet index built: %u subnets, %d groups, %d nodes\n", count,
+			lpm->nroots, lpm->nnodes);
+	return 0;
+}
+
+
+/*
+ * Search the tree with the root node for the subnet record matching addr
+ * and port - first one in table order (subnet_match_mode 0) or with the
+ * longest mask (subnet_match_mode 1). Returns record index or -1.
+ */
+static int subnet_lpm_lookup(struct subnet *table, struct subnet_lpm *lpm,
+		int node, int *next, ip_addr_t *addr, unsigned int port)
+{
+	subnet_lpm_node_t *n;
+	int best = -1;
+	int k;
+
+	while(node >= 0) {
+		n = &lpm->nodes[node];
+		if(n->bits > addr->len * 8
+				|| subnet_lpm_common(addr->u.addr, n->key, n->bits) < n->bits)
+			break;
+		for(k = n->rec; k >= 0; k = next[k]) {
+			if(table[k].port == port || table[k].port == 0)
+				break;
+		}
+		if(k >= 0) {
+			/* deeper nodes have longer masks */
+			if(_perm_subnet_match_mode != 0 || best < 0 || k < best)
+				best = k;
+		}
+		if(n->bits >= addr->len * 8)
+			break;
+		node = n->child[subnet_lpm_bit(addr->u.addr, n->bits)];
+	}
+	return best;
+}
+
+
 /*
  * Add <grp, subnet, mask, port, tag> into subnet table so that table is
  * kept in increasing ordered according to grp.
@@ -702,16 +1173,36 @@ int match_subnet_table(struct subnet *table, unsigned int grp, ip_addr_t *addr,
 	avp_value_t val;
 	int best_idx = -1;
 	unsigned int best_mask = 0;
+	struct subnet_lpm *lpm;
+	int l, r, m;
 
 	count = table[PERM_MAX_SUBNETS].grp;
 
+	lpm = table[PERM_MAX_SUBNETS].lpm;
+	if(lpm != NULL) {
+		/* binary search of group */
+		l = 0;
+		r = lpm->nroots - 1;
+		while(l <= r) {
+			m = (l + r) / 2;
+			if(lpm->roots[m].grp == grp) {
+				best_idx = subnet_lpm_lookup(table, lpm,
+						lpm->roots[m].root[subnet_lpm_af(addr->af)],
+						lpm->next_grp, addr, port);
+				break;
+			}
+			if(lpm->roots[m].grp < grp)
+				l = m + 1;
+			else
+				r = m - 1;
+		}
+		count = 0;
+	}
+
 	i = 0;
 	while((i < count) && (table[i].grp < grp))
 		i++;
 
-	if(i == count)
-		return -1;
-
 	while((i < count) && (table[i].grp == grp)) {
 		if(((table[i].port == port) || (table[i].port == 0))
 				&& (ip_addr_match_net(addr, &table[i].subnet, table[i].mask)
@@ -755,9 +1246,17 @@ int find_group_in_subnet_table(
 	avp_value_t val;
 	int best_idx = -1;
 	unsigned int best_mask = 0;
+	struct subnet_lpm *lpm;
 
 	count = table[PERM_MAX_SUBNETS].grp;
 
+	lpm = table[PERM_MAX_SUBNETS].lpm;
+	if(lpm != NULL) {
+		best_idx = subnet_lpm_lookup(table, lpm,
+				lpm->all[subnet_lpm_af(addr->af)], lpm->next_all, addr, port);
+		count = 0;
+	}
+
 	i = 0;
 	while(i < count) {
 		if(((table[i].port == port) || (table[i].port == 0))
@@ -837,6 +1336,7 @@ int subnet_table_rpc_print(struct subnet *table, rpc_t *rpc, void *c)
 void empty_subnet_table(struct subnet *table)
 {
 	int i;
+	subnet_table_free_lpm(table);
 	table[PERM_MAX_SUBNETS].grp = 0;
 	for(i = 0; i < PERM_MAX_SUBNETS; i++) {
 		if(table[i].tag.s != NULL) {
@@ -856,6 +1356,7 @@ void free_subnet_table(struct subnet *table)
 	int i;
 	if(!table)
 		return;
+	subnet_table_free_lpm(table);
 	for(i = 0; i < PERM_MAX_SUBNETS; i++) {
 		if(table[i].tag.s != NULL) {
 			shm_free(table[i].tag.s);
@@ -26,6 +26,7 @@
 #define _PERM_HASH_H_
 
 #include <stdio.h>
+#include <time.h>
 #include "../../core/parser/msg_parser.h"
 #include "../../core/str.h"
 #include "../../core/rpc.h"
@@ -87,6 +88,24 @@ int hash_table_insert(struct trusted_list **hash_table, char *src_ip,
 		int priority);
 
 
+/*
+ * Start a matching pass with the per process compiled patterns cache
+ */
+void perm_re_pass_start(void *tag);
+
+
+/*
+ * Check if a pattern is a valid regular expression
+ */
+int perm_re_check(char *pattern);
+
+
+/*
+ * Match subject against pattern compiled in the per process cache
+ */
+int perm_re_match(char *pattern, char *subject, int sidx);
+
+
 /*
  * Check if an entry exists in hash table that has given src_ip and protocol
  * value and pattern or ruri_pattern that matches to provided URI.
@@ -107,6 +126,32 @@ int hash_table_rpc_print(struct trusted_list **hash_table, rpc_t *rpc, void *c);
 void empty_hash_table(struct trusted_list **hash_table);
 
 
+/*
+ * Chain of trusted entries replaced by an incremental reload, kept until
+ * no reader can walk it anymore
+ */
+struct trusted_chain
+{
+	struct trusted_list *list;
+	time_t time;				/* when it was replaced */
+	struct trusted_chain *next; /* next replaced chain */
+};
+
+
+/*
+ * Free a chain of hash table entries
+ */
+void free_hash_chain(struct trusted_list *np);
+
+
+/*
+ * Replace the entries of the source addresses in keys by the ones in
+ * ntable, adding the replaced chains to old
+ */
+int hash_table_replace(struct trusted_list **table, struct trusted_list **ntable,
+		str *keys, int nkeys, struct trusted_chain **old);
+
+
 /*
  * Structure stored in address hash table
  */
@@ -175,6 +220,12 @@ int addr_hash_table_rpc_print(struct addr_list **table, rpc_t *rpc, void *c);
 void empty_addr_hash_table(struct addr_list **hash_table);
 
 
+/*
+ * Longest prefix match index of a subnet table
+ */
+struct subnet_lpm;
+
+
 /*
  * Structure used to store a subnet
  */
@@ -186,6 +237,7 @@ struct subnet
 	unsigned int port; /* port or 0 */
 	unsigned int mask; /* how many bits belong to network part */
 	str tag;
+	struct subnet_lpm *lpm; /* prefix match index, set in last record */
 };
 
 
@@ -231,6 +283,13 @@ int subnet_table_insert(struct subnet *table, unsigned int grp,
 		ip_addr_t *subnet, unsigned int mask, unsigned int port, str *tagv);
 
 
+/*
+ * Build the longest prefix match index of a subnet table, it has to be
+ * done after all the subnets were inserted and before using the table
+ */
+int subnet_table_build_lpm(struct subnet *table);
+
+
 /*
  * Print subnets stored in subnet table
  */
@@ -74,6 +74,8 @@ str perm_from_col = str_init("from_pattern"); /* Name of from pattern column */
 str perm_ruri_col = str_init("ruri_pattern"); /* Name of RURI pattern column */
 str perm_tag_col = str_init("tag");			  /* Name of tag column */
 str perm_priority_col = str_init("priority"); /* Name of priority column */
+str perm_trusted_log_table = STR_NULL; /* Name of trusted change log table */
+str perm_trusted_log_id_col = str_init("id"); /* Name of change log id column */
 str perm_tag_avp_param = {NULL, 0};			  /* Peer tag AVP spec */
 int perm_peer_tag_mode = 0; /* Add tags form all mathcing peers to avp */
 
@@ -190,6 +192,8 @@ static param_export_t params[] = {
 	{"ruri_col", PARAM_STR, &perm_ruri_col},
 	{"tag_col", PARAM_STR, &perm_tag_col},
 	{"priority_col", PARAM_STR, &perm_priority_col},
+	{"trusted_log_table", PARAM_STR, &perm_trusted_log_table},
+	{"trusted_log_id_col", PARAM_STR, &perm_trusted_log_id_col},
 	{"peer_tag_avp", PARAM_STR, &perm_tag_avp_param},
 	{"peer_tag_mode", PARAM_INT, &perm_peer_tag_mode},
 	{"address_table", PARAM_STR, &perm_address_table},
@@ -1051,6 +1055,11 @@ static const char *rpc_trusted_reload_doc[2] = {
 	0
 };
 
+static const char *rpc_trusted_reload_changes_doc[2] = {
+	"Reload the records of permissions trusted table listed in change log",
+	0
+};
+
 static const char *rpc_address_reload_doc[2] = {
 	"Reload permissions address table",
 	0
@@ -1084,6 +1093,8 @@ static const char *rpc_test_uri_doc[2] = {
 rpc_export_t permissions_rpc[] = {
 	{"permissions.trustedReload", rpc_trusted_reload, rpc_trusted_reload_doc,
 			RPC_EXEC_DELTA},
+	{"permissions.trustedReloadChanges", rpc_trusted_reload_changes,
+			rpc_trusted_reload_changes_doc, 0},
 	{"permissions.addressReload", rpc_address_reload, rpc_address_reload_doc,
 			RPC_EXEC_DELTA},
 	{"permissions.trustedDump", rpc_trusted_dump, rpc_trusted_dump_doc, 0},
@@ -56,6 +56,8 @@ extern str perm_from_col;	   /* Name of from pattern column */
 extern str perm_ruri_col;	   /* Name of RURI pattern column */
 extern str perm_tag_col;	   /* Name of tag column */
 extern str perm_priority_col;  /* Name of priority column */
+extern str perm_trusted_log_table;  /* Name of trusted change log table */
+extern str perm_trusted_log_id_col; /* Name of change log id column */
 extern str perm_address_table; /* Name of address table */
 extern str perm_grp_col;	   /* Name of address group column */
 extern str perm_ip_addr_col;   /* Name of ip address column */
@@ -73,6 +73,33 @@ done:
 }
 
 
+/*! \brief
+ * RPC function to reload the changed records of trusted table
+ */
+void rpc_trusted_reload_changes(rpc_t *rpc, void *c)
+{
+	int n;
+
+	if(perm_trusted_log_table.len <= 0) {
+		rpc->fault(c, 500, "No change log table");
+		return;
+	}
+	if(perm_rpc_reload_time == NULL) {
+		rpc->fault(c, 500, "Not ready for reload");
+		return;
+	}
+
+	n = reload_trusted_changes_cmd();
+	if(n < 0) {
+		rpc->fault(c, 500, "Reload failed.");
+		return;
+	}
+
+	rpc->rpl_printf(c, "Reload OK - %d changed addresses", n);
+	return;
+}
+
+
 /*! \brief
  * RPC function to dump trusted table
  */
@@ -41,6 +41,8 @@
 
 void rpc_trusted_reload(rpc_t *rpc, void *c);
 
+void rpc_trusted_reload_changes(rpc_t *rpc, void *c);
+
 void rpc_trusted_dump(rpc_t *rpc, void *c);
 
 void rpc_address_reload(rpc_t *rpc, void *c);
@@ -24,16 +24,17 @@
  */
 
 #include <sys/types.h>
-#include <regex.h>
 #include <string.h>
 
 #include "permissions.h"
 #include "hash.h"
 #include "../../core/config.h"
 #include "../../lib/srdb1/db.h"
+#include "../../lib/srdb1/db_changelog.h"
 #include "../../core/ip_addr.h"
 #include "../../core/mod_fix.h"
 #include "../../core/mem/shm_mem.h"
+#include "../../core/locking.h"
 #include "../../core/parser/msg_parser.h"
 #include "../../core/parser/parse_from.h"
 #include "../../core/usr_avp.h"
@@ -49,63 +50,36 @@ struct trusted_list **perm_trust_table_2 = 0; /* Pointer to hash table 2 */
 static db1_con_t *perm_db_handle = 0;
 static db_func_t perm_dbf;
 
+/* position in the trusted change log table */
+static db_changelog_t *perm_trusted_log = 0;
+/* chains of the current table replaced by incremental reloads */
+static struct trusted_chain **perm_trusted_old = 0;
+/* serializes the updates of the trusted tables */
+static gen_lock_t *perm_trusted_lock = 0;
+
+/* source addresses read from the change log */
+typedef struct trusted_log_keys
+{
+	str *keys;
+	int nkeys;
+	int size;
+} trusted_log_keys_t;
+
 
 /*
- * Reload trusted table to new hash table and when done, make new hash table
- * current one.
+ * Add the rows of a query result on trusted table into a hash table
  */
-int reload_trusted_table(void)
+static int trusted_load_rows(struct trusted_list **table, db1_res_t *res)
 {
-	db_key_t cols[6];
-	db1_res_t *res = NULL;
 	db_row_t *row;
 	db_val_t *val;
-
-	struct trusted_list **new_hash_table;
 	int i;
 	int priority;
 
 	char *pattern, *ruri_pattern, *tag;
 
-	if(perm_trust_table == 0) {
-		LM_ERR("in-memory hash table not initialized\n");
-		return -1;
-	}
-
-	if(perm_db_handle == 0) {
-		LM_ERR("no connection to database\n");
-		return -1;
-	}
-
-	cols[0] = &perm_source_col;
-	cols[1] = &perm_proto_col;
-	cols[2] = &perm_from_col;
-	cols[3] = &perm_ruri_col;
-	cols[4] = &perm_tag_col;
-	cols[5] = &perm_priority_col;
-
-	if(perm_dbf.use_table(perm_db_handle, &perm_trusted_table) < 0) {
-		LM_ERR("failed to use trusted table\n");
-		return -1;
-	}
-
-	if(perm_dbf.query(perm_db_handle, NULL, 0, NULL, cols, 0, 6, 0, &res) < 0) {
-		LM_ERR("failed to query database\n");
-		return -1;
-	}
-
-	/* Choose new hash table and free its old contents */
-	if(*perm_trust_table == perm_trust_table_1) {
-		new_hash_table = perm_trust_table_2;
-	} else {
-		new_hash_table = perm_trust_table_1;
-	}
-	empty_hash_table(new_hash_table);
-
 	row = RES_ROWS(res);
 
-	LM_DBG("number of rows in trusted table: %d\n", RES_ROW_N(res));
-
 	for(i = 0; i < RES_ROW_N(res); i++) {
 		val = ROW_VALUES(row + i);
 		if((ROW_N(row + i) == 6)
@@ -146,13 +120,11 @@ int reload_trusted_table(void)
 			} else {
 				priority = (int)VAL_INT(val + 5);
 			}
-			if(hash_table_insert(new_hash_table, (char *)VAL_STRING(val),
+			if(hash_table_insert(table, (char *)VAL_STRING(val),
 					   (char *)VAL_STRING(val + 1), pattern, ruri_pattern, tag,
 					   priority)
 					== -1) {
 				LM_ERR("hash table problem\n");
-				perm_dbf.free_result(perm_db_handle, res);
-				empty_hash_table(new_hash_table);
 				return -1;
 			}
 			LM_DBG("tuple <%s, %s, %s, %s, %s> inserted into trusted hash "
@@ -161,21 +133,272 @@ int reload_trusted_table(void)
 					tag);
 		} else {
 			LM_ERR("database problem\n");
-			perm_dbf.free_result(perm_db_handle, res);
-			empty_hash_table(new_hash_table);
 			return -1;
 		}
 	}
 
+	return 0;
+}
+
+
+/*
+ * Reload trusted table to new hash table and when done, make new hash table
+ * current one.
+ */
+int reload_trusted_table(void)
+{
+	db_key_t cols[6];
+	db1_res_t *res = NULL;
+	db_changelog_t clog;
+
+	struct trusted_list **new_hash_table;
+
+	if(perm_trust_table == 0) {
+		LM_ERR("in-memory hash table not initialized\n");
+		return -1;
+	}
+
+	if(perm_db_handle == 0) {
+		LM_ERR("no connection to database\n");
+		return -1;
+	}
+
+	cols[0] = &perm_source_col;
+	cols[1] = &perm_proto_col;
+	cols[2] = &perm_from_col;
+	cols[3] = &perm_ruri_col;
+	cols[4] = &perm_tag_col;
+	cols[5] = &perm_priority_col;
+
+	/* changes logged from now on are applied by next incremental reload */
+	memset(&clog, 0, sizeof(db_changelog_t));
+	if(perm_trusted_log_table.len > 0) {
+		clog = *perm_trusted_log;
+		if(db_changelog_fetch(&perm_dbf, perm_db_handle,
+				   &perm_trusted_log_table, &perm_trusted_log_id_col,
+				   &perm_source_col, &clog, NULL, NULL)
+				< 0) {
+			LM_ERR("failed to read trusted change log\n");
+			return -1;
+		}
+	}
+
+	if(perm_dbf.use_table(perm_db_handle, &perm_trusted_table) < 0) {
+		LM_ERR("failed to use trusted table\n");
+		return -1;
+	}
+
+	if(perm_dbf.query(perm_db_handle, NULL, 0, NULL, cols, 0, 6, 0, &res) < 0) {
+		LM_ERR("failed to query database\n");
+		return -1;
+	}
+
+	/* Choose new hash table and free its old contents */
+	if(*perm_trust_table == perm_trust_table_1) {
+		new_hash_table = perm_trust_table_2;
+	} else {
+		new_hash_table = perm_trust_table_1;
+	}
+	empty_hash_table(new_hash_table);
+
+	LM_DBG("number of rows in trusted table: %d\n", RES_ROW_N(res));
+
+	if(trusted_load_rows(new_hash_table, res) < 0) {
+		perm_dbf.free_result(perm_db_handle, res);
+		empty_hash_table(new_hash_table);
+		return -1;
+	}
+
 	perm_dbf.free_result(perm_db_handle, res);
 
 	*perm_trust_table = new_hash_table;
+	if(perm_trusted_log_table.len > 0)
+		*perm_trusted_log = clog;
 
 	LM_DBG("trusted table reloaded successfully.\n");
 
 	return 1;
 }
 
+
+/*
+ * Collect the source addresses of the change log rows, once each
+ */
+static int trusted_log_key(db_val_t *val, void *param)
+{
+	trusted_log_keys_t *lk = (trusted_log_keys_t *)param;
+	str key;
+	str *nkeys;
+	int i;
+
+	if(VAL_TYPE(val) == DB1_STRING) {
+		key.s = (char *)VAL_STRING(val);
+		key.len = strlen(key.s);
+	} else if(VAL_TYPE(val) == DB1_STR) {
+		key = VAL_STR(val);
+	} else {
+		LM_ERR("invalid type of source address in change log\n");
+		return -1;
+	}
+
+	for(i = 0; i < lk->nkeys; i++) {
+		if(lk->keys[i].len == key.len
+				&& memcmp(lk->keys[i].s, key.s, key.len) == 0)
+			return 0;
+	}
+	if(lk->nkeys == lk->size) {
+		nkeys = (str *)pkg_realloc(
+				lk->keys, (lk->size ? 2 * lk->size : 16) * sizeof(str));
+		if(nkeys == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		lk->keys = nkeys;
+		lk->size = lk->size ? 2 * lk->size : 16;
+	}
+	lk->keys[lk->nkeys].s = (char *)pkg_malloc(key.len + 1);
+	if(lk->keys[lk->nkeys].s == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memcpy(lk->keys[lk->nkeys].s, key.s, key.len);
+	lk->keys[lk->nkeys].s[key.len] = '\0';
+	lk->keys[lk->nkeys].len = key.len;
+	lk->nkeys++;
+	return 0;
+}
+
+
+/*
+ * Reload the records of the source addresses listed in trusted change log
+ * since last reload. The slots of these addresses are rebuilt and swapped
+ * one by one in the current hash table, the replaced chains being freed
+ * later by the timer. Returns the number of reloaded addresses or -1.
+ */
+int reload_trusted_changes(void)
+{
+	db_key_t cols[6];
+	db_key_t keys[1];
+	db_op_t ops[1];
+	db_val_t vals[1];
+	db1_res_t *res = NULL;
+	struct trusted_list **ntable = NULL;
+	trusted_log_keys_t lk;
+	db_changelog_t clog;
+	int i, ret = -1;
+
+	if(perm_trust_table == 0) {
+		LM_ERR("in-memory hash table not initialized\n");
+		return -1;
+	}
+
+	if(perm_db_handle == 0) {
+		LM_ERR("no connection to database\n");
+		return -1;
+	}
+
+	memset(&lk, 0, sizeof(trusted_log_keys_t));
+	clog = *perm_trusted_log;
+	if(db_changelog_fetch(&perm_dbf, perm_db_handle, &perm_trusted_log_table,
+			   &perm_trusted_log_id_col, &perm_source_col, &clog,
+			   trusted_log_key, &lk)
+			< 0) {
+		LM_ERR("failed to read trusted change log\n");
+		goto done;
+	}
+	if(lk.nkeys == 0) {
+		*perm_trusted_log = clog;
+		ret = 0;
+		goto done;
+	}
+
+	cols[0] = &perm_source_col;
+	cols[1] = &perm_proto_col;
+	cols[2] = &perm_from_col;
+	cols[3] = &perm_ruri_col;
+	cols[4] = &perm_tag_col;
+	cols[5] = &perm_priority_col;
+
+	keys[0] = &perm_source_col;
+	ops[0] = OP_EQ;
+	VAL_TYPE(vals) = DB1_STR;
+	VAL_NULL(vals) = 0;
+
+	if(perm_dbf.use_table(perm_db_handle, &perm_trusted_table) < 0) {
+		LM_ERR("failed to use trusted table\n");
+		goto done;
+	}
+
+	ntable = new_hash_table();
+	if(ntable == NULL)
+		goto done;
+
+	for(i = 0; i < lk.nkeys; i++) {
+		VAL_STR(vals) = lk.keys[i];
+		if(perm_dbf.query(perm_db_handle, keys, ops, vals, cols, 1, 6, 0, &res)
+				< 0) {
+			LM_ERR("failed to query database\n");
+			goto done;
+		}
+		if(trusted_load_rows(ntable, res) < 0) {
+			perm_dbf.free_result(perm_db_handle, res);
+			goto done;
+		}
+		perm_dbf.free_result(perm_db_handle, res);
+	}
+
+	if(hash_table_replace(
+			   *perm_trust_table, ntable, lk.keys, lk.nkeys, perm_trusted_old)
+			< 0) {
+		LM_ERR("failed to update trusted hash table\n");
+		goto done;
+	}
+	*perm_trusted_log = clog;
+	ret = lk.nkeys;
+	LM_DBG("reloaded records of %d source addresses from trusted table\n",
+			lk.nkeys);
+
+done:
+	if(ntable)
+		free_hash_table(ntable);
+	for(i = 0; i < lk.nkeys; i++)
+		pkg_free(lk.keys[i].s);
+	if(lk.keys)
+		pkg_free(lk.keys);
+	return ret;
+}
+
+
+/*
+ * Free the chains replaced by incremental reloads more than age seconds
+ * ago, all of them if age is negative
+ */
+static void trusted_free_old(int age)
+{
+	struct trusted_chain *tc, *next, **prev;
+	time_t limit;
+
+	if(perm_trusted_old == 0)
+		return;
+
+	limit = time(NULL) - age;
+	lock_get(perm_trusted_lock);
+	/* newest chains first */
+	for(prev = perm_trusted_old; *prev != NULL; prev = &(*prev)->next) {
+		if(age < 0 || (*prev)->time <= limit)
+			break;
+	}
+	tc = *prev;
+	*prev = NULL;
+	lock_release(perm_trusted_lock);
+
+	for(; tc != NULL; tc = next) {
+		next = tc->next;
+		free_hash_chain(tc->list);
+		shm_free(tc);
+	}
+}
+
 void perm_ht_timer(unsigned int ticks, void *);
 
 /*
@@ -234,6 +457,18 @@ int init_trusted(void)
 
 		*perm_trust_table = perm_trust_table_1;
 
+		perm_trusted_log = (db_changelog_t *)shm_malloc(
+				sizeof(db_changelog_t) + sizeof(struct trusted_chain *));
+		if(!perm_trusted_log)
+			goto error;
+		memset(perm_trusted_log, 0, sizeof(db_changelog_t));
+		perm_trusted_old = (struct trusted_chain **)(perm_trusted_log + 1);
+		*perm_trusted_old = NULL;
+
+		perm_trusted_lock = lock_alloc();
+		if(!perm_trusted_lock || !lock_init(perm_trusted_lock))
+			goto error;
+
 		if(reload_trusted_table() == -1) {
 			LM_CRIT("reload of trusted table failed\n");
 			goto error;
@@ -260,6 +495,15 @@ error:
 		shm_free(perm_trust_table);
 		perm_trust_table = 0;
 	}
+	if(perm_trusted_lock) {
+		lock_dealloc(perm_trusted_lock);
+		perm_trusted_lock = 0;
+	}
+	if(perm_trusted_log) {
+		shm_free(perm_trusted_log);
+		perm_trusted_log = 0;
+		perm_trusted_old = 0;
+	}
 	perm_dbf.close(perm_db_handle);
 	perm_db_handle = 0;
 	return -1;
@@ -301,6 +545,8 @@ int init_child_trusted(int rank)
 
 void perm_ht_timer(unsigned int ticks, void *param)
 {
+	trusted_free_old(perm_trusted_table_interval);
+
 	if(perm_rpc_reload_time == NULL)
 		return;
 
@@ -321,12 +567,19 @@ void perm_ht_timer(unsigned int ticks, void *param)
  */
 void clean_trusted(void)
 {
+	trusted_free_old(-1);
 	if(perm_trust_table_1)
 		free_hash_table(perm_trust_table_1);
 	if(perm_trust_table_2)
 		free_hash_table(perm_trust_table_2);
 	if(perm_trust_table)
 		shm_free(perm_trust_table);
+	if(perm_trusted_lock) {
+		lock_destroy(perm_trusted_lock);
+		lock_dealloc(perm_trusted_lock);
+	}
+	if(perm_trusted_log)
+		shm_free(perm_trusted_log);
 }
 
 
@@ -403,7 +656,6 @@ static int match_res(struct sip_msg *msg, int proto, db1_res_t *_r, char *uri)
 	char ruri_string[MAX_URI_SIZE + 1];
 	db_row_t *row;
 	db_val_t *val;
-	regex_t preg;
 	int_str tag_avp, avp_val;
 	int count = 0;
 
@@ -415,6 +667,7 @@ static int match_res(struct sip_msg *msg, int proto, db1_res_t *_r, char *uri)
 		}
 		memcpy(ruri_string, ruri.s, ruri.len);
 		ruri_string[ruri.len] = (char)0;
+		perm_re_pass_start(NULL);
 	}
 	get_tag_avp(&tag_avp, &tag_avp_type);
 
@@ -440,29 +693,16 @@ static int match_res(struct sip_msg *msg, int proto, db1_res_t *_r, char *uri)
 					VAL_STRING(val + 3));
 
 			if(IS_SIP(msg)) {
-				if(!VAL_NULL(val + 1)) {
-					if(regcomp(&preg, (char *)VAL_STRING(val + 1), REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
-						if(VAL_NULL(val + 2)) {
-							continue;
-						}
-					}
-					if(regexec(&preg, uri, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
-						continue;
-					}
-					regfree(&preg);
+				if(!VAL_NULL(val + 1)
+						&& perm_re_match((char *)VAL_STRING(val + 1), uri, 0)
+								   <= 0) {
+					continue;
 				}
-				if(!VAL_NULL(val + 2)) {
-					if(regcomp(&preg, (char *)VAL_STRING(val + 2), REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
-						continue;
-					}
-					if(regexec(&preg, ruri_string, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
-						continue;
-					}
-					regfree(&preg);
+				if(!VAL_NULL(val + 2)
+						&& perm_re_match(
+								   (char *)VAL_STRING(val + 2), ruri_string, 1)
+								   <= 0) {
+					continue;
 				}
 			}
 			/* Found a match */
@@ -704,6 +944,11 @@ int reload_trusted_table_cmd(void)
 		return -1;
 	}
 
+	if(perm_trusted_lock == 0) {
+		LM_ERR("trusted table not cached\n");
+		return -1;
+	}
+
 	if(!perm_db_handle) {
 		perm_db_handle = perm_dbf.init(&perm_db_url);
 		if(!perm_db_handle) {
@@ -711,14 +956,48 @@ int reload_trusted_table_cmd(void)
 			return -1;
 		}
 	}
+	lock_get(perm_trusted_lock);
 	if(reload_trusted_table() != 1) {
+		lock_release(perm_trusted_lock);
 		perm_dbf.close(perm_db_handle);
 		perm_db_handle = 0;
 		return -1;
 	}
+	lock_release(perm_trusted_lock);
 
 	perm_dbf.close(perm_db_handle);
 	perm_db_handle = 0;
 
 	return 1;
 }
+
+int reload_trusted_changes_cmd(void)
+{
+	int ret;
+
+	if(!perm_db_url.s) {
+		LM_ERR("db_url not set\n");
+		return -1;
+	}
+
+	if(perm_trusted_lock == 0) {
+		LM_ERR("trusted table not cached\n");
+		return -1;
+	}
+
+	if(!perm_db_handle) {
+		perm_db_handle = perm_dbf.init(&perm_db_url);
+		if(!perm_db_handle) {
+			LM_ERR("unable to connect database\n");
+			return -1;
+		}
+	}
+	lock_get(perm_trusted_lock);
+	ret = reload_trusted_changes();
+	lock_release(perm_trusted_lock);
+
+	perm_dbf.close(perm_db_handle);
+	perm_db_handle = 0;
+
+	return ret;
+}
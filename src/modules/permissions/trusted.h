@@ -55,6 +55,13 @@ int init_child_trusted(int rank);
 int reload_trusted_table(void);
 
 
+/*
+ * Reload the records of the source addresses listed in trusted change log
+ * since last reload into current hash table.
+ */
+int reload_trusted_changes(void);
+
+
 /*
  * Close connections and release memory
  */
@@ -93,4 +100,6 @@ int allow_trusted_3(struct sip_msg *_msg, char *_src_ip_sp, char *_proto_sp,
 
 int reload_trusted_table_cmd(void);
 
+int reload_trusted_changes_cmd(void);
+
 #endif /* TRUSTED_H */
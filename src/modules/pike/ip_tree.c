@@ -167,6 +167,7 @@ static inline void destroy_ip_node(pike_ip_node_t *node)
 /* destroy and free the IP tree */
 void destroy_ip_tree(void)
 {
+	pike_ip_node_t *node;
 	int i;
 
 	if(pike_root == 0)
@@ -179,9 +180,13 @@ void destroy_ip_tree(void)
 	}
 
 	/* destroy all the nodes */
-	for(i = 0; i < MAX_IP_BRANCHES; i++)
-		if(pike_root->entries[i].node)
-			destroy_ip_node(pike_root->entries[i].node);
+	for(i = 0; i < MAX_IP_BRANCHES; i++) {
+		while(pike_root->entries[i].node) {
+			node = pike_root->entries[i].node;
+			pike_root->entries[i].node = node->next;
+			destroy_ip_node(node);
+		}
+	}
 
 	shm_free(pike_root);
 	pike_root = 0;
@@ -272,19 +277,39 @@ pike_node_status_t node_status(pike_ip_node_t *node)
 }
 
 
+/* get the tree branch for an IP address - the branches (and their locks)
+ * are selected by a hash over the first 2 bytes of IPv4 addresses and the
+ * first 6 bytes of IPv6 addresses, so IPv6 traffic is not serialized on
+ * the few values of the first byte */
+unsigned char get_ip_branch(unsigned char *ip, int ip_len)
+{
+	unsigned int h;
+	int n;
+	int i;
+
+	n = (ip_len == 4) ? 2 : 6;
+	if(n > ip_len)
+		n = ip_len;
+	h = 0;
+	for(i = 0; i < n; i++)
+		h = h * 31 + ip[i];
+	return (unsigned char)((h ^ (h >> 8) ^ (h >> 16)) & 0xff);
+}
+
+
 /* mark with one more hit the given IP address - */
-pike_ip_node_t *mark_node(unsigned char *ip, int ip_len,
+pike_ip_node_t *mark_node(unsigned char *ip, int ip_len, unsigned char branch,
 		pike_ip_node_t **father, unsigned char *flag)
 {
 	pike_ip_node_t *node;
 	pike_ip_node_t *kid;
 	int byte_pos;
 
-	kid = pike_root->entries[ip[0]].node;
+	kid = pike_root->entries[branch].node;
 	node = NULL;
 	byte_pos = 0;
 
-	LM_DBG("search on branch %d (top=%p)\n", ip[0], kid);
+	LM_DBG("search on branch %d (top=%p)\n", branch, kid);
 	/* search into the ip tree the longest prefix matching the given IP */
 	while(kid && byte_pos < ip_len) {
 		while(kid && kid->byte != (unsigned char)ip[byte_pos]) {
@@ -319,16 +344,20 @@ pike_ip_node_t *mark_node(unsigned char *ip, int ip_len,
 			*flag |= RED_NODE;
 		}
 	} else if(byte_pos == 0) {
-		/* we hit an empty branch in the IP tree */
+		/* no tree for the first byte of the IP in the branch */
 		assert(node == 0);
 		/* add a new node containing the start byte of the IP address */
 		if((node = new_ip_node(ip[0])) == 0)
 			return 0;
 		node->hits[CURR_POS] = 1;
-		node->branch = ip[0];
+		node->branch = branch;
 		*flag = NEW_NODE;
-		/* set this node as pike_root of the branch starting with first byte of IP*/
-		pike_root->entries[ip[0]].node = node;
+		/* link this node in the list of roots of the branch */
+		if(pike_root->entries[branch].node) {
+			pike_root->entries[branch].node->prev = node;
+			node->next = pike_root->entries[branch].node;
+		}
+		pike_root->entries[branch].node = node;
 	} else {
 		/* only a non-empty prefix of the IP was found */
 		if(node->hits[CURR_POS] < MAX_TYPE_VAL(node->hits[CURR_POS]) - 1)
@@ -356,10 +385,12 @@ pike_ip_node_t *mark_node(unsigned char *ip, int ip_len,
 void remove_node(pike_ip_node_t *node)
 {
 	LM_DBG("destroying node %p\n", node);
-	/* is it a branch pike_root node? (these nodes have no prev (father)) */
+	/* is it the head of the branch roots list? (it has no prev (father)) */
 	if(node->prev == 0) {
-		assert(pike_root->entries[node->byte].node == node);
-		pike_root->entries[node->byte].node = 0;
+		assert(pike_root->entries[node->branch].node == node);
+		pike_root->entries[node->branch].node = node->next;
+		if(node->next)
+			node->next->prev = 0;
 	} else {
 		/* unlink it from kids list */
 		if(node->prev->kids == node)
@@ -407,6 +438,7 @@ static void print_node(pike_ip_node_t *node, int sp, FILE *f)
 
 void print_tree(FILE *f)
 {
+	pike_ip_node_t *node;
 	int i;
 
 	DBG("DEBUG:pike:print_tree: printing IP tree\n");
@@ -414,8 +446,8 @@ void print_tree(FILE *f)
 		if(prv_get_tree_branch(i) == 0)
 			continue;
 		prv_lock_tree_branch(i);
-		if(prv_get_tree_branch(i))
-			print_node(prv_get_tree_branch(i), 0, f);
+		for(node = prv_get_tree_branch(i); node; node = node->next)
+			print_node(node, 0, f);
 		prv_unlock_tree_branch(i);
 	}
 }
@@ -80,7 +80,8 @@ typedef struct ip_tree
 
 int init_ip_tree(int);
 void destroy_ip_tree(void);
-pike_ip_node_t *mark_node(unsigned char *ip, int ip_len,
+unsigned char get_ip_branch(unsigned char *ip, int ip_len);
+pike_ip_node_t *mark_node(unsigned char *ip, int ip_len, unsigned char branch,
 		pike_ip_node_t **father, unsigned char *flag);
 void remove_node(pike_ip_node_t *node);
 int is_node_hot_leaf(pike_ip_node_t *node);
@@ -57,6 +57,8 @@ static int pike_time_unit = 2;
 static int pike_max_reqs = 30;
 int pike_timeout = 120;
 int pike_log_level = L_WARN;
+int pike_ipv4_prefix_len = 32;
+int pike_ipv6_prefix_len = 128;
 
 /* global variables */
 gen_lock_t *pike_timer_lock = 0;
@@ -76,6 +78,8 @@ static param_export_t params[] = {
 	{"reqs_density_per_unit", PARAM_INT, &pike_max_reqs},
 	{"remove_latency", PARAM_INT, &pike_timeout},
 	{"pike_log_level", PARAM_INT, &pike_log_level},
+	{"ipv4_prefix_len", PARAM_INT, &pike_ipv4_prefix_len},
+	{"ipv6_prefix_len", PARAM_INT, &pike_ipv6_prefix_len},
 	{0, 0, 0}
 };
 
@@ -97,6 +101,15 @@ static int pike_init(void)
 {
 	LOG(L_INFO, "PIKE - initializing\n");
 
+	if(pike_ipv4_prefix_len < 1 || pike_ipv4_prefix_len > 32) {
+		LM_ERR("invalid ipv4 prefix length: %d\n", pike_ipv4_prefix_len);
+		return -1;
+	}
+	if(pike_ipv6_prefix_len < 1 || pike_ipv6_prefix_len > 128) {
+		LM_ERR("invalid ipv6 prefix length: %d\n", pike_ipv6_prefix_len);
+		return -1;
+	}
+
 	if(rpc_register_array(pike_rpc_methods) != 0) {
 		LM_ERR("failed to register RPC commands\n");
 		return -1;
@@ -43,6 +43,8 @@ extern gen_lock_t *pike_timer_lock;
 extern pike_list_link_t *pike_timer;
 extern int pike_timeout;
 extern int pike_log_level;
+extern int pike_ipv4_prefix_len;
+extern int pike_ipv6_prefix_len;
 
 counter_handle_t blocked;
 
@@ -53,17 +55,44 @@ void pike_counter_init()
 }
 
 
+/* build the key for the IP tree - the address with the bits after the
+ * prefix length set to 0, so all the addresses in the prefix hit the
+ * same node (e.g., an IPv6 /64 sending from random addresses) */
+static inline void pike_ip_key(ip_addr_t *ip, unsigned char *key)
+{
+	int plen;
+	int i;
+
+	plen = (ip->len == 4) ? pike_ipv4_prefix_len : pike_ipv6_prefix_len;
+	memcpy(key, ip->u.addr, ip->len);
+	if(plen <= 0 || plen >= ip->len * 8)
+		return;
+	i = plen >> 3;
+	if(plen & 0x07) {
+		key[i] &= (unsigned char)(0xff << (8 - (plen & 0x07)));
+		i++;
+	}
+	for(; i < ip->len; i++)
+		key[i] = 0;
+}
+
+
 int pike_check_ipaddr(sip_msg_t *msg, ip_addr_t *ip)
 {
 	pike_ip_node_t *node;
 	pike_ip_node_t *father;
 	unsigned char flags;
+	unsigned char key[16];
+	unsigned char branch;
+
+	pike_ip_key(ip, key);
+	branch = get_ip_branch(key, ip->len);
 
 	/* first lock the proper tree branch and mark the IP with one more hit*/
-	lock_tree_branch(ip->u.addr[0]);
-	node = mark_node(ip->u.addr, ip->len, &father, &flags);
+	lock_tree_branch(branch);
+	node = mark_node(key, ip->len, branch, &father, &flags);
 	if(node == 0) {
-		unlock_tree_branch(ip->u.addr[0]);
+		unlock_tree_branch(branch);
 		/* even if this is an error case, we return true in script to avoid
 		 * considering the IP as marked (bogdan) */
 		return 1;
@@ -128,7 +157,7 @@ int pike_check_ipaddr(sip_msg_t *msg, ip_addr_t *ip)
 	/*print_timer_list( pike_timer );*/ /* debug*/
 	lock_release(pike_timer_lock);
 
-	unlock_tree_branch(ip->u.addr[0]);
+	unlock_tree_branch(branch);
 	/*print_tree( 0 );*/ /* debug */
 
 	if(flags & RED_NODE) {
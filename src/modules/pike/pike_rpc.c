@@ -92,6 +92,7 @@ while(foo) {
 
 static void collect_data(int options)
 {
+	pike_ip_node_t *node;
 	int i;
 
 	g_max_hits = get_max_hits();
@@ -104,8 +105,8 @@ static void collect_data(int options)
 			continue;
 		DBG("pike: collect_data: branch %d", i);
 		lock_tree_branch(i);
-		if(get_tree_branch(i))
-			traverse_subtree(get_tree_branch(i), 0, options);
+		for(node = get_tree_branch(i); node; node = node->next)
+			traverse_subtree(node, 0, options);
 		unlock_tree_branch(i);
 	}
 }
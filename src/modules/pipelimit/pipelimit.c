@@ -61,6 +61,8 @@
 #include "pl_statistics.h"
 #include "pl_ht.h"
 #include "pl_db.h"
+#include "pl_gcra.h"
+#include "pl_dmq.h"
 
 MODULE_VERSION
 
@@ -95,6 +97,7 @@ typedef struct pl_queue {
 static int pl_drop_code = 503;
 static str pl_drop_reason = str_init("Server Unavailable");
 static int pl_hash_size = 6;
+static int pl_gcra_size = 0;
 
 static struct timer_ln *pl_timer = NULL;
 
@@ -108,6 +111,8 @@ static int *drop_rate = NULL;	 /* updated by PIPE_ALGO_FEEDBACK */
 
 static int *network_load_value = NULL; /* network load */
 
+static ticks_t *pl_interval_start = NULL; /* start of current interval */
+
 /* where to get the load for feedback. values: cpu, external */
 static int load_source_mp = LOAD_SOURCE_CPU;
 static int *load_source = NULL;
@@ -117,6 +122,7 @@ static int pl_timer_interval = PL_TIMER_INTERVAL_DEFAULT;
 static int pl_timer_mode = 0;
 int _pl_cfg_setpoint = 0; /* desired load, used when reading modparams */
 int pl_clean_unused = 0;
+static int pl_dmq_interval = 1;
 
 /* === */
 
@@ -126,15 +132,19 @@ static int pl_load_fetch = 1;
 static int mod_init(void);
 static ticks_t pl_timer_handle(ticks_t, struct timer_ln *, void *);
 static void pl_timer_exec(unsigned int ticks, void *param);
+static void pl_dmq_timer_exec(unsigned int ticks, void *param);
 static int w_pl_check(struct sip_msg *, char *, char *);
 static int w_pl_check3(struct sip_msg *, char *, char *, char *);
 static int w_pl_active(sip_msg_t *, char *, char *);
 static int w_pl_drop_default(struct sip_msg *, char *, char *);
 static int w_pl_drop_forced(struct sip_msg *, char *, char *);
 static int w_pl_drop(struct sip_msg *, char *, char *);
+static int w_pl_check_gcra(struct sip_msg *, char *, char *, char *);
 static void destroy(void);
 static int fixup_pl_check3(void **param, int param_no);
 static int fixup_free_pl_check3(void **param, int param_no);
+static int fixup_pl_check_gcra(void **param, int param_no);
+static int fixup_free_pl_check_gcra(void **param, int param_no);
 
 /* clang-format off */
 static cmd_export_t cmds[] = {
@@ -144,6 +154,8 @@ static cmd_export_t cmds[] = {
 		fixup_pl_check3, fixup_free_pl_check3, ANY_ROUTE},
 	{"pl_active", (cmd_function)w_pl_active, 1,
 		fixup_spve_null, fixup_free_spve_null, ANY_ROUTE},
+	{"pl_check_gcra", (cmd_function)w_pl_check_gcra, 3,
+		fixup_pl_check_gcra, fixup_free_pl_check_gcra, ANY_ROUTE},
 	{"pl_drop", (cmd_function)w_pl_drop_default, 0,
 		0, 0, REQUEST_ROUTE | BRANCH_ROUTE | FAILURE_ROUTE | ONSEND_ROUTE},
 	{"pl_drop", (cmd_function)w_pl_drop_forced, 1,
@@ -164,8 +176,11 @@ static param_export_t params[] = {
 	{"plp_limit_column", PARAM_STR, &rlp_limit_col},
 	{"plp_algorithm_column", PARAM_STR, &rlp_algorithm_col},
 	{"hash_size", PARAM_INT, &pl_hash_size},
+	{"gcra_size", PARAM_INT, &pl_gcra_size},
 	{"load_fetch", PARAM_INT, &pl_load_fetch},
 	{"clean_unused", PARAM_INT, &pl_clean_unused},
+	{"dmq_mode", PARAM_INT, &pl_dmq_mode},
+	{"dmq_interval", PARAM_INT, &pl_dmq_interval},
 
 	{0, 0, 0}
 };
@@ -355,6 +370,28 @@ static int mod_init(void)
 		LM_ERR("could not allocate pipes htable\n");
 		return -1;
 	}
+	if(pl_gcra_size < 0 || pl_gcra_size > 30) {
+		LM_ERR("invalid gcra size parameter: %d\n", pl_gcra_size);
+		return -1;
+	}
+	if(pl_gcra_size > 0 && pl_gcra_init(1 << pl_gcra_size) < 0) {
+		LM_ERR("could not allocate gcra slots table\n");
+		return -1;
+	}
+	if(pl_dmq_mode != 0) {
+		if(pl_dmq_interval <= 0) {
+			LM_ERR("invalid dmq interval parameter: %d\n", pl_dmq_interval);
+			return -1;
+		}
+		if(pl_dmq_init() < 0) {
+			LM_ERR("failed to initialize dmq integration\n");
+			return -1;
+		}
+		if(sr_wtimer_add(pl_dmq_timer_exec, NULL, pl_dmq_interval) < 0) {
+			LM_ERR("cannot add dmq timer exec routine\n");
+			return -1;
+		}
+	}
 	if(pl_init_db() < 0) {
 		LM_ERR("could not load pipes description\n");
 		return -1;
@@ -423,6 +460,11 @@ static int mod_init(void)
 		LM_ERR("oom for drop_rate\n");
 		return -1;
 	}
+	pl_interval_start = shm_malloc(sizeof(ticks_t));
+	if(pl_interval_start == NULL) {
+		LM_ERR("oom for interval_start\n");
+		return -1;
+	}
 
 	*network_load_value = 0;
 	*load_value = 0.0;
@@ -432,6 +474,7 @@ static int mod_init(void)
 	*pid_kd = 0.0;
 	*_pl_pid_setpoint = 0.01 * (double)_pl_cfg_setpoint;
 	*drop_rate = 0;
+	*pl_interval_start = get_ticks_raw();
 
 	return 0;
 }
@@ -439,6 +482,7 @@ static int mod_init(void)
 
 static void destroy(void)
 {
+	pl_gcra_destroy();
 	LM_DBG("done");
 }
 
@@ -533,6 +577,26 @@ int hash[100] = {18, 50, 51, 39, 49, 68, 8, 78, 61, 75, 53, 32, 45, 77, 31, 12,
 		71, 23, 2, 67, 36, 65, 27, 1, 19, 59, 89, 48};
 
 
+/**
+ * sliding window estimate of the cluster wide counter: the current
+ * interval plus the part of the previous one still inside the window
+ */
+static int pipe_window_counter(pl_pipe_t *pipe)
+{
+	ticks_t itv;
+	ticks_t elapsed;
+	long last;
+
+	itv = S_TO_TICKS(pl_timer_interval);
+	elapsed = get_ticks_raw() - *pl_interval_start;
+	if(itv == 0 || elapsed >= itv)
+		return pipe->counter + pipe->remote_counter;
+
+	last = (long)(pipe->last_counter + pipe->last_remote_counter);
+	return pipe->counter + pipe->remote_counter
+		   + (int)(last * (long)(itv - elapsed) / (long)itv);
+}
+
 /**
  * runs the pipe's algorithm
  * (expects pl_lock to be taken), TODO revert to "return" instead of "ret ="
@@ -551,7 +615,10 @@ static int pipe_push_direct(pl_pipe_t *pipe)
 			ret = 2;
 			break;
 		case PIPE_ALGO_TAILDROP:
-			ret = (pipe->counter <= pipe->limit) ? 1 : -1;
+			if(pl_dmq_mode != 0)
+				ret = (pipe_window_counter(pipe) <= pipe->limit) ? 1 : -1;
+			else
+				ret = (pipe->counter <= pipe->limit) ? 1 : -1;
 			break;
 		case PIPE_ALGO_RED:
 			if(pipe->load == 0)
@@ -569,6 +636,9 @@ static int pipe_push_direct(pl_pipe_t *pipe)
 			LM_ERR("unknown ratelimit algorithm: %d\n", pipe->algo);
 			ret = 1;
 	}
+	/* only the accepted requests are sent to the cluster */
+	if(pl_dmq_mode != 0 && ret > 0)
+		pipe->dmq_delta++;
 	LM_DBG("pipe=%.*s algo=%d limit=%d pkg_load=%d counter=%d "
 		   "load=%2.1lf network_load=%d => %s\n",
 			pipe->name.len, pipe->name.s, pipe->algo, pipe->limit, pipe->load,
@@ -706,6 +776,55 @@ static int fixup_free_pl_check3(void **param, int param_no)
 	return 0;
 }
 
+/**
+ * per key limit checking with GCRA, no pipe has to be defined
+ */
+static int pl_check_gcra(sip_msg_t *msg, str *key, int rate, int burst)
+{
+	return pl_gcra_check(key, rate, burst);
+}
+
+static int w_pl_check_gcra(
+		struct sip_msg *msg, char *p1key, char *p2rate, char *p3burst)
+{
+	int rate = 0;
+	int burst = 0;
+	str key = {0, 0};
+
+	if(fixup_get_svalue(msg, (gparam_t *)p1key, &key) != 0 || key.s == 0) {
+		LM_ERR("invalid key parameter");
+		return -1;
+	}
+	if(fixup_get_ivalue(msg, (gparam_t *)p2rate, &rate) != 0 || rate <= 0) {
+		LM_ERR("invalid rate value: %d\n", rate);
+		return -1;
+	}
+	if(fixup_get_ivalue(msg, (gparam_t *)p3burst, &burst) != 0 || burst < 0) {
+		LM_ERR("invalid burst value: %d\n", burst);
+		return -1;
+	}
+
+	return pl_check_gcra(msg, &key, rate, burst);
+}
+
+static int fixup_pl_check_gcra(void **param, int param_no)
+{
+	if(param_no == 1)
+		return fixup_spve_null(param, 1);
+	if(param_no == 2 || param_no == 3)
+		return fixup_igp_null(param, 1);
+	return 0;
+}
+
+static int fixup_free_pl_check_gcra(void **param, int param_no)
+{
+	if(param_no == 1)
+		return fixup_free_spve_null(param, 1);
+	if(param_no == 2 || param_no == 3)
+		return fixup_free_igp_null(param, 1);
+	return 0;
+}
+
 static int pl_active(sip_msg_t *msg, str *pipeid)
 {
 	pl_pipe_t *pipe = NULL;
@@ -747,6 +866,7 @@ static void pl_timer_refresh(void)
 	}
 
 	pl_pipe_timer_update(pl_timer_interval, *network_load_value);
+	*pl_interval_start = get_ticks_raw();
 }
 
 /* timer housekeeping, invoked each timer interval to reset counters */
@@ -761,6 +881,12 @@ static void pl_timer_exec(unsigned int ticks, void *param)
 	pl_timer_refresh();
 }
 
+/* send the local pipe counters to the other cluster nodes */
+static void pl_dmq_timer_exec(unsigned int ticks, void *param)
+{
+	pl_dmq_send_counters();
+}
+
 
 /* rpc function documentation */
 const char *rpc_pl_stats_doc[2] = {
@@ -887,6 +1013,11 @@ static sr_kemi_t sr_kemi_pipelimit_exports[] = {
 		{ SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_INT,
 			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
 	},
+	{ str_init("pipelimit"), str_init("pl_check_gcra"),
+		SR_KEMIP_INT, pl_check_gcra,
+		{ SR_KEMIP_STR, SR_KEMIP_INT, SR_KEMIP_INT,
+			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+	},
 	{ str_init("pipelimit"), str_init("pl_active"),
 		SR_KEMIP_INT, pl_active,
 		{ SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
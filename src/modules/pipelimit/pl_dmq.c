@@ -0,0 +1,264 @@
+/*
+ * pipelimit module
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \ingroup pipelimit
+ * \brief pipelimit :: pl_dmq
+ *
+ * Exchange of pipe counters between cluster nodes over DMQ. Each node
+ * periodically broadcasts the number of requests it accepted per pipe
+ * since the previous broadcast. The receiving nodes add them to the
+ * remote counter of the local pipe with the same name, so the limit
+ * is checked against the traffic of the whole cluster.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/ut.h"
+#include "../../core/utils/srjson.h"
+#include "../../core/parser/msg_parser.h"
+#include "../../core/parser/parse_content.h"
+
+#include "pl_ht.h"
+#include "pl_dmq.h"
+
+int pl_dmq_mode = 0;
+
+static str pl_dmq_content_type = str_init("application/json");
+static str pl_dmq_200_rpl = str_init("OK");
+static str pl_dmq_400_rpl = str_init("Bad Request");
+
+static dmq_api_t pl_dmqb;
+static dmq_peer_t *pl_dmq_peer = NULL;
+
+/**
+ * register pipelimit dmq peer
+ */
+int pl_dmq_init(void)
+{
+	dmq_peer_t not_peer;
+
+	if(dmq_load_api(&pl_dmqb) != 0) {
+		LM_ERR("cannot load dmq api\n");
+		return -1;
+	}
+
+	memset(&not_peer, 0, sizeof(dmq_peer_t));
+	not_peer.callback = pl_dmq_handle_msg;
+	not_peer.description.s = "pipelimit";
+	not_peer.description.len = 9;
+	not_peer.peer_id.s = "pipelimit";
+	not_peer.peer_id.len = 9;
+	pl_dmq_peer = pl_dmqb.register_dmq_peer(&not_peer);
+	if(pl_dmq_peer == NULL) {
+		LM_ERR("error in register_dmq_peer\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * handle the counters received from another node
+ */
+int pl_dmq_handle_msg(
+		struct sip_msg *msg, peer_reponse_t *resp, dmq_node_t *node)
+{
+	int content_length = 0;
+	srjson_doc_t jdoc;
+	srjson_t *pipes = NULL;
+	srjson_t *it = NULL;
+	srjson_t *jp = NULL;
+	str body = STR_NULL;
+	str name = STR_NULL;
+	int count;
+
+	srjson_InitDoc(&jdoc, NULL);
+
+	if(!msg->content_length) {
+		LM_ERR("no content length header found\n");
+		goto invalid;
+	}
+	content_length = get_content_length(msg);
+	if(!content_length) {
+		LM_DBG("content length is 0\n");
+		goto invalid;
+	}
+
+	body.s = get_body(msg);
+	body.len = content_length;
+	if(!body.s) {
+		LM_ERR("unable to get body\n");
+		goto invalid;
+	}
+
+	LM_DBG("body: %.*s\n", body.len, body.s);
+
+	jdoc.buf = body;
+	jdoc.root = srjson_Parse(&jdoc, jdoc.buf.s);
+	if(jdoc.root == NULL) {
+		LM_ERR("invalid json doc [[%.*s]]\n", body.len, body.s);
+		goto invalid;
+	}
+
+	for(it = jdoc.root->child; it; it = it->next) {
+		if(it->string != NULL && strcmp(it->string, "pipes") == 0) {
+			pipes = it;
+			break;
+		}
+	}
+	if(pipes == NULL) {
+		LM_ERR("no pipes in json object\n");
+		goto invalid;
+	}
+
+	for(it = pipes->child; it; it = it->next) {
+		name.s = NULL;
+		count = 0;
+		for(jp = it->child; jp; jp = jp->next) {
+			if(jp->string == NULL)
+				continue;
+			if(strcmp(jp->string, "name") == 0 && jp->valuestring != NULL) {
+				name.s = jp->valuestring;
+				name.len = strlen(jp->valuestring);
+			} else if(strcmp(jp->string, "count") == 0) {
+				count = SRJSON_GET_INT(jp);
+			}
+		}
+		if(name.s == NULL || name.len <= 0 || count <= 0) {
+			LM_DBG("skipping incomplete pipe entry\n");
+			continue;
+		}
+		pl_pipe_add_remote(&name, count);
+	}
+
+	resp->reason = pl_dmq_200_rpl;
+	resp->resp_code = 200;
+	goto cleanup;
+
+invalid:
+	resp->reason = pl_dmq_400_rpl;
+	resp->resp_code = 400;
+
+cleanup:
+	srjson_DestroyDoc(&jdoc);
+
+	return 0;
+}
+
+/**
+ * add one pipe to the json array - its delta is reset once the broadcast
+ * is sent
+ */
+static int pl_dmq_add_pipe(pl_pipe_t *pipe, void *param)
+{
+	srjson_doc_t *jdoc = (srjson_doc_t *)param;
+	srjson_t *pipes;
+	srjson_t *jp;
+
+	pipes = jdoc->root->child;
+	jp = srjson_CreateObject(jdoc);
+	if(jp == NULL) {
+		LM_ERR("cannot create json object\n");
+		return -1;
+	}
+	srjson_AddStrToObject(jdoc, jp, "name", pipe->name.s, pipe->name.len);
+	srjson_AddNumberToObject(jdoc, jp, "count", pipe->dmq_delta);
+	srjson_AddItemToArray(jdoc, pipes, jp);
+	pipe->dmq_sent = pipe->dmq_delta;
+
+	return 0;
+}
+
+/**
+ * remove the sent requests from the delta of the pipe, or keep them
+ * for the next broadcast if it failed
+ */
+static int pl_dmq_sent_pipe(pl_pipe_t *pipe, void *param)
+{
+	if(*(int *)param == 0)
+		pipe->dmq_delta -= pipe->dmq_sent;
+	pipe->dmq_sent = 0;
+
+	return 0;
+}
+
+/**
+ * broadcast the requests counted locally since the last call
+ */
+int pl_dmq_send_counters(void)
+{
+	srjson_doc_t jdoc;
+	srjson_t *pipes;
+	int ret = -1;
+
+	if(pl_dmq_peer == NULL) {
+		return -1;
+	}
+
+	srjson_InitDoc(&jdoc, NULL);
+
+	jdoc.root = srjson_CreateObject(&jdoc);
+	if(jdoc.root == NULL) {
+		LM_ERR("cannot create json root\n");
+		goto done;
+	}
+	pipes = srjson_CreateArray(&jdoc);
+	if(pipes == NULL) {
+		LM_ERR("cannot create json array\n");
+		goto done;
+	}
+	srjson_AddItemToObject(&jdoc, jdoc.root, "pipes", pipes);
+
+	if(pl_pipe_dmq_walk(pl_dmq_add_pipe, &jdoc) < 0) {
+		goto done;
+	}
+	if(pipes->child == NULL) {
+		/* nothing to send */
+		ret = 0;
+		goto done;
+	}
+
+	jdoc.buf.s = srjson_PrintUnformatted(&jdoc, jdoc.root);
+	if(jdoc.buf.s == NULL) {
+		LM_ERR("unable to serialize data\n");
+		goto done;
+	}
+	jdoc.buf.len = strlen(jdoc.buf.s);
+	LM_DBG("sending serialized data %.*s\n", jdoc.buf.len, jdoc.buf.s);
+	if(pl_dmqb.bcast_message(
+			   pl_dmq_peer, &jdoc.buf, 0, NULL, 1, &pl_dmq_content_type)
+			< 0) {
+		LM_ERR("failed to broadcast pipe counters\n");
+		goto done;
+	}
+	ret = 0;
+
+done:
+	pl_pipe_dmq_walk(pl_dmq_sent_pipe, &ret);
+	if(jdoc.buf.s != NULL) {
+		jdoc.free_fn(jdoc.buf.s);
+		jdoc.buf.s = NULL;
+	}
+	srjson_DestroyDoc(&jdoc);
+	return ret;
+}
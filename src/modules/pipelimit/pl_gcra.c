@@ -0,0 +1,207 @@
+/*
+ * pipelimit module
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \ingroup pipelimit
+ * \brief pipelimit :: pl_gcra
+ *
+ * Generic Cell Rate Algorithm (token bucket equivalent) keyed by
+ * arbitrary strings. Each key keeps only its theoretical arrival time
+ * (TAT) in one slot of a fixed shared memory table. A slot is a long
+ * value holding a 16 bit key fingerprint in the upper bits and the TAT
+ * in microseconds in the lower 48 bits, updated with compare-and-swap,
+ * so no lock is taken on the hot path. Slots whose TAT is in the past
+ * carry no state and are reused by other keys (lazy eviction). A slot
+ * with live state is never given to another key: when all the probed
+ * slots are in use, the new key shares the limit of the home slot owner.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "../../core/dprint.h"
+#include "../../core/hashes.h"
+#include "../../core/atomic_ops.h"
+#include "../../core/mem/shm_mem.h"
+
+#include "pl_gcra.h"
+
+#define PL_GCRA_TAT_BITS 48
+#define PL_GCRA_TAT_MASK ((1UL << PL_GCRA_TAT_BITS) - 1)
+#define PL_GCRA_FP(v) ((unsigned long)(v) >> PL_GCRA_TAT_BITS)
+#define PL_GCRA_TAT(v) ((unsigned long)(v)&PL_GCRA_TAT_MASK)
+#define PL_GCRA_SLOT(fp, tat) \
+	((long)(((unsigned long)(fp) << PL_GCRA_TAT_BITS) | ((tat)&PL_GCRA_TAT_MASK)))
+
+/* number of consecutive slots probed for a key */
+#define PL_GCRA_PROBES 4
+
+static volatile long *_pl_gcra_slots = NULL;
+static unsigned int _pl_gcra_mask = 0;
+
+/**
+ * monotonic time in microseconds, truncated to the TAT width
+ */
+static inline unsigned long pl_gcra_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((unsigned long)ts.tv_sec * 1000000UL
+				   + (unsigned long)ts.tv_nsec / 1000UL)
+		   & PL_GCRA_TAT_MASK;
+}
+
+/**
+ * allocate the slots table - size must be a power of two
+ */
+int pl_gcra_init(unsigned int size)
+{
+	if(sizeof(long) < 8) {
+		LM_ERR("gcra limiter requires 64bit long values\n");
+		return -1;
+	}
+	_pl_gcra_slots = (volatile long *)shm_malloc(size * sizeof(long));
+	if(_pl_gcra_slots == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset((void *)_pl_gcra_slots, 0, size * sizeof(long));
+	_pl_gcra_mask = size - 1;
+
+	return 0;
+}
+
+void pl_gcra_destroy(void)
+{
+	if(_pl_gcra_slots != NULL) {
+		shm_free((void *)_pl_gcra_slots);
+		_pl_gcra_slots = NULL;
+	}
+}
+
+/**
+ * find the slot for a key: the one with the same fingerprint, else the
+ * first one with expired state, else the home slot, shared with the
+ * key owning it
+ */
+static volatile long *pl_gcra_slot(
+		unsigned int hid, unsigned long fp, unsigned long now)
+{
+	volatile long *free_slot = NULL;
+	long v;
+	int i;
+
+	for(i = 0; i < PL_GCRA_PROBES; i++) {
+		v = atomic_get_long(&_pl_gcra_slots[(hid + i) & _pl_gcra_mask]);
+		if(PL_GCRA_FP(v) == fp) {
+			return &_pl_gcra_slots[(hid + i) & _pl_gcra_mask];
+		}
+		if(free_slot == NULL && PL_GCRA_TAT(v) <= now) {
+			free_slot = &_pl_gcra_slots[(hid + i) & _pl_gcra_mask];
+		}
+	}
+	if(free_slot != NULL) {
+		return free_slot;
+	}
+	return &_pl_gcra_slots[hid & _pl_gcra_mask];
+}
+
+/**
+ * conform check for key at rate requests/second, allowing burst
+ * back-to-back requests
+ * - return: 1 - accepted; -1 - rejected; -2 - error
+ */
+int pl_gcra_check(str *key, int rate, int burst)
+{
+	volatile long *slot;
+	unsigned long now;
+	unsigned long fp;
+	unsigned long sfp;
+	unsigned long tat;
+	unsigned long itv;
+	unsigned long tau;
+	unsigned int hid;
+	long ov;
+	long nv;
+	int reprobe;
+
+	if(_pl_gcra_slots == NULL) {
+		LM_ERR("gcra limiter not enabled (see gcra_size parameter)\n");
+		return -2;
+	}
+	if(key == NULL || key->s == NULL || key->len <= 0 || rate <= 0) {
+		LM_ERR("invalid parameters\n");
+		return -2;
+	}
+	if(burst <= 0) {
+		burst = 1;
+	}
+
+	itv = 1000000UL / (unsigned long)rate;
+	if(itv == 0) {
+		itv = 1;
+	}
+	tau = itv * (unsigned long)(burst - 1);
+
+	hid = get_hash1_raw(key->s, key->len);
+	/* fingerprint 0 is reserved for never used slots */
+	fp = (get_hash1_raw2(key->s, key->len) >> 16) | 1;
+
+	now = pl_gcra_now();
+	slot = pl_gcra_slot(hid, fp, now);
+	reprobe = 1;
+
+	for(;;) {
+		ov = atomic_get_long(slot);
+		if(PL_GCRA_FP(ov) == fp) {
+			sfp = fp;
+			tat = PL_GCRA_TAT(ov);
+		} else if(PL_GCRA_TAT(ov) <= now) {
+			/* expired state of another key, taken over */
+			sfp = fp;
+			tat = now;
+		} else if(reprobe) {
+			/* the slot was taken meanwhile by another key */
+			reprobe = 0;
+			slot = pl_gcra_slot(hid, fp, now);
+			continue;
+		} else {
+			/* live state of another key and no free slot around: the
+			 * keys share its limit, the owner keeps the slot, so that
+			 * a full table makes the limits stricter, not looser */
+			sfp = PL_GCRA_FP(ov);
+			tat = PL_GCRA_TAT(ov);
+		}
+		if(tat < now) {
+			tat = now;
+		}
+		if(tat - now > tau) {
+			LM_DBG("key [%.*s] over limit\n", key->len, key->s);
+			return -1;
+		}
+		nv = PL_GCRA_SLOT(sfp, tat + itv);
+		if(atomic_cmpxchg_long(slot, ov, nv) == ov) {
+			return 1;
+		}
+	}
+}
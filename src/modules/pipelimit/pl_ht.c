@@ -41,6 +41,7 @@
 #include "../../core/rpc_lookup.h"
 
 #include "pl_ht.h"
+#include "pl_dmq.h"
 
 static rlp_htable_t *_pl_pipes_ht = NULL;
 extern int pl_clean_unused;
@@ -370,7 +371,7 @@ void pl_pipe_timer_update(int interval, int netload)
 		it = _pl_pipes_ht->slots[i].first;
 		while(it) {
 			if(pl_clean_unused) {
-				if(it->counter > 0) {
+				if(it->counter > 0 || it->remote_counter > 0) {
 					// used, reset unused intervals counter
 					it->unused_intervals = 0;
 				} else {
@@ -398,10 +399,12 @@ void pl_pipe_timer_update(int interval, int netload)
 				if(it->algo == PIPE_ALGO_NETWORK) {
 					it->load = (netload > it->limit) ? 1 : -1;
 				} else if(it->limit && interval) {
-					it->load = it->counter / it->limit;
+					it->load = (it->counter + it->remote_counter) / it->limit;
 				}
 				it->last_counter = it->counter;
 				it->counter = 0;
+				it->last_remote_counter = it->remote_counter;
+				it->remote_counter = 0;
 			}
 
 			it = it->next;
@@ -410,6 +413,52 @@ void pl_pipe_timer_update(int interval, int netload)
 	}
 }
 
+/**
+ * add the requests counted by another cluster node to a pipe
+ */
+int pl_pipe_add_remote(str *pipeid, int count)
+{
+	pl_pipe_t *it;
+
+	it = pl_pipe_get(pipeid, 1);
+	if(it == NULL) {
+		LM_DBG("no local pipe [%.*s] for remote counter\n", pipeid->len,
+				pipeid->s);
+		return 0;
+	}
+	it->remote_counter += count;
+	pl_pipe_release(pipeid);
+
+	return 1;
+}
+
+/**
+ * run f() for each pipe with requests not yet sent to the cluster,
+ * with the slot locked
+ */
+int pl_pipe_dmq_walk(pl_pipe_walk_f f, void *param)
+{
+	int i;
+	pl_pipe_t *it;
+
+	if(_pl_pipes_ht == NULL)
+		return -1;
+
+	for(i = 0; i < _pl_pipes_ht->htsize; i++) {
+		lock_get(&_pl_pipes_ht->slots[i].lock);
+		for(it = _pl_pipes_ht->slots[i].first; it; it = it->next) {
+			if(it->dmq_delta <= 0)
+				continue;
+			if(f(it, param) < 0) {
+				lock_release(&_pl_pipes_ht->slots[i].lock);
+				return -1;
+			}
+		}
+		lock_release(&_pl_pipes_ht->slots[i].lock);
+	}
+	return 0;
+}
+
 extern int _pl_cfg_setpoint;
 extern double *_pl_pid_setpoint;
 
@@ -516,6 +565,13 @@ int rpc_pl_list_pipe(rpc_t *rpc, void *c, pl_pipe_t *it)
 		rpc->fault(c, 500, "Internal error address list structure");
 		return -1;
 	}
+	if(pl_dmq_mode != 0
+			&& rpc->struct_add(th, "dd", "remote_counter", it->remote_counter,
+					   "last_remote_counter", it->last_remote_counter)
+					   < 0) {
+		rpc->fault(c, 500, "Internal error address list structure");
+		return -1;
+	}
 	return 0;
 }
 
@@ -615,6 +671,8 @@ void rpc_pl_reset_pipe(rpc_t *rpc, void *c)
 
 	it->counter = 0;
 	it->last_counter = 0;
+	it->remote_counter = 0;
+	it->last_remote_counter = 0;
 	it->load = 0;
 	it->unused_intervals = 0;
 
@@ -49,6 +49,13 @@ typedef struct _pl_pipe
 	int load;
 	int unused_intervals;
 
+	/* cluster (dmq) mode: counters of the other nodes and local
+	 * requests not yet sent to them */
+	int remote_counter;
+	int last_remote_counter;
+	int dmq_delta;
+	int dmq_sent; /* part of dmq_delta in the broadcast being sent */
+
 	struct _pl_pipe *prev;
 	struct _pl_pipe *next;
 } pl_pipe_t;
@@ -74,6 +81,9 @@ int pl_pipe_add(str *pipeid, str *algorithm, int limit);
 int pl_print_pipes(void);
 int pl_pipe_check_feedback_setpoints(int *cfgsp);
 void pl_pipe_timer_update(int interval, int netload);
+int pl_pipe_add_remote(str *pipeid, int count);
+typedef int (*pl_pipe_walk_f)(pl_pipe_t *pipe, void *param);
+int pl_pipe_dmq_walk(pl_pipe_walk_f f, void *param);
 
 void rpl_pipe_lock(int slot);
 void rpl_pipe_release(int slot);
@@ -60,6 +60,7 @@ MODULE_VERSION
 static char *db_url = DEFAULT_DB_URL;
 static char *db_table = "prefix_route";
 static int prefix_route_exit = 1;
+static char *db_file = NULL;
 
 static int add_route(
 		struct tree_item *root, const char *prefix, const char *route)
@@ -107,6 +108,10 @@ int pr_db_load(void)
 			{.name = "comment", .type = DB_CSTR},
 			{.name = NULL, .type = DB_NONE}};
 
+	/* Records from prefix file, mapped again by all processes */
+	if(db_file)
+		return tree_file_reload();
+
 	ctx = db_ctx("prefix_route");
 	if(!ctx) {
 		LM_ERR("db_ctx() failed\n");
@@ -201,6 +206,16 @@ out:
  */
 static int mod_init(void)
 {
+	/* Map prefix file, no database */
+	if(db_file && *db_file) {
+		if(0 != tree_file_init(db_file, db_table)) {
+			LM_CRIT("prefix file load failed\n\n");
+			return -1;
+		}
+		return 0;
+	}
+	db_file = NULL;
+
 	/* Initialise tree */
 	if(0 != tree_init()) {
 		LM_CRIT("tree init failed\n\n");
@@ -340,6 +355,7 @@ static param_export_t params[] = {
 	{"db_url", PARAM_STRING, &db_url},
 	{"db_table", PARAM_STRING, &db_table},
 	{"exit", PARAM_INT, &prefix_route_exit},
+	{"db_file", PARAM_STRING, &db_file},
 	{0, 0, 0}
 };
 
@@ -36,6 +36,9 @@
 #include "../../core/str.h"
 #include "../../core/lock_alloc.h"
 #include "../../core/lock_ops.h"
+#include "../../core/mem/mem.h"
+#include "../../core/route.h"
+#include "../../core/utils/pfxdb.h"
 #include "tree.h"
 
 
@@ -299,6 +302,202 @@ static struct tree *tree_get(void)
 }
 
 
+/** Prefix file used instead of the tree (db_file parameter) */
+static pfxdb_handle_t *tree_file = NULL;
+static str tree_file_table = STR_NULL;
+static int *tree_file_routes = NULL; /**< Route number of each value */
+static int tree_file_version = -1;
+
+
+/**
+ * Resolve the route names of a prefix file, NULL if one is not defined
+ */
+static int *tree_file_routes_get(pfxdb_t *db)
+{
+	pfxdb_val_t *v;
+	char *name;
+	int *routes;
+	uint32_t i;
+
+	routes = (int *)pkg_malloc((db->hdr->nvals + 1) * sizeof(int));
+	if(NULL == routes) {
+		PKG_MEM_ERROR;
+		return NULL;
+	}
+
+	for(i = 0; i < db->hdr->nvals; i++) {
+		v = &db->vals[i];
+		name = db->strs + v->off;
+		if((uint64_t)v->off + v->len >= db->hdr->strs_size
+				|| name[v->len] != '\0') {
+			LM_CRIT("invalid route name %u in prefix file\n", i);
+			goto error;
+		}
+		routes[i] = route_lookup(&main_rt, name);
+		if(routes[i] < 0) {
+			LM_CRIT("route name '%s' is not defined\n", name);
+			goto error;
+		}
+		if(routes[i] >= main_rt.entries) {
+			LM_CRIT("route %d > n_entries (%d)\n", routes[i], main_rt.entries);
+			goto error;
+		}
+	}
+
+	return routes;
+
+error:
+	pkg_free(routes);
+	return NULL;
+}
+
+
+int tree_file_init(char *path, char *table)
+{
+	int t;
+
+	tree_file = (pfxdb_handle_t *)pkg_malloc(sizeof(*tree_file));
+	if(NULL == tree_file) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	if(pfxdb_handle_init(tree_file, path) < 0) {
+		pkg_free(tree_file);
+		tree_file = NULL;
+		return -1;
+	}
+
+	tree_file_table.s = table;
+	tree_file_table.len = strlen(table);
+
+	tree_file_routes = tree_file_routes_get(tree_file->db);
+	if(NULL == tree_file_routes) {
+		tree_close();
+		return -1;
+	}
+	tree_file_version = tree_file->lversion;
+
+	t = pfxdb_table_get(tree_file->db, &tree_file_table);
+	LM_NOTICE("Total prefix routes mapped: %u\n",
+			(t < 0) ? 0 : tree_file->db->tables[t].nrecs);
+
+	return 0;
+}
+
+
+int tree_file_reload(void)
+{
+	pfxdb_t *db;
+	int *routes;
+
+	if(NULL == tree_file)
+		return -1;
+
+	/* check the routes before asking all processes to use the file */
+	db = pfxdb_open(tree_file->path);
+	if(NULL == db)
+		return -1;
+	routes = tree_file_routes_get(db);
+	pfxdb_close(db);
+	if(NULL == routes)
+		return -1;
+	pkg_free(routes);
+
+	return pfxdb_handle_reload(tree_file);
+}
+
+
+/**
+ * Same as tree_item_get(), looking up the mapped prefix file
+ */
+static int tree_file_route_get(const str *user)
+{
+	pfxdb_t *db;
+	pfxdb_node_t *node, *next;
+	const char *p, *pmax;
+	uint32_t r;
+	int route = 0;
+
+	if(NULL == user || NULL == user->s || !user->len)
+		return -1;
+
+	db = pfxdb_handle_get(tree_file);
+	if(NULL == db)
+		return -1;
+
+	/* route numbers are resolved again after a reload */
+	if(NULL == tree_file_routes || tree_file_version != tree_file->lversion) {
+		if(tree_file_routes)
+			pkg_free(tree_file_routes);
+		tree_file_routes = tree_file_routes_get(db);
+		tree_file_version = tree_file->lversion;
+		if(NULL == tree_file_routes)
+			return -1;
+	}
+
+	node = pfxdb_root(db, pfxdb_table_get(db, &tree_file_table));
+	if(NULL == node)
+		return 0;
+
+	pmax = user->s + user->len;
+	for(p = user->s; p < pmax; p++) {
+		if(!isdigit(*p)) {
+			continue;
+		}
+
+		/* Update route with best match so far */
+		if(pfxdb_node_nvals(db, node) > 0) {
+			r = db->refs[node->values];
+			if(r < db->hdr->nvals && tree_file_routes[r] > 0)
+				route = tree_file_routes[r];
+		}
+
+		/* exist? */
+		next = pfxdb_child(db, node, (unsigned char)*p);
+		if(NULL == next) {
+			break;
+		}
+
+		node = next;
+	}
+
+	return route;
+}
+
+
+/**
+ * Print the nodes of the prefix file, same format as tree_item_print()
+ */
+static void tree_file_item_print(
+		pfxdb_t *db, pfxdb_node_t *node, FILE *f, int level)
+{
+	pfxdb_node_t *child;
+	str name;
+	int i, j;
+
+	if(pfxdb_node_val(db, node, 0, &name) == 0) {
+		fprintf(f, " \t--> route[%.*s] ", name.len, name.s);
+	}
+
+	if(!pfxdb_children_ok(db, node))
+		return;
+
+	for(i = 0; i < node->nchild; i++) {
+		child = &db->nodes[node->child + i];
+		if(child->depth != node->depth + 1) {
+			continue;
+		}
+
+		fputc('\n', f);
+		for(j = 0; j < level; j++)
+			fputc(' ', f);
+
+		fprintf(f, "%c ", child->key);
+		tree_file_item_print(db, child, f, level + 1);
+	}
+}
+
+
 static struct tree *tree_ref(void)
 {
 	struct tree *tree;
@@ -347,6 +546,15 @@ int tree_init(void)
 
 void tree_close(void)
 {
+	if(tree_file) {
+		pfxdb_handle_destroy(tree_file);
+		pkg_free(tree_file);
+		tree_file = NULL;
+	}
+	if(tree_file_routes) {
+		pkg_free(tree_file_routes);
+		tree_file_routes = NULL;
+	}
 	if(shared_tree)
 		tree_flush(tree_get());
 	shared_tree = NULL;
@@ -388,6 +596,9 @@ int tree_route_get(const str *user)
 	struct tree *tree;
 	int route;
 
+	if(tree_file)
+		return tree_file_route_get(user);
+
 	/* Find match in tree */
 	tree = tree_ref();
 	if(NULL == tree) {
@@ -404,6 +615,21 @@ int tree_route_get(const str *user)
 void tree_print(FILE *f)
 {
 	struct tree *tree;
+	pfxdb_t *db;
+	pfxdb_node_t *root;
+
+	if(tree_file) {
+		fprintf(f, "Prefix route file:\n");
+		fprintf(f, " file: %s\n", tree_file->path);
+		db = pfxdb_handle_get(tree_file);
+		root = (db) ? pfxdb_root(db, pfxdb_table_get(db, &tree_file_table))
+					: NULL;
+		if(root)
+			tree_file_item_print(db, root, f, 0);
+		else
+			fprintf(f, " (no tree)\n");
+		return;
+	}
 
 	tree = tree_ref();
 
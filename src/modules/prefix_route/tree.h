@@ -46,4 +46,7 @@ void tree_close(void);
 int tree_swap(struct tree_item *root);
 int tree_route_get(const str *user);
 void tree_print(FILE *f);
+
+int tree_file_init(char *path, char *table);
+int tree_file_reload(void);
 #endif
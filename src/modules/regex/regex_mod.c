@@ -41,9 +41,12 @@
 #include "../../core/sr_module.h"
 #include "../../core/dprint.h"
 #include "../../core/pt.h"
+#include "../../core/mem/mem.h"
 #include "../../core/mem/shm_mem.h"
 #include "../../core/str.h"
 #include "../../core/locking.h"
+#include "../../core/counters.h"
+#include "../../core/utils/lrucache.h"
 #include "../../core/mod_fix.h"
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
@@ -57,6 +60,7 @@ MODULE_VERSION
 #define FILE_MAX_LINE 500	/*!< Max line size in the file */
 #define MAX_GROUPS 20		/*!< Max number of groups */
 #define GROUP_MAX_SIZE 8192 /*!< Max size of a group */
+#define CACHE_SIZE 64		/*!< Max number of cached dynamic patterns */
 
 
 static int regex_init_rpc(void);
@@ -77,6 +81,7 @@ static int pcre_caseless = 0;
 static int pcre_multiline = 0;
 static int pcre_dotall = 0;
 static int pcre_extended = 0;
+static int cache_size = CACHE_SIZE;
 
 
 /*
@@ -91,6 +96,39 @@ static int *num_pcres = NULL;
 static int pcre_options = 0x00000000;
 
 
+/*
+ * Per process cache of the patterns given to pcre_match(), compiled in
+ * private memory, with the least recently used one dropped when full
+ */
+typedef struct regex_cache_data
+{
+	pcre2_code *re;			/*!< compiled pattern */
+	pcre2_match_data *md; /*!< match data reused for each match */
+} regex_cache_data_t;
+
+static ksr_lru_cache_t _regex_cache;
+static int regex_cache_compile(ksr_lru_item_t *it, void *param);
+static void regex_cache_free(ksr_lru_item_t *it, void *param);
+static pcre2_general_context *regex_cache_gctx = NULL;
+static pcre2_compile_context *regex_cache_cctx = NULL;
+
+static counter_handle_t regex_cache_hits;
+static counter_handle_t regex_cache_misses;
+static counter_handle_t regex_cache_evictions;
+
+/* clang-format off */
+static counter_def_t regex_cnt_defs[] = {
+	{&regex_cache_hits, "cache_hits", 0, 0, 0,
+		"patterns of pcre_match() found compiled in the cache"},
+	{&regex_cache_misses, "cache_misses", 0, 0, 0,
+		"patterns of pcre_match() compiled"},
+	{&regex_cache_evictions, "cache_evictions", 0, 0, 0,
+		"compiled patterns dropped from a full cache"},
+	{0, 0, 0, 0, 0, 0}
+};
+/* clang-format on */
+
+
 /*
  * Module core functions
  */
@@ -140,6 +178,7 @@ static param_export_t params[] = {
 	{"pcre_multiline", PARAM_INT, &pcre_multiline},
 	{"pcre_dotall", PARAM_INT, &pcre_dotall},
 	{"pcre_extended", PARAM_INT, &pcre_extended},
+	{"cache_size", PARAM_INT, &cache_size},
 	{0, 0, 0}
 };
 
@@ -174,6 +213,18 @@ static void pcre2_free(void *ptr, void *ext)
 	}
 }
 
+static void *pcre2_pkg_malloc(size_t size, void *ext)
+{
+	return pkg_malloc(size);
+}
+
+static void pcre2_pkg_free(void *ptr, void *ext)
+{
+	if(ptr) {
+		pkg_free(ptr);
+	}
+}
+
 /*! \brief
  * Init module function
  */
@@ -184,6 +235,21 @@ static int mod_init(void)
 		return -1;
 	}
 
+	if(counter_register_array("regex", regex_cnt_defs) < 0) {
+		LM_ERR("failed to register counters\n");
+		return -1;
+	}
+	if(cache_size < 1) {
+		LM_WARN("cache_size too small, set to 1\n");
+		cache_size = 1;
+	}
+	ksr_lru_cache_init(&_regex_cache, (unsigned int)cache_size,
+			sizeof(regex_cache_data_t), regex_cache_compile, regex_cache_free,
+			NULL);
+	_regex_cache.hits = &regex_cache_hits;
+	_regex_cache.misses = &regex_cache_misses;
+	_regex_cache.evictions = &regex_cache_evictions;
+
 	/* Group matching feature */
 	if(file == NULL) {
 		LM_NOTICE("'file' parameter is not set, group matching disabled\n");
@@ -545,19 +611,22 @@ static void free_shared_memory(void)
  * Script functions
  */
 
-/*! \brief Return true if the argument matches the regular expression parameter */
-static int ki_pcre_match(sip_msg_t *msg, str *string, str *regex)
+/*! \brief Compile a pattern for the cache
+ *
+ * The patterns are JIT compiled when pcre2 supports it.
+ */
+static int regex_cache_compile(ksr_lru_item_t *it, void *param)
 {
-	pcre2_code *pcre_re = NULL;
-	pcre2_match_data *pcre_md = NULL;
-	int pcre_rc;
+	regex_cache_data_t *d = (regex_cache_data_t *)it->data;
 	int pcre_error_num = 0;
 	char pcre_error[128];
 	size_t pcre_erroffset;
+	int rc;
 
-	pcre_re = pcre2_compile((PCRE2_SPTR)regex->s, PCRE2_ZERO_TERMINATED,
-			pcre_options, &pcre_error_num, &pcre_erroffset, pcres_ctx);
-	if(pcre_re == NULL) {
+	d->re = pcre2_compile((PCRE2_SPTR)it->key.s, (PCRE2_SIZE)it->key.len,
+			(uint32_t)it->flags, &pcre_error_num, &pcre_erroffset,
+			regex_cache_cctx);
+	if(d->re == NULL) {
 		switch(pcre2_get_error_message(
 				pcre_error_num, (PCRE2_UCHAR *)pcre_error, 128)) {
 			case PCRE2_ERROR_NOMEMORY:
@@ -571,17 +640,77 @@ static int ki_pcre_match(sip_msg_t *msg, str *string, str *regex)
 				break;
 		}
 		LM_ERR("pcre_re compilation of '%s' failed at offset %zu: %s\n",
-				regex->s, pcre_erroffset, pcre_error);
+				it->key.s, pcre_erroffset, pcre_error);
+		return -1;
+	}
+	/* matching falls back to the interpreter without jit support */
+	rc = pcre2_jit_compile(d->re, PCRE2_JIT_COMPLETE);
+	if(rc < 0) {
+		LM_DBG("pcre2 jit not used for '%s' (%d)\n", it->key.s, rc);
+	}
+	d->md = pcre2_match_data_create_from_pattern(d->re, regex_cache_gctx);
+	if(d->md == NULL) {
+		LM_ERR("failed to create the match data for '%s'\n", it->key.s);
+		pcre2_code_free(d->re);
+		return -1;
+	}
+	return 0;
+}
+
+static void regex_cache_free(ksr_lru_item_t *it, void *param)
+{
+	regex_cache_data_t *d = (regex_cache_data_t *)it->data;
+
+	pcre2_match_data_free(d->md);
+	pcre2_code_free(d->re);
+}
+
+/*! \brief Get the compiled pattern, compiling it if not in the cache
+ *
+ * The pcre2 contexts of the process are created at first use. The result
+ * is owned by the cache and is valid until the next call.
+ */
+static regex_cache_data_t *regex_cache_get(str *regex, uint32_t options)
+{
+	ksr_lru_item_t *it;
+
+	if(regex_cache_cctx == NULL) {
+		if(regex_cache_gctx == NULL
+				&& (regex_cache_gctx = pcre2_general_context_create(
+							pcre2_pkg_malloc, pcre2_pkg_free, NULL))
+						   == NULL) {
+			LM_ERR("pcre2 general context creation failed\n");
+			return NULL;
+		}
+		if((regex_cache_cctx = pcre2_compile_context_create(regex_cache_gctx))
+				== NULL) {
+			LM_ERR("pcre2 compile context creation failed\n");
+			return NULL;
+		}
+	}
+
+	it = ksr_lru_cache_get(&_regex_cache, regex, (int)options);
+	return (it != NULL) ? (regex_cache_data_t *)it->data : NULL;
+}
+
+/*! \brief Return true if the argument matches the regular expression parameter */
+static int ki_pcre_match(sip_msg_t *msg, str *string, str *regex)
+{
+	regex_cache_data_t *it;
+	int pcre_rc;
+	char pcre_error[128];
+
+	it = regex_cache_get(regex, pcre_options);
+	if(it == NULL) {
 		return -4;
 	}
 
-	pcre_md = pcre2_match_data_create_from_pattern(pcre_re, pcres_gctx);
-	pcre_rc = pcre2_match(pcre_re,	   /* the compiled pattern */
+	pcre_rc = pcre2_match(it->re,	   /* the compiled pattern */
 			(PCRE2_SPTR)string->s,	   /* the matching string */
 			(PCRE2_SIZE)(string->len), /* the length of the subject */
 			0,						   /* start at offset 0 in the string */
 			0,						   /* default options */
-			pcre_md,				   /* the match data block */
+			it->md,					   /* the match data block */
 			pcres_mctx); /* a match context; NULL means use defaults */
 
 	/* Matching failed: handle error cases */
@@ -607,14 +736,8 @@ static int ki_pcre_match(sip_msg_t *msg, str *string, str *regex)
 				LM_ERR("matching error:'%s' failed[%d]\n", pcre_error, pcre_rc);
 				break;
 		}
-		if(pcre_md)
-			pcre2_match_data_free(pcre_md);
-		pcre2_code_free(pcre_re);
 		return -1;
 	}
-	if(pcre_md)
-		pcre2_match_data_free(pcre_md);
-	pcre2_code_free(pcre_re);
 	LM_DBG("'%s' matches '%s'\n", string->s, regex->s);
 	return 1;
 }
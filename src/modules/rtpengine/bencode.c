@@ -10,6 +10,19 @@
 /* set to 0 for alloc debugging, e.g. through valgrind */
 #define BENCODE_MIN_BUFFER_PIECE_LEN 512
 
+/* size of the first piece of a buffer - large enough to hold a typical
+ * offer/answer command and its decoded reply without growing */
+#define BENCODE_FIRST_BUFFER_PIECE_LEN 8192
+
+/* largest piece kept in the per-process cache for reuse */
+#define BENCODE_MAX_CACHED_PIECE_LEN 65536
+
+/* nesting limit when skipping over raw encoded objects */
+#define BENCODE_RAW_MAX_DEPTH 32
+
+/* first output size of a writer */
+#define BENCODE_MIN_WRITER_LEN 256
+
 #define BENCODE_HASH_BUCKETS 31 /* prime numbers work best */
 
 #define BENCODE_ALLOC_ALIGN 8
@@ -18,6 +31,7 @@ struct __bencode_buffer_piece
 {
 	char *tail;
 	unsigned int left;
+	unsigned int size;
 	struct __bencode_buffer_piece *next;
 	char buf[0];
 };
@@ -45,6 +59,10 @@ static bencode_item_t __bencode_end_marker = {
 static bencode_item_t *__bencode_decode(
 		bencode_buffer_t *buf, const char *s, const char *end);
 
+/* a released piece kept for the next buffer, so that in steady state
+ * encoding and decoding do not go through the memory manager */
+static struct __bencode_buffer_piece *__bencode_piece_cache = NULL;
+
 
 static void __bencode_item_init(bencode_item_t *item)
 {
@@ -87,6 +105,7 @@ static struct __bencode_buffer_piece *__bencode_piece_new(unsigned int size)
 
 	ret->tail = ret->buf;
 	ret->left = size;
+	ret->size = size;
 	ret->next = NULL;
 
 	return ret;
@@ -94,9 +113,17 @@ static struct __bencode_buffer_piece *__bencode_piece_new(unsigned int size)
 
 int bencode_buffer_init(bencode_buffer_t *buf)
 {
-	buf->pieces = __bencode_piece_new(0);
-	if(!buf->pieces)
-		return -1;
+	if(__bencode_piece_cache) {
+		buf->pieces = __bencode_piece_cache;
+		__bencode_piece_cache = NULL;
+		buf->pieces->tail = buf->pieces->buf;
+		buf->pieces->left = buf->pieces->size;
+		buf->pieces->next = NULL;
+	} else {
+		buf->pieces = __bencode_piece_new(BENCODE_FIRST_BUFFER_PIECE_LEN);
+		if(!buf->pieces)
+			return -1;
+	}
 	buf->free_list = NULL;
 	buf->error = 0;
 	return 0;
@@ -150,8 +177,18 @@ void bencode_buffer_free(bencode_buffer_t *buf)
 
 	for(piece = buf->pieces; piece; piece = next) {
 		next = piece->next;
+		/* keep the largest piece up to the limit for the next buffer */
+		if(piece->size <= BENCODE_MAX_CACHED_PIECE_LEN
+				&& (!__bencode_piece_cache
+						|| __bencode_piece_cache->size < piece->size)) {
+			if(__bencode_piece_cache)
+				BENCODE_FREE(__bencode_piece_cache);
+			__bencode_piece_cache = piece;
+			continue;
+		}
 		BENCODE_FREE(piece);
 	}
+	buf->pieces = NULL;
 }
 
 static bencode_item_t *__bencode_item_alloc(
@@ -447,6 +484,147 @@ char *bencode_collapse_dup(bencode_item_t *root, int *len)
 	return ret;
 }
 
+/* grow the last allocation of the buffer in place, if it is at the tail
+ * of the current piece and the piece has space left */
+static int __bencode_alloc_extend(bencode_buffer_t *buf, void *p,
+		unsigned int oldsize, unsigned int newsize)
+{
+	struct __bencode_buffer_piece *piece;
+
+	piece = buf->pieces;
+	if(!piece || piece->tail != (char *)p + oldsize
+			|| newsize - oldsize > piece->left)
+		return -1;
+	piece->left -= newsize - oldsize;
+	piece->tail += newsize - oldsize;
+	return 0;
+}
+
+/* make room for n more bytes in the output of a writer */
+static char *__bencode_writer_reserve(bencode_writer_t *w, unsigned int n)
+{
+	unsigned int size;
+	char *s;
+
+	if(!w->buffer || w->buffer->error)
+		return NULL;
+	if(w->len + n <= w->size)
+		return w->s + w->len;
+
+	size = w->size ? w->size : BENCODE_MIN_WRITER_LEN;
+	while(size < w->len + n)
+		size <<= 1;
+	if(w->s && !__bencode_alloc_extend(w->buffer, w->s, w->size, size)) {
+		w->size = size;
+		return w->s + w->len;
+	}
+	s = __bencode_alloc(w->buffer, size);
+	if(!s)
+		return NULL;
+	if(w->len)
+		memcpy(s, w->s, w->len);
+	w->s = s;
+	w->size = size;
+	return w->s + w->len;
+}
+
+/* print an unsigned number, returns the number of chars */
+static int __bencode_writer_uint(char *out, unsigned long long int u)
+{
+	char tmp[20];
+	int n, i;
+
+	n = 0;
+	do {
+		tmp[n++] = '0' + (u % 10);
+		u /= 10;
+	} while(u);
+	for(i = 0; i < n; i++)
+		out[i] = tmp[n - 1 - i];
+	return n;
+}
+
+void bencode_writer_init(bencode_writer_t *w, bencode_buffer_t *buf)
+{
+	w->buffer = buf;
+	w->s = NULL;
+	w->len = 0;
+	w->size = 0;
+}
+
+int bencode_writer_fail(bencode_writer_t *w)
+{
+	if(w->buffer)
+		w->buffer->error = 1;
+	return -1;
+}
+
+int bencode_writer_raw(bencode_writer_t *w, const char *s, int len)
+{
+	char *out;
+
+	if(len < 0)
+		return bencode_writer_fail(w);
+	out = __bencode_writer_reserve(w, len);
+	if(!out)
+		return -1;
+	memcpy(out, s, len);
+	w->len += len;
+	return 0;
+}
+
+int bencode_writer_string_len(bencode_writer_t *w, const char *s, int len)
+{
+	char *out;
+	int len_len;
+
+	if(len < 0 || len > 99999)
+		return bencode_writer_fail(w);
+	out = __bencode_writer_reserve(w, len + 6);
+	if(!out)
+		return -1;
+	len_len = __bencode_writer_uint(out, len);
+	out[len_len++] = ':';
+	memcpy(out + len_len, s, len);
+	w->len += len_len + len;
+	return 0;
+}
+
+int bencode_writer_integer(bencode_writer_t *w, long long int i)
+{
+	char *out;
+	int n;
+
+	/* i, up to 20 chars of digits and sign, e */
+	out = __bencode_writer_reserve(w, 22);
+	if(!out)
+		return -1;
+	n = 0;
+	out[n++] = 'i';
+	if(i < 0) {
+		out[n++] = '-';
+		n += __bencode_writer_uint(out + n, -(unsigned long long int)i);
+	} else {
+		n += __bencode_writer_uint(out + n, i);
+	}
+	out[n++] = 'e';
+	w->len += n;
+	return 0;
+}
+
+int bencode_writer_item(bencode_writer_t *w, bencode_item_t *item)
+{
+	char *out;
+
+	if(!item)
+		return bencode_writer_fail(w);
+	out = __bencode_writer_reserve(w, item->str_len + 1);
+	if(!out)
+		return -1;
+	w->len += __bencode_str_dump(out, item);
+	return 0;
+}
+
 static unsigned int __bencode_hash_str_len(const unsigned char *s, int len)
 {
 	unsigned long *ul;
@@ -767,3 +945,176 @@ void bencode_buffer_destroy_add(
 	li->next = buf->free_list;
 	buf->free_list = li;
 }
+
+
+static const char *__bencode_raw_skip(
+		const char *s, const char *end, int depth)
+{
+	unsigned long int sl;
+
+	if(s >= end || depth > BENCODE_RAW_MAX_DEPTH)
+		return NULL;
+
+	switch(*s) {
+		case 'd':
+		case 'l':
+			s++;
+			while(s < end && *s != 'e') {
+				s = __bencode_raw_skip(s, end, depth + 1);
+				if(!s)
+					return NULL;
+			}
+			if(s >= end)
+				return NULL;
+			return s + 1;
+		case 'i':
+			s++;
+			if(s < end && *s == '-')
+				s++;
+			while(s < end && *s >= '0' && *s <= '9')
+				s++;
+			if(s >= end || *s != 'e')
+				return NULL;
+			return s + 1;
+		default:
+			if(*s < '0' || *s > '9')
+				return NULL;
+			sl = 0;
+			while(s < end && *s >= '0' && *s <= '9') {
+				sl = sl * 10 + (*s - '0');
+				if(sl > (unsigned long int)(end - s))
+					return NULL;
+				s++;
+			}
+			if(s >= end || *s != ':')
+				return NULL;
+			s++;
+			if(sl > (unsigned long int)(end - s))
+				return NULL;
+			return s + sl;
+	}
+}
+
+int bencode_raw_dictionary_get_len(const char *s, int len,
+		const char *keystr, int keylen, const char **val, int *vlen)
+{
+	const char *end = s + len;
+	const char *k, *v;
+	unsigned long int sl;
+
+	if(!s || len <= 0 || *s != 'd')
+		return -1;
+	s++;
+
+	while(s < end && *s != 'e') {
+		/* key - always a string */
+		k = s;
+		sl = 0;
+		while(k < end && *k >= '0' && *k <= '9') {
+			sl = sl * 10 + (*k - '0');
+			if(sl > (unsigned long int)(end - k))
+				return -1;
+			k++;
+		}
+		if(k == s || k >= end || *k != ':')
+			return -1;
+		k++;
+		if(sl > (unsigned long int)(end - k))
+			return -1;
+		v = k + sl;
+		s = __bencode_raw_skip(v, end, 1);
+		if(!s)
+			return -1;
+		if(sl == keylen && !memcmp(k, keystr, keylen)) {
+			*val = v;
+			*vlen = s - v;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+str *bencode_raw_dictionary_get_str(
+		const char *s, int len, const char *key, str *out)
+{
+	const char *v, *p;
+	int vlen;
+
+	if(bencode_raw_dictionary_get_len(s, len, key, strlen(key), &v, &vlen))
+		return NULL;
+	if(*v < '0' || *v > '9')
+		return NULL;
+	p = memchr(v, ':', vlen);
+	if(!p)
+		return NULL;
+	out->s = (char *)p + 1;
+	out->len = v + vlen - out->s;
+	return out;
+}
+
+int bencode_raw_expect(const char *s, int len, bencode_type_t expect)
+{
+	const char *e;
+
+	if(!s || len <= 0)
+		return -1;
+	switch(expect) {
+		case BENCODE_DICTIONARY:
+			if(*s != 'd')
+				return -1;
+			break;
+		case BENCODE_LIST:
+			if(*s != 'l')
+				return -1;
+			break;
+		case BENCODE_INTEGER:
+			if(*s != 'i')
+				return -1;
+			break;
+		case BENCODE_STRING:
+			if(*s < '0' || *s > '9')
+				return -1;
+			break;
+		default:
+			return -1;
+	}
+	e = __bencode_raw_skip(s, s + len, 0);
+	if(!e)
+		return -1;
+	return e - s;
+}
+
+str *bencode_raw_dictionary_get_expect(const char *s, int len, const char *key,
+		bencode_type_t expect, str *out)
+{
+	const char *v;
+	int vlen;
+
+	if(bencode_raw_dictionary_get_len(s, len, key, strlen(key), &v, &vlen))
+		return NULL;
+	if(bencode_raw_expect(v, vlen, expect) != vlen)
+		return NULL;
+	out->s = (char *)v;
+	out->len = vlen;
+	return out;
+}
+
+long long int bencode_raw_dictionary_get_integer(
+		const char *s, int len, const char *key, long long int defval)
+{
+	const char *v;
+	char *convend;
+	int vlen;
+	long long int i;
+
+	if(bencode_raw_dictionary_get_len(s, len, key, strlen(key), &v, &vlen))
+		return defval;
+	if(*v != 'i')
+		return defval;
+	/* the value was checked to end with 'e' */
+	i = strtoll(v + 1, &convend, 10);
+	if(convend == v + 1 || *convend != 'e')
+		return defval;
+	return i;
+}
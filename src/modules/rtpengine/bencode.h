@@ -11,10 +11,12 @@ enum bencode_type;
 struct bencode_item;
 struct __bencode_buffer_piece;
 struct __bencode_free_list;
+struct bencode_writer;
 
 typedef enum bencode_type bencode_type_t;
 typedef struct bencode_buffer bencode_buffer_t;
 typedef struct bencode_item bencode_item_t;
+typedef struct bencode_writer bencode_writer_t;
 typedef void (*free_func_t)(void *);
 
 enum bencode_type
@@ -50,6 +52,14 @@ struct bencode_buffer
 	unsigned int error : 1; /* set to !0 if allocation failed at any point */
 };
 
+struct bencode_writer
+{
+	bencode_buffer_t *buffer; /* NULL if the writer is disabled */
+	char *s;				  /* encoded output, not null-terminated */
+	unsigned int len;
+	unsigned int size;
+};
+
 
 /* to embed BENCODE_STRING objects into printf-like functions */
 #define BENCODE_FORMAT "%.*s"
@@ -238,6 +248,66 @@ static str *bencode_collapse_str(bencode_item_t *root, str *out);
 char *bencode_collapse_dup(bencode_item_t *root, int *len);
 
 
+/*** SINGLE PASS WRITING ***/
+
+/* A writer encodes a document directly into one contiguous output area allocated from a
+ * bencode_buffer_t object, without building a tree of bencode_item_t objects. Values are
+ * written in document order: a dictionary is written as "d", then each key followed by its
+ * value, then "e". The output grows in place as long as nothing else is allocated from the
+ * same buffer in between and is ready to be sent as a whole once the document is complete.
+ * A writer can also hold the contents of a list without the list markers, to be appended
+ * to another writer later on.
+ *
+ * A writer initialized with a NULL buffer is disabled: nothing is written to it and all
+ * writing functions return -1. Otherwise, any failure (failed allocation or invalid
+ * argument) sets the error flag of the buffer, the output must not be used then. All
+ * writing functions return 0 on success or -1 on failure. */
+void bencode_writer_init(bencode_writer_t *w, bencode_buffer_t *buf);
+
+/* Sets the error flag of the buffer of the writer, if any. Returns -1. */
+int bencode_writer_fail(bencode_writer_t *w);
+
+/* Appends raw, already encoded data to the output */
+int bencode_writer_raw(bencode_writer_t *w, const char *s, int len);
+
+/* Writes a byte-string object. The string is copied into the output. */
+int bencode_writer_string_len(bencode_writer_t *w, const char *s, int len);
+INLINE int bencode_writer_string(bencode_writer_t *w, const char *s);
+INLINE int bencode_writer_str(bencode_writer_t *w, const str *s);
+
+/* Writes an integer object */
+int bencode_writer_integer(bencode_writer_t *w, long long int i);
+
+/* Writes the start and the end of a dictionary or a list */
+INLINE int bencode_writer_dictionary(bencode_writer_t *w);
+INLINE int bencode_writer_list(bencode_writer_t *w);
+INLINE int bencode_writer_end(bencode_writer_t *w);
+
+/* Encodes a complete object tree into the output */
+int bencode_writer_item(bencode_writer_t *w, bencode_item_t *item);
+
+/* Returns true if nothing was written yet */
+INLINE int bencode_writer_empty(bencode_writer_t *w);
+
+/* Fills in a "str" object with the output. Returns "out". */
+INLINE str *bencode_writer_get_str(bencode_writer_t *w, str *out);
+
+/* Convenience functions to write a key (a null-terminated string) and its value into the
+ * dictionary being written. */
+INLINE int bencode_writer_dictionary_add_string(
+		bencode_writer_t *w, const char *key, const char *val);
+INLINE int bencode_writer_dictionary_add_str(
+		bencode_writer_t *w, const char *key, const str *val);
+INLINE int bencode_writer_dictionary_str_add_str(
+		bencode_writer_t *w, const str *key, const str *val);
+INLINE int bencode_writer_dictionary_add_integer(
+		bencode_writer_t *w, const char *key, long long int val);
+
+/* Ditto, the value being a list with the contents of the writer "list" */
+INLINE int bencode_writer_dictionary_add_list(
+		bencode_writer_t *w, const char *key, bencode_writer_t *list);
+
+
 /*** DECODING ***/
 
 /* Decodes an encoded document from a string into a tree of bencode_item_t objects. The string does
@@ -296,6 +366,46 @@ INLINE bencode_item_t *bencode_decode_expect(
 INLINE bencode_item_t *bencode_decode_expect_str(
 		bencode_buffer_t *buf, const str *s, bencode_type_t expect);
 
+/* Looks up a key in an encoded dictionary without decoding it into a tree of objects. No memory
+ * is allocated, the values are located by skipping over the encoded data, so this is suited to
+ * extract a few top level values from a reply. On success, returns 0 and "val"/"vlen" point to
+ * the still encoded value inside "s". Returns -1 if the key is not found or the document is
+ * not a valid dictionary. */
+int bencode_raw_dictionary_get_len(const char *s, int len, const char *keystr,
+		int keylen, const char **val, int *vlen);
+
+/* Identical to bencode_raw_dictionary_get_len(), but for string values. The key must be a
+ * null-terminated string. On success, "out" points to the contents of the string inside "s"
+ * (not null-terminated) and is returned. Returns NULL otherwise. */
+str *bencode_raw_dictionary_get_str(
+		const char *s, int len, const char *key, str *out);
+
+/* Compares the string value of a key in an encoded dictionary with a C string. Returns 2 if the
+ * key isn't found or isn't a string, otherwise returns like strcmp(). */
+INLINE int bencode_raw_dictionary_get_strcmp(
+		const char *s, int len, const char *key, const char *cmp);
+
+/* Checks that an encoded document is valid and that its type matches "expect". Nothing is
+ * decoded and no memory is allocated. Returns the length of the encoded object, which can be
+ * less than "len" if there is stray data after it, or -1 on error. */
+int bencode_raw_expect(const char *s, int len, bencode_type_t expect);
+
+/* Identical to bencode_raw_dictionary_get_len(), but returns the value only if its type matches
+ * "expect". The key must be a null-terminated string. On success, "out" points to the encoded
+ * value, which can be decoded on its own, and is returned. Returns NULL otherwise. */
+str *bencode_raw_dictionary_get_expect(const char *s, int len, const char *key,
+		bencode_type_t expect, str *out);
+
+/* Identical to bencode_raw_dictionary_get_str() but copies the string into a newly allocated
+ * buffer (using the BENCODE_MALLOC function). Returns out->s, which may be NULL. */
+INLINE char *bencode_raw_dictionary_get_str_dup(
+		const char *s, int len, const char *key, str *out);
+
+/* Identical to bencode_raw_dictionary_get_str() but expects an integer object. Returns "defval"
+ * if the key is not found or if the value is not an integer. */
+long long int bencode_raw_dictionary_get_integer(
+		const char *s, int len, const char *key, long long int defval);
+
 
 /*** DICTIONARY LOOKUP & EXTRACTION ***/
 
@@ -592,6 +702,38 @@ INLINE int bencode_dictionary_get_strcmp(
 	return bencode_strcmp(i, str);
 }
 
+INLINE int bencode_raw_dictionary_get_strcmp(
+		const char *s, int len, const char *key, const char *cmp)
+{
+	str val;
+	int cmplen;
+
+	if(!bencode_raw_dictionary_get_str(s, len, key, &val))
+		return 2;
+	cmplen = strlen(cmp);
+	if(val.len != cmplen)
+		return (val.len < cmplen) ? -1 : 1;
+	return memcmp(val.s, cmp, cmplen);
+}
+
+INLINE char *bencode_raw_dictionary_get_str_dup(
+		const char *s, int len, const char *key, str *out)
+{
+	str val;
+
+	out->s = NULL;
+	out->len = 0;
+	if(!bencode_raw_dictionary_get_str(s, len, key, &val))
+		return NULL;
+	out->s = BENCODE_MALLOC(val.len + 1);
+	if(!out->s)
+		return NULL;
+	memcpy(out->s, val.s, val.len);
+	out->s[val.len] = '\0';
+	out->len = val.len;
+	return out->s;
+}
+
 INLINE str *bencode_get_str(bencode_item_t *in, str *out)
 {
 	if(!in || in->type != BENCODE_STRING)
@@ -609,4 +751,89 @@ INLINE bencode_item_t *bencode_dictionary_add_iovec(bencode_item_t *dict,
 					bencode_item_buffer(dict), iov, iov_cnt, str_len));
 }
 
+INLINE int bencode_writer_string(bencode_writer_t *w, const char *s)
+{
+	return bencode_writer_string_len(w, s, strlen(s));
+}
+
+INLINE int bencode_writer_str(bencode_writer_t *w, const str *s)
+{
+	return bencode_writer_string_len(w, s->s, s->len);
+}
+
+INLINE int bencode_writer_dictionary(bencode_writer_t *w)
+{
+	return bencode_writer_raw(w, "d", 1);
+}
+
+INLINE int bencode_writer_list(bencode_writer_t *w)
+{
+	return bencode_writer_raw(w, "l", 1);
+}
+
+INLINE int bencode_writer_end(bencode_writer_t *w)
+{
+	return bencode_writer_raw(w, "e", 1);
+}
+
+INLINE int bencode_writer_empty(bencode_writer_t *w)
+{
+	return w->len == 0;
+}
+
+INLINE str *bencode_writer_get_str(bencode_writer_t *w, str *out)
+{
+	out->s = w->s;
+	out->len = w->len;
+	return out;
+}
+
+INLINE int bencode_writer_dictionary_add_string(
+		bencode_writer_t *w, const char *key, const char *val)
+{
+	if(!val)
+		return bencode_writer_fail(w);
+	if(bencode_writer_string(w, key))
+		return -1;
+	return bencode_writer_string(w, val);
+}
+
+INLINE int bencode_writer_dictionary_add_str(
+		bencode_writer_t *w, const char *key, const str *val)
+{
+	if(!val)
+		return bencode_writer_fail(w);
+	if(bencode_writer_string(w, key))
+		return -1;
+	return bencode_writer_str(w, val);
+}
+
+INLINE int bencode_writer_dictionary_str_add_str(
+		bencode_writer_t *w, const str *key, const str *val)
+{
+	if(!key || !val)
+		return bencode_writer_fail(w);
+	if(bencode_writer_str(w, key))
+		return -1;
+	return bencode_writer_str(w, val);
+}
+
+INLINE int bencode_writer_dictionary_add_integer(
+		bencode_writer_t *w, const char *key, long long int val)
+{
+	if(bencode_writer_string(w, key))
+		return -1;
+	return bencode_writer_integer(w, val);
+}
+
+INLINE int bencode_writer_dictionary_add_list(
+		bencode_writer_t *w, const char *key, bencode_writer_t *list)
+{
+	if(bencode_writer_string(w, key) || bencode_writer_list(w))
+		return -1;
+	if(list->len && bencode_writer_raw(w, list->s, list->len))
+		return -1;
+	return bencode_writer_end(w);
+}
+
 #endif
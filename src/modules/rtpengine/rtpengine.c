@@ -40,6 +40,7 @@
 #include <sys/un.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <poll.h>
 #include <stdio.h>
@@ -80,7 +81,11 @@
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
 #include "../../core/kemi.h"
+#include "../../core/receive.h"
+#include "../../core/script_cb.h"
 #include "../../core/char_msg_val.h"
+#include "../../core/hashes.h"
+#include "../../core/clist.h"
 #include "../../core/utils/srjson.h"
 #include "../../core/cfg/cfg_struct.h"
 #include "../../core/rand/fastrand.h"
@@ -129,10 +134,11 @@ enum {
 
 struct ng_flags_parse {
 	int via, to, packetize, transport, directional;
-	bencode_item_t *dict, *flags, *direction, *replace, *rtcp_mux, *sdes, *t38,
-			*received_from, *codec, *codec_strip, *codec_offer,
-			*codec_transcode, *codec_mask, *codec_set, *codec_except, *codec_accept,
-			*codec_consume, *from_tags;
+	/* the command and the lists added to it at the end */
+	bencode_writer_t dict, flags, direction, replace, rtcp_mux, sdes, t38,
+			received_from, codec_strip, codec_offer, codec_transcode,
+			codec_mask, codec_set, codec_except, codec_accept, codec_consume,
+			from_tags;
 	str call_id, from_tag, to_tag;
 };
 
@@ -234,6 +240,9 @@ static int rtpengine_delete1_f(struct sip_msg *, char *, char *);
 static int rtpengine_manage1_f(struct sip_msg *, char *, char *);
 static int rtpengine_query1_f(struct sip_msg *, char *, char *);
 static int rtpengine_info1_f(struct sip_msg *, char *, char *);
+static int w_rtpengine_offer_async(sip_msg_t *msg, char *pflags, char *prt);
+static int w_rtpengine_answer_async(sip_msg_t *msg, char *pflags, char *prt);
+static int w_rtpengine_manage_async(sip_msg_t *msg, char *pflags, char *prt);
 static void rtpengine_ping_check_timer(unsigned int ticks, void *);
 
 static int w_rtpengine_query_v(sip_msg_t *msg, char *pfmt, char *pvar);
@@ -295,7 +304,8 @@ static struct rtpp_node *select_rtpp_node(
 		str, str, int, struct rtpp_node **, int, enum rtpe_operation);
 static int is_queried_node(struct rtpp_node *, struct rtpp_node **, int);
 static int build_rtpp_socks(int lmode, int rtest);
-static char *send_rtpp_command(struct rtpp_node *, bencode_item_t *, int *);
+static char *send_rtpp_command(
+		struct rtpp_node *, str *, const char *, int *);
 static int get_extra_id(struct sip_msg *msg, str *id_str);
 
 static int rtpengine_set_store(modparam_t type, void *val);
@@ -316,6 +326,9 @@ static int add_rtpp_node_info(
 static int rtpp_test_ping(struct rtpp_node *node);
 
 static void rtpengine_dtmf_events_loop(void);
+static void rtpengine_async_loop(int rank);
+static int rtpengine_async_exec(
+		sip_msg_t *msg, unsigned int flags, void *param);
 static int rtpengine_raise_dtmf_event(char *buffer, int len);
 
 /* Pseudo-Variables */
@@ -424,6 +437,12 @@ int dtmf_event_rt = -1; /* default disabled */
 static int rtpengine_ping_mode = 1;
 static int rtpengine_ping_interval = 60;
 static int rtpengine_enable_dmq = 0;
+static int rtpengine_async_mode = 0;
+/* pipes of the async processes - read end at 2*i, write end at 2*i+1 */
+static int *_rtpe_async_pipes = NULL;
+
+static str async_result_pvar_str = {NULL, 0};
+static pv_spec_t *async_result_pvar = NULL;
 
 /* clang-format off */
 typedef struct rtpp_set_link {
@@ -509,6 +528,12 @@ static cmd_export_t cmds[] = {
 		fixup_spve_null, fixup_free_spve_null, ANY_ROUTE},
 	{"rtpengine_manage", (cmd_function)rtpengine_manage1_f, 2,
 		fixup_spve_spve, fixup_free_spve_spve, ANY_ROUTE},
+	{"rtpengine_offer_async", (cmd_function)w_rtpengine_offer_async, 2,
+		fixup_spve_spve, fixup_free_spve_spve, REQUEST_ROUTE},
+	{"rtpengine_answer_async", (cmd_function)w_rtpengine_answer_async, 2,
+		fixup_spve_spve, fixup_free_spve_spve, REQUEST_ROUTE},
+	{"rtpengine_manage_async", (cmd_function)w_rtpengine_manage_async, 2,
+		fixup_spve_spve, fixup_free_spve_spve, REQUEST_ROUTE},
 	{"rtpengine_delete", (cmd_function)rtpengine_delete1_f, 0, 0, 0, ANY_ROUTE},
 	{"rtpengine_delete", (cmd_function)rtpengine_delete1_f, 1,
 		fixup_spve_null, fixup_free_spve_null, ANY_ROUTE},
@@ -598,6 +623,8 @@ static param_export_t params[] = {
 	{"dtmf_event_volume", PARAM_STR, &dtmf_event_volume_pvar_str},
 	{"event_callback",  PARAM_STR, &rtpe_event_callback},
 	{"enable_dmq", PARAM_INT, &rtpengine_enable_dmq},
+	{"async_mode", PARAM_INT, &rtpengine_async_mode},
+	{"async_result_pv", PARAM_STR, &async_result_pvar_str},
 	/* MOS stats output */
 	/* global averages */
 	{"mos_min_pv", PARAM_STR, &global_mos_stats.min.mos_param},
@@ -1979,8 +2006,8 @@ static int fixup_free_set_id(void **param, int param_no)
  * @brief Sends a ping command to an RTP engine node and checks the response.
  *
  * @details Initialize a bencode buffer, construct a ping command dictionary,
- * send the command to the specified RTP engine node, and then decodes the response.
- * It checks if the response is a dictionary and if it contains the expected "pong" result.
+ * send the command to the specified RTP engine node, and then checks if the response
+ * is a dictionary that contains the expected "pong" result.
  *
  * @param node The RTP engine node to send the ping command to.
  * @return Returns 0 on success (pong received), -1 on failure.
@@ -1988,7 +2015,8 @@ static int fixup_free_set_id(void **param, int param_no)
 static int rtpp_test_ping(struct rtpp_node *node)
 {
 	bencode_buffer_t bencbuf;
-	bencode_item_t *dict;
+	bencode_writer_t cmd;
+	str request;
 	char *cp;
 	int ret;
 
@@ -1996,20 +2024,23 @@ static int rtpp_test_ping(struct rtpp_node *node)
 	if(bencode_buffer_init(&bencbuf)) {
 		return -1;
 	}
-	dict = bencode_dictionary(&bencbuf);
-	bencode_dictionary_add_string(dict, "command", command_strings[OP_PING]);
+	bencode_writer_init(&cmd, &bencbuf);
+	bencode_writer_dictionary(&cmd);
+	bencode_writer_dictionary_add_string(
+			&cmd, "command", command_strings[OP_PING]);
+	bencode_writer_end(&cmd);
 
 	if(bencbuf.error) {
 		goto error;
 	}
 
-	cp = send_rtpp_command(node, dict, &ret);
+	cp = send_rtpp_command(node, bencode_writer_get_str(&cmd, &request),
+			command_strings[OP_PING], &ret);
 	if(!cp) {
 		goto error;
 	}
 
-	dict = bencode_decode_expect(&bencbuf, cp, ret, BENCODE_DICTIONARY);
-	if(!dict || bencode_dictionary_get_strcmp(dict, "result", "pong")) {
+	if(bencode_raw_dictionary_get_strcmp(cp, ret, "result", "pong")) {
 		goto error;
 	}
 
@@ -2757,6 +2788,55 @@ static int mod_init(void)
 		cfg_register_child(1);
 	}
 
+	if(async_result_pvar_str.len > 0) {
+		async_result_pvar = pv_cache_get(&async_result_pvar_str);
+		if(async_result_pvar == NULL
+				|| (async_result_pvar->type != PVT_AVP
+						&& async_result_pvar->type != PVT_XAVP
+						&& async_result_pvar->type != PVT_SCRIPTVAR)) {
+			LM_ERR("async_result_pv: not a valid AVP, XAVP or VAR "
+				   "definition <%.*s>\n",
+					async_result_pvar_str.len, async_result_pvar_str.s);
+			return -1;
+		}
+	}
+
+	if(rtpengine_async_mode > 0) {
+		if(tmb.t_suspend == NULL) {
+			LM_ERR("async mode requires tm module\n");
+			return -1;
+		}
+		_rtpe_async_pipes =
+				(int *)pkg_malloc(2 * rtpengine_async_mode * sizeof(int));
+		if(_rtpe_async_pipes == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		for(i = 0; i < rtpengine_async_mode; i++) {
+			if(pipe(&_rtpe_async_pipes[2 * i]) < 0) {
+				LM_ERR("failed to create async pipe (%s:%d)\n",
+						strerror(errno), errno);
+				return -1;
+			}
+			if(fcntl(_rtpe_async_pipes[2 * i], F_SETFL, O_NONBLOCK) < 0
+					|| fcntl(_rtpe_async_pipes[2 * i + 1], F_SETFL,
+							   O_NONBLOCK)
+							   < 0) {
+				LM_ERR("failed to set async pipe non-blocking (%s:%d)\n",
+						strerror(errno), errno);
+				return -1;
+			}
+		}
+		if(register_script_cb(
+				   rtpengine_async_exec, PRE_SCRIPT_CB | FAILURE_CB, 0)
+				< 0) {
+			LM_ERR("failed to register pre-script callback\n");
+			return -1;
+		}
+		register_procs(rtpengine_async_mode);
+		cfg_register_child(rtpengine_async_mode);
+	}
+
 	if(rtpengine_enable_dmq > 0 && rtpengine_dmq_init() != 0) {
 		LM_ERR("rtpengine_dmq_init() failed!\n");
 		return -1;
@@ -3035,6 +3115,7 @@ static int mos_label_stats_parse(struct minmax_mos_label_stats *mmls)
 static int child_init(int rank)
 {
 	pid_t mypid = 0;
+	int i;
 
 	if(!rtpp_set_list)
 		return 0;
@@ -3045,6 +3126,23 @@ static int child_init(int rank)
 	}
 
 	if(rank == PROC_MAIN) {
+		for(i = 0; i < rtpengine_async_mode; i++) {
+			LM_DBG("Register RTPENGINE ASYNC WORKER %d\n", getpid());
+			/* fork worker process */
+			mypid = fork_process(PROC_RPC, "RTPENGINE ASYNC WORKER", 1);
+			if(mypid < 0) {
+				LM_ERR("failed to fork RTPENGINE ASYNC WORKER process %d\n",
+						mypid);
+				return -1;
+			} else if(mypid == 0) {
+				if(cfg_child_init())
+					return -1;
+				/* this will loop forever */
+				rtpengine_async_loop(i);
+				return -1;
+			}
+		}
+
 		if(rtpengine_dtmf_event_sock.len > 0) {
 			LM_DBG("Register RTPENGINE DTMF WORKER %d\n", getpid());
 			/* fork worker process */
@@ -3196,9 +3294,8 @@ static const char *transports[] = {
 		[0x06] = "UDP/TLS/RTP/SAVPF",
 };
 
-static int parse_codec_flag(struct ng_flags_parse *ng_flags, const str *key,
-		const str *val, const char *cmp1, const char *cmp2, const char *dictstr,
-		bencode_item_t **dictp)
+static int parse_codec_flag(const str *key, const str *val, const char *cmp1,
+		const char *cmp2, bencode_writer_t *list)
 {
 	str s;
 
@@ -3209,11 +3306,7 @@ static int parse_codec_flag(struct ng_flags_parse *ng_flags, const str *key,
 			return 0;
 	}
 
-	if(!*dictp) {
-		*dictp = bencode_list(ng_flags->dict->buffer);
-		bencode_dictionary_add(ng_flags->codec, dictstr, *dictp);
-	}
-	bencode_list_add_str(*dictp, &s);
+	bencode_writer_str(list, &s);
 
 	return 1;
 }
@@ -3314,52 +3407,52 @@ static int parse_from_to_tags(struct ng_flags_parse *ng_flags,
 			|| op == OP_STOP_FORWARDING || op == OP_SILENCE_MEDIA
 			|| op == OP_UNSILENCE_MEDIA) {
 		if(ng_flags->directional) {
-			bencode_dictionary_add_str(
-					ng_flags->dict, "from-tag", &ng_flags->from_tag);
+			bencode_writer_dictionary_add_str(
+					&ng_flags->dict, "from-tag", &ng_flags->from_tag);
 			if(ng_flags->to && ng_flags->to_tag.s && ng_flags->to_tag.len)
-				bencode_dictionary_add_str(
-						ng_flags->dict, "to-tag", &ng_flags->to_tag);
+				bencode_writer_dictionary_add_str(
+						&ng_flags->dict, "to-tag", &ng_flags->to_tag);
 		}
 	} else if(op == OP_SUBSCRIBE_REQUEST) {
 		/* SUBSCRIBE can either specify a list of from tags or have the keyword
 		 * all
 		 * */
-		if(ng_flags->from_tags)
-			bencode_dictionary_add(
-					ng_flags->dict, "from-tags", ng_flags->from_tags);
+		if(!bencode_writer_empty(&ng_flags->from_tags))
+			bencode_writer_dictionary_add_list(
+					&ng_flags->dict, "from-tags", &ng_flags->from_tags);
 		/* SUBSCRIBE can specify a to tag, if none specified a to-tag gets auto
 		 * generated
 		 * */
 		if(ng_flags->to && ng_flags->to_tag.s && ng_flags->to_tag.len)
-			bencode_dictionary_add_str(
-					ng_flags->dict, "to-tag", &ng_flags->to_tag);
+			bencode_writer_dictionary_add_str(
+					&ng_flags->dict, "to-tag", &ng_flags->to_tag);
 	} else if(op == OP_SUBSCRIBE_ANSWER || op == OP_UNSUBSCRIBE) {
 		/* SUBSCRIBE answer and UNSUBSCRIBE should specify the tag matching the
 		 * original subscribe request.  Internal api passes it via extra_dict
 		 * so this can be missing from flags in that case
 		 */
 		if(ng_flags->to && ng_flags->to_tag.s && ng_flags->to_tag.len)
-			bencode_dictionary_add_str(
-					ng_flags->dict, "to-tag", &ng_flags->to_tag);
+			bencode_writer_dictionary_add_str(
+					&ng_flags->dict, "to-tag", &ng_flags->to_tag);
 	} else if((msg->first_line.type == SIP_REQUEST && op != OP_ANSWER)
 			  || (msg->first_line.type == SIP_REPLY && op == OP_DELETE)
 			  || (msg->first_line.type == SIP_REPLY && op == OP_ANSWER)
 			  || ng_flags->directional) /* set if from-tag was set manually */
 	{
-		bencode_dictionary_add_str(
-				ng_flags->dict, "from-tag", &ng_flags->from_tag);
+		bencode_writer_dictionary_add_str(
+				&ng_flags->dict, "from-tag", &ng_flags->from_tag);
 		if(ng_flags->to && ng_flags->to_tag.s && ng_flags->to_tag.len)
-			bencode_dictionary_add_str(
-					ng_flags->dict, "to-tag", &ng_flags->to_tag);
+			bencode_writer_dictionary_add_str(
+					&ng_flags->dict, "to-tag", &ng_flags->to_tag);
 	} else {
 		if(!ng_flags->to_tag.s || !ng_flags->to_tag.len) {
 			LM_ERR("No to-tag present\n");
 			return -1;
 		}
-		bencode_dictionary_add_str(
-				ng_flags->dict, "from-tag", &ng_flags->to_tag);
-		bencode_dictionary_add_str(
-				ng_flags->dict, "to-tag", &ng_flags->from_tag);
+		bencode_writer_dictionary_add_str(
+				&ng_flags->dict, "from-tag", &ng_flags->to_tag);
+		bencode_writer_dictionary_add_str(
+				&ng_flags->dict, "to-tag", &ng_flags->from_tag);
 	}
 	return 0;
 }
@@ -3404,7 +3497,7 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 
 		/* check for items which have their own sub-list */
 		if(str_key_val_prefix(&key, "replace", &val, &s)) {
-			bencode_list_add_str(ng_flags->replace, &s);
+			bencode_writer_str(&ng_flags->replace, &s);
 			goto next;
 		}
 		if(str_key_val_prefix(&key, "received-from", &val, &s)) {
@@ -3412,56 +3505,56 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 			if(ip_af == AF_INET) {
 				s1.s = "IP4";
 				s1.len = 3;
-				bencode_list_add_str(ng_flags->received_from, &s1);
-				bencode_list_add_str(ng_flags->received_from, &s);
+				bencode_writer_str(&ng_flags->received_from, &s1);
+				bencode_writer_str(&ng_flags->received_from, &s);
 
 			} else if(ip_af == AF_INET6) {
 				s1.s = "IP6";
 				s1.len = 3;
-				bencode_list_add_str(ng_flags->received_from, &s1);
-				bencode_list_add_str(ng_flags->received_from, &s);
+				bencode_writer_str(&ng_flags->received_from, &s1);
+				bencode_writer_str(&ng_flags->received_from, &s);
 			}
 
 
 			goto next;
 		}
 		if(str_key_val_prefix(&key, "SDES", &val, &s)) {
-			bencode_list_add_str(ng_flags->sdes, &s);
+			bencode_writer_str(&ng_flags->sdes, &s);
 			goto next;
 		}
 		if(str_key_val_prefix(&key, "T38", &val, &s)
 				|| str_key_val_prefix(&key, "T.38", &val, &s)) {
-			bencode_list_add_str(ng_flags->t38, &s);
+			bencode_writer_str(&ng_flags->t38, &s);
 			goto next;
 		}
 		if(str_key_val_prefix(&key, "rtcp-mux", &val, &s)) {
-			bencode_list_add_str(ng_flags->rtcp_mux, &s);
+			bencode_writer_str(&ng_flags->rtcp_mux, &s);
 			goto next;
 		}
 
-		if(parse_codec_flag(ng_flags, &key, &val, "transcode",
-				   "codec-transcode", "transcode", &ng_flags->codec_transcode))
+		if(parse_codec_flag(&key, &val, "transcode",
+				   "codec-transcode", &ng_flags->codec_transcode))
 			goto next;
-		if(parse_codec_flag(ng_flags, &key, &val, "codec-strip", NULL, "strip",
+		if(parse_codec_flag(&key, &val, "codec-strip", NULL,
 				   &ng_flags->codec_strip))
 			goto next;
-		if(parse_codec_flag(ng_flags, &key, &val, "codec-offer", NULL, "offer",
+		if(parse_codec_flag(&key, &val, "codec-offer", NULL,
 				   &ng_flags->codec_offer))
 			goto next;
-		if(parse_codec_flag(ng_flags, &key, &val, "codec-mask", NULL, "mask",
+		if(parse_codec_flag(&key, &val, "codec-mask", NULL,
 				   &ng_flags->codec_mask))
 			goto next;
-		if(parse_codec_flag(ng_flags, &key, &val, "codec-set", NULL, "set",
+		if(parse_codec_flag(&key, &val, "codec-set", NULL,
 				   &ng_flags->codec_set))
 			goto next;
-		if(parse_codec_flag(ng_flags, &key, &val, "codec-except", NULL,
-				   "except", &ng_flags->codec_except))
+		if(parse_codec_flag(&key, &val, "codec-except", NULL,
+				   &ng_flags->codec_except))
 			goto next;
-		if(parse_codec_flag(ng_flags, &key, &val, "codec-accept", NULL,
-				   "accept", &ng_flags->codec_accept))
+		if(parse_codec_flag(&key, &val, "codec-accept", NULL,
+				   &ng_flags->codec_accept))
 			goto next;
-		if(parse_codec_flag(ng_flags, &key, &val, "codec-consume", NULL,
-				   "consume", &ng_flags->codec_consume))
+		if(parse_codec_flag(&key, &val, "codec-consume", NULL,
+				   &ng_flags->codec_consume))
 			goto next;
 
 		/* check for specially handled items */
@@ -3474,8 +3567,8 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 					ng_flags->transport |= 0x100;
 					ng_flags->transport &= ~0x002;
 				} else if(str_eq(&key, "TOS") && val.s) {
-					bencode_dictionary_add_integer(
-							ng_flags->dict, "TOS", atoi(val.s));
+					bencode_writer_dictionary_add_integer(
+							&ng_flags->dict, "TOS", atoi(val.s));
 				} else
 					goto generic;
 				goto next;
@@ -3517,7 +3610,7 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 
 			case 8:
 				if(str_eq(&key, "internal") || str_eq(&key, "external"))
-					bencode_list_add_str(ng_flags->direction, &key);
+					bencode_writer_str(&ng_flags->direction, &key);
 				else if(str_eq(&key, "RTP/AVPF") && !val.s)
 					ng_flags->transport = 0x102;
 				else if(str_eq(&key, "RTP/SAVP") && !val.s)
@@ -3537,17 +3630,13 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 				if(str_eq(&key, "RTP/SAVPF") && !val.s)
 					ng_flags->transport = 0x103;
 				else if(str_eq(&key, "direction"))
-					bencode_list_add_str(ng_flags->direction, &val);
+					bencode_writer_str(&ng_flags->direction, &val);
 				else if(str_eq(&key, "from-tags")) {
 					err = "missing value";
 					if(!val.s)
 						goto error;
 
-					if(!ng_flags->from_tags) {
-						ng_flags->from_tags =
-								bencode_list(ng_flags->dict->buffer);
-					}
-					bencode_list_add_str(ng_flags->from_tags, &val);
+					bencode_writer_str(&ng_flags->from_tags, &val);
 				} else
 					goto generic;
 				goto next;
@@ -3593,8 +3682,8 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 					err = "invalid value";
 					if(!ng_flags->packetize)
 						goto error;
-					bencode_dictionary_add_integer(
-							ng_flags->dict, "repacketize", ng_flags->packetize);
+					bencode_writer_dictionary_add_integer(&ng_flags->dict,
+							"repacketize", ng_flags->packetize);
 				} else if(str_eq(&key, "directional"))
 					ng_flags->directional = 1;
 				else
@@ -3610,8 +3699,8 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 					*op = OP_ANSWER;
 					goto next;
 				} else if(str_eq(&key, "delete-delay") && val.s)
-					bencode_dictionary_add_integer(
-							ng_flags->dict, "delete delay", atoi(val.s));
+					bencode_writer_dictionary_add_integer(
+							&ng_flags->dict, "delete delay", atoi(val.s));
 				break;
 
 
@@ -3635,9 +3724,9 @@ static int parse_flags(struct ng_flags_parse *ng_flags, struct sip_msg *msg,
 	generic:
 		if(!val.s) {
 			LM_DBG("Setting flag %.*s\n", key.len, key.s);
-			bencode_list_add_str(ng_flags->flags, &key);
+			bencode_writer_str(&ng_flags->flags, &key);
 		} else
-			bencode_dictionary_str_add_str(ng_flags->dict, &key, &val);
+			bencode_writer_dictionary_str_add_str(&ng_flags->dict, &key, &val);
 		goto next;
 
 	next:
@@ -3655,28 +3744,85 @@ error:
 	return -1;
 }
 
+/**
+ * copy the entries of a dictionary built through the api to the command,
+ * the items of its flags list going to the flags of the command
+ */
+static void rtpp_copy_extra_dict(
+		struct ng_flags_parse *ng_flags, bencode_item_t *extra_dict)
+{
+	bencode_item_t *key, *item;
+
+	for(key = extra_dict->child; key && key->sibling;
+			key = key->sibling->sibling) {
+		if(!bencode_strcmp(key, "flags")
+				&& key->sibling->type == BENCODE_LIST) {
+			for(item = key->sibling->child; item; item = item->sibling)
+				bencode_writer_item(&ng_flags->flags, item);
+			continue;
+		}
+		bencode_writer_item(&ng_flags->dict, key);
+		bencode_writer_item(&ng_flags->dict, key->sibling);
+	}
+}
+
+/**
+ * add the codec dictionary with the codec lists given in the flags
+ */
+static void rtpp_add_codec_lists(struct ng_flags_parse *ng_flags)
+{
+	struct
+	{
+		const char *name;
+		bencode_writer_t *list;
+	} codec[] = {
+			{"transcode", &ng_flags->codec_transcode},
+			{"strip", &ng_flags->codec_strip},
+			{"offer", &ng_flags->codec_offer},
+			{"mask", &ng_flags->codec_mask},
+			{"set", &ng_flags->codec_set},
+			{"except", &ng_flags->codec_except},
+			{"accept", &ng_flags->codec_accept},
+			{"consume", &ng_flags->codec_consume},
+	};
+	int i, n;
+
+	n = 0;
+	for(i = 0; i < sizeof(codec) / sizeof(codec[0]); i++) {
+		if(!bencode_writer_empty(codec[i].list))
+			n++;
+	}
+	if(n == 0)
+		return;
+
+	bencode_writer_string(&ng_flags->dict, "codec");
+	bencode_writer_dictionary(&ng_flags->dict);
+	for(i = 0; i < sizeof(codec) / sizeof(codec[0]); i++) {
+		if(!bencode_writer_empty(codec[i].list))
+			bencode_writer_dictionary_add_list(
+					&ng_flags->dict, codec[i].name, codec[i].list);
+	}
+	bencode_writer_end(&ng_flags->dict);
+}
+
 /**
  * flags - rtpp flags in a raw format (plain text)
  * p_viabranch - can be NULL. If not NULL flags are parsed on the daemon side,
  *             if it's NULL, flags are parsed by the module.
  *             Allowed values similarly to the flag option `via-branch`.
  */
-static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
+static int rtpp_function_call_prepare(bencode_buffer_t *bencbuf,
 		struct sip_msg *msg, enum rtpe_operation op, str *flags,
 		str *p_viabranch, str *body_out, str *cl_field,
-		bencode_item_t *extra_dict)
+		bencode_item_t *extra_dict, struct ng_flags_parse *ngf,
+		str *p_viabranch_out, char *branch_buf)
 {
 	struct ng_flags_parse ng_flags;
-	bencode_item_t *item, *resp;
-	bencode_item_t *result;
 	pv_value_t pv_val;
 	str viabranch = STR_NULL;
-	str body = STR_NULL, error = STR_NULL, tmp_callid = STR_NULL;
-	int ret, queried_nodes = 0, cont_type = 0;
+	str body = STR_NULL, tmp_callid = STR_NULL;
+	int ret, cont_type = 0;
 	unsigned int parse_by_module = (p_viabranch) ? 0 : 1;
-	struct rtpp_node *node;
-	char *cp;
-	char branch_buf[MAX_BRANCH_PARAM_LEN];
 
 	body.s = NULL;
 
@@ -3687,57 +3833,68 @@ static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
 		if(get_callid(msg, &ng_flags.call_id) == -1
 				|| ng_flags.call_id.len == 0) {
 			LM_ERR("can't get Call-Id field\n");
-			return NULL;
+			return -1;
 		}
 		if(get_to_tag(msg, &ng_flags.to_tag) == -1) {
 			LM_ERR("can't get To tag\n");
-			return NULL;
+			return -1;
 		}
 		if(get_from_tag(msg, &ng_flags.from_tag) == -1
 				|| ng_flags.from_tag.len == 0) {
 			LM_ERR("can't get From tag\n");
-			return NULL;
+			return -1;
 		}
 	}
 
-	/* initialize bencode buffer */
-	if(bencode_buffer_init(bencbuf)) {
+	/* initialize bencode buffer, unless the extra dictionary has been
+	 * built in it */
+	if(!extra_dict && bencode_buffer_init(bencbuf)) {
 		LM_ERR("could not initialize bencode_buffer_t\n");
-		return NULL;
+		return -1;
 	}
 
-	/* initialize some basic bencode items */
-	if(!extra_dict) {
-		ng_flags.dict = bencode_dictionary(bencbuf);
-		if(parse_by_module) {
-			ng_flags.flags = bencode_list(bencbuf);
-		}
-	} else {
-		ng_flags.dict = extra_dict;
-		ng_flags.flags = bencode_dictionary_get(ng_flags.dict, "flags");
-		bencode_dictionary_get_str(ng_flags.dict, "call-id", &tmp_callid);
+	/* the command is written in a single pass, the lists being collected
+	 * while parsing the flags and added at the end */
+	bencode_writer_init(&ng_flags.dict, bencbuf);
+	bencode_writer_dictionary(&ng_flags.dict);
+	bencode_writer_init(&ng_flags.from_tags, bencbuf);
+	if(parse_by_module || extra_dict) {
+		bencode_writer_init(&ng_flags.flags, bencbuf);
+	}
+	if(extra_dict) {
+		rtpp_copy_extra_dict(&ng_flags, extra_dict);
+		bencode_dictionary_get_str(extra_dict, "call-id", &tmp_callid);
 		if(tmp_callid.len > 0) {
 			ng_flags.call_id = tmp_callid;
 		}
 	}
 
 	if(parse_by_module) {
-		ng_flags.received_from = bencode_list(bencbuf);
+		bencode_writer_init(&ng_flags.received_from, bencbuf);
 	}
 
-	item = bencode_dictionary_add_list(ng_flags.dict, "supports");
-	bencode_list_add_string(item, "load limit");
+	bencode_writer_string(&ng_flags.dict, "supports");
+	bencode_writer_list(&ng_flags.dict);
+	bencode_writer_string(&ng_flags.dict, "load limit");
+	bencode_writer_end(&ng_flags.dict);
 
 	/* offer/asnwer specific things */
 	if(op == OP_OFFER || op == OP_ANSWER) {
-		/* create these bencode items only if parsing is local */
+		/* collect these lists only if parsing is local */
 		if(parse_by_module && flags) {
-			ng_flags.direction = bencode_list(bencbuf);
-			ng_flags.replace = bencode_list(bencbuf);
-			ng_flags.rtcp_mux = bencode_list(bencbuf);
-			ng_flags.sdes = bencode_list(bencbuf);
-			ng_flags.t38 = bencode_list(bencbuf);
-			ng_flags.codec = bencode_dictionary(bencbuf);
+			bencode_writer_init(&ng_flags.direction, bencbuf);
+			bencode_writer_init(&ng_flags.replace, bencbuf);
+			bencode_writer_init(&ng_flags.rtcp_mux, bencbuf);
+			bencode_writer_init(&ng_flags.sdes, bencbuf);
+			bencode_writer_init(&ng_flags.t38, bencbuf);
+			bencode_writer_init(&ng_flags.codec_strip, bencbuf);
+			bencode_writer_init(&ng_flags.codec_offer, bencbuf);
+			bencode_writer_init(&ng_flags.codec_transcode, bencbuf);
+			bencode_writer_init(&ng_flags.codec_mask, bencbuf);
+			bencode_writer_init(&ng_flags.codec_set, bencbuf);
+			bencode_writer_init(&ng_flags.codec_except, bencbuf);
+			bencode_writer_init(&ng_flags.codec_accept, bencbuf);
+			bencode_writer_init(&ng_flags.codec_consume, bencbuf);
 		}
 	}
 	if(op == OP_OFFER || op == OP_ANSWER || op == OP_SUBSCRIBE_ANSWER) {
@@ -3756,10 +3913,10 @@ static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
 			goto error;
 		}
 		if(body_intermediate.s)
-			bencode_dictionary_add_str(
-					ng_flags.dict, "sdp", &body_intermediate);
+			bencode_writer_dictionary_add_str(
+					&ng_flags.dict, "sdp", &body_intermediate);
 		else
-			bencode_dictionary_add_str(ng_flags.dict, "sdp", &body);
+			bencode_writer_dictionary_add_str(&ng_flags.dict, "sdp", &body);
 	}
 
 	/**
@@ -3781,11 +3938,11 @@ static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
 		/* check required values */
 		if(ng_flags.call_id.len == 0) {
 			LM_ERR("can't get Call-Id field\n");
-			return NULL;
+			goto error;
 		}
 		if(ng_flags.from_tag.len == 0) {
 			LM_ERR("can't get From tag\n");
-			return NULL;
+			goto error;
 		}
 	}
 
@@ -3793,56 +3950,59 @@ static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
 	 * but only add those if any flags were given at all */
 	if(parse_by_module && flags) {
 		/* direction */
-		if(ng_flags.direction && ng_flags.direction->child)
-			bencode_dictionary_add(
-					ng_flags.dict, "direction", ng_flags.direction);
-		/* flags */
-		if(ng_flags.flags && ng_flags.flags->child)
-			bencode_dictionary_add(ng_flags.dict, "flags", ng_flags.flags);
+		if(!bencode_writer_empty(&ng_flags.direction))
+			bencode_writer_dictionary_add_list(
+					&ng_flags.dict, "direction", &ng_flags.direction);
 		/* replace */
-		if(ng_flags.replace && ng_flags.replace->child)
-			bencode_dictionary_add(ng_flags.dict, "replace", ng_flags.replace);
+		if(!bencode_writer_empty(&ng_flags.replace))
+			bencode_writer_dictionary_add_list(
+					&ng_flags.dict, "replace", &ng_flags.replace);
 		/* codec */
-		if(ng_flags.codec && ng_flags.codec->child)
-			bencode_dictionary_add(ng_flags.dict, "codec", ng_flags.codec);
+		rtpp_add_codec_lists(&ng_flags);
 		/* transport-protocol */
 		if((ng_flags.transport & 0x100))
-			bencode_dictionary_add_string(ng_flags.dict, "transport-protocol",
+			bencode_writer_dictionary_add_string(&ng_flags.dict,
+					"transport-protocol",
 					transports[ng_flags.transport & 0x007]);
 		/* rtcp-mux */
-		if(ng_flags.rtcp_mux && ng_flags.rtcp_mux->child)
-			bencode_dictionary_add(
-					ng_flags.dict, "rtcp-mux", ng_flags.rtcp_mux);
+		if(!bencode_writer_empty(&ng_flags.rtcp_mux))
+			bencode_writer_dictionary_add_list(
+					&ng_flags.dict, "rtcp-mux", &ng_flags.rtcp_mux);
 		/* SDES */
-		if(ng_flags.sdes && ng_flags.sdes->child)
-			bencode_dictionary_add(ng_flags.dict, "SDES", ng_flags.sdes);
+		if(!bencode_writer_empty(&ng_flags.sdes))
+			bencode_writer_dictionary_add_list(
+					&ng_flags.dict, "SDES", &ng_flags.sdes);
 		/* T.38 */
-		if(ng_flags.t38 && ng_flags.t38->child)
-			bencode_dictionary_add(ng_flags.dict, "T.38", ng_flags.t38);
+		if(!bencode_writer_empty(&ng_flags.t38))
+			bencode_writer_dictionary_add_list(
+					&ng_flags.dict, "T.38", &ng_flags.t38);
 		/* received-from */
-		if(ng_flags.received_from && ng_flags.received_from->child) {
-			bencode_dictionary_add(
-					ng_flags.dict, "received-from", ng_flags.received_from);
-		} else {
-			bencode_dictionary_add(
-					ng_flags.dict, "received-from", ng_flags.received_from);
-			bencode_list_add_string(ng_flags.received_from,
+		if(bencode_writer_empty(&ng_flags.received_from)) {
+			bencode_writer_string(&ng_flags.received_from,
 					(msg->rcv.src_ip.af == AF_INET)
 							? "IP4"
 							: ((msg->rcv.src_ip.af == AF_INET6) ? "IP6" : "?"));
-			bencode_list_add_string(
-					ng_flags.received_from, ip_addr2a(&msg->rcv.src_ip));
+			bencode_writer_string(
+					&ng_flags.received_from, ip_addr2a(&msg->rcv.src_ip));
 		}
+		bencode_writer_dictionary_add_list(
+				&ng_flags.dict, "received-from", &ng_flags.received_from);
 	}
 
 	/* bencode items which are to be added always */
 	{
 		/* trickle ice sdp fragment */
 		if(cont_type == 3)
-			bencode_list_add_string(ng_flags.flags, "fragment");
+			bencode_writer_string(&ng_flags.flags, "fragment");
+
+		/* flags */
+		if(!bencode_writer_empty(&ng_flags.flags))
+			bencode_writer_dictionary_add_list(
+					&ng_flags.dict, "flags", &ng_flags.flags);
 
 		/* call-id */
-		bencode_dictionary_add_str(ng_flags.dict, "call-id", &ng_flags.call_id);
+		bencode_writer_dictionary_add_str(
+				&ng_flags.dict, "call-id", &ng_flags.call_id);
 
 		/* viabranch */
 		if(parse_by_module && ng_flags.via) {
@@ -3862,7 +4022,8 @@ static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
 			}
 		}
 		if(viabranch.s && viabranch.len) {
-			bencode_dictionary_add_str(ng_flags.dict, "via-branch", &viabranch);
+			bencode_writer_dictionary_add_str(
+					&ng_flags.dict, "via-branch", &viabranch);
 		}
 
 		/* from/to tags */
@@ -3870,91 +4031,70 @@ static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
 			goto error;
 
 		/* rtpengine command */
-		bencode_dictionary_add_string(
-				ng_flags.dict, "command", command_strings[op]);
+		bencode_writer_dictionary_add_string(
+				&ng_flags.dict, "command", command_strings[op]);
 
 		/* sip message type */
-		bencode_dictionary_add_string(ng_flags.dict, "sip-message-type",
-				sip_type_strings[msg->first_line.type]);
+		bencode_writer_dictionary_add_string(&ng_flags.dict,
+				"sip-message-type", sip_type_strings[msg->first_line.type]);
 	}
 
 	/* add rtpp flags, if parsed by daemon */
 	if(!parse_by_module && flags)
-		bencode_dictionary_add_str(ng_flags.dict, "rtpp-flags", flags);
+		bencode_writer_dictionary_add_str(&ng_flags.dict, "rtpp-flags", flags);
 
-	/**
-	 * send it out
-	 */
+	bencode_writer_end(&ng_flags.dict);
 
 	if(bencbuf->error) {
 		LM_ERR("out of memory - bencode failed\n");
 		goto error;
 	}
 
-	if(msg->id != current_msg_id)
-		active_rtpp_set = default_rtpp_set;
-
-select_node:
-	do {
-		if(queried_nodes
-				>= cfg_get(rtpengine, rtpengine_cfg, queried_nodes_limit)) {
-			LM_ERR("queried nodes limit reached\n");
-			goto error;
-		}
-
-		node = select_rtpp_node(ng_flags.call_id, viabranch, 1,
-				queried_nodes_ptr, queried_nodes, op);
-		if(!node) {
-			LM_ERR("no available proxies\n");
-			goto error;
-		}
-
-		cp = send_rtpp_command(node, ng_flags.dict, &ret);
-		/* if node is disabled permanent, don't recheck it later */
-		if(cp == NULL
-				&& node->rn_recheck_ticks != RTPENGINE_MAX_RECHECK_TICKS) {
-			node->rn_disabled = 1;
-			node->rn_recheck_ticks =
-					get_ticks()
-					+ cfg_get(rtpengine, rtpengine_cfg, rtpengine_disable_tout);
-		}
+	if(body_out)
+		*body_out = body;
+	*ngf = ng_flags;
+	*p_viabranch_out = viabranch;
 
-		queried_nodes_ptr[queried_nodes++] = node;
-	} while(cp == NULL);
+	return 0;
 
-	LM_DBG("proxy reply: %.*s\n", ret, cp);
+error:
+	bencode_buffer_free(bencbuf);
+	return -1;
+}
 
-	set_rtp_inst_pvar(msg, &node->rn_url);
-	/*** process reply ***/
+/**
+ * check the result of an rtpengine reply, looked up in the encoded reply
+ * - return: 0 - ok; 1 - try next node; -1 - error
+ */
+static int rtpp_check_reply(struct rtpp_node *node, char *cp, int ret)
+{
+	str result, item;
+	str error = STR_NULL;
 
-	resp = bencode_decode_expect(bencbuf, cp, ret, BENCODE_DICTIONARY);
-	if(!resp) {
+	if(bencode_raw_expect(cp, ret, BENCODE_DICTIONARY) < 0) {
 		LM_ERR("failed to decode bencoded reply from proxy: %.*s\n", ret, cp);
-		goto error;
+		return -1;
 	}
 
-	result = bencode_dictionary_get_expect(resp, "result", BENCODE_STRING);
-	if(!result) {
+	if(!bencode_raw_dictionary_get_str(cp, ret, "result", &result)) {
 		LM_ERR("No 'result' dictionary entry in response from proxy %.*s",
 				node->rn_url.len, node->rn_url.s);
-		goto error;
+		return -1;
 	}
 
-	if(!bencode_strcmp(result, "load limit")) {
-		item = bencode_dictionary_get_expect(resp, "message", BENCODE_STRING);
-		if(!item)
+	if(str_eq(&result, "load limit")) {
+		if(!bencode_raw_dictionary_get_str(cp, ret, "message", &item))
 			LM_INFO("proxy %.*s has reached its load limit - trying next one",
 					node->rn_url.len, node->rn_url.s);
 		else
 			LM_INFO("proxy %.*s has reached its load limit (%.*s) - trying "
 					"next one",
-					node->rn_url.len, node->rn_url.s, (int)item->iov[1].iov_len,
-					(char *)item->iov[1].iov_base);
-		goto select_node;
+					node->rn_url.len, node->rn_url.s, item.len, item.s);
+		return 1;
 	}
 
-	if(!bencode_strcmp(result, "error")) {
-		if(!bencode_dictionary_get_str(resp, "error-reason", &error)) {
+	if(str_eq(&result, "error")) {
+		if(!bencode_raw_dictionary_get_str(cp, ret, "error-reason", &error)) {
 			LM_ERR("proxy return error but didn't give an error reason: %.*s\n",
 					ret, cp);
 		} else {
@@ -3964,7 +4104,7 @@ select_node:
 							== 0)) {
 				LM_WARN("proxy %.*s: %.*s", node->rn_url.len, node->rn_url.s,
 						error.len, error.s);
-				goto select_node;
+				return 1;
 			}
 			if((RTPENGINE_SESS_OUT_OF_PORTS_MSG_LEN == error.len)
 					&& (strncmp(error.s, RTPENGINE_SESS_OUT_OF_PORTS_MSG,
@@ -3972,35 +4112,44 @@ select_node:
 							== 0)) {
 				LM_WARN("proxy %.*s: %.*s", node->rn_url.len, node->rn_url.s,
 						error.len, error.s);
-				goto select_node;
+				return 1;
 			}
 
 			LM_ERR("proxy replied with error: %.*s\n", error.len, error.s);
 		}
-		goto error;
+		return -1;
 	}
 
+	return 0;
+}
+
+/**
+ * keep track of the node used for a call-id/via-branch
+ */
+static void rtpp_hash_table_update(str callid, str viabranch,
+		enum rtpe_operation op, struct rtpp_node *node)
+{
+	struct rtpengine_hash_entry *entry;
+
 	/* add hastable entry with the node => */
-	if(!rtpengine_hash_table_lookup(ng_flags.call_id, viabranch, op)) {
+	if(!rtpengine_hash_table_lookup(callid, viabranch, op)) {
 		// build the entry
-		struct rtpengine_hash_entry *entry =
-				shm_malloc(sizeof(struct rtpengine_hash_entry));
+		entry = shm_malloc(sizeof(struct rtpengine_hash_entry));
 		if(!entry) {
 			LM_ERR("rtpengine hash table fail to create entry for calllen=%d "
 				   "callid=%.*s viabranch=%.*s\n",
-					ng_flags.call_id.len, ng_flags.call_id.len,
-					ng_flags.call_id.s, viabranch.len, viabranch.s);
+					callid.len, callid.len, callid.s, viabranch.len,
+					viabranch.s);
 			goto skip_hash_table_insert;
 		}
 		memset(entry, 0, sizeof(struct rtpengine_hash_entry));
 
 		// fill the entry
-		if(ng_flags.call_id.s && ng_flags.call_id.len > 0) {
-			if(shm_str_dup(&entry->callid, &ng_flags.call_id) < 0) {
+		if(callid.s && callid.len > 0) {
+			if(shm_str_dup(&entry->callid, &callid) < 0) {
 				LM_ERR("rtpengine hash table fail to duplicate calllen=%d "
 					   "callid=%.*s\n",
-						ng_flags.call_id.len, ng_flags.call_id.len,
-						ng_flags.call_id.s);
+						callid.len, callid.len, callid.s);
 				rtpengine_hash_table_free_entry(entry);
 				goto skip_hash_table_insert;
 			}
@@ -4009,7 +4158,7 @@ select_node:
 			if(shm_str_dup(&entry->viabranch, &viabranch) < 0) {
 				LM_ERR("rtpengine hash table fail to duplicate calllen=%d "
 					   "viabranch=%.*s\n",
-						ng_flags.call_id.len, viabranch.len, viabranch.s);
+						callid.len, viabranch.len, viabranch.s);
 				rtpengine_hash_table_free_entry(entry);
 				goto skip_hash_table_insert;
 			}
@@ -4019,107 +4168,222 @@ select_node:
 		entry->tout = get_ticks() + hash_table_tout;
 
 		// insert the key<->entry from the hashtable
-		if(!rtpengine_hash_table_insert(ng_flags.call_id, viabranch, entry)) {
+		if(!rtpengine_hash_table_insert(callid, viabranch, entry)) {
 			LM_ERR("rtpengine hash table fail to insert node=%.*s for "
 				   "calllen=%d callid=%.*s viabranch=%.*s\n",
-					node->rn_url.len, node->rn_url.s, ng_flags.call_id.len,
-					ng_flags.call_id.len, ng_flags.call_id.s, viabranch.len,
-					viabranch.s);
+					node->rn_url.len, node->rn_url.s, callid.len, callid.len,
+					callid.s, viabranch.len, viabranch.s);
 			rtpengine_hash_table_free_entry(entry);
 			goto skip_hash_table_insert;
 		} else {
 			LM_DBG("rtpengine hash table insert node=%.*s for calllen=%d "
 				   "callid=%.*s viabranch=%.*s\n",
-					node->rn_url.len, node->rn_url.s, ng_flags.call_id.len,
-					ng_flags.call_id.len, ng_flags.call_id.s, viabranch.len,
-					viabranch.s);
+					node->rn_url.len, node->rn_url.s, callid.len, callid.len,
+					callid.s, viabranch.len, viabranch.s);
 			if(rtpengine_enable_dmq > 0)
-				rtpengine_dmq_replicate_insert(
-						ng_flags.call_id, viabranch, entry);
+				rtpengine_dmq_replicate_insert(callid, viabranch, entry);
 		}
 	}
 
 skip_hash_table_insert:
-	if(body_out)
-		*body_out = body;
-
 	if(op == OP_DELETE) {
 		/* Delete the key<->value from the hashtable */
-		if(!rtpengine_hash_table_remove(ng_flags.call_id, viabranch, op)) {
+		if(!rtpengine_hash_table_remove(callid, viabranch, op)) {
 			LM_ERR("rtpengine hash table failed to remove entry for callen=%d "
 				   "callid=%.*s viabranch=%.*s\n",
-					ng_flags.call_id.len, ng_flags.call_id.len,
-					ng_flags.call_id.s, viabranch.len, viabranch.s);
+					callid.len, callid.len, callid.s, viabranch.len,
+					viabranch.s);
 		} else {
 			LM_DBG("rtpengine hash table remove entry for callen=%d "
 				   "callid=%.*s viabranch=%.*s\n",
-					ng_flags.call_id.len, ng_flags.call_id.len,
-					ng_flags.call_id.s, viabranch.len, viabranch.s);
+					callid.len, callid.len, callid.s, viabranch.len,
+					viabranch.s);
 			if(rtpengine_enable_dmq > 0)
-				rtpengine_dmq_replicate_remove(ng_flags.call_id, viabranch);
+				rtpengine_dmq_replicate_remove(callid, viabranch);
 		}
 	}
-
-	return resp;
-
-error:
-	bencode_buffer_free(bencbuf);
-	return NULL;
 }
 
-static int rtpp_function_call_simple(
-		struct sip_msg *msg, enum rtpe_operation op, void *d)
+/**
+ * send the command to a node and check the reply, which is left encoded in
+ * the receive buffer and is valid until the next command is sent
+ * - on success the bencode buffer has to be freed by the caller
+ */
+static int rtpp_function_call_raw(bencode_buffer_t *bencbuf,
+		struct sip_msg *msg, enum rtpe_operation op, str *flags,
+		str *p_viabranch, str *body_out, str *cl_field,
+		bencode_item_t *extra_dict, str *reply)
 {
-	void **parms;
-	str *flags = NULL;
-	str *viabranch = NULL;
-	bencode_buffer_t bencbuf;
-	bencode_item_t *ret;
-
-	parms = d;
-	flags = parms[0];
-	viabranch = parms[1];
+	struct ng_flags_parse ng_flags;
+	str viabranch = STR_NULL;
+	str request;
+	int ret, queried_nodes = 0;
+	struct rtpp_node *node;
+	char *cp;
+	char branch_buf[MAX_BRANCH_PARAM_LEN];
 
-	ret = rtpp_function_call(
-			&bencbuf, msg, op, flags, viabranch, NULL, NULL, NULL);
-	if(!ret)
+	if(rtpp_function_call_prepare(bencbuf, msg, op, flags, p_viabranch,
+			   body_out, cl_field, extra_dict, &ng_flags, &viabranch,
+			   branch_buf)
+			< 0)
 		return -1;
+	bencode_writer_get_str(&ng_flags.dict, &request);
 
-	if(bencode_dictionary_get_strcmp(ret, "result", "ok")) {
-		LM_ERR("proxy didn't return \"ok\" result\n");
-		bencode_buffer_free(&bencbuf);
-		return -1;
+	/**
+	 * send it out
+	 */
+
+	if(msg->id != current_msg_id)
+		active_rtpp_set = default_rtpp_set;
+
+select_node:
+	do {
+		if(queried_nodes
+				>= cfg_get(rtpengine, rtpengine_cfg, queried_nodes_limit)) {
+			LM_ERR("queried nodes limit reached\n");
+			goto error;
+		}
+
+		node = select_rtpp_node(ng_flags.call_id, viabranch, 1,
+				queried_nodes_ptr, queried_nodes, op);
+		if(!node) {
+			LM_ERR("no available proxies\n");
+			goto error;
+		}
+
+		cp = send_rtpp_command(node, &request, command_strings[op], &ret);
+		/* if node is disabled permanent, don't recheck it later */
+		if(cp == NULL
+				&& node->rn_recheck_ticks != RTPENGINE_MAX_RECHECK_TICKS) {
+			node->rn_disabled = 1;
+			node->rn_recheck_ticks =
+					get_ticks()
+					+ cfg_get(rtpengine, rtpengine_cfg, rtpengine_disable_tout);
+		}
+
+		queried_nodes_ptr[queried_nodes++] = node;
+	} while(cp == NULL);
+
+	LM_DBG("proxy reply: %.*s\n", ret, cp);
+
+	set_rtp_inst_pvar(msg, &node->rn_url);
+	/*** process reply ***/
+
+	switch(rtpp_check_reply(node, cp, ret)) {
+		case 0:
+			break;
+		case 1:
+			goto select_node;
+		default:
+			goto error;
 	}
 
-	bencode_buffer_free(&bencbuf);
-	return 1;
-}
+	rtpp_hash_table_update(ng_flags.call_id, viabranch, op, node);
 
-static int rtpengine_simple_wrap(
-		struct sip_msg *msg, void *d, int more, enum rtpe_operation op)
-{
-	return rtpp_function_call_simple(msg, op, d);
-}
+	reply->s = cp;
+	reply->len = ret;
+	return 0;
 
+error:
+	bencode_buffer_free(bencbuf);
+	return -1;
+}
 
-static bencode_item_t *rtpp_function_call_ok(bencode_buffer_t *bencbuf,
-		struct sip_msg *msg, enum rtpe_operation op, str *flags, str *viabranch,
-		str *body, str *cl_field, bencode_item_t *dict)
+/**
+ * send the command and decode the whole reply
+ */
+static bencode_item_t *rtpp_function_call(bencode_buffer_t *bencbuf,
+		struct sip_msg *msg, enum rtpe_operation op, str *flags,
+		str *p_viabranch, str *body_out, str *cl_field,
+		bencode_item_t *extra_dict)
 {
-	bencode_item_t *ret;
+	bencode_item_t *resp;
+	str reply;
 
-	ret = rtpp_function_call(
-			bencbuf, msg, op, flags, viabranch, body, cl_field, dict);
-	if(!ret)
+	if(rtpp_function_call_raw(bencbuf, msg, op, flags, p_viabranch, body_out,
+			   cl_field, extra_dict, &reply)
+			< 0)
 		return NULL;
 
-	if(bencode_dictionary_get_strcmp(ret, "result", "ok")) {
-		LM_ERR("proxy didn't return \"ok\" result\n");
+	resp = bencode_decode_expect(
+			bencbuf, reply.s, reply.len, BENCODE_DICTIONARY);
+	if(!resp) {
+		LM_ERR("failed to decode bencoded reply from proxy: %.*s\n",
+				reply.len, reply.s);
 		bencode_buffer_free(bencbuf);
 		return NULL;
 	}
-
-	return ret;
+	return resp;
+}
+
+/**
+ * send the command and check that the result is ok, the reply being left
+ * encoded in the receive buffer (if reply is not NULL)
+ */
+static int rtpp_function_call_ok_raw(struct sip_msg *msg,
+		enum rtpe_operation op, str *flags, str *viabranch, str *body,
+		str *cl_field, str *reply)
+{
+	bencode_buffer_t bencbuf;
+	str rbuf;
+
+	if(rtpp_function_call_raw(&bencbuf, msg, op, flags, viabranch, body,
+			   cl_field, NULL, &rbuf)
+			< 0)
+		return -1;
+	/* the command is sent, the reply is in the receive buffer */
+	bencode_buffer_free(&bencbuf);
+
+	if(bencode_raw_dictionary_get_strcmp(rbuf.s, rbuf.len, "result", "ok")) {
+		LM_ERR("proxy didn't return \"ok\" result\n");
+		return -1;
+	}
+	if(reply)
+		*reply = rbuf;
+	return 0;
+}
+
+static int rtpp_function_call_simple(
+		struct sip_msg *msg, enum rtpe_operation op, void *d)
+{
+	void **parms;
+	str *flags = NULL;
+	str *viabranch = NULL;
+	parms = d;
+	flags = parms[0];
+	viabranch = parms[1];
+
+	if(rtpp_function_call_ok_raw(msg, op, flags, viabranch, NULL, NULL, NULL)
+			< 0)
+		return -1;
+	return 1;
+}
+
+static int rtpengine_simple_wrap(
+		struct sip_msg *msg, void *d, int more, enum rtpe_operation op)
+{
+	return rtpp_function_call_simple(msg, op, d);
+}
+
+
+static bencode_item_t *rtpp_function_call_ok(bencode_buffer_t *bencbuf,
+		struct sip_msg *msg, enum rtpe_operation op, str *flags, str *viabranch,
+		str *body, str *cl_field, bencode_item_t *dict)
+{
+	bencode_item_t *ret;
+
+	ret = rtpp_function_call(
+			bencbuf, msg, op, flags, viabranch, body, cl_field, dict);
+	if(!ret)
+		return NULL;
+
+	if(bencode_dictionary_get_strcmp(ret, "result", "ok")) {
+		LM_ERR("proxy didn't return \"ok\" result\n");
+		bencode_buffer_free(bencbuf);
+		return NULL;
+	}
+
+	return ret;
 }
 
 /**
@@ -4272,7 +4536,8 @@ free_nodes:
 static int rtpp_test(struct rtpp_node *node, int isdisabled, int force)
 {
 	bencode_buffer_t bencbuf;
-	bencode_item_t *dict;
+	bencode_writer_t cmd;
+	str request;
 	char *cp;
 	int ret;
 
@@ -4298,12 +4563,15 @@ static int rtpp_test(struct rtpp_node *node, int isdisabled, int force)
 		LM_ERR("could not initialized bencode_buffer_t\n");
 		return 1;
 	}
-	dict = bencode_dictionary(&bencbuf);
-	bencode_dictionary_add_string(dict, "command", "ping");
+	bencode_writer_init(&cmd, &bencbuf);
+	bencode_writer_dictionary(&cmd);
+	bencode_writer_dictionary_add_string(&cmd, "command", "ping");
+	bencode_writer_end(&cmd);
 	if(bencbuf.error)
 		goto benc_error;
 
-	cp = send_rtpp_command(node, dict, &ret);
+	cp = send_rtpp_command(
+			node, bencode_writer_get_str(&cmd, &request), "ping", &ret);
 	if(!cp) {
 		node->rn_disabled = 1;
 		node->rn_recheck_ticks =
@@ -4313,8 +4581,7 @@ static int rtpp_test(struct rtpp_node *node, int isdisabled, int force)
 		goto error;
 	}
 
-	dict = bencode_decode_expect(&bencbuf, cp, ret, BENCODE_DICTIONARY);
-	if(!dict || bencode_dictionary_get_strcmp(dict, "result", "pong")) {
+	if(bencode_raw_dictionary_get_strcmp(cp, ret, "result", "pong")) {
 		LM_ERR("proxy responded with invalid response\n");
 		goto error;
 	}
@@ -4332,8 +4599,12 @@ error:
 	return 1;
 }
 
-static char *send_rtpp_command(
-		struct rtpp_node *node, bencode_item_t *dict, int *outlen)
+/**
+ * send the encoded command to a node
+ * - return: the reply, in a static buffer, NULL on error
+ */
+static char *send_rtpp_command(struct rtpp_node *node, str *cmd,
+		const char *cmdname, int *outlen)
 {
 	struct sockaddr_un addr;
 	int fd = -1, len, i, vcnt;
@@ -4341,16 +4612,14 @@ static char *send_rtpp_command(
 	char *cp;
 	static char buf[0x40000];
 	struct pollfd fds[1];
-	struct iovec *v;
-	str cmd = STR_NULL;
+	struct iovec v[2];
 	const static str rtpe_proto = {"ng.rtpengine.com", 16};
 	str request, response;
 
-	v = bencode_iovec(dict, &vcnt, 1, 0);
-	if(!v) {
-		LM_ERR("error converting bencode to iovec\n");
-		return NULL;
-	}
+	/* the cookie goes in front of the command */
+	v[1].iov_base = cmd->s;
+	v[1].iov_len = cmd->len;
+	vcnt = 1;
 
 	len = 0;
 	cp = buf;
@@ -4459,10 +4728,9 @@ static char *send_rtpp_command(
 				len = writev(rtpp_socks[node->idx], v, vcnt + 1);
 			} while(len == -1 && (errno == EINTR || errno == ENOBUFS));
 			if(len <= 0) {
-				bencode_get_str(bencode_dictionary_get(dict, "command"), &cmd);
-				LM_ERR("can't send command \"%.*s\" to RTPEngine <%s> "
+				LM_ERR("can't send command \"%s\" to RTPEngine <%s> "
 					   "(%s:%d)\n",
-						cmd.len, cmd.s, node->rn_url.s, strerror(errno), errno);
+						cmdname, node->rn_url.s, strerror(errno), errno);
 				goto badproxy;
 			}
 			while((poll(fds, 1, rtpengine_tout_ms) == 1)
@@ -4471,12 +4739,9 @@ static char *send_rtpp_command(
 					len = recv(rtpp_socks[node->idx], buf, sizeof(buf) - 1, 0);
 				} while(len == -1 && errno == EINTR);
 				if(len <= 0) {
-					bencode_get_str(
-							bencode_dictionary_get(dict, "command"), &cmd);
-					LM_ERR("can't read reply for command \"%.*s\" from "
+					LM_ERR("can't read reply for command \"%s\" from "
 						   "RTPEngine <%s> (%s:%d)\n",
-							cmd.len, cmd.s, node->rn_url.s, strerror(errno),
-							errno);
+							cmdname, node->rn_url.s, strerror(errno), errno);
 					goto badproxy;
 				}
 				if(len >= (v[0].iov_len - 1)
@@ -4494,10 +4759,9 @@ static char *send_rtpp_command(
 			}
 		}
 		if(i == rtpengine_retr) {
-			bencode_get_str(bencode_dictionary_get(dict, "command"), &cmd);
-			LM_ERR("timeout waiting reply for command \"%.*s\" from RTPEngine "
+			LM_ERR("timeout waiting reply for command \"%s\" from RTPEngine "
 				   "<%s>\n",
-					cmd.len, cmd.s, node->rn_url.s);
+					cmdname, node->rn_url.s);
 			goto badproxy;
 		}
 	}
@@ -5308,7 +5572,11 @@ static int set_rtpengine_set_f(struct sip_msg *msg, char *str1, char *str2)
 	return 1;
 }
 
-static int rtpengine_manage(struct sip_msg *msg, void *d)
+/**
+ * detect the rtpengine operation to be done by rtpengine_manage()
+ * - return: 1 - operation detected; 0 - nothing to do; -1 - error
+ */
+static int rtpengine_manage_op(struct sip_msg *msg, enum rtpe_operation *op)
 {
 	int method;
 	int nosdp;
@@ -5317,7 +5585,7 @@ static int rtpengine_manage(struct sip_msg *msg, void *d)
 	if(route_type == BRANCH_FAILURE_ROUTE) {
 		/* do nothing in branch failure event route
 		 * - delete done on transaction failure route */
-		return 1;
+		return 0;
 	}
 
 	if(msg->cseq == NULL
@@ -5334,8 +5602,9 @@ static int rtpengine_manage(struct sip_msg *msg, void *d)
 					   | METHOD_UPDATE | METHOD_PRACK)))
 		return -1;
 
+	*op = OP_DELETE;
 	if(method & (METHOD_CANCEL | METHOD_BYE))
-		return rtpengine_delete(msg, d);
+		return 1;
 
 	if(msg->msg_flags & FL_SDP_BODY)
 		nosdp = 0;
@@ -5343,10 +5612,14 @@ static int rtpengine_manage(struct sip_msg *msg, void *d)
 		nosdp = parse_sdp(msg);
 
 	if(msg->first_line.type == SIP_REQUEST) {
-		if((method & (METHOD_ACK | METHOD_PRACK)) && nosdp == 0)
-			return rtpengine_offer_answer(msg, d, OP_ANSWER, 0);
-		if(method == METHOD_UPDATE && nosdp == 0)
-			return rtpengine_offer_answer(msg, d, OP_OFFER, 0);
+		if((method & (METHOD_ACK | METHOD_PRACK)) && nosdp == 0) {
+			*op = OP_ANSWER;
+			return 1;
+		}
+		if(method == METHOD_UPDATE && nosdp == 0) {
+			*op = OP_OFFER;
+			return 1;
+		}
 		if(method == METHOD_INVITE && nosdp == 0) {
 			msg->msg_flags |= FL_SDP_BODY;
 			if(tmb.t_gett != NULL) {
@@ -5355,27 +5628,43 @@ static int rtpengine_manage(struct sip_msg *msg, void *d)
 					t->uas.request->msg_flags |= FL_SDP_BODY;
 				}
 			}
-			if(route_type == FAILURE_ROUTE)
-				return rtpengine_delete(msg, d);
-			return rtpengine_offer_answer(msg, d, OP_OFFER, 0);
+			if(route_type != FAILURE_ROUTE)
+				*op = OP_OFFER;
+			return 1;
 		}
 	} else if(msg->first_line.type == SIP_REPLY) {
 		if(msg->first_line.u.reply.statuscode >= 300)
-			return rtpengine_delete(msg, d);
+			return 1;
 		if(nosdp == 0) {
+			*op = OP_ANSWER;
 			if(method == METHOD_UPDATE)
-				return rtpengine_offer_answer(msg, d, OP_ANSWER, 0);
+				return 1;
 			if(tmb.t_gett == NULL || tmb.t_gett() == NULL
 					|| tmb.t_gett() == T_UNDEFINED)
-				return rtpengine_offer_answer(msg, d, OP_ANSWER, 0);
+				return 1;
 			if(tmb.t_gett()->uas.request->msg_flags & FL_SDP_BODY)
-				return rtpengine_offer_answer(msg, d, OP_ANSWER, 0);
-			return rtpengine_offer_answer(msg, d, OP_OFFER, 0);
+				return 1;
+			*op = OP_OFFER;
+			return 1;
 		}
 	}
 	return -1;
 }
 
+static int rtpengine_manage(struct sip_msg *msg, void *d)
+{
+	enum rtpe_operation op = OP_ANY;
+	int ret;
+
+	ret = rtpengine_manage_op(msg, &op);
+	if(ret <= 0)
+		return (ret == 0) ? 1 : -1;
+
+	if(op == OP_DELETE)
+		return rtpengine_delete(msg, d);
+	return rtpengine_offer_answer(msg, d, op, 0);
+}
+
 static int rtpengine_manage_wrap(
 		struct sip_msg *msg, void *d, int more, enum rtpe_operation op)
 {
@@ -5488,7 +5777,7 @@ static int rtpengine_subscribe_request_wrap(
 	str *stream_xavp = NULL;
 	str *viabranch = NULL;
 	bencode_buffer_t bencbuf;
-	bencode_item_t *dict;
+	str reply, medias;
 	str ret_body, to_tag = {"", 0};
 
 	pv_spec_t *pvs = NULL;
@@ -5503,13 +5792,14 @@ static int rtpengine_subscribe_request_wrap(
 	stream_xavp = parms[3];
 	viabranch = parms[4];
 
-	dict = rtpp_function_call_ok(
-			&bencbuf, msg, op, flags, viabranch, NULL, NULL, NULL);
-	if(!dict)
+	if(rtpp_function_call_ok_raw(
+			   msg, op, flags, viabranch, NULL, NULL, &reply)
+			< 0)
 		return -1;
 
 	// Extract SDP body from the RTPEngine response
-	if(!bencode_dictionary_get_str_dup(dict, "sdp", &ret_body)) {
+	if(!bencode_raw_dictionary_get_str_dup(
+			   reply.s, reply.len, "sdp", &ret_body)) {
 		LM_ERR("failed to extract sdp body from proxy reply\n");
 		return -1;
 	}
@@ -5527,7 +5817,8 @@ static int rtpengine_subscribe_request_wrap(
 	}
 
 	// Extract and allocate a new to-tag from the RTPEngine response
-	if(!bencode_dictionary_get_str(dict, "to-tag", &to_tag)) {
+	if(!bencode_raw_dictionary_get_str(
+			   reply.s, reply.len, "to-tag", &to_tag)) {
 		LM_ERR("failed to extract to-tag from proxy reply\n");
 		return -1;
 	}
@@ -5543,13 +5834,19 @@ static int rtpengine_subscribe_request_wrap(
 				to_tag.len, to_tag.s);
 	}
 
-	if(stream_xavp != NULL) {
-		rtpengine_copy_streams_to_xavp(
-				stream_xavp, bencode_dictionary_get(dict, "tag-medias"));
+	// Decode only the streams from the RTPEngine response
+	if(stream_xavp != NULL
+			&& bencode_raw_dictionary_get_expect(reply.s, reply.len,
+					"tag-medias", BENCODE_LIST, &medias)) {
+		if(bencode_buffer_init(&bencbuf)) {
+			LM_ERR("could not initialize bencode_buffer_t\n");
+			return -1;
+		}
+		rtpengine_copy_streams_to_xavp(stream_xavp,
+				bencode_decode_expect_str(&bencbuf, &medias, BENCODE_LIST));
+		bencode_buffer_free(&bencbuf);
 	}
 
-	// Free the bencode buffer
-	bencode_buffer_free(bencode_item_buffer(dict));
 	return 0;
 }
 
@@ -5598,19 +5895,14 @@ static int rtpengine_subscribe_answer_wrap(
 	void **parms;
 	str *flags = NULL;
 	str *viabranch = NULL;
-	bencode_buffer_t bencbuf;
-	bencode_item_t *dict;
 
 	parms = d;
 	flags = parms[0];
 	viabranch = parms[1];
 
-	dict = rtpp_function_call_ok(
-			&bencbuf, msg, op, flags, viabranch, NULL, NULL, NULL);
-	if(!dict)
+	if(rtpp_function_call_ok_raw(msg, op, flags, viabranch, NULL, NULL, NULL)
+			< 0)
 		return -1;
-	// Free the bencode buffer
-	bencode_buffer_free(bencode_item_buffer(dict));
 	return 0;
 }
 
@@ -5659,49 +5951,33 @@ static int rtpengine_unsubscribe_wrap(
 	void **parms;
 	str *flags = NULL;
 	str *viabranch = NULL;
-	bencode_buffer_t bencbuf;
-	bencode_item_t *dict;
 
 	parms = d;
 	flags = parms[0];
 	viabranch = parms[1];
 
-	dict = rtpp_function_call_ok(
-			&bencbuf, msg, op, flags, viabranch, NULL, NULL, NULL);
-	if(!dict)
+	if(rtpp_function_call_ok_raw(msg, op, flags, viabranch, NULL, NULL, NULL)
+			< 0)
 		return -1;
-	// Free the bencode buffer
-	bencode_buffer_free(bencode_item_buffer(dict));
 	return 0;
 }
 
-static int rtpengine_offer_answer(
-		struct sip_msg *msg, void *d, enum rtpe_operation op, int more)
+/**
+ * update the message body with the sdp from the encoded rtpengine reply
+ */
+static int rtpengine_offer_answer_apply(
+		struct sip_msg *msg, str *reply, str body, str cl_field, int more)
 {
-	void **parms;
-	str *flags = NULL;
-	str *viabranch = NULL;
-	bencode_buffer_t bencbuf;
-	bencode_item_t *dict;
-	str body, newbody;
+	str newbody;
 	struct lump *anchor;
 	pv_value_t pv_val;
 	str cur_body = STR_NULL;
-	str cl_field = STR_NULL;
 	str cl_repl = STR_NULL;
 
-	parms = d;
-	flags = parms[0];
-	viabranch = parms[1];
-
-	dict = rtpp_function_call_ok(
-			&bencbuf, msg, op, flags, viabranch, &body, &cl_field, NULL);
-	if(!dict)
-		return -1;
-
-	if(!bencode_dictionary_get_str_dup(dict, "sdp", &newbody)) {
+	if(!bencode_raw_dictionary_get_str_dup(
+			   reply->s, reply->len, "sdp", &newbody)) {
 		LM_ERR("failed to extract sdp body from proxy reply\n");
-		goto error;
+		return -1;
 	}
 
 	if(body_intermediate.s)
@@ -5764,18 +6040,37 @@ static int rtpengine_offer_answer(
 		}
 	}
 
-	bencode_buffer_free(&bencbuf);
 	return 1;
 
 error_free:
 	pkg_free(newbody.s);
 	if(cl_repl.s)
 		pkg_free(cl_repl.s);
-error:
-	bencode_buffer_free(&bencbuf);
 	return -1;
 }
 
+static int rtpengine_offer_answer(
+		struct sip_msg *msg, void *d, enum rtpe_operation op, int more)
+{
+	void **parms;
+	str *flags = NULL;
+	str *viabranch = NULL;
+	str reply;
+	str body;
+	str cl_field = STR_NULL;
+
+	parms = d;
+	flags = parms[0];
+	viabranch = parms[1];
+
+	if(rtpp_function_call_ok_raw(
+			   msg, op, flags, viabranch, &body, &cl_field, &reply)
+			< 0)
+		return -1;
+
+	return rtpengine_offer_answer_apply(msg, &reply, body, cl_field, more);
+}
+
 
 static int rtpengine_generic_f(
 		struct sip_msg *msg, char *str1, enum rtpe_operation op)
@@ -6582,6 +6877,610 @@ static int ki_set_rtpengine_set2(sip_msg_t *msg, int r1, int r2)
 	return 1;
 }
 
+/**
+ * asynchronous offer/answer/delete
+ * - the SIP worker builds the ng command, suspends the transaction and
+ *   passes the task over a pipe to one of the async processes, selected
+ *   by the hash of the call-id
+ * - each async process sends the commands on its own control sockets,
+ *   matches the replies by cookie and resumes the transactions
+ */
+typedef struct rtpe_async_task
+{
+	unsigned int tindex;
+	unsigned int tlabel;
+	cfg_action_t *ract;
+	str cbname;
+	enum rtpe_operation op;
+	unsigned int setid; /* the node is looked up again by set and url */
+	unsigned int idx;
+	str url;
+	str callid;
+	str viabranch;
+	str request;
+	str reply;
+	char cookie[36];
+	int cookie_len;
+	int retr;
+	struct timeval due;
+	struct rtpe_async_task *next; /* slot of the pending table */
+	struct rtpe_async_task *tnext; /* list ordered by due time */
+	struct rtpe_async_task *tprev;
+} rtpe_async_task_t;
+
+#define RTPE_ASYNC_HSIZE 1024
+
+/* commands waiting for the reply in the async process, by cookie */
+static rtpe_async_task_t **_rtpe_async_htable = NULL;
+/* same commands ordered by due time - the timeout is the same for all */
+static rtpe_async_task_t _rtpe_async_due;
+
+static rtpe_async_task_t *_rtpe_async_current = NULL;
+
+/**
+ * node of a task - looked up again each time, the list of nodes can be
+ * reloaded while the command is pending
+ */
+static struct rtpp_node *rtpengine_async_node(rtpe_async_task_t *task)
+{
+	struct rtpp_node *node;
+
+	node = get_rtpp_node(get_rtpp_set(task->setid, 0), &task->url);
+	if(node == NULL || node->rn_displayed == 0 || node->idx != task->idx) {
+		LM_ERR("RTPEngine <%.*s> removed while command \"%s\" was pending\n",
+				task->url.len, task->url.s, command_strings[task->op]);
+		return NULL;
+	}
+	return node;
+}
+
+static int rtpengine_async_call(sip_msg_t *msg, enum rtpe_operation op,
+		str *flags, str *viabranch, str *rtname)
+{
+	bencode_buffer_t bencbuf;
+	struct ng_flags_parse ng_flags;
+	str vb = STR_NULL;
+	char branch_buf[MAX_BRANCH_PARAM_LEN];
+	struct rtpp_node *node;
+	str request;
+	int ret;
+	tm_cell_t *t;
+	cfg_action_t *act = NULL;
+	rtpe_async_task_t *task;
+	char *p;
+	unsigned int pidx;
+	int pfd;
+
+	if(_rtpe_async_pipes == NULL) {
+		LM_ERR("async mode is not enabled\n");
+		return -1;
+	}
+	if(tmb.t_suspend == NULL) {
+		LM_ERR("tm module is required for async mode\n");
+		return -1;
+	}
+	if(faked_msg_match(msg) || msg->first_line.type != SIP_REQUEST) {
+		LM_ERR("async mode can be used only for received requests\n");
+		return -1;
+	}
+	if(msg->first_line.u.request.method_value & (METHOD_ACK | METHOD_CANCEL)) {
+		/* no transaction of their own to suspend */
+		LM_ERR("async mode cannot be used for ACK and CANCEL requests\n");
+		return -1;
+	}
+
+	if(sr_kemi_eng_get() == NULL) {
+		ret = route_lookup(&main_rt, rtname->s);
+		if(ret < 0 || (act = main_rt.rlist[ret]) == NULL) {
+			LM_ERR("route block not found or empty: %.*s\n", rtname->len,
+					rtname->s);
+			return -1;
+		}
+	}
+
+	if(op == OP_ANY) {
+		ret = rtpengine_manage_op(msg, &op);
+		if(ret <= 0)
+			return (ret == 0) ? 1 : -1;
+	}
+
+	body_intermediate.s = NULL;
+	if(set_rtpengine_set_from_avp(msg, 1) == -1)
+		return -1;
+	if(selected_rtpp_set_2 && selected_rtpp_set_2 != selected_rtpp_set_1) {
+		LM_ERR("async mode does not support a second rtpengine set\n");
+		return -1;
+	}
+
+	if(rtpp_function_call_prepare(&bencbuf, msg, op, flags, viabranch, NULL,
+			   NULL, NULL, &ng_flags, &vb, branch_buf)
+			< 0)
+		return -1;
+
+	if(msg->id != current_msg_id)
+		active_rtpp_set = default_rtpp_set;
+
+	node = select_rtpp_node(ng_flags.call_id, vb, 1, queried_nodes_ptr, 0, op);
+	if(!node) {
+		LM_ERR("no available proxies\n");
+		goto error;
+	}
+	if(node->rn_umode != RNU_UDP && node->rn_umode != RNU_UDP6) {
+		LM_ERR("async mode works only with udp rtpengine nodes (%.*s)\n",
+				node->rn_url.len, node->rn_url.s);
+		goto error;
+	}
+
+	bencode_writer_get_str(&ng_flags.dict, &request);
+
+	t = tmb.t_gett();
+	if(t == NULL || t == T_UNDEFINED) {
+		if(tmb.t_newtran(msg) < 0) {
+			LM_ERR("cannot create the transaction\n");
+			goto error;
+		}
+	}
+
+	task = (rtpe_async_task_t *)shm_mallocxz(
+			sizeof(rtpe_async_task_t) + node->rn_url.len + ng_flags.call_id.len
+			+ vb.len + rtname->len + request.len + 5);
+	if(task == NULL) {
+		SHM_MEM_ERROR;
+		goto error;
+	}
+	p = (char *)task + sizeof(rtpe_async_task_t);
+	task->url.s = p;
+	memcpy(p, node->rn_url.s, node->rn_url.len);
+	task->url.len = node->rn_url.len;
+	p += task->url.len + 1;
+	task->callid.s = p;
+	memcpy(p, ng_flags.call_id.s, ng_flags.call_id.len);
+	task->callid.len = ng_flags.call_id.len;
+	p += task->callid.len + 1;
+	if(vb.len > 0) {
+		task->viabranch.s = p;
+		memcpy(p, vb.s, vb.len);
+		task->viabranch.len = vb.len;
+		p += vb.len + 1;
+	}
+	task->cbname.s = p;
+	memcpy(p, rtname->s, rtname->len);
+	task->cbname.len = rtname->len;
+	p += rtname->len + 1;
+	task->request.s = p;
+	memcpy(p, request.s, request.len);
+	task->request.len = request.len;
+	task->ract = act;
+	task->op = op;
+	task->setid = active_rtpp_set->id_set;
+	task->idx = node->idx;
+
+	if(tmb.t_suspend(msg, &task->tindex, &task->tlabel) < 0) {
+		LM_ERR("failed to suspend the processing\n");
+		shm_free(task);
+		goto error;
+	}
+
+	/* the commands of a call are handled in order by the same process */
+	pidx = get_hash1_raw(task->callid.s, task->callid.len)
+		   % rtpengine_async_mode;
+	pfd = _rtpe_async_pipes[2 * pidx + 1];
+	do {
+		ret = write(pfd, &task, sizeof(task));
+	} while(ret == -1 && errno == EINTR);
+	if(ret != sizeof(task)) {
+		LM_ERR("failed to pass the task to the async process (%s:%d)\n",
+				strerror(errno), errno);
+		tmb.t_cancel_suspend(task->tindex, task->tlabel);
+		shm_free(task);
+		goto error;
+	}
+
+	bencode_buffer_free(&bencbuf);
+	/* force exit in config */
+	return 0;
+
+error:
+	bencode_buffer_free(&bencbuf);
+	return -1;
+}
+
+/**
+ * apply the rtpengine reply to the message of the resumed transaction
+ */
+static int rtpengine_async_apply(sip_msg_t *msg, rtpe_async_task_t *task)
+{
+	bencode_buffer_t bencbuf;
+	bencode_item_t *resp;
+	struct rtpp_node *node;
+	str body = STR_NULL;
+	str cl_field = STR_NULL;
+	int ret = -1;
+
+	if(task->reply.s == NULL) {
+		LM_ERR("no reply for command \"%s\" from RTPEngine <%.*s>\n",
+				command_strings[task->op], task->url.len, task->url.s);
+		return -1;
+	}
+	node = rtpengine_async_node(task);
+	if(node == NULL) {
+		return -1;
+	}
+
+	set_rtp_inst_pvar(msg, &node->rn_url);
+
+	if(rtpp_check_reply(node, task->reply.s, task->reply.len) != 0) {
+		return -1;
+	}
+
+	rtpp_hash_table_update(task->callid, task->viabranch, task->op, node);
+
+	if(bencode_raw_dictionary_get_strcmp(
+			   task->reply.s, task->reply.len, "result", "ok")) {
+		LM_ERR("proxy didn't return \"ok\" result\n");
+		return -1;
+	}
+
+	if(task->op == OP_DELETE) {
+		/* the stats are looked up in the decoded reply */
+		if(bencode_buffer_init(&bencbuf)) {
+			LM_ERR("could not initialize bencode_buffer_t\n");
+			return -1;
+		}
+		resp = bencode_decode_expect_str(
+				&bencbuf, &task->reply, BENCODE_DICTIONARY);
+		if(resp) {
+			parse_call_stats(resp, msg);
+			ret = 1;
+		}
+		bencode_buffer_free(&bencbuf);
+		return ret;
+	}
+
+	if(read_sdp_pvar == NULL && extract_body(msg, &body, &cl_field) == -1) {
+		LM_ERR("can't extract body from the message\n");
+		return -1;
+	}
+	return rtpengine_offer_answer_apply(msg, &task->reply, body, cl_field, 0);
+}
+
+/**
+ * pre-script callback executed for the resumed transaction
+ */
+static int rtpengine_async_exec(sip_msg_t *msg, unsigned int flags, void *param)
+{
+	rtpe_async_task_t *task;
+	pv_value_t val;
+
+	if(_rtpe_async_current == NULL)
+		return 1;
+	task = _rtpe_async_current;
+	_rtpe_async_current = NULL;
+
+	memset(&val, 0, sizeof(pv_value_t));
+	val.flags = PV_VAL_INT | PV_TYPE_INT;
+	val.ri = rtpengine_async_apply(msg, task);
+
+	if(async_result_pvar != NULL
+			&& async_result_pvar->setf(
+					   msg, &async_result_pvar->pvp, (int)EQ_T, &val)
+					   < 0) {
+		LM_ERR("failed setting async result pvar\n");
+	}
+
+	return 1;
+}
+
+static void rtpengine_async_resume(rtpe_async_task_t *task)
+{
+	str evname = str_init("rtpengine:async");
+
+	_rtpe_async_current = task;
+	if(task->ract != NULL) {
+		tmb.t_continue(task->tindex, task->tlabel, task->ract);
+	} else {
+		tmb.t_continue_cb(
+				task->tindex, task->tlabel, &task->cbname, &evname);
+	}
+	ksr_msg_env_reset();
+	_rtpe_async_current = NULL;
+
+	if(task->reply.s != NULL)
+		shm_free(task->reply.s);
+	shm_free(task);
+}
+
+static int rtpengine_async_send(rtpe_async_task_t *task)
+{
+	struct iovec v[2];
+	int len;
+
+	if(task->idx >= rtpp_socks_size || rtpp_socks[task->idx] < 0) {
+		LM_ERR("no control socket for RTPEngine <%.*s>\n", task->url.len,
+				task->url.s);
+		return -1;
+	}
+
+	v[0].iov_base = task->cookie;
+	v[0].iov_len = task->cookie_len;
+	v[1].iov_base = task->request.s;
+	v[1].iov_len = task->request.len;
+	do {
+		len = writev(rtpp_socks[task->idx], v, 2);
+	} while(len == -1 && (errno == EINTR || errno == ENOBUFS));
+	if(len <= 0) {
+		LM_ERR("can't send command \"%s\" to RTPEngine <%.*s> (%s:%d)\n",
+				command_strings[task->op], task->url.len, task->url.s,
+				strerror(errno), errno);
+		return -1;
+	}
+	return 0;
+}
+
+static void rtpengine_async_fail_node(rtpe_async_task_t *task)
+{
+	struct rtpp_node *node;
+
+	node = rtpengine_async_node(task);
+	if(node == NULL)
+		return;
+	/* if node is disabled permanent, don't recheck it later */
+	if(node->rn_recheck_ticks != RTPENGINE_MAX_RECHECK_TICKS) {
+		node->rn_disabled = 1;
+		node->rn_recheck_ticks =
+				get_ticks()
+				+ cfg_get(rtpengine, rtpengine_cfg, rtpengine_disable_tout);
+	}
+}
+
+/**
+ * slot of the pending table for the cookie, without the trailing space
+ */
+static unsigned int rtpengine_async_hslot(char *cookie, int len)
+{
+	return get_hash1_raw(cookie, len) & (RTPE_ASYNC_HSIZE - 1);
+}
+
+static void rtpengine_async_pending_add(rtpe_async_task_t *task)
+{
+	unsigned int slot;
+
+	slot = rtpengine_async_hslot(task->cookie, task->cookie_len - 1);
+	task->next = _rtpe_async_htable[slot];
+	_rtpe_async_htable[slot] = task;
+	clist_append(&_rtpe_async_due, task, tnext, tprev);
+}
+
+static void rtpengine_async_pending_rm(rtpe_async_task_t *task)
+{
+	rtpe_async_task_t **tp;
+
+	tp = &_rtpe_async_htable[rtpengine_async_hslot(
+			task->cookie, task->cookie_len - 1)];
+	while(*tp != NULL && *tp != task)
+		tp = &(*tp)->next;
+	if(*tp != NULL)
+		*tp = task->next;
+	clist_rm(task, tnext, tprev);
+	task->next = NULL;
+}
+
+/**
+ * pending command for the reply - matched by the cookie up to the space
+ */
+static rtpe_async_task_t *rtpengine_async_pending_get(
+		char *buf, int len, int sidx)
+{
+	rtpe_async_task_t *task;
+	char *sp;
+
+	sp = memchr(buf, ' ', len);
+	if(sp == NULL)
+		return NULL;
+	for(task = _rtpe_async_htable[rtpengine_async_hslot(buf, sp - buf)];
+			task != NULL; task = task->next) {
+		if(task->idx == sidx && task->cookie_len - 1 == sp - buf
+				&& memcmp(buf, task->cookie, sp - buf) == 0)
+			return task;
+	}
+	return NULL;
+}
+
+/**
+ * main loop of an async process
+ */
+static void rtpengine_async_loop(int rank)
+{
+	static char buf[0x40000];
+	rtpe_async_task_t *task;
+	struct pollfd *pfds = NULL;
+	unsigned int npfds = 0;
+	struct timeval now, tout;
+	int i, n, len, wait_ms;
+	int pfd;
+	char *cp;
+
+	pfd = _rtpe_async_pipes[2 * rank];
+	_rtpe_async_htable = (rtpe_async_task_t **)pkg_mallocxz(
+			RTPE_ASYNC_HSIZE * sizeof(rtpe_async_task_t *));
+	if(_rtpe_async_htable == NULL) {
+		PKG_MEM_ERROR;
+		return;
+	}
+	clist_init(&_rtpe_async_due, tnext, tprev);
+
+	for(;;) {
+		cfg_update();
+		/* refresh control sockets if the list of rtpengines changed */
+		if(build_rtpp_socks(1, 0) < 0)
+			LM_ERR("failed to build the control sockets\n");
+
+		if(npfds != rtpp_socks_size + 1) {
+			npfds = rtpp_socks_size + 1;
+			pfds = (struct pollfd *)pkg_reallocxf(
+					pfds, npfds * sizeof(struct pollfd));
+			if(pfds == NULL) {
+				PKG_MEM_ERROR;
+				return;
+			}
+		}
+		pfds[0].fd = pfd;
+		pfds[0].events = POLLIN;
+		pfds[0].revents = 0;
+		for(i = 1; i < npfds; i++) {
+			pfds[i].fd = rtpp_socks[i - 1];
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+		}
+
+		gettimeofday(&now, NULL);
+		wait_ms = -1;
+		task = _rtpe_async_due.tnext;
+		if(task != &_rtpe_async_due) {
+			wait_ms = 0;
+			if(timercmp(&task->due, &now, >))
+				wait_ms = (int)((task->due.tv_sec - now.tv_sec) * 1000
+								+ (task->due.tv_usec - now.tv_usec) / 1000);
+		}
+
+		n = poll(pfds, npfds, wait_ms);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			LM_ERR("poll failed (%s:%d)\n", strerror(errno), errno);
+			sleep_us(100000);
+			continue;
+		}
+
+		cfg_update();
+		gettimeofday(&now, NULL);
+		tout.tv_sec = cfg_get(rtpengine, rtpengine_cfg, rtpengine_tout_ms)
+					  / 1000;
+		tout.tv_usec =
+				(cfg_get(rtpengine, rtpengine_cfg, rtpengine_tout_ms) % 1000)
+				* 1000;
+
+		/* replies from rtpengines */
+		for(i = 1; n > 0 && i < npfds; i++) {
+			if(!(pfds[i].revents & POLLIN))
+				continue;
+			for(;;) {
+				len = recv(pfds[i].fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+				if(len <= 0)
+					break;
+				task = rtpengine_async_pending_get(buf, len, i - 1);
+				if(task == NULL) {
+					LM_DBG("unexpected reply from RTPEngine - dropped\n");
+					continue;
+				}
+				rtpengine_async_pending_rm(task);
+				cp = buf + task->cookie_len;
+				len -= task->cookie_len;
+				task->reply.s = (char *)shm_malloc(len + 1);
+				if(task->reply.s == NULL) {
+					SHM_MEM_ERROR;
+				} else {
+					memcpy(task->reply.s, cp, len);
+					task->reply.s[len] = '\0';
+					task->reply.len = len;
+				}
+				LM_DBG("proxy reply: %.*s\n", len, cp);
+				rtpengine_async_resume(task);
+			}
+		}
+
+		/* new tasks from sip workers */
+		if(pfds[0].revents & POLLIN) {
+			while(read(pfd, &task, sizeof(task)) == sizeof(task)) {
+				cp = gencookie();
+				task->cookie_len = strlen(cp);
+				memcpy(task->cookie, cp, task->cookie_len);
+				if(rtpengine_async_send(task) < 0) {
+					rtpengine_async_fail_node(task);
+					rtpengine_async_resume(task);
+					continue;
+				}
+				timeradd(&now, &tout, &task->due);
+				rtpengine_async_pending_add(task);
+			}
+		}
+
+		/* retransmissions and timeouts - the head of the list is due first,
+		 * resent commands are moved at the end */
+		while(_rtpe_async_due.tnext != &_rtpe_async_due) {
+			task = _rtpe_async_due.tnext;
+			if(timercmp(&task->due, &now, >))
+				break;
+			task->retr++;
+			if(task->retr < cfg_get(rtpengine, rtpengine_cfg, rtpengine_retr)
+					&& rtpengine_async_send(task) == 0) {
+				clist_rm(task, tnext, tprev);
+				timeradd(&now, &tout, &task->due);
+				clist_append(&_rtpe_async_due, task, tnext, tprev);
+				continue;
+			}
+			LM_ERR("timeout waiting reply for command \"%s\" from RTPEngine "
+				   "<%.*s>\n",
+					command_strings[task->op], task->url.len, task->url.s);
+			rtpengine_async_pending_rm(task);
+			rtpengine_async_fail_node(task);
+			rtpengine_async_resume(task);
+		}
+	}
+}
+
+static int ki_rtpengine_offer_async(
+		sip_msg_t *msg, str *flags, str *rtname)
+{
+	return rtpengine_async_call(msg, OP_OFFER, flags, NULL, rtname);
+}
+
+static int ki_rtpengine_answer_async(
+		sip_msg_t *msg, str *flags, str *rtname)
+{
+	return rtpengine_async_call(msg, OP_ANSWER, flags, NULL, rtname);
+}
+
+static int ki_rtpengine_manage_async(
+		sip_msg_t *msg, str *flags, str *rtname)
+{
+	return rtpengine_async_call(msg, OP_ANY, flags, NULL, rtname);
+}
+
+static int w_rtpengine_async(sip_msg_t *msg, char *pflags, char *prt,
+		enum rtpe_operation op)
+{
+	str flags = STR_NULL;
+	str rtname = STR_NULL;
+
+	if(fixup_get_svalue(msg, (gparam_t *)pflags, &flags) != 0) {
+		LM_ERR("cannot get flags parameter\n");
+		return -1;
+	}
+	if(fixup_get_svalue(msg, (gparam_t *)prt, &rtname) != 0
+			|| rtname.len <= 0) {
+		LM_ERR("cannot get route block name\n");
+		return -1;
+	}
+	return rtpengine_async_call(
+			msg, op, (flags.len > 0) ? &flags : NULL, NULL, &rtname);
+}
+
+static int w_rtpengine_offer_async(sip_msg_t *msg, char *pflags, char *prt)
+{
+	return w_rtpengine_async(msg, pflags, prt, OP_OFFER);
+}
+
+static int w_rtpengine_answer_async(sip_msg_t *msg, char *pflags, char *prt)
+{
+	return w_rtpengine_async(msg, pflags, prt, OP_ANSWER);
+}
+
+static int w_rtpengine_manage_async(sip_msg_t *msg, char *pflags, char *prt)
+{
+	return w_rtpengine_async(msg, pflags, prt, OP_ANY);
+}
+
 /**
  *
  */
@@ -6603,6 +7502,12 @@ static sr_kemi_t sr_kemi_rtpengine_exports[] = {
             SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
     },
 
+    { str_init("rtpengine"), str_init("rtpengine_manage_async"),
+        SR_KEMIP_INT, ki_rtpengine_manage_async,
+        { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
+
     { str_init("rtpengine"), str_init("rtpengine_offer0"),
         SR_KEMIP_INT, ki_rtpengine_offer0,
         { SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE,
@@ -6618,6 +7523,11 @@ static sr_kemi_t sr_kemi_rtpengine_exports[] = {
         { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
             SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
     },
+    { str_init("rtpengine"), str_init("rtpengine_offer_async"),
+        SR_KEMIP_INT, ki_rtpengine_offer_async,
+        { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
 
     { str_init("rtpengine"), str_init("rtpengine_answer0"),
         SR_KEMIP_INT, ki_rtpengine_answer0,
@@ -6634,6 +7544,11 @@ static sr_kemi_t sr_kemi_rtpengine_exports[] = {
         { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
             SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
     },
+    { str_init("rtpengine"), str_init("rtpengine_answer_async"),
+        SR_KEMIP_INT, ki_rtpengine_answer_async,
+        { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
 
     { str_init("rtpengine"), str_init("rtpengine_delete0"),
         SR_KEMIP_INT, ki_rtpengine_delete0,
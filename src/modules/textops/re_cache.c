@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief Per process cache of the regular expressions given at runtime
+ * \ingroup textops
+ * Module: \ref textops
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/counters.h"
+#include "../../core/utils/lrucache.h"
+
+#include "re_cache.h"
+
+/* flags value of the subst expressions, their flags being in the string */
+#define TXT_RE_SUBST (-1)
+
+/* the smallest cache size, functions may hold two expressions at once */
+#define TXT_RE_CACHE_MIN 4
+
+/* compiled object kept in the data of the cache items */
+typedef union txt_re_data
+{
+	regex_t re;				/* compiled re, if not a subst expression */
+	struct subst_expr *se; /* parsed subst expression */
+} txt_re_data_t;
+
+int txt_re_cache_size = 128;
+
+static ksr_lru_cache_t _txt_re_cache;
+
+static counter_handle_t txt_re_hits;
+static counter_handle_t txt_re_misses;
+static counter_handle_t txt_re_evictions;
+
+/* clang-format off */
+static counter_def_t txt_re_cnt_defs[] = {
+	{&txt_re_hits, "re_cache_hits", 0, 0, 0,
+		"dynamic regular expressions found compiled in the cache"},
+	{&txt_re_misses, "re_cache_misses", 0, 0, 0,
+		"dynamic regular expressions compiled"},
+	{&txt_re_evictions, "re_cache_evictions", 0, 0, 0,
+		"compiled regular expressions dropped from a full cache"},
+	{0, 0, 0, 0, 0, 0}
+};
+/* clang-format on */
+
+static int txt_re_compile(ksr_lru_item_t *it, void *param)
+{
+	txt_re_data_t *d = (txt_re_data_t *)it->data;
+
+	/* the subst expression keeps references to its string (variable
+	 * names), hence it is parsed from the copy owned by the item */
+	if(it->flags == TXT_RE_SUBST) {
+		d->se = subst_parser(&it->key);
+		return (d->se != NULL) ? 0 : -1;
+	}
+	return (regcomp(&d->re, it->key.s, it->flags) == 0) ? 0 : -1;
+}
+
+static void txt_re_free(ksr_lru_item_t *it, void *param)
+{
+	txt_re_data_t *d = (txt_re_data_t *)it->data;
+
+	if(it->flags == TXT_RE_SUBST) {
+		subst_expr_free(d->se);
+	} else {
+		regfree(&d->re);
+	}
+}
+
+/**
+ * register the cache counters, to be called from mod_init
+ */
+int txt_re_cache_init(void)
+{
+	if(txt_re_cache_size < TXT_RE_CACHE_MIN) {
+		LM_WARN("re_cache_size too small, set to %d\n", TXT_RE_CACHE_MIN);
+		txt_re_cache_size = TXT_RE_CACHE_MIN;
+	}
+	if(counter_register_array("textops", txt_re_cnt_defs) < 0) {
+		LM_ERR("failed to register counters\n");
+		return -1;
+	}
+	ksr_lru_cache_init(&_txt_re_cache, (unsigned int)txt_re_cache_size,
+			sizeof(txt_re_data_t), txt_re_compile, txt_re_free, NULL);
+	_txt_re_cache.hits = &txt_re_hits;
+	_txt_re_cache.misses = &txt_re_misses;
+	_txt_re_cache.evictions = &txt_re_evictions;
+	return 0;
+}
+
+/**
+ *
+ */
+regex_t *txt_re_get(str *pattern, int cflags)
+{
+	ksr_lru_item_t *it;
+
+	it = ksr_lru_cache_get(&_txt_re_cache, pattern, cflags);
+	return (it != NULL) ? &((txt_re_data_t *)it->data)->re : NULL;
+}
+
+/**
+ *
+ */
+struct subst_expr *txt_subst_get(str *subst)
+{
+	ksr_lru_item_t *it;
+
+	it = ksr_lru_cache_get(&_txt_re_cache, subst, TXT_RE_SUBST);
+	return (it != NULL) ? ((txt_re_data_t *)it->data)->se : NULL;
+}
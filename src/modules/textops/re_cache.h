@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief Per process cache of the regular expressions given at runtime
+ * \ingroup textops
+ * Module: \ref textops
+ *
+ * The functions taking the regular expression or the subst expression
+ * from a variable or from KEMI compile it for each call. The compiled
+ * expressions are kept in a bounded cache in private memory instead,
+ * the least recently used one being dropped when it is full.
+ */
+
+#ifndef _TEXTOPS_RE_CACHE_H_
+#define _TEXTOPS_RE_CACHE_H_
+
+#include <sys/types.h>
+#include <regex.h>
+
+#include "../../core/str.h"
+#include "../../core/re.h"
+
+extern int txt_re_cache_size;
+
+int txt_re_cache_init(void);
+
+/*!
+ * \brief Get the compiled regular expression for a pattern
+ *
+ * The result is owned by the cache, it must not be freed and stays
+ * valid until at least txt_re_cache_size other expressions are taken.
+ * \param pattern regular expression
+ * \param cflags regcomp() flags
+ * \return compiled regular expression, NULL on error
+ */
+regex_t *txt_re_get(str *pattern, int cflags);
+
+/*!
+ * \brief Get the parsed subst expression (s/re/repl/flags)
+ *
+ * Same ownership rules as for txt_re_get().
+ * \param subst subst expression
+ * \return parsed subst expression, NULL on error
+ */
+struct subst_expr *txt_subst_get(str *subst);
+
+#endif
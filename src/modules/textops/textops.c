@@ -70,6 +70,7 @@
 #include "textops.h"
 #include "txt_var.h"
 #include "api.h"
+#include "re_cache.h"
 
 MODULE_VERSION
 
@@ -348,12 +349,17 @@ static cmd_export_t cmds[] = {
 	{0, 0, 0, 0, 0, 0}
 };
 
+static param_export_t params[] = {
+	{"re_cache_size", PARAM_INT, &txt_re_cache_size},
+	{0, 0, 0}
+};
+
 
 struct module_exports exports = {
 	"textops",       /* module name*/
 	DEFAULT_DLFLAGS, /* dlopen flags */
 	cmds,            /* exported functions */
-	0,               /* exported parameters */
+	params,          /* exported parameters */
 	0,               /* exported rpc functions */
 	0,               /* exported pseudo-variables */
 	0,               /* response handling function */
@@ -365,6 +371,9 @@ struct module_exports exports = {
 
 static int mod_init(void)
 {
+	if(txt_re_cache_init() < 0) {
+		return -1;
+	}
 	return 0;
 }
 
@@ -460,16 +469,15 @@ int search_append_f(struct sip_msg *msg, char *key, char *str2)
 
 static int ki_search_append(sip_msg_t *msg, str *ematch, str *val)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, ematch->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(ematch, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", ematch->len, ematch->s);
 		return -1;
 	}
-	ret = search_append_helper(msg, &mre, val);
-	regfree(&mre);
+	ret = search_append_helper(msg, mre, val);
 
 	return ret;
 }
@@ -527,16 +535,15 @@ static int search_append_body_f(struct sip_msg *msg, char *key, char *str2)
 
 static int ki_search_append_body(sip_msg_t *msg, str *ematch, str *val)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, ematch->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(ematch, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", ematch->len, ematch->s);
 		return -1;
 	}
-	ret = search_append_body_helper(msg, &mre, val);
-	regfree(&mre);
+	ret = search_append_body_helper(msg, mre, val);
 
 	return ret;
 }
@@ -607,18 +614,16 @@ static int replace_all_f(struct sip_msg *msg, char *key, char *str2)
 
 static int ki_replace_all(sip_msg_t *msg, str *sre, str *sval)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
 
-	ret = replace_all_helper(msg, &mre, sval);
-
-	regfree(&mre);
+	ret = replace_all_helper(msg, mre, sval);
 
 	return ret;
 }
@@ -702,18 +707,16 @@ static int replace_body_all_f(struct sip_msg *msg, char *key, char *str2)
 
 static int ki_replace_body_all(sip_msg_t *msg, str *sre, str *sval)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
 
-	ret = replace_body_all_helper(msg, &mre, sval, 1);
-
-	regfree(&mre);
+	ret = replace_body_all_helper(msg, mre, sval, 1);
 
 	return ret;
 }
@@ -730,18 +733,16 @@ static int replace_body_atonce_f(struct sip_msg *msg, char *key, char *str2)
 
 static int ki_replace_body_atonce(sip_msg_t *msg, str *sre, str *sval)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
 
-	ret = replace_body_all_helper(msg, &mre, sval, 0);
-
-	regfree(&mre);
+	ret = replace_body_all_helper(msg, mre, sval, 0);
 
 	return ret;
 }
@@ -796,7 +797,7 @@ static int replace_helper(sip_msg_t *msg, regex_t *re, str *val)
 static int ki_regex_substring(sip_msg_t *msg, str *input, str *regex,
 		int mindex, int nmatch, str *dst)
 {
-	regex_t preg;
+	regex_t *preg;
 	regmatch_t *pmatch;
 	pv_spec_t *pvresult = NULL;
 	pv_value_t valx;
@@ -827,7 +828,6 @@ static int ki_regex_substring(sip_msg_t *msg, str *input, str *regex,
 	}
 
 	memset(&valx, 0, sizeof(pv_value_t));
-	memset(&preg, 0, sizeof(regex_t));
 
 	pmatch = pkg_malloc(nmatch * sizeof(regmatch_t));
 
@@ -839,17 +839,15 @@ static int ki_regex_substring(sip_msg_t *msg, str *input, str *regex,
 		return -1;
 	}
 
-	rc = regcomp(&preg, regex->s, REG_EXTENDED);
-
-	if(0 != rc) {
-		LM_ERR("regular expression coudnt be compiled, Error code: (%d)\n", rc);
+	preg = txt_re_get(regex, REG_EXTENDED);
+	if(preg == NULL) {
+		LM_ERR("regular expression coudnt be compiled: %.*s\n", regex->len,
+				regex->s);
 		pkg_free(pmatch);
-		regfree(&preg);
 		return -1;
 	}
 
-	rc = regexec(&preg, input->s, nmatch, pmatch, REG_EXTENDED);
-	regfree(&preg);
+	rc = regexec(preg, input->s, nmatch, pmatch, REG_EXTENDED);
 	if(rc != 0) {
 		LM_DBG("no matches\n");
 		pkg_free(pmatch);
@@ -957,18 +955,16 @@ static int replace_f(sip_msg_t *msg, char *key, char *str2)
 
 static int ki_replace(sip_msg_t *msg, str *sre, str *sval)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
 
-	ret = replace_helper(msg, &mre, sval);
-
-	regfree(&mre);
+	ret = replace_helper(msg, mre, sval);
 
 	return ret;
 }
@@ -1141,18 +1137,16 @@ static int replace_body_f(struct sip_msg *msg, char *key, char *str2)
 
 static int ki_replace_body(sip_msg_t *msg, str *sre, str *sval)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
 
-	ret = replace_body_helper(msg, &mre, sval);
-
-	regfree(&mre);
+	ret = replace_body_helper(msg, mre, sval);
 
 	return ret;
 }
@@ -1265,18 +1259,16 @@ static int replace_hdrs_f(struct sip_msg *msg, char *key, char *str2)
 
 static int ki_replace_hdrs(sip_msg_t *msg, str *sre, str *sval)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
 
-	ret = replace_hdrs_helper(msg, &mre, sval);
-
-	regfree(&mre);
+	ret = replace_hdrs_helper(msg, mre, sval);
 
 	return ret;
 }
@@ -1557,7 +1549,7 @@ static int subst_v_helper_f(
 		LM_ERR("the variable is read only\n");
 		return -1;
 	}
-	se = subst_parser(subex);
+	se = txt_subst_get(subex);
 	if(se == 0) {
 		LM_ERR("bad subst re: %.*s\n", subex->len, subex->s);
 		return -1;
@@ -1568,7 +1560,6 @@ static int subst_v_helper_f(
 		if(nmatches < 0) {
 			LM_ERR("substitution failed\n");
 		}
-		subst_expr_free(se);
 		return -1;
 	}
 	memset(&val, 0, sizeof(pv_value_t));
@@ -1579,7 +1570,6 @@ static int subst_v_helper_f(
 
 	pkg_free(result->s);
 	pkg_free(result);
-	subst_expr_free(se);
 	return 1;
 }
 
@@ -1976,18 +1966,16 @@ static int remove_hf_re_f(struct sip_msg *msg, char *key, char *foo)
 
 static int ki_remove_hf_re(sip_msg_t *msg, str *ematch)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, ematch->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(ematch, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", ematch->len, ematch->s);
 		return -1;
 	}
 
-	ret = remove_hf_re(msg, &mre);
-
-	regfree(&mre);
+	ret = remove_hf_re(msg, mre);
 
 	return ret;
 }
@@ -2037,26 +2025,22 @@ static int remove_hf_exp_f(struct sip_msg *msg, char *ematch, char *eskip)
 
 static int ki_remove_hf_exp(sip_msg_t *msg, str *ematch, str *eskip)
 {
-	regex_t mre;
-	regex_t sre;
+	regex_t *mre;
+	regex_t *sre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	memset(&sre, 0, sizeof(regex_t));
-	if(regcomp(&mre, ematch->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(ematch, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", ematch->len, ematch->s);
 		return -1;
 	}
-	if(regcomp(&sre, eskip->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	sre = txt_re_get(eskip, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(sre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", eskip->len, eskip->s);
-		regfree(&mre);
 		return -1;
 	}
 
-	ret = remove_hf_exp(msg, &mre, &sre);
-
-	regfree(&mre);
-	regfree(&sre);
+	ret = remove_hf_exp(msg, mre, sre);
 
 	return ret;
 }
@@ -2190,16 +2174,15 @@ static int is_present_hf_pv_f(sip_msg_t *msg, char *key, char *foo)
 
 static int ki_is_present_hf_re(sip_msg_t *msg, str *ematch)
 {
-	regex_t mre;
+	regex_t *mre;
 	int ret;
 
-	memset(&mre, 0, sizeof(regex_t));
-	if(regcomp(&mre, ematch->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	mre = txt_re_get(ematch, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(mre == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", ematch->len, ematch->s);
 		return -1;
 	}
-	ret = is_present_hf_re_helper(msg, &mre);
-	regfree(&mre);
+	ret = is_present_hf_re_helper(msg, mre);
 
 	return ret;
 }
@@ -2265,13 +2248,11 @@ static int ki_remove_hf_match(sip_msg_t *msg, str *hname, str *op, str *expr)
 	sr_lump_t *anchor = NULL;
 	int vop = 0;
 	int vrm = 0;
-	regex_t mre;
+	regex_t *mre = NULL;
 	regmatch_t pmatch;
 	char c;
 	int ret = -2;
 
-	memset(&mre, 0, sizeof(regex_t));
-
 	/* ensure all headers are parsed */
 	if(parse_headers(msg, HDR_EOH_F, 0) < 0) {
 		LM_ERR("error parsing headers\n");
@@ -2294,9 +2275,8 @@ static int ki_remove_hf_match(sip_msg_t *msg, str *hname, str *op, str *expr)
 	} else if(op->len == 2 && strncasecmp(op->s, "in", op->len) == 0) {
 		vop = 3;
 	} else if(op->len == 2 && strncasecmp(op->s, "re", op->len) == 0) {
-		memset(&mre, 0, sizeof(regex_t));
-		if(regcomp(&mre, expr->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE)
-				!= 0) {
+		mre = txt_re_get(expr, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+		if(mre == NULL) {
 			LM_ERR("failed to compile regex: [%.*s]\n", expr->len, expr->s);
 			return -1;
 		}
@@ -2340,7 +2320,7 @@ static int ki_remove_hf_match(sip_msg_t *msg, str *hname, str *op, str *expr)
 				break;
 			case 4:
 				STR_VTOZ(hfi->body.s[hfi->body.len], c);
-				if(regexec(&mre, hfi->body.s, 1, &pmatch, 0) == 0) {
+				if(regexec(mre, hfi->body.s, 1, &pmatch, 0) == 0) {
 					vrm = 1;
 				}
 				STR_ZTOV(hfi->body.s[hfi->body.len], c);
@@ -2358,9 +2338,6 @@ static int ki_remove_hf_match(sip_msg_t *msg, str *hname, str *op, str *expr)
 	}
 
 done:
-	if(vop == 4) {
-		regfree(&mre);
-	}
 	return ret;
 }
 
@@ -5136,7 +5113,7 @@ static int w_via_param_rm(sip_msg_t *msg, char *pname, char *pidx)
 static int ki_search_str(sip_msg_t *msg, str *stext, str *sre)
 {
 	int ret;
-	regex_t re;
+	regex_t *re;
 	regmatch_t pmatch;
 
 
@@ -5148,20 +5125,18 @@ static int ki_search_str(sip_msg_t *msg, str *stext, str *sre)
 		return -2;
 	}
 
-	memset(&re, 0, sizeof(regex_t));
-	if(regcomp(&re, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	re = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(re == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -2;
 	}
 
-	if(regexec(&re, stext->s, 1, &pmatch, 0) != 0) {
+	if(regexec(re, stext->s, 1, &pmatch, 0) != 0) {
 		ret = -1;
 	} else {
 		ret = 1;
 	}
 
-	regfree(&re);
-
 	return ret;
 }
 
@@ -5190,19 +5165,18 @@ static int w_search_str(sip_msg_t *msg, char *ptext, char *pre)
  */
 static int ki_search(sip_msg_t *msg, str *sre)
 {
-	regex_t re;
+	regex_t *re;
 	int ret;
 
 	if(sre == NULL || sre->len <= 0)
 		return 1;
 
-	memset(&re, 0, sizeof(regex_t));
-	if(regcomp(&re, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	re = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(re == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
-	ret = search_helper_f(msg, &re);
-	regfree(&re);
+	ret = search_helper_f(msg, re);
 	return ret;
 }
 
@@ -5211,19 +5185,18 @@ static int ki_search(sip_msg_t *msg, str *sre)
  */
 static int ki_search_body(sip_msg_t *msg, str *sre)
 {
-	regex_t re;
+	regex_t *re;
 	int ret;
 
 	if(sre == NULL || sre->len <= 0)
 		return 1;
 
-	memset(&re, 0, sizeof(regex_t));
-	if(regcomp(&re, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	re = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(re == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
-	ret = search_body_helper_f(msg, &re);
-	regfree(&re);
+	ret = search_body_helper_f(msg, re);
 	return ret;
 }
 
@@ -5233,7 +5206,7 @@ static int ki_search_body(sip_msg_t *msg, str *sre)
  */
 static int ki_search_hf(sip_msg_t *msg, str *hname, str *sre, str *flags)
 {
-	regex_t re;
+	regex_t *re;
 	gparam_t ghp;
 	int ret;
 
@@ -5246,13 +5219,12 @@ static int ki_search_hf(sip_msg_t *msg, str *hname, str *sre, str *flags)
 	if(ki_hname_gparam(hname, &ghp) < 0)
 		return -1;
 
-	memset(&re, 0, sizeof(regex_t));
-	if(regcomp(&re, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE) != 0) {
+	re = txt_re_get(sre, REG_EXTENDED | REG_ICASE | REG_NEWLINE);
+	if(re == NULL) {
 		LM_ERR("failed to compile regex: %.*s\n", sre->len, sre->s);
 		return -1;
 	}
-	ret = search_hf_helper_f(msg, &ghp, &re, (flags) ? flags->s : NULL);
-	regfree(&re);
+	ret = search_hf_helper_f(msg, &ghp, re, (flags) ? flags->s : NULL);
 	return ret;
 }
 
@@ -5264,13 +5236,12 @@ static int ki_subst(sip_msg_t *msg, str *subst)
 	if(subst == NULL || subst->len <= 0)
 		return -1;
 
-	se = subst_parser(subst);
+	se = txt_subst_get(subst);
 	if(se == 0) {
 		LM_ERR("cannot compile subst expression\n");
 		return -1;
 	}
 	ret = subst_helper_f(msg, se);
-	subst_expr_free(se);
 
 	return ret;
 }
@@ -5283,13 +5254,12 @@ static int ki_subst_uri(sip_msg_t *msg, str *subst)
 	if(subst == NULL || subst->len <= 0)
 		return -1;
 
-	se = subst_parser(subst);
+	se = txt_subst_get(subst);
 	if(se == 0) {
 		LM_ERR("cannot compile subst expression\n");
 		return -1;
 	}
 	ret = subst_uri_helper_f(msg, se);
-	subst_expr_free(se);
 
 	return ret;
 }
@@ -5302,13 +5272,12 @@ static int ki_subst_user(sip_msg_t *msg, str *subst)
 	if(subst == NULL || subst->len <= 0)
 		return -1;
 
-	se = subst_parser(subst);
+	se = txt_subst_get(subst);
 	if(se == 0) {
 		LM_ERR("cannot compile subst expression\n");
 		return -1;
 	}
 	ret = subst_user_helper_f(msg, se);
-	subst_expr_free(se);
 
 	return ret;
 }
@@ -5321,13 +5290,12 @@ static int ki_subst_body(sip_msg_t *msg, str *subst)
 	if(subst == NULL || subst->len <= 0)
 		return -1;
 
-	se = subst_parser(subst);
+	se = txt_subst_get(subst);
 	if(se == 0) {
 		LM_ERR("cannot compile subst expression\n");
 		return -1;
 	}
 	ret = subst_body_helper_f(msg, se);
-	subst_expr_free(se);
 
 	return ret;
 }
@@ -5350,14 +5318,13 @@ static int ki_subst_hf(sip_msg_t *msg, str *hname, str *subst, str *flags)
 	if(ki_hname_gparam(hname, &ghp) < 0)
 		return -1;
 
-	se = subst_parser(subst);
+	se = txt_subst_get(subst);
 	if(se == 0) {
 		LM_ERR("cannot compile subst expression\n");
 		return -1;
 	}
 
 	ret = subst_hf_helper_f(msg, &ghp, se, (flags) ? flags->s : NULL);
-	subst_expr_free(se);
 
 	return ret;
 }
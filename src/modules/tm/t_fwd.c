@@ -59,6 +59,7 @@
 #endif
 #include "../../core/atomic_ops.h" /* membar_depends() */
 #include "../../core/kemi.h"
+#include "../../core/overload_ctl.h"
 
 
 extern int tm_failure_exec_mode;
@@ -1562,6 +1563,16 @@ int t_send_branch(struct cell *t, int branch, struct sip_msg *p_msg,
 		}
 	}
 #endif /* USE_DST_BLOCKLIST */
+	/* local transactions (e.g., BYE from dialog) are not dropped */
+	if(unlikely(ksr_ovl_mode != 0) && !is_local(t)
+			&& ksr_ovl_dst_reject(&uac->request.dst, p_msg)) {
+		su2ip_addr(&ip, &uac->request.dst.to);
+		LM_DBG("overloaded destination: %s:%d (%d)\n", ip_addr2a(&ip),
+				su_getport(&uac->request.dst.to), uac->request.dst.proto);
+		/* disable the current branch like for blocklisted destinations */
+		uac->last_received = 503;
+		return -1; /* don't send */
+	}
 	if(SEND_BUFFER(&uac->request) == -1) {
 		/* disable the current branch: set a "fake" timeout
 		 *  reply code but don't set uac->reply, to avoid overriding
@@ -88,6 +88,7 @@
 #include "select.h"
 #include "t_serial.h"
 #include "rpc_uac.h"
+#include "../../core/overload_ctl.h"
 
 MODULE_VERSION
 
@@ -234,6 +235,9 @@ str _tm_reply_408_reason = str_init("Request Timeout");
 int _tm_delayed_reply = 1;
 int _tm_evlreq_mode = 0;
 
+/* number of active transactions at 100% load for core overload control */
+static int tm_ovl_max_transactions = 0;
+
 #ifdef USE_DNS_FAILOVER
 str failover_reply_codes_str = {NULL, 0};
 int **failover_reply_codes = NULL;
@@ -538,6 +542,7 @@ static param_export_t params[] = {
 	{"reply_408_reason", PARAM_STR, &_tm_reply_408_reason},
 	{"delayed_reply", PARAM_INT, &_tm_delayed_reply},
 	{"evlreq_mode", PARAM_INT, &_tm_evlreq_mode},
+	{"ovl_max_transactions", PARAM_INT, &tm_ovl_max_transactions},
 	{0, 0, 0}
 };
 
@@ -559,6 +564,22 @@ struct module_exports exports = {
 };
 /* clang-format on */
 
+/**
+ * load source for core overload control - active transactions
+ */
+static int tm_ovl_load(void)
+{
+	struct t_proc_stats all;
+	long current;
+
+	if(tm_get_stats(&all) < 0)
+		return 0;
+	current = (long)all.transactions - (long)all.deleted;
+	if(current <= 0)
+		return 0;
+	return (int)(current * 100 / tm_ovl_max_transactions);
+}
+
 /* helper for fixup_on_* */
 static int fixup_routes(char *r_type, struct route_list *rt, void **param)
 {
@@ -924,6 +945,13 @@ static int mod_init(void)
 	if(goto_on_sl_reply && onreply_rt.rlist[goto_on_sl_reply] == 0)
 		LM_WARN("empty/non existing on_sl_reply route\n");
 
+	if(tm_ovl_max_transactions > 0) {
+		if(ksr_ovl_register_load("tm", tm_ovl_load) < 0) {
+			LM_ERR("failed to register overload control load source\n");
+			return -1;
+		}
+	}
+
 #ifdef WITH_TM_CTX
 	tm_ctx_init();
 #endif
@@ -39,6 +39,7 @@
 #include "../../core/counters.h"
 #include "../../core/ut.h"
 #include "../../core/pt.h"
+#include "../../core/kemi_prof.h"
 
 #include "prom.h"
 #include "prom_metric.h"
@@ -169,6 +170,84 @@ int get_timestamp(uint64_t *ts)
 	return 0;
 }
 
+/**
+ * @brief Generate the _bucket, _sum and _count series of a histogram.
+ *
+ * @return 0 on success.
+ */
+static int metric_hist_generate(prom_ctx_t *ctx, str *group, str *name,
+		counter_hist_val_t *hval, uint64_t ts)
+{
+	int i;
+
+	/* without it the series are taken as untyped */
+	if(prom_body_printf(ctx, "# TYPE ") == -1
+			|| prom_body_name_printf(ctx, "%.*s%.*s_%.*s",
+					   xhttp_prom_beginning.len, xhttp_prom_beginning.s,
+					   group->len, group->s, name->len, name->s)
+					   == -1
+			|| prom_body_printf(ctx, " histogram\n") == -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+
+	for(i = 0; i <= hval->nbounds; i++) {
+		if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s_bucket",
+				   xhttp_prom_beginning.len, xhttp_prom_beginning.s,
+				   group->len, group->s, name->len, name->s)
+				== -1) {
+			LM_ERR("Fail to print\n");
+			return -1;
+		}
+		if(i < hval->nbounds) {
+			if(prom_body_printf(ctx, "{le=\"%ld\"%s} %lu %" PRIu64 "\n",
+					   (long)hval->bounds[i], xhttp_prom_tags_comma,
+					   (unsigned long)hval->buckets[i], ts)
+					== -1) {
+				LM_ERR("Fail to print\n");
+				return -1;
+			}
+		} else {
+			if(prom_body_printf(ctx, "{le=\"+Inf\"%s} %lu %" PRIu64 "\n",
+					   xhttp_prom_tags_comma, (unsigned long)hval->buckets[i],
+					   ts)
+					== -1) {
+				LM_ERR("Fail to print\n");
+				return -1;
+			}
+		}
+	}
+
+	if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s_sum%s",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, group->len,
+			   group->s, name->len, name->s, xhttp_prom_tags_braces)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+	if(prom_body_printf(ctx, " %lu %" PRIu64 "\n", (unsigned long)hval->sum, ts)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+
+	if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s_count%s",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, group->len,
+			   group->s, name->len, name->s, xhttp_prom_tags_braces)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+	if(prom_body_printf(
+			   ctx, " %lu %" PRIu64 "\n", (unsigned long)hval->count, ts)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 /**
  * @brief Generate a string suitable for a Prometheus metric.
  *
@@ -177,6 +256,7 @@ int get_timestamp(uint64_t *ts)
 static int metric_generate(
 		prom_ctx_t *ctx, str *group, str *name, counter_handle_t *h)
 {
+	counter_hist_val_t hval;
 	long counter_val = counter_get_val(*h);
 
 	/* Calculate timestamp. */
@@ -190,6 +270,10 @@ static int metric_generate(
 			group->len, group->s, name->len, name->s, counter_val,
 			(uint64_t)ts);
 
+	if(counter_hist_get_val(*h, &hval) == 0) {
+		return metric_hist_generate(ctx, group, name, &hval, ts);
+	}
+
 	/* Print metric name. */
 	if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s%s", xhttp_prom_beginning.len,
 			   xhttp_prom_beginning.s, group->len, group->s, name->len, name->s,
@@ -312,6 +396,104 @@ error:
 	return -1;
 }
 
+/**
+ * @brief Print the histogram of a KEMI function execution time.
+ *
+ * @return 0 on success.
+ */
+static int prom_metric_kemi_item_print(sr_kemi_prof_stats_t *st, void *p)
+{
+	prom_ctx_t *ctx = (prom_ctx_t *)p;
+	str *mname;
+	str *fname;
+	unsigned long cnt = 0;
+	unsigned long total = 0;
+	uint64_t ts;
+	int i;
+
+	if(st->calls == 0) {
+		return 0;
+	}
+	if(get_timestamp(&ts)) {
+		LM_ERR("Fail to get timestamp\n");
+		return -1;
+	}
+	mname = &st->ket->mname;
+	fname = &st->ket->fname;
+
+	/* +Inf and _count are the sum of the buckets, the number of calls
+	 * being read apart from them while they are updated */
+	for(i = 0; i < SR_KEMI_PROF_BUCKETS; i++) {
+		total += st->buckets[i];
+	}
+
+	for(i = 0; i < SR_KEMI_PROF_BUCKETS; i++) {
+		/* buckets are cumulative in Prometheus */
+		cnt += st->buckets[i];
+		if(sr_kemi_prof_bounds[i] == 0) {
+			break;
+		}
+		if(prom_body_printf(ctx,
+				   "%.*skemi_exec_seconds_bucket{module=\"%.*s\", "
+				   "function=\"%.*s\", le=\"%f\"%s} %lu %" PRIu64 "\n",
+				   xhttp_prom_beginning.len, xhttp_prom_beginning.s,
+				   mname->len, mname->s, fname->len, fname->s,
+				   (double)sr_kemi_prof_bounds[i] / 1000000.0,
+				   xhttp_prom_tags_comma, cnt, ts)
+				== -1) {
+			LM_ERR("Fail to print\n");
+			return -1;
+		}
+	}
+	if(prom_body_printf(ctx,
+			   "%.*skemi_exec_seconds_bucket{module=\"%.*s\", "
+			   "function=\"%.*s\", le=\"+Inf\"%s} %lu %" PRIu64 "\n",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, mname->len,
+			   mname->s, fname->len, fname->s, xhttp_prom_tags_comma,
+			   total, ts)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+	if(prom_body_printf(ctx,
+			   "%.*skemi_exec_seconds_sum{module=\"%.*s\", "
+			   "function=\"%.*s\"%s} %f %" PRIu64 "\n",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, mname->len,
+			   mname->s, fname->len, fname->s, xhttp_prom_tags_comma,
+			   (double)st->time_ns / 1000000000.0, ts)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+	if(prom_body_printf(ctx,
+			   "%.*skemi_exec_seconds_count{module=\"%.*s\", "
+			   "function=\"%.*s\"%s} %lu %" PRIu64 "\n",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, mname->len,
+			   mname->s, fname->len, fname->s, xhttp_prom_tags_comma,
+			   total, ts)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Generate Prometheus metrics from the KEMI functions profiler.
+ *
+ * @return 0 on success.
+ */
+static int prom_metric_kemi_print(prom_ctx_t *ctx)
+{
+	if(prom_body_printf(ctx, "# TYPE %.*skemi_exec_seconds histogram\n",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+	return sr_kemi_prof_iterate(prom_metric_kemi_item_print, ctx);
+}
+
 /**
  * @brief Statistic getter callback.
  */
@@ -364,6 +546,13 @@ int prom_stats_get(prom_ctx_t *ctx, str *stat)
 		}
 	}
 
+	if(kemi_stats_enabled) {
+		if(prom_metric_kemi_print(ctx)) {
+			LM_ERR("Fail to print kemi metrics\n");
+			return -1;
+		}
+	}
+
 	LM_DBG("Statistics for: %.*s\n", stat->len, stat->s);
 
 	int len = stat->len;
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/**
+ * @file
+ * @brief xHTTP_PROM :: Cache of rendered metrics.
+ * @ingroup xhttp_prom
+ * - Module: @ref xhttp_prom
+ *
+ * The metrics are rendered periodically by a timer process in one of two
+ * shared memory buffers, which is published when complete. The HTTP
+ * workers only copy the last published buffer in the reply, so a scrape
+ * does not depend anymore on the number of statistics and metrics.
+ * A buffer is not rendered again while it is still referenced by a worker.
+ */
+
+#include <string.h>
+
+#ifdef XHTTP_PROM_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../../core/mem/shm_mem.h"
+#include "../../core/locking.h"
+#include "../../core/dprint.h"
+
+#include "prom.h"
+#include "prom_cache.h"
+
+/**
+ * @brief one rendering of the metrics.
+ */
+typedef struct prom_cache_buf
+{
+	char *buf;	 /**< Rendered metrics. */
+	int len;	 /**< Length of rendered metrics. */
+	char *gzbuf; /**< Gzip compressed metrics. */
+	int gzlen;	 /**< Length of compressed metrics (0 - not available). */
+	int refs;	 /**< Number of workers sending this buffer. */
+} prom_cache_buf_t;
+
+/**
+ * @brief double buffered cache.
+ */
+typedef struct prom_cache
+{
+	gen_lock_t lock;
+	int active; /**< Index of published buffer, -1 if none yet. */
+	int size;	/**< Size of each buffer. */
+	prom_cache_buf_t b[2];
+} prom_cache_t;
+
+static prom_cache_t *_prom_cache = NULL;
+
+int prom_cache_interval = 0; /**< refresh interval in milliseconds. */
+
+int prom_cache_gzip = 0; /**< enable or disable gzip replies. */
+
+/**
+ * @brief Initialize the cache (shared memory buffers).
+ *
+ * @return 0 on success.
+ */
+int prom_cache_init(int size)
+{
+	int i;
+
+#ifndef XHTTP_PROM_ZLIB
+	if(prom_cache_gzip) {
+		LM_WARN("module compiled without zlib - gzip replies disabled\n");
+		prom_cache_gzip = 0;
+	}
+#endif
+
+	_prom_cache = (prom_cache_t *)shm_malloc(sizeof(prom_cache_t));
+	if(_prom_cache == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_prom_cache, 0, sizeof(prom_cache_t));
+	if(lock_init(&_prom_cache->lock) == NULL) {
+		LM_ERR("Cannot initialize the lock\n");
+		shm_free(_prom_cache);
+		_prom_cache = NULL;
+		return -1;
+	}
+	_prom_cache->active = -1;
+	_prom_cache->size = size;
+
+	for(i = 0; i < 2; i++) {
+		_prom_cache->b[i].buf = (char *)shm_malloc(size);
+		if(_prom_cache->b[i].buf == NULL) {
+			SHM_MEM_ERROR;
+			goto error;
+		}
+		if(prom_cache_gzip) {
+			_prom_cache->b[i].gzbuf = (char *)shm_malloc(size);
+			if(_prom_cache->b[i].gzbuf == NULL) {
+				SHM_MEM_ERROR;
+				goto error;
+			}
+		}
+	}
+
+	return 0;
+
+error:
+	prom_cache_destroy();
+	return -1;
+}
+
+/**
+ * @brief Free the cache.
+ */
+void prom_cache_destroy(void)
+{
+	int i;
+
+	if(_prom_cache == NULL) {
+		return;
+	}
+	for(i = 0; i < 2; i++) {
+		if(_prom_cache->b[i].buf) {
+			shm_free(_prom_cache->b[i].buf);
+		}
+		if(_prom_cache->b[i].gzbuf) {
+			shm_free(_prom_cache->b[i].gzbuf);
+		}
+	}
+	lock_destroy(&_prom_cache->lock);
+	shm_free(_prom_cache);
+	_prom_cache = NULL;
+}
+
+#ifdef XHTTP_PROM_ZLIB
+/**
+ * @brief Compress the rendered metrics with gzip format.
+ *
+ * @return 0 on success.
+ */
+static int prom_cache_compress(prom_cache_buf_t *pb, int size)
+{
+	z_stream zs;
+	int ret;
+
+	pb->gzlen = 0;
+	memset(&zs, 0, sizeof(zs));
+	/* 15 + 16 - max window size with gzip header and trailer */
+	if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+			   Z_DEFAULT_STRATEGY)
+			!= Z_OK) {
+		LM_ERR("Cannot initialize gzip compression\n");
+		return -1;
+	}
+	zs.next_in = (Bytef *)pb->buf;
+	zs.avail_in = (uInt)pb->len;
+	zs.next_out = (Bytef *)pb->gzbuf;
+	zs.avail_out = (uInt)size;
+	ret = deflate(&zs, Z_FINISH);
+	if(ret != Z_STREAM_END) {
+		LM_ERR("Cannot compress metrics (%d) - buffer too small?\n", ret);
+		deflateEnd(&zs);
+		return -1;
+	}
+	pb->gzlen = (int)zs.total_out;
+	deflateEnd(&zs);
+
+	return 0;
+}
+#endif
+
+/**
+ * @brief Timer function rendering the metrics into the cache.
+ */
+void prom_cache_timer(unsigned int ticks, void *param)
+{
+	prom_ctx_t ctx;
+	prom_cache_buf_t *pb;
+	int idx;
+
+	if(_prom_cache == NULL) {
+		return;
+	}
+
+	lock_get(&_prom_cache->lock);
+	idx = (_prom_cache->active == 0) ? 1 : 0;
+	pb = &_prom_cache->b[idx];
+	if(pb->refs > 0) {
+		/* still used by a worker for a previous scrape */
+		lock_release(&_prom_cache->lock);
+		LM_DBG("Cache buffer %d still in use - skip rendering\n", idx);
+		return;
+	}
+	lock_release(&_prom_cache->lock);
+
+	/* only the timer process writes the buffer not published */
+	memset(&ctx, 0, sizeof(prom_ctx_t));
+	ctx.reply.buf.s = pb->buf;
+	ctx.reply.buf.len = _prom_cache->size;
+	ctx.reply.body.s = pb->buf;
+	ctx.reply.body.len = 0;
+	if(prom_stats_get(&ctx, &xhttp_prom_stats)) {
+		LM_ERR("Fail to render metrics - keeping last published ones\n");
+		return;
+	}
+	pb->len = ctx.reply.body.len;
+	pb->gzlen = 0;
+#ifdef XHTTP_PROM_ZLIB
+	if(prom_cache_gzip && pb->len > 0) {
+		prom_cache_compress(pb, _prom_cache->size);
+	}
+#endif
+
+	lock_get(&_prom_cache->lock);
+	_prom_cache->active = idx;
+	lock_release(&_prom_cache->lock);
+
+	LM_DBG("Published cache buffer %d (%d bytes, %d gzip)\n", idx, pb->len,
+			pb->gzlen);
+}
+
+/**
+ * @brief Get a reference to the last rendered metrics.
+ *
+ * @return index of the referenced buffer, -1 if nothing rendered yet.
+ */
+int prom_cache_acquire(str *body, str *gzbody)
+{
+	prom_cache_buf_t *pb;
+	int idx;
+
+	if(_prom_cache == NULL) {
+		return -1;
+	}
+
+	lock_get(&_prom_cache->lock);
+	idx = _prom_cache->active;
+	if(idx < 0) {
+		lock_release(&_prom_cache->lock);
+		return -1;
+	}
+	pb = &_prom_cache->b[idx];
+	pb->refs++;
+	lock_release(&_prom_cache->lock);
+
+	body->s = pb->buf;
+	body->len = pb->len;
+	if(gzbody != NULL) {
+		gzbody->s = pb->gzbuf;
+		gzbody->len = pb->gzlen;
+	}
+
+	return idx;
+}
+
+/**
+ * @brief Release a reference obtained with prom_cache_acquire().
+ */
+void prom_cache_release(int idx)
+{
+	if(_prom_cache == NULL || idx < 0 || idx > 1) {
+		return;
+	}
+
+	lock_get(&_prom_cache->lock);
+	if(_prom_cache->b[idx].refs > 0) {
+		_prom_cache->b[idx].refs--;
+	}
+	lock_release(&_prom_cache->lock);
+}
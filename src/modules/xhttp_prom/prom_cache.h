@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/**
+ * @file
+ * @brief xHTTP_PROM :: Header for the cache of rendered metrics.
+ * @ingroup xhttp_prom
+ * - Module: @ref xhttp_prom
+ */
+
+#ifndef _PROM_CACHE_H_
+#define _PROM_CACHE_H_
+
+#include "../../core/str.h"
+
+/**
+ * @brief refresh interval of the cache in milliseconds (0 - no cache).
+ */
+extern int prom_cache_interval;
+
+/**
+ * @brief enable or disable gzip compressed replies from the cache.
+ */
+extern int prom_cache_gzip;
+
+/**
+ * @brief Initialize the cache (shared memory buffers).
+ *
+ * @param size size of each buffer.
+ * @return 0 on success.
+ */
+int prom_cache_init(int size);
+
+/**
+ * @brief Free the cache.
+ */
+void prom_cache_destroy(void);
+
+/**
+ * @brief Timer function rendering the metrics into the cache.
+ */
+void prom_cache_timer(unsigned int ticks, void *param);
+
+/**
+ * @brief Get a reference to the last rendered metrics.
+ *
+ * @param body filled with the rendered metrics.
+ * @param gzbody if not NULL, filled with the gzip compressed metrics (len
+ *        is 0 if not available).
+ * @return index of the referenced buffer, -1 if nothing rendered yet.
+ */
+int prom_cache_acquire(str *body, str *gzbody);
+
+/**
+ * @brief Release a reference obtained with prom_cache_acquire().
+ */
+void prom_cache_release(int idx);
+
+#endif // _PROM_CACHE_H_
@@ -124,6 +124,8 @@ struct prom_metric_s
 	struct prom_buckets_upper_s
 			*buckets_upper; /**< Upper bounds for buckets. */
 	struct prom_lvalue_s *lval_list;
+	int lval_no;   /**< Number of lvalue structures. */
+	int lval_drop; /**< Updates dropped by label values limit. */
 	struct prom_metric_s *next;
 };
 
@@ -559,11 +561,13 @@ error:
  *
  * If it does not exist it creates a new one and inserts it into the metric.
  *
+ * @param limit set to 1 if the max number of label values is reached.
+ *
  * @return pointer to lvalue on success.
  * @return NULL on error.
  */
 static prom_lvalue_t *prom_lvalue_get_create(
-		prom_metric_t *p_m, str *l1, str *l2, str *l3)
+		prom_metric_t *p_m, str *l1, str *l2, str *l3, int *limit)
 {
 	if(!p_m) {
 		LM_ERR("No metric found\n");
@@ -611,6 +615,18 @@ static prom_lvalue_t *prom_lvalue_get_create(
 		p = p->next;
 	}
 
+	/* Limit the number of label values (cardinality) of a metric. */
+	if(prom_max_label_values > 0 && p_m->lb_name != NULL
+			&& p_m->lval_no >= prom_max_label_values) {
+		if(p_m->lval_drop++ == 0) {
+			LM_WARN("Max number of label values (%d) reached for metric: "
+					"%.*s\n",
+					prom_max_label_values, p_m->name.len, p_m->name.s);
+		}
+		*limit = 1;
+		return NULL;
+	}
+
 	LM_DBG("Creating lvalue %.*s\n", p_m->name.len, p_m->name.s);
 	/* No lvalue structure found. Create and insert a new one. */
 	p = prom_metric_lvalue_create(p_m, l1, l2, l3);
@@ -618,6 +634,7 @@ static prom_lvalue_t *prom_lvalue_get_create(
 		LM_ERR("Cannot create a new lvalue structure\n");
 		return NULL;
 	}
+	p_m->lval_no++;
 
 	return p;
 }
@@ -651,6 +668,7 @@ static void prom_metric_timeout_delete(prom_metric_t *p_m)
 
 			/* Free current lvalue. */
 			prom_lvalue_free(current);
+			p_m->lval_no--;
 
 		} else {
 			l = &((*l)->next);
@@ -677,11 +695,13 @@ static void prom_metric_list_timeout_delete()
  *
  * If metric name exists but no lvalue matches it creates a new lvalue.
  *
+ * @param limit set to 1 if the max number of label values is reached.
+ *
  * @return NULL if no lvalue was found or created.
  * @return pointer to lvalue on success.
  */
-static prom_lvalue_t *prom_metric_lvalue_get(
-		str *s_name, metric_type_t m_type, str *l1, str *l2, str *l3)
+static prom_lvalue_t *prom_metric_lvalue_get(str *s_name,
+		metric_type_t m_type, str *l1, str *l2, str *l3, int *limit)
 {
 	if(!s_name || s_name->len == 0 || s_name->s == NULL) {
 		LM_ERR("No name for metric\n");
@@ -713,9 +733,11 @@ static prom_lvalue_t *prom_metric_lvalue_get(
 	}
 
 	prom_lvalue_t *p_lv = NULL;
-	p_lv = prom_lvalue_get_create(p_m, l1, l2, l3);
+	p_lv = prom_lvalue_get_create(p_m, l1, l2, l3, limit);
 	if(p_lv == NULL) {
-		LM_ERR("Failed to create lvalue\n");
+		if(*limit == 0) {
+			LM_ERR("Failed to create lvalue\n");
+		}
 		return NULL;
 	}
 
@@ -1157,10 +1179,14 @@ int prom_counter_inc(str *s_name, int number, str *l1, str *l2, str *l3)
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_COUNTER, l1, l2, l3);
+	int limit = 0;
+	p = prom_metric_lvalue_get(s_name, M_COUNTER, l1, l2, l3, &limit);
 	if(!p) {
-		LM_ERR("Cannot find counter: %.*s\n", s_name->len, s_name->s);
 		lock_release(prom_lock);
+		if(limit) {
+			return PROM_LVALUE_LIMIT;
+		}
+		LM_ERR("Cannot find counter: %.*s\n", s_name->len, s_name->s);
 		return -1;
 	}
 
@@ -1180,10 +1206,14 @@ int prom_counter_reset(str *s_name, str *l1, str *l2, str *l3)
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_COUNTER, l1, l2, l3);
+	int limit = 0;
+	p = prom_metric_lvalue_get(s_name, M_COUNTER, l1, l2, l3, &limit);
 	if(!p) {
-		LM_ERR("Cannot find counter: %.*s\n", s_name->len, s_name->s);
 		lock_release(prom_lock);
+		if(limit) {
+			return PROM_LVALUE_LIMIT;
+		}
+		LM_ERR("Cannot find counter: %.*s\n", s_name->len, s_name->s);
 		return -1;
 	}
 
@@ -1203,10 +1233,14 @@ int prom_gauge_set(str *s_name, double number, str *l1, str *l2, str *l3)
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_GAUGE, l1, l2, l3);
+	int limit = 0;
+	p = prom_metric_lvalue_get(s_name, M_GAUGE, l1, l2, l3, &limit);
 	if(!p) {
-		LM_ERR("Cannot find gauge: %.*s\n", s_name->len, s_name->s);
 		lock_release(prom_lock);
+		if(limit) {
+			return PROM_LVALUE_LIMIT;
+		}
+		LM_ERR("Cannot find gauge: %.*s\n", s_name->len, s_name->s);
 		return -1;
 	}
 
@@ -1226,10 +1260,14 @@ int prom_gauge_reset(str *s_name, str *l1, str *l2, str *l3)
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_GAUGE, l1, l2, l3);
+	int limit = 0;
+	p = prom_metric_lvalue_get(s_name, M_GAUGE, l1, l2, l3, &limit);
 	if(!p) {
-		LM_ERR("Cannot find gauge: %.*s\n", s_name->len, s_name->s);
 		lock_release(prom_lock);
+		if(limit) {
+			return PROM_LVALUE_LIMIT;
+		}
+		LM_ERR("Cannot find gauge: %.*s\n", s_name->len, s_name->s);
 		return -1;
 	}
 
@@ -1634,8 +1672,13 @@ int prom_histogram_observe(
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_HISTOGRAM, l1, l2, l3);
+	int limit = 0;
+	p = prom_metric_lvalue_get(s_name, M_HISTOGRAM, l1, l2, l3, &limit);
 	if(!p) {
+		if(limit) {
+			lock_release(prom_lock);
+			return PROM_LVALUE_LIMIT;
+		}
 		LM_ERR("Cannot find histogram: %.*s\n", s_name->len, s_name->s);
 		goto error;
 	}
@@ -2000,6 +2043,31 @@ error:
 	return -1;
 }
 
+/**
+ * @brief Print number of updates dropped by label values limit.
+ *
+ * @return 0 on success.
+ */
+static int prom_metric_drop_print(prom_ctx_t *ctx, prom_metric_t *p)
+{
+	uint64_t ts;
+
+	if(get_timestamp(&ts)) {
+		LM_ERR("Fail to get timestamp\n");
+		return -1;
+	}
+	if(prom_body_printf(ctx,
+			   "%.*slabel_values_dropped{metric=\"%.*s\"%s} %d %" PRIu64
+			   "\n",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, p->name.len,
+			   p->name.s, xhttp_prom_tags_comma, p->lval_drop, ts)
+			== -1) {
+		LM_ERR("Fail to print\n");
+		return -1;
+	}
+	return 0;
+}
+
 /**
  * @brief Print user defined metrics.
  *
@@ -2036,6 +2104,13 @@ int prom_metric_list_print(prom_ctx_t *ctx)
 
 		} /* while pvl */
 
+		if(p->lval_drop > 0) {
+			if(prom_metric_drop_print(ctx, p)) {
+				LM_ERR("Failed to print\n");
+				goto error;
+			}
+		}
+
 		p = p->next;
 
 	} /* while p */
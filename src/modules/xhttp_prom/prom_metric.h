@@ -35,6 +35,13 @@
 
 #include "xhttp_prom.h"
 
+/**
+ * @brief Returned when a value is dropped because the max number of label
+ * values of the metric is reached - not an error, it is counted in the
+ * label_values_dropped metric.
+ */
+#define PROM_LVALUE_LIMIT 1
+
 /**
  * @brief Initialize user defined metrics.
  */
@@ -69,21 +76,29 @@ int prom_metric_list_print(prom_ctx_t *ctx);
 
 /**
  * @brief Reset a counter.
+ *
+ * @return 0 on success, PROM_LVALUE_LIMIT if dropped, -1 on error.
  */
 int prom_counter_reset(str *s_name, str *l1, str *l2, str *l3);
 
 /**
  * @brief Reset value in a gauge.
+ *
+ * @return 0 on success, PROM_LVALUE_LIMIT if dropped, -1 on error.
  */
 int prom_gauge_reset(str *s_name, str *l1, str *l2, str *l3);
 
 /**
  * @brief Add some positive amount to a counter.
+ *
+ * @return 0 on success, PROM_LVALUE_LIMIT if dropped, -1 on error.
  */
 int prom_counter_inc(str *s_name, int number, str *l1, str *l2, str *l3);
 
 /**
  * @brief Set a value in a gauge.
+ *
+ * @return 0 on success, PROM_LVALUE_LIMIT if dropped, -1 on error.
  */
 int prom_gauge_set(str *s_name, double number, str *l1, str *l2, str *l3);
 
@@ -91,6 +106,8 @@ int prom_gauge_set(str *s_name, double number, str *l1, str *l2, str *l3);
  * @brief Observe a value in a histogram.
  *
  * @param number value to observe.
+ *
+ * @return 0 on success, PROM_LVALUE_LIMIT if dropped, -1 on error.
  */
 int prom_histogram_observe(
 		str *s_name, double number, str *l1, str *l2, str *l3);
@@ -36,10 +36,14 @@
 #include "../../core/kemi.h"
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
+#include "../../core/timer_proc.h"
+#include "../../core/data_lump_rpl.h"
+#include "../../core/ut.h"
 
 #include "xhttp_prom.h"
 #include "prom.h"
 #include "prom_metric.h"
+#include "prom_cache.h"
 
 /**
  * @file
@@ -61,6 +65,7 @@ MODULE_VERSION
 
 str XHTTP_PROM_REASON_OK = str_init("OK");
 str XHTTP_PROM_CONTENT_TYPE_TEXT_HTML = str_init("text/plain; version=0.0.4");
+str XHTTP_PROM_HDR_GZIP = str_init("Content-Encoding: gzip\r\n");
 
 static rpc_export_t rpc_cmds[];
 static int mod_init(void);
@@ -176,6 +181,10 @@ int uptime_stat_enabled = 0; /**< enable or disable uptime statistic. */
 
 int pkgmem_stats_enabled = 0; /**< enable or disable pkgmem statistics. */
 
+int kemi_stats_enabled = 0; /**< enable or disable KEMI profiler metrics. */
+
+int prom_max_label_values = 0; /**< max label values per metric. */
+
 char error_buf[ERROR_REASON_BUF_LEN];
 
 /* clang-format off */
@@ -217,6 +226,10 @@ static param_export_t params[] = {
 	{"xhttp_prom_timeout", PARAM_INT, &timeout_minutes},
 	{"xhttp_prom_uptime_stat", PARAM_INT, &uptime_stat_enabled},
 	{"xhttp_prom_pkg_stats", PARAM_INT, &pkgmem_stats_enabled},
+	{"xhttp_prom_kemi_stats", PARAM_INT, &kemi_stats_enabled},
+	{"xhttp_prom_cache_interval", PARAM_INT, &prom_cache_interval},
+	{"xhttp_prom_cache_gzip", PARAM_INT, &prom_cache_gzip},
+	{"xhttp_prom_max_label_values", PARAM_INT, &prom_max_label_values},
 	{0, 0, 0}
 };
 
@@ -292,6 +305,15 @@ static int mod_init(void)
 
 	memset(&_prom_ctx, 0, sizeof(prom_ctx_t));
 
+	/* Initialize the cache rendered by a timer process. */
+	if(prom_cache_interval > 0) {
+		if(prom_cache_init(buf_size)) {
+			LM_ERR("Cannot initialize the metrics cache\n");
+			return -1;
+		}
+		register_basic_timers(1);
+	}
+
 	/* Initialize Prometheus metrics. */
 	if(prom_metric_init()) {
 		LM_ERR("Cannot initialize Prometheus metrics\n");
@@ -334,6 +356,15 @@ static int child_init(int rank)
 		pkg_proc_stats_no = kex_api.get_pkmem_stats(&pkg_proc_stats);
 	}
 
+	if(rank == PROC_MAIN && prom_cache_interval > 0) {
+		if(fork_basic_utimer(PROC_TIMER, "XHTTP_PROM CACHE TIMER", 1,
+				   prom_cache_timer, NULL, prom_cache_interval)
+				< 0) {
+			LM_ERR("failed to start metrics cache timer routine\n");
+			return -1;
+		}
+	}
+
 	return 0;
 }
 
@@ -350,6 +381,7 @@ static void mod_destroy(void)
 	}
 
 	prom_metric_close();
+	prom_cache_destroy();
 }
 
 /**
@@ -510,6 +542,60 @@ static int prom_send(prom_ctx_t *ctx)
 	return 0;
 }
 
+/**
+ * @brief Check if the HTTP client accepts gzip encoded replies.
+ */
+static int prom_accept_gzip(sip_msg_t *msg)
+{
+	hdr_field_t *hf;
+
+	if(parse_headers(msg, HDR_EOH_F, 0) < 0) {
+		return 0;
+	}
+	for(hf = msg->headers; hf; hf = hf->next) {
+		if(hf->name.len == 15
+				&& strncasecmp(hf->name.s, "Accept-Encoding", 15) == 0
+				&& ser_memmem(hf->body.s, "gzip", hf->body.len, 4) != NULL) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Send the metrics rendered by the cache timer process.
+ *
+ * @return 0 on success, -1 if the cache is not ready yet.
+ */
+static int prom_cache_send(prom_ctx_t *ctx)
+{
+	str body = STR_NULL;
+	str gzbody = STR_NULL;
+	int idx;
+
+	idx = prom_cache_acquire(&body,
+			(prom_cache_gzip && prom_accept_gzip(ctx->msg)) ? &gzbody : NULL);
+	if(idx < 0) {
+		LM_DBG("Metrics cache not ready yet\n");
+		return -1;
+	}
+
+	ctx->reply_sent = 1;
+	if(gzbody.len > 0) {
+		if(add_lump_rpl(ctx->msg, XHTTP_PROM_HDR_GZIP.s, XHTTP_PROM_HDR_GZIP.len,
+				   LUMP_RPL_HDR)
+				== 0) {
+			LM_ERR("failed to insert content-encoding lump\n");
+			gzbody.len = 0;
+		}
+	}
+	xhttp_api.reply(ctx->msg, 200, &XHTTP_PROM_REASON_OK,
+			&XHTTP_PROM_CONTENT_TYPE_TEXT_HTML,
+			(gzbody.len > 0) ? &gzbody : &body);
+	prom_cache_release(idx);
+
+	return 0;
+}
 
 static int ki_xhttp_prom_dispatch(sip_msg_t *msg)
 {
@@ -535,6 +621,9 @@ static int ki_xhttp_prom_dispatch(sip_msg_t *msg)
 	}
 	memset(&_prom_ctx, 0, sizeof(prom_ctx_t));
 	_prom_ctx.msg = msg;
+	if(prom_cache_interval > 0 && prom_cache_send(&_prom_ctx) == 0) {
+		return 0;
+	}
 	if(init_xhttp_prom_reply(&_prom_ctx) < 0) {
 		goto send_reply;
 	}
@@ -574,7 +663,7 @@ static int ki_xhttp_prom_counter_reset_l0(struct sip_msg *msg, str *s_name)
 		return -1;
 	}
 
-	if(prom_counter_reset(s_name, NULL, NULL, NULL)) {
+	if(prom_counter_reset(s_name, NULL, NULL, NULL) < 0) {
 		LM_ERR("Cannot reset counter: %.*s\n", s_name->len, s_name->s);
 		return -1;
 	}
@@ -599,7 +688,7 @@ static int ki_xhttp_prom_counter_reset_l1(
 		return -1;
 	}
 
-	if(prom_counter_reset(s_name, l1, NULL, NULL)) {
+	if(prom_counter_reset(s_name, l1, NULL, NULL) < 0) {
 		LM_ERR("Cannot reset counter: %.*s (%.*s)\n", s_name->len, s_name->s,
 				l1->len, l1->s);
 		return -1;
@@ -632,7 +721,7 @@ static int ki_xhttp_prom_counter_reset_l2(
 		return -1;
 	}
 
-	if(prom_counter_reset(s_name, l1, l2, NULL)) {
+	if(prom_counter_reset(s_name, l1, l2, NULL) < 0) {
 		LM_ERR("Cannot reset counter: %.*s (%.*s, %.*s)\n", s_name->len,
 				s_name->s, l1->len, l1->s, l2->len, l2->s);
 		return -1;
@@ -670,7 +759,7 @@ static int ki_xhttp_prom_counter_reset_l3(
 		return -1;
 	}
 
-	if(prom_counter_reset(s_name, l1, l2, l3)) {
+	if(prom_counter_reset(s_name, l1, l2, l3) < 0) {
 		LM_ERR("Cannot reset counter: %.*s (%.*s, %.*s, %.*s)\n", s_name->len,
 				s_name->s, l1->len, l1->s, l2->len, l2->s, l3->len, l3->s);
 		return -1;
@@ -746,7 +835,9 @@ static int w_prom_counter_reset(
 	} /* if l1 != NULL */
 
 	if(prom_counter_reset(&s_name, (l1 != NULL) ? &l1_str : NULL,
-			   (l2 != NULL) ? &l2_str : NULL, (l3 != NULL) ? &l3_str : NULL)) {
+			   (l2 != NULL) ? &l2_str : NULL,
+			   (l3 != NULL) ? &l3_str : NULL)
+			< 0) {
 		LM_ERR("Cannot reset counter: %.*s\n", s_name.len, s_name.s);
 		return -1;
 	}
@@ -799,7 +890,7 @@ static int ki_xhttp_prom_gauge_reset_l0(struct sip_msg *msg, str *s_name)
 		return -1;
 	}
 
-	if(prom_gauge_reset(s_name, NULL, NULL, NULL)) {
+	if(prom_gauge_reset(s_name, NULL, NULL, NULL) < 0) {
 		LM_ERR("Cannot reset gauge: %.*s\n", s_name->len, s_name->s);
 		return -1;
 	}
@@ -824,7 +915,7 @@ static int ki_xhttp_prom_gauge_reset_l1(
 		return -1;
 	}
 
-	if(prom_gauge_reset(s_name, l1, NULL, NULL)) {
+	if(prom_gauge_reset(s_name, l1, NULL, NULL) < 0) {
 		LM_ERR("Cannot reset gauge: %.*s (%.*s)\n", s_name->len, s_name->s,
 				l1->len, l1->s);
 		return -1;
@@ -856,7 +947,7 @@ static int ki_xhttp_prom_gauge_reset_l2(
 		return -1;
 	}
 
-	if(prom_gauge_reset(s_name, l1, l2, NULL)) {
+	if(prom_gauge_reset(s_name, l1, l2, NULL) < 0) {
 		LM_ERR("Cannot reset gauge: %.*s (%.*s, %.*s)\n", s_name->len,
 				s_name->s, l1->len, l1->s, l2->len, l2->s);
 		return -1;
@@ -894,7 +985,7 @@ static int ki_xhttp_prom_gauge_reset_l3(
 		return -1;
 	}
 
-	if(prom_gauge_reset(s_name, l1, l2, l3)) {
+	if(prom_gauge_reset(s_name, l1, l2, l3) < 0) {
 		LM_ERR("Cannot reset gauge: %.*s (%.*s, %.*s, %.*s)\n", s_name->len,
 				s_name->s, l1->len, l1->s, l2->len, l2->s, l3->len, l3->s);
 		return -1;
@@ -970,7 +1061,9 @@ static int w_prom_gauge_reset(
 	} /* if l1 != NULL */
 
 	if(prom_gauge_reset(&s_name, (l1 != NULL) ? &l1_str : NULL,
-			   (l2 != NULL) ? &l2_str : NULL, (l3 != NULL) ? &l3_str : NULL)) {
+			   (l2 != NULL) ? &l2_str : NULL,
+			   (l3 != NULL) ? &l3_str : NULL)
+			< 0) {
 		LM_ERR("Cannot reset gauge: %.*s\n", s_name.len, s_name.s);
 		return -1;
 	}
@@ -1047,7 +1140,7 @@ static int ki_xhttp_prom_counter_inc_l0(
 		return -1;
 	}
 
-	if(prom_counter_inc(s_name, number, NULL, NULL, NULL)) {
+	if(prom_counter_inc(s_name, number, NULL, NULL, NULL) < 0) {
 		LM_ERR("Cannot add number: %d to counter: %.*s\n", number, s_name->len,
 				s_name->s);
 		return -1;
@@ -1078,7 +1171,7 @@ static int ki_xhttp_prom_counter_inc_l1(
 		return -1;
 	}
 
-	if(prom_counter_inc(s_name, number, l1, NULL, NULL)) {
+	if(prom_counter_inc(s_name, number, l1, NULL, NULL) < 0) {
 		LM_ERR("Cannot add number: %d to counter: %.*s (%.*s)\n", number,
 				s_name->len, s_name->s, l1->len, l1->s);
 		return -1;
@@ -1116,7 +1209,7 @@ static int ki_xhttp_prom_counter_inc_l2(
 		return -1;
 	}
 
-	if(prom_counter_inc(s_name, number, l1, l2, NULL)) {
+	if(prom_counter_inc(s_name, number, l1, l2, NULL) < 0) {
 		LM_ERR("Cannot add number: %d to counter: %.*s (%.*s, %.*s)\n", number,
 				s_name->len, s_name->s, l1->len, l1->s, l2->len, l2->s);
 		return -1;
@@ -1159,7 +1252,7 @@ static int ki_xhttp_prom_counter_inc_l3(
 		return -1;
 	}
 
-	if(prom_counter_inc(s_name, number, l1, l2, l3)) {
+	if(prom_counter_inc(s_name, number, l1, l2, l3) < 0) {
 		LM_ERR("Cannot add number: %d to counter: %.*s (%.*s, %.*s, %.*s)\n",
 				number, s_name->len, s_name->s, l1->len, l1->s, l2->len, l2->s,
 				l3->len, l3->s);
@@ -1246,7 +1339,9 @@ static int w_prom_counter_inc(struct sip_msg *msg, char *pname, char *pnumber,
 	} /* if l1 != NULL */
 
 	if(prom_counter_inc(&s_name, number, (l1 != NULL) ? &l1_str : NULL,
-			   (l2 != NULL) ? &l2_str : NULL, (l3 != NULL) ? &l3_str : NULL)) {
+			   (l2 != NULL) ? &l2_str : NULL,
+			   (l3 != NULL) ? &l3_str : NULL)
+			< 0) {
 		LM_ERR("Cannot add number: %d to counter: %.*s\n", number, s_name.len,
 				s_name.s);
 		return -1;
@@ -1314,7 +1409,7 @@ static int ki_xhttp_prom_gauge_set_l0(
 		return -1;
 	}
 
-	if(prom_gauge_set(s_name, number, NULL, NULL, NULL)) {
+	if(prom_gauge_set(s_name, number, NULL, NULL, NULL) < 0) {
 		LM_ERR("Cannot assign number: %f to gauge: %.*s\n", number, s_name->len,
 				s_name->s);
 		return -1;
@@ -1351,7 +1446,7 @@ static int ki_xhttp_prom_gauge_set_l1(
 		return -1;
 	}
 
-	if(prom_gauge_set(s_name, number, l1, NULL, NULL)) {
+	if(prom_gauge_set(s_name, number, l1, NULL, NULL) < 0) {
 		LM_ERR("Cannot assign number: %f to gauge: %.*s (%.*s)\n", number,
 				s_name->len, s_name->s, l1->len, l1->s);
 		return -1;
@@ -1394,7 +1489,7 @@ static int ki_xhttp_prom_gauge_set_l2(
 		return -1;
 	}
 
-	if(prom_gauge_set(s_name, number, l1, l2, NULL)) {
+	if(prom_gauge_set(s_name, number, l1, l2, NULL) < 0) {
 		LM_ERR("Cannot assign number: %f to gauge: %.*s (%.*s, %.*s)\n", number,
 				s_name->len, s_name->s, l1->len, l1->s, l2->len, l2->s);
 		return -1;
@@ -1443,7 +1538,7 @@ static int ki_xhttp_prom_gauge_set_l3(struct sip_msg *msg, str *s_name,
 		return -1;
 	}
 
-	if(prom_gauge_set(s_name, number, l1, l2, l3)) {
+	if(prom_gauge_set(s_name, number, l1, l2, l3) < 0) {
 		LM_ERR("Cannot assign number: %f to gauge: %.*s (%.*s, %.*s, %.*s)\n",
 				number, s_name->len, s_name->s, l1->len, l1->s, l2->len, l2->s,
 				l3->len, l3->s);
@@ -1536,7 +1631,9 @@ static int w_prom_gauge_set(struct sip_msg *msg, char *pname, char *pnumber,
 	} /* if l1 != NULL */
 
 	if(prom_gauge_set(&s_name, number, (l1 != NULL) ? &l1_str : NULL,
-			   (l2 != NULL) ? &l2_str : NULL, (l3 != NULL) ? &l3_str : NULL)) {
+			   (l2 != NULL) ? &l2_str : NULL,
+			   (l3 != NULL) ? &l3_str : NULL)
+			< 0) {
 		LM_ERR("Cannot assign number: %f to gauge: %.*s\n", number, s_name.len,
 				s_name.s);
 		return -1;
@@ -1603,7 +1700,7 @@ static int ki_xhttp_prom_histogram_observe_l0(
 		return -1;
 	}
 
-	if(prom_histogram_observe(s_name, number, NULL, NULL, NULL)) {
+	if(prom_histogram_observe(s_name, number, NULL, NULL, NULL) < 0) {
 		LM_ERR("Cannot observe number: %f in histogram: %.*s\n", number,
 				s_name->len, s_name->s);
 		return -1;
@@ -1640,7 +1737,7 @@ static int ki_xhttp_prom_histogram_observe_l1(
 		return -1;
 	}
 
-	if(prom_histogram_observe(s_name, number, l1, NULL, NULL)) {
+	if(prom_histogram_observe(s_name, number, l1, NULL, NULL) < 0) {
 		LM_ERR("Cannot observe number: %f in histogram: %.*s (%.*s)\n", number,
 				s_name->len, s_name->s, l1->len, l1->s);
 		return -1;
@@ -1683,7 +1780,7 @@ static int ki_xhttp_prom_histogram_observe_l2(
 		return -1;
 	}
 
-	if(prom_histogram_observe(s_name, number, l1, l2, NULL)) {
+	if(prom_histogram_observe(s_name, number, l1, l2, NULL) < 0) {
 		LM_ERR("Cannot observe number: %f in histogram: %.*s (%.*s, %.*s)\n",
 				number, s_name->len, s_name->s, l1->len, l1->s, l2->len, l2->s);
 		return -1;
@@ -1732,7 +1829,7 @@ static int ki_xhttp_prom_histogram_observe_l3(struct sip_msg *msg, str *s_name,
 		return -1;
 	}
 
-	if(prom_histogram_observe(s_name, number, l1, l2, l3)) {
+	if(prom_histogram_observe(s_name, number, l1, l2, l3) < 0) {
 		LM_ERR("Cannot observe number: %f in histogram: %.*s (%.*s, %.*s, "
 			   "%.*s)\n",
 				number, s_name->len, s_name->s, l1->len, l1->s, l2->len, l2->s,
@@ -1827,7 +1924,9 @@ static int w_prom_histogram_observe(struct sip_msg *msg, char *pname,
 	} /* if l1 != NULL */
 
 	if(prom_histogram_observe(&s_name, number, (l1 != NULL) ? &l1_str : NULL,
-			   (l2 != NULL) ? &l2_str : NULL, (l3 != NULL) ? &l3_str : NULL)) {
+			   (l2 != NULL) ? &l2_str : NULL,
+			   (l3 != NULL) ? &l3_str : NULL)
+			< 0) {
 		LM_ERR("Cannot observe number: %f in histogram : %.*s\n", number,
 				s_name.len, s_name.s);
 		return -1;
@@ -76,6 +76,11 @@ typedef struct prom_ctx
 	int reply_sent;
 } prom_ctx_t;
 
+/**
+ * @brief String to indicate which statistics to display.
+ */
+extern str xhttp_prom_stats;
+
 /**
  * @brief string for beginning of metrics.
  */
@@ -111,6 +116,16 @@ extern int uptime_stat_enabled;
  */
 extern int pkgmem_stats_enabled;
 
+/**
+ * @brief enable or disable KEMI functions profiler metrics.
+ */
+extern int kemi_stats_enabled;
+
+/**
+ * @brief max number of label values per metric (0 - no limit).
+ */
+extern int prom_max_label_values;
+
 /**
  * @brief pointer to pkgmem statistics.
  */
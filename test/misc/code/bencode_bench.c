@@ -0,0 +1,384 @@
+/*
+ * benchmark for the bencode writer and raw reader of the rtpengine module
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Encodes an offer command like rtpp_function_call_prepare() does, once
+ * through a tree of items collapsed to an iovec array and once with the
+ * single pass writer, checking that both give the same document. Then
+ * looks up the values used by rtpengine_offer_answer() in an offer reply
+ * and the result of a delete reply with call stats, once in the decoded
+ * tree and once in the encoded reply.
+ *
+ * Example gcc command line:
+ *  gcc -O2 -Wall bencode_bench.c -o bencode_bench
+ *  ./bencode_bench [loops]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* minimal replacement for the compat header of the rtpengine module */
+#define __COMPAT__H__
+
+typedef struct _str
+{
+	char *s;
+	int len;
+} str;
+
+#define BENCODE_MALLOC malloc
+#define BENCODE_FREE free
+#define INLINE static inline
+
+#include "../../../src/modules/rtpengine/bencode.c"
+
+#define SDP_LINES 40
+
+static char sdp[4096];
+static str sdp_str;
+static char offer_reply[8192];
+static int offer_reply_len;
+static char delete_reply[16384];
+static int delete_reply_len;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void build_sdp(void)
+{
+	int i, n;
+
+	n = snprintf(sdp, sizeof(sdp),
+			"v=0\r\no=- 3817372 3817372 IN IP4 192.0.2.10\r\ns=-\r\n"
+			"c=IN IP4 192.0.2.10\r\nt=0 0\r\n"
+			"m=audio 30000 RTP/AVP 0 8 9 101\r\n");
+	for(i = 0; i < SDP_LINES; i++)
+		n += snprintf(sdp + n, sizeof(sdp) - n,
+				"a=candidate:%d 1 UDP 2130706431 192.0.2.%d %d typ host\r\n",
+				i, i + 1, 30000 + 2 * i);
+	sdp_str.s = sdp;
+	sdp_str.len = n;
+}
+
+/* the offer command, built as the tree before */
+static struct iovec *encode_tree(bencode_buffer_t *buf, int *cnt)
+{
+	bencode_item_t *dict, *item;
+	str s;
+
+	dict = bencode_dictionary(buf);
+	item = bencode_dictionary_add_list(dict, "supports");
+	bencode_list_add_string(item, "load limit");
+	bencode_dictionary_add_str(dict, "sdp", &sdp_str);
+	s.s = "remove";
+	s.len = 6;
+	bencode_dictionary_add_str(dict, "ICE", &s);
+	item = bencode_dictionary_add_list(dict, "direction");
+	bencode_list_add_string(item, "internal");
+	bencode_list_add_string(item, "external");
+	item = bencode_dictionary_add_list(dict, "flags");
+	bencode_list_add_string(item, "trust-address");
+	bencode_list_add_string(item, "loop-protect");
+	item = bencode_dictionary_add_list(dict, "replace");
+	bencode_list_add_string(item, "origin");
+	bencode_list_add_string(item, "session-connection");
+	item = bencode_dictionary_add_dictionary(dict, "codec");
+	item = bencode_dictionary_add_list(item, "strip");
+	bencode_list_add_string(item, "G722");
+	bencode_dictionary_add_string(dict, "transport-protocol", "RTP/AVP");
+	item = bencode_dictionary_add_list(dict, "received-from");
+	bencode_list_add_string(item, "IP4");
+	bencode_list_add_string(item, "198.51.100.7");
+	bencode_dictionary_add_string(
+			dict, "call-id", "a84b4c76e66710@pc33.example.com");
+	bencode_dictionary_add_string(
+			dict, "via-branch", "z9hG4bK776asdhds.0");
+	bencode_dictionary_add_string(dict, "from-tag", "1928301774");
+	bencode_dictionary_add_string(dict, "command", "offer");
+	bencode_dictionary_add_string(dict, "sip-message-type", "sip_request");
+	bencode_dictionary_add_integer(dict, "TOS", 184);
+	return bencode_iovec(dict, cnt, 1, 0);
+}
+
+/* the same command with the writer, the lists being collected apart like
+ * when parsing the flags */
+static int encode_writer(bencode_buffer_t *buf, str *out)
+{
+	bencode_writer_t w, direction, flags, replace, strip, rfrom;
+	str s;
+
+	bencode_writer_init(&w, buf);
+	bencode_writer_init(&direction, buf);
+	bencode_writer_init(&flags, buf);
+	bencode_writer_init(&replace, buf);
+	bencode_writer_init(&strip, buf);
+	bencode_writer_init(&rfrom, buf);
+
+	bencode_writer_dictionary(&w);
+	bencode_writer_string(&w, "supports");
+	bencode_writer_list(&w);
+	bencode_writer_string(&w, "load limit");
+	bencode_writer_end(&w);
+	bencode_writer_dictionary_add_str(&w, "sdp", &sdp_str);
+	s.s = "remove";
+	s.len = 6;
+	bencode_writer_dictionary_add_str(&w, "ICE", &s);
+	bencode_writer_string(&direction, "internal");
+	bencode_writer_string(&direction, "external");
+	bencode_writer_string(&flags, "trust-address");
+	bencode_writer_string(&flags, "loop-protect");
+	bencode_writer_string(&replace, "origin");
+	bencode_writer_string(&replace, "session-connection");
+	bencode_writer_string(&strip, "G722");
+	bencode_writer_dictionary_add_list(&w, "direction", &direction);
+	bencode_writer_dictionary_add_list(&w, "flags", &flags);
+	bencode_writer_dictionary_add_list(&w, "replace", &replace);
+	bencode_writer_string(&w, "codec");
+	bencode_writer_dictionary(&w);
+	bencode_writer_dictionary_add_list(&w, "strip", &strip);
+	bencode_writer_end(&w);
+	bencode_writer_dictionary_add_string(&w, "transport-protocol", "RTP/AVP");
+	bencode_writer_string(&rfrom, "IP4");
+	bencode_writer_string(&rfrom, "198.51.100.7");
+	bencode_writer_dictionary_add_list(&w, "received-from", &rfrom);
+	bencode_writer_dictionary_add_string(
+			&w, "call-id", "a84b4c76e66710@pc33.example.com");
+	bencode_writer_dictionary_add_string(
+			&w, "via-branch", "z9hG4bK776asdhds.0");
+	bencode_writer_dictionary_add_string(&w, "from-tag", "1928301774");
+	bencode_writer_dictionary_add_string(&w, "command", "offer");
+	bencode_writer_dictionary_add_string(
+			&w, "sip-message-type", "sip_request");
+	bencode_writer_dictionary_add_integer(&w, "TOS", 184);
+	bencode_writer_end(&w);
+	if(buf->error)
+		return -1;
+	bencode_writer_get_str(&w, out);
+	return 0;
+}
+
+static void build_replies(void)
+{
+	bencode_buffer_t buf;
+	bencode_writer_t w;
+	str s;
+	int i, j;
+
+	bencode_buffer_init(&buf);
+	bencode_writer_init(&w, &buf);
+	bencode_writer_dictionary(&w);
+	bencode_writer_dictionary_add_str(&w, "sdp", &sdp_str);
+	bencode_writer_dictionary_add_string(&w, "to-tag", "a6c85cf");
+	bencode_writer_dictionary_add_string(&w, "result", "ok");
+	bencode_writer_end(&w);
+	bencode_writer_get_str(&w, &s);
+	memcpy(offer_reply, s.s, s.len);
+	offer_reply_len = s.len;
+	bencode_buffer_free(&buf);
+
+	/* delete reply - the result comes after the stats */
+	bencode_buffer_init(&buf);
+	bencode_writer_init(&w, &buf);
+	bencode_writer_dictionary(&w);
+	bencode_writer_dictionary_add_integer(&w, "created", 1700000000);
+	bencode_writer_string(&w, "tags");
+	bencode_writer_dictionary(&w);
+	for(i = 0; i < 2; i++) {
+		bencode_writer_string(&w, i ? "a6c85cf" : "1928301774");
+		bencode_writer_dictionary(&w);
+		bencode_writer_string(&w, "medias");
+		bencode_writer_list(&w);
+		for(j = 0; j < 4; j++) {
+			bencode_writer_dictionary(&w);
+			bencode_writer_dictionary_add_integer(&w, "index", j);
+			bencode_writer_dictionary_add_string(&w, "type", "audio");
+			bencode_writer_dictionary_add_integer(&w, "packets", 123456 + j);
+			bencode_writer_dictionary_add_integer(&w, "bytes", 21234567 + j);
+			bencode_writer_dictionary_add_integer(&w, "errors", j);
+			bencode_writer_dictionary_add_integer(&w, "MOS", 43);
+			bencode_writer_end(&w);
+		}
+		bencode_writer_end(&w);
+		bencode_writer_end(&w);
+	}
+	bencode_writer_end(&w);
+	bencode_writer_dictionary_add_string(&w, "result", "ok");
+	bencode_writer_end(&w);
+	bencode_writer_get_str(&w, &s);
+	memcpy(delete_reply, s.s, s.len);
+	delete_reply_len = s.len;
+	bencode_buffer_free(&buf);
+}
+
+static int flatten(struct iovec *v, int cnt, char *out)
+{
+	int i, len;
+
+	len = 0;
+	for(i = 0; i < cnt; i++) {
+		memcpy(out + len, v[i].iov_base, v[i].iov_len);
+		len += v[i].iov_len;
+	}
+	return len;
+}
+
+int main(int argc, char **argv)
+{
+	bencode_buffer_t buf;
+	bencode_item_t *resp;
+	bencode_writer_t w;
+	struct iovec *v;
+	static char tbuf[8192];
+	str out, val = {NULL, 0}, tag = {NULL, 0};
+	long loops = 200000;
+	long k;
+	double t0, t1, t2;
+	int cnt, tlen, errors = 0;
+	unsigned long sum;
+
+	if(argc > 1)
+		loops = atol(argv[1]);
+
+	build_sdp();
+	build_replies();
+
+	/* same document from both encoders */
+	bencode_buffer_init(&buf);
+	v = encode_tree(&buf, &cnt);
+	tlen = flatten(v + 1, cnt, tbuf);
+	bencode_buffer_free(&buf);
+	bencode_buffer_init(&buf);
+	if(encode_writer(&buf, &out) < 0 || out.len != tlen
+			|| memcmp(out.s, tbuf, tlen)) {
+		fprintf(stderr, "writer output differs from the tree\n");
+		errors++;
+	}
+	bencode_buffer_init(&buf);
+	bencode_writer_init(&w, &buf);
+	bencode_writer_integer(&w, -42);
+	bencode_writer_integer(&w, 0);
+	bencode_writer_string_len(&w, "", 0);
+	if(w.len != 10 || memcmp(w.s, "i-42ei0e0:", 10)) {
+		fprintf(stderr, "wrong integer or empty string from the writer\n");
+		errors++;
+	}
+	bencode_buffer_free(&buf);
+
+	printf("%-28s %12s %12s\n", "", "tree ns/op", "raw ns/op");
+
+	sum = 0;
+	t0 = now_ns();
+	for(k = 0; k < loops; k++) {
+		bencode_buffer_init(&buf);
+		v = encode_tree(&buf, &cnt);
+		sum += cnt;
+		bencode_buffer_free(&buf);
+	}
+	t1 = now_ns();
+	for(k = 0; k < loops; k++) {
+		bencode_buffer_init(&buf);
+		encode_writer(&buf, &out);
+		sum += out.len;
+		bencode_buffer_free(&buf);
+	}
+	t2 = now_ns();
+	printf("%-28s %12.1f %12.1f\n", "encode offer", (t1 - t0) / loops,
+			(t2 - t1) / loops);
+
+	t0 = now_ns();
+	for(k = 0; k < loops; k++) {
+		bencode_buffer_init(&buf);
+		resp = bencode_decode_expect(
+				&buf, offer_reply, offer_reply_len, BENCODE_DICTIONARY);
+		if(!resp || bencode_dictionary_get_strcmp(resp, "result", "ok")
+				|| !bencode_dictionary_get_str(resp, "sdp", &val)
+				|| !bencode_dictionary_get_str(resp, "to-tag", &tag))
+			errors++;
+		sum += val.len + tag.len;
+		bencode_buffer_free(&buf);
+	}
+	t1 = now_ns();
+	for(k = 0; k < loops; k++) {
+		if(bencode_raw_expect(offer_reply, offer_reply_len, BENCODE_DICTIONARY)
+						!= offer_reply_len
+				|| bencode_raw_dictionary_get_strcmp(
+						offer_reply, offer_reply_len, "result", "ok")
+				|| !bencode_raw_dictionary_get_str(
+						offer_reply, offer_reply_len, "sdp", &val)
+				|| !bencode_raw_dictionary_get_str(
+						offer_reply, offer_reply_len, "to-tag", &tag))
+			errors++;
+		sum += val.len + tag.len;
+	}
+	t2 = now_ns();
+	printf("%-28s %12.1f %12.1f\n", "decode offer reply",
+			(t1 - t0) / loops, (t2 - t1) / loops);
+	if(val.len != sdp_str.len || memcmp(val.s, sdp_str.s, val.len)) {
+		fprintf(stderr, "wrong sdp in the reply\n");
+		errors++;
+	}
+
+	t0 = now_ns();
+	for(k = 0; k < loops; k++) {
+		bencode_buffer_init(&buf);
+		resp = bencode_decode_expect(
+				&buf, delete_reply, delete_reply_len, BENCODE_DICTIONARY);
+		if(!resp || bencode_dictionary_get_strcmp(resp, "result", "ok"))
+			errors++;
+		bencode_buffer_free(&buf);
+	}
+	t1 = now_ns();
+	for(k = 0; k < loops; k++) {
+		if(bencode_raw_expect(
+				   delete_reply, delete_reply_len, BENCODE_DICTIONARY)
+						!= delete_reply_len
+				|| bencode_raw_dictionary_get_strcmp(
+						delete_reply, delete_reply_len, "result", "ok"))
+			errors++;
+	}
+	t2 = now_ns();
+	printf("%-28s %12.1f %12.1f\n", "check delete reply result",
+			(t1 - t0) / loops, (t2 - t1) / loops);
+	if(bencode_raw_dictionary_get_integer(
+			   delete_reply, delete_reply_len, "created", 0)
+			!= 1700000000) {
+		fprintf(stderr, "wrong integer in the reply\n");
+		errors++;
+	}
+
+	if(sum == 0)
+		errors++;
+	if(errors) {
+		printf("%d errors\n", errors);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
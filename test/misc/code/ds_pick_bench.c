@@ -0,0 +1,268 @@
+/*
+ * benchmark for the relative weight selection of the dispatcher
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Picks destinations of sets of increasing size with a part of them
+ * inactive, with the 100 slot array of relative weights of the dispatcher
+ * baseline (round robin over the array, then the next active destination)
+ * and with the alias table holding only the active destinations. Prints
+ * the time of a pick and of a rebuild after a state change, and how far
+ * the picks are from the weights (total variation distance, 0 is exact).
+ * Checks that the alias table picks only active destinations, in
+ * proportion to their weight.
+ *
+ * Example gcc command line:
+ *  gcc -O2 -Wall ds_pick_bench.c -o ds_pick_bench -lm
+ *  ./ds_pick_bench [picks [seed]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/* minimal replacements for the core headers used by ds_walias.c */
+#define dprint_h
+#define shm_mem_h
+#define __KSRXRAND_H__
+
+#define LM_ERR(fmt, args...) fprintf(stderr, "ERROR: " fmt, ##args)
+#define SHM_MEM_ERROR LM_ERR("no more shm\n")
+#define shm_malloc malloc
+#define shm_free free
+
+/* xorshift, the dispatcher uses the random function of the core */
+static unsigned int bench_rnd = 2463534242u;
+
+static inline int bench_xrand(void)
+{
+	bench_rnd ^= bench_rnd << 13;
+	bench_rnd ^= bench_rnd >> 17;
+	bench_rnd ^= bench_rnd << 5;
+	return (int)(bench_rnd & 0x7fffffff);
+}
+
+#define ksr_xrand() bench_xrand()
+
+#include "../../../src/modules/dispatcher/ds_walias.c"
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* baseline: array of 100 slots, each active destination getting a
+ * truncated share of them, the rest going to the last one, shuffled */
+static void rwlist_update(unsigned int *rwlist, int *w, int n, char *down)
+{
+	int j, k, t, slice, rw_sum;
+	unsigned int last_insert, tmp;
+
+	rw_sum = 0;
+	for(j = 0; j < n; j++) {
+		if(!down[j])
+			rw_sum += w[j];
+	}
+	if(rw_sum == 0)
+		return;
+	t = 0;
+	for(j = 0; j < n; j++) {
+		if(down[j])
+			continue;
+		slice = w[j] * 100 / rw_sum;
+		for(k = 0; k < slice; k++)
+			rwlist[t++] = (unsigned int)j;
+	}
+	last_insert = t > 0 ? rwlist[t - 1] : (unsigned int)(n - 1);
+	for(j = t; j < 100; j++)
+		rwlist[j] = last_insert;
+	for(j = 0; j < 100; j++) {
+		k = j + (bench_xrand() % (100 - j));
+		tmp = rwlist[j];
+		rwlist[j] = rwlist[k];
+		rwlist[k] = tmp;
+	}
+}
+
+/* baseline selection: next array slot, then the next active one */
+static int pick_rwlist(unsigned int *rwlist, int *rwlast, int n, char *down)
+{
+	int i, hash;
+
+	hash = rwlist[*rwlast];
+	*rwlast = (*rwlast + 1) % 100;
+	i = hash;
+	while(down[i]) {
+		i = (i + 1) % n;
+		if(i == hash)
+			return -1;
+	}
+	return i;
+}
+
+/* same as the dispatcher: the table holds the active destinations */
+static void active_update(ds_walias_t *aa, ds_walias_t *wa, char *down)
+{
+	int j;
+
+	aa->n = 0;
+	for(j = 0; j < wa->n; j++) {
+		if(down[j])
+			continue;
+		aa->dst[aa->n] = j;
+		aa->w[aa->n] = wa->w[j];
+		aa->n++;
+	}
+	ds_walias_build(aa);
+}
+
+/* total variation distance between the picks and the weights */
+static double pick_distance(
+		unsigned long *hits, long picks, int *w, int n, char *down)
+{
+	double wsum, d;
+	int j;
+
+	wsum = 0;
+	for(j = 0; j < n; j++) {
+		if(!down[j])
+			wsum += w[j];
+	}
+	d = 0;
+	for(j = 0; j < n; j++) {
+		if(down[j])
+			d += (double)hits[j] / picks;
+		else
+			d += fabs((double)hits[j] / picks - w[j] / wsum);
+	}
+	return d / 2;
+}
+
+int main(int argc, char **argv)
+{
+	static const int sizes[] = {16, 256, 4096, 65536};
+	static const int pdown[] = {0, 50, 90, 99};
+	ds_walias_t *wa, *aa;
+	unsigned int rwlist[100];
+	int rwlast;
+	char *down;
+	unsigned long *hits;
+	double t0, t1, t2, t3, t4, d0, d1, wsum, exp;
+	long picks = 2000000;
+	long k;
+	int s, p, n, j, r, errors = 0;
+
+	if(argc > 1)
+		picks = atol(argv[1]);
+	if(argc > 2)
+		bench_rnd = (unsigned int)atol(argv[2]) | 1;
+
+	printf("%8s %5s %9s %9s %9s %9s %9s %9s\n", "dsts", "down", "array ns",
+			"array us", "array tv", "alias ns", "alias us", "alias tv");
+	for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		n = sizes[s];
+		wa = ds_walias_new(n);
+		aa = ds_walias_new(n);
+		down = malloc(n);
+		hits = malloc(n * sizeof(unsigned long));
+		if(wa == NULL || aa == NULL || down == NULL || hits == NULL)
+			return 1;
+		for(j = 0; j < n; j++) {
+			wa->dst[j] = j;
+			wa->w[j] = 1 + j % 10;
+		}
+		wa->n = n;
+		ds_walias_build(wa);
+
+		for(p = 0; p < sizeof(pdown) / sizeof(pdown[0]); p++) {
+			/* the first destinations are down, like a failed site */
+			for(j = 0; j < n; j++)
+				down[j] = (j < (long)n * pdown[p] / 100) ? 1 : 0;
+
+			t0 = now_ns();
+			rwlist_update(rwlist, wa->w, n, down);
+			t1 = now_ns();
+			rwlast = 0;
+			memset(hits, 0, n * sizeof(unsigned long));
+			for(k = 0; k < picks; k++) {
+				r = pick_rwlist(rwlist, &rwlast, n, down);
+				if(r >= 0)
+					hits[r]++;
+			}
+			t2 = now_ns();
+			d0 = pick_distance(hits, picks, wa->w, n, down);
+
+			active_update(aa, wa, down);
+			t3 = now_ns();
+			memset(hits, 0, n * sizeof(unsigned long));
+			for(k = 0; k < picks; k++) {
+				r = aa->dst[ds_walias_pick(aa, aa->n)];
+				hits[r]++;
+			}
+			t4 = now_ns();
+			d1 = pick_distance(hits, picks, wa->w, n, down);
+
+			/* the active destinations with the largest weight get their
+			 * share within 10% */
+			wsum = 0;
+			for(j = 0; j < n; j++) {
+				if(!down[j])
+					wsum += wa->w[j];
+			}
+			for(j = 0; j < n; j++) {
+				if(down[j] && hits[j] > 0) {
+					fprintf(stderr, "inactive destination %d picked\n", j);
+					errors++;
+					break;
+				}
+				exp = (double)picks * wa->w[j] / wsum;
+				if(!down[j] && exp >= 10000
+						&& (hits[j] < exp * 0.9 || hits[j] > exp * 1.1)) {
+					fprintf(stderr, "destination %d: %lu picks, expected %.0f\n",
+							j, hits[j], exp);
+					errors++;
+					break;
+				}
+			}
+
+			printf("%8d %4d%% %9.1f %9.1f %9.3f %9.1f %9.1f %9.3f\n", n,
+					pdown[p], (t2 - t1) / picks, (t1 - t0) / 1000, d0,
+					(t4 - t3) / picks, (t3 - t2) / 1000, d1);
+		}
+		ds_walias_free(wa);
+		ds_walias_free(aa);
+		free(down);
+		free(hits);
+	}
+
+	if(errors) {
+		printf("%d errors\n", errors);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * check the pipelimit GCRA limiter when keys collide in its table
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Runs pl_gcra_check() with a fake clock over a table much smaller than
+ * the number of keys, checking that no key gets more than its limit
+ * because another key took its slot, and that expired slots are reused.
+ *
+ * Example gcc command line:
+ *  gcc -O2 -Wall gcra_test.c -o gcra_test
+ *  ./gcra_test [keys [slots]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* minimal replacements for the core headers used by pl_gcra.c */
+#define dprint_h
+#define __atomic_ops
+#define shm_mem_h
+
+#define LM_ERR(fmt, args...) fprintf(stderr, "ERROR: " fmt, ##args)
+#define LM_DBG(fmt, args...) \
+	do {                     \
+	} while(0)
+#define SHM_MEM_ERROR LM_ERR("no more shm\n")
+#define shm_malloc malloc
+#define shm_free free
+
+#define atomic_get_long(v) __atomic_load_n((v), __ATOMIC_SEQ_CST)
+#define atomic_cmpxchg_long(v, o, n) \
+	__sync_val_compare_and_swap((v), (o), (n))
+
+/* fake clock, in microseconds */
+static unsigned long test_now = 1000000;
+
+static int test_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+	ts->tv_sec = test_now / 1000000;
+	ts->tv_nsec = (test_now % 1000000) * 1000;
+	return 0;
+}
+
+#define clock_gettime test_clock_gettime
+
+#include "../../../src/modules/pipelimit/pl_gcra.c"
+
+#define RATE 10
+#define BURST 5
+
+static int check(int i, int n)
+{
+	char buf[32];
+	str key;
+	int accepted = 0;
+
+	key.s = buf;
+	key.len = snprintf(buf, sizeof(buf), "key-%d", i);
+	while(n-- > 0) {
+		if(pl_gcra_check(&key, RATE, BURST) == 1)
+			accepted++;
+	}
+	return accepted;
+}
+
+int main(int argc, char **argv)
+{
+	int nkeys = 64, nslots = 8;
+	int i, a, errors = 0;
+
+	if(argc > 1)
+		nkeys = atoi(argv[1]);
+	if(argc > 2)
+		nslots = atoi(argv[2]);
+	if(nslots <= 0 || (nslots & (nslots - 1)) != 0) {
+		fprintf(stderr, "slots must be a power of two\n");
+		return 1;
+	}
+	if(pl_gcra_init(nslots) < 0)
+		return 1;
+
+	/* alone in the table: the burst, then one per interval */
+	a = check(0, 2 * BURST);
+	if(a != BURST) {
+		fprintf(stderr, "single key: %d accepted, expected %d\n", a, BURST);
+		errors++;
+	}
+	test_now += 1000000 / RATE;
+	a = check(0, 2 * BURST);
+	if(a != 1) {
+		fprintf(stderr, "single key after one interval: %d accepted\n", a);
+		errors++;
+	}
+
+	/* many keys at the same time: a key can lose to the keys sharing its
+	 * slot, but can never get more than its own limit */
+	test_now += 10000000;
+	for(i = 0; i < nkeys; i++) {
+		a = check(i, 2 * BURST);
+		if(a > BURST) {
+			fprintf(stderr, "key %d: %d accepted, limit %d\n", i, a, BURST);
+			errors++;
+		}
+	}
+	/* again, the keys owning the slots must not have been reset */
+	for(i = 0; i < nkeys; i++) {
+		a = check(i, 2 * BURST);
+		if(a != 0) {
+			fprintf(stderr, "key %d: %d accepted again, limit reached\n", i,
+					a);
+			errors++;
+		}
+	}
+
+	/* all states expired: the slots are reused with a full burst */
+	test_now += 10000000;
+	a = check(nkeys, 2 * BURST);
+	if(a != BURST) {
+		fprintf(stderr, "new key after expiry: %d accepted, expected %d\n", a,
+				BURST);
+		errors++;
+	}
+
+	pl_gcra_destroy();
+	if(errors) {
+		printf("%d errors\n", errors);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * benchmark for the bytecode of the integer script expressions
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Builds conditions the way the cfg parser does, fixes them up and
+ * evaluates them with rval_expr_eval_long(), once interpreted and once
+ * compiled by rve_compile(), for a range of values of the variables.
+ * Checks that both give the same result and prints the time of an
+ * evaluation. The variables are pvars with an integer value ($v0, $v1)
+ * or a string one ($s0), read by a get function like the ones of the
+ * modules, so the time of a real accessor has to be added to both.
+ *
+ * Example gcc command line:
+ *  gcc -O2 -Wall -DUSE_PTHREAD_MUTEX rve_bytecode_bench.c -o rve_bytecode_bench
+ *  ./rve_bytecode_bench [evaluations]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "../../../src/core/rvalue.c"
+
+/* symbols of the core used by rvalue.c */
+int process_no = 0;
+int scr_opt_lev = 9;
+int log_stderr = 1;
+int log_color = 0;
+str *log_prefix_val = NULL;
+volatile int dprint_crit = 0;
+km_log_f _km_log_func = &syslog;
+ksr_slog_f _ksr_slog_func = NULL;
+struct log_level_info log_level_info[] = {{"ALERT", LOG_ALERT},
+		{"BUG", LOG_CRIT}, {"CRITICAL", LOG_CRIT}, {"", LOG_CRIT},
+		{"ERROR", LOG_ERR}, {"WARNING", LOG_WARNING}, {"NOTICE", LOG_NOTICE},
+		{"INFO", LOG_INFO}, {"DEBUG", LOG_DEBUG}};
+
+int my_pid(void)
+{
+	return 0;
+}
+
+int get_debug_level(char *mname, int mnlen)
+{
+	return L_WARN;
+}
+
+int get_debug_facility(char *mname, int mnlen)
+{
+	return LOG_DAEMON;
+}
+
+void dprint_color(int level)
+{
+}
+
+void dprint_color_reset(void)
+{
+}
+
+int eval_expr(struct run_act_ctx *h, struct expr *e, struct sip_msg *msg)
+{
+	return -1;
+}
+
+int fix_actions(struct action *a)
+{
+	return 0;
+}
+
+int fix_expr(struct expr *exp)
+{
+	return 0;
+}
+
+int run_actions_safe(
+		struct run_act_ctx *c, struct action *a, struct sip_msg *msg)
+{
+	return -1;
+}
+
+int resolve_select(select_t *s)
+{
+	return -1;
+}
+
+int run_select(str *res, select_t *s, struct sip_msg *msg)
+{
+	return -1;
+}
+
+void err_select(select_t *s)
+{
+}
+
+avp_t *search_avp_by_index(avp_flags_t flags, avp_name_t name, avp_value_t *val,
+		avp_index_t index)
+{
+	return NULL;
+}
+
+int tr_exec(struct sip_msg *msg, trans_t *t, pv_value_t *v)
+{
+	return -1;
+}
+
+int pv_get_spec_value(struct sip_msg *msg, pv_spec_p sp, pv_value_t *value)
+{
+	if(msg == NULL || sp == NULL || sp->getf == NULL || value == NULL
+			|| sp->type == PVT_NONE)
+		return -1;
+	memset(value, 0, sizeof(pv_value_t));
+	return (*sp->getf)(msg, &(sp->pvp), value);
+}
+
+void pv_value_destroy(pv_value_t *val)
+{
+	/* the values are not allocated */
+	memset(val, 0, sizeof(pv_value_t));
+}
+
+/* values of the variables: $v0, $v1 and $s0 as string */
+static long bench_var[2];
+static char bench_str[32] = "5";
+
+static int bench_pv_get(struct sip_msg *msg, pv_param_t *param, pv_value_t *res)
+{
+	int idx;
+
+	idx = param->pvn.u.isname.name.n;
+	if(idx < 2) {
+		res->ri = bench_var[idx];
+		res->flags = PV_VAL_INT | PV_TYPE_INT;
+	} else {
+		res->rs.s = bench_str;
+		res->rs.len = strlen(bench_str);
+		res->flags = PV_VAL_STR;
+	}
+	return 0;
+}
+
+static struct cfg_pos bench_pos;
+
+static struct rval_expr *pv(int idx)
+{
+	pv_spec_t spec;
+
+	memset(&spec, 0, sizeof(spec));
+	spec.type = PVT_OTHER;
+	spec.getf = bench_pv_get;
+	spec.pvp.pvn.u.isname.name.n = idx;
+	return mk_rval_expr_v(RV_PVAR, &spec, &bench_pos);
+}
+
+static struct rval_expr *k(long v)
+{
+	return mk_rval_expr_v(RV_LONG, (void *)v, &bench_pos);
+}
+
+static struct rval_expr *op(
+		enum rval_expr_op o, struct rval_expr *l, struct rval_expr *r)
+{
+	return mk_rval_expr2(o, l, r, &bench_pos);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *names[] = {"$v0 > 5 && $v1 < 10",
+			"($v0 + 2) * $v1 - 7 > 100 || $v1 & 4",
+			"$v0 >= 1 && $v0 <= 9 && $v1 != 3 && !($v0 % 3)",
+			"$s0 > 3", "$v0 == 3"};
+	struct rval_expr *rve[2][5];
+	struct run_act_ctx ctx;
+	struct sip_msg msg;
+	long evals = 5000000;
+	long i, n, r[2];
+	double t0, t1, tt[2];
+	int e, c, ret[2], errors = 0;
+
+	if(argc > 1)
+		evals = atol(argv[1]);
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctx, 0, sizeof(ctx));
+
+	/* [0] interpreted, [1] compiled */
+	for(c = 0; c < 2; c++) {
+		rve[c][0] = op(RVE_LAND_OP, op(RVE_GT_OP, pv(0), k(5)),
+				op(RVE_LT_OP, pv(1), k(10)));
+		rve[c][1] = op(RVE_LOR_OP,
+				op(RVE_GT_OP,
+						op(RVE_MINUS_OP,
+								op(RVE_MUL_OP, op(RVE_PLUS_OP, pv(0), k(2)),
+										pv(1)),
+								k(7)),
+						k(100)),
+				op(RVE_BAND_OP, pv(1), k(4)));
+		rve[c][2] = op(RVE_LAND_OP,
+				op(RVE_LAND_OP,
+						op(RVE_LAND_OP, op(RVE_GTE_OP, pv(0), k(1)),
+								op(RVE_LTE_OP, pv(0), k(9))),
+						op(RVE_IDIFF_OP, pv(1), k(3))),
+				mk_rval_expr1(RVE_LNOT_OP, op(RVE_MOD_OP, pv(0), k(3)),
+						&bench_pos));
+		rve[c][3] = op(RVE_GT_OP, pv(2), k(3));
+		rve[c][4] = op(RVE_EQ_OP, pv(0), k(3));
+		ksr_expr_bytecode = c;
+		for(e = 0; e < 5; e++) {
+			if(rve[c][e] == NULL || fix_rval_expr(rve[c][e]) < 0
+					|| rve_compile(rve[c][e]) < 0)
+				return 1;
+		}
+	}
+
+	printf("%-48s %5s %12s %12s\n", "expression", "instr", "tree ns/eval",
+			"code ns/eval");
+	for(e = 0; e < 5; e++) {
+		for(c = 0; c < 2; c++) {
+			t0 = now_ns();
+			for(i = 0; i < evals; i++) {
+				n = i & 1023;
+				bench_var[0] = n % 13;
+				bench_var[1] = n % 17;
+				rval_expr_eval_long(&ctx, &msg, &r[c], rve[c][e]);
+			}
+			t1 = now_ns();
+			tt[c] = (t1 - t0) / evals;
+		}
+		/* same results, including the string conversion */
+		for(n = 0; n < 1024; n++) {
+			bench_var[0] = n % 13 - 3;
+			bench_var[1] = n % 17;
+			snprintf(bench_str, sizeof(bench_str), "%ld", n % 7);
+			for(c = 0; c < 2; c++)
+				ret[c] = rval_expr_eval_long(&ctx, &msg, &r[c], rve[c][e]);
+			if(ret[0] != ret[1] || r[0] != r[1]) {
+				fprintf(stderr, "%s: $v0=%ld $v1=%ld $s0=%s: %ld (%d), %ld (%d)\n",
+						names[e], bench_var[0], bench_var[1], bench_str, r[0],
+						ret[0], r[1], ret[1]);
+				errors++;
+				break;
+			}
+		}
+		printf("%-48s %5d %12.1f %12.1f\n", names[e],
+				rve[1][e]->code ? rve[1][e]->code->n : 0, tt[0], tt[1]);
+	}
+	for(c = 0; c < 2; c++) {
+		for(e = 0; e < 5; e++)
+			rve_destroy(rve[c][e]);
+	}
+
+	if(errors) {
+		printf("%d errors\n", errors);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
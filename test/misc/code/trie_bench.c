@@ -0,0 +1,247 @@
+/*
+ * compare the dtrie and the path compressed ptrie from lib/trie
+ *  (both for correctness and speed)
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Loads the same random prefixes in both tries, like carrierroute does
+ * for a routing domain, then looks up random numbers with the longest
+ * match used by cr_route() and cr_prime_balance_uri(), checking that both
+ * give the same result.
+ *
+ * Example gcc command line:
+ *  gcc -O2 -Wall trie_bench.c -o trie_bench
+ *  ./trie_bench [prefixes [lookups [branches [seed]]]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* minimal replacements for the core headers used by lib/trie */
+#define dprint_h
+#define mem_h
+#define shm_mem_h
+
+#define LM_ERR(fmt, args...) fprintf(stderr, "ERROR: " fmt, ##args)
+#define LM_DBG(fmt, args...) \
+	do {                     \
+	} while(0)
+#define SHM_MEM_ERROR LM_ERR("no more shm\n")
+#define PKG_MEM_ERROR LM_ERR("no more pkg\n")
+
+static unsigned long mem_used = 0;
+static unsigned long mem_chunks = 0;
+
+static void *bench_malloc(size_t size)
+{
+	size_t *p;
+
+	p = malloc(size + sizeof(size_t));
+	if(p == NULL)
+		return NULL;
+	*p = size;
+	mem_used += size;
+	mem_chunks++;
+	return p + 1;
+}
+
+static void bench_free(void *p)
+{
+	if(p == NULL)
+		return;
+	mem_used -= ((size_t *)p)[-1];
+	mem_chunks--;
+	free((size_t *)p - 1);
+}
+
+#define shm_malloc bench_malloc
+#define shm_free bench_free
+#define pkg_malloc malloc
+#define pkg_free free
+
+#include "../../../src/lib/trie/dtrie.c"
+#include "../../../src/lib/trie/ptrie.c"
+
+#define MAX_LEN 16
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* random key, numbers with a few common leading digits like real
+ * routing prefixes, or printable ascii */
+static void rand_key(char *s, int len, unsigned int branches)
+{
+	int i;
+
+	for(i = 0; i < len; i++) {
+		if(branches == 10)
+			s[i] = '0' + ((i < 2) ? rand() % 4 : rand() % 10);
+		else
+			s[i] = 'a' + ((i < 2) ? rand() % 4 : rand() % 26);
+	}
+}
+
+static int count_walk(void **data, const char *key, unsigned int len, void *p)
+{
+	(*(unsigned int *)p)++;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct dtrie_node_t *dt;
+	struct ptrie_t *pt;
+	unsigned int nprefix = 100000, nlookup = 1000000, branches = 10;
+	unsigned int i, seed = 1, n, errors = 0;
+	unsigned long dmem, dchunks, sum_d = 0, sum_p = 0;
+	char *keys;
+	int len, nd, np;
+	void **rd, **rp;
+	double t0, t_dins, t_pins, t_dlook, t_plook, t_dfree, t_pfree;
+
+	if(argc > 1)
+		nprefix = atoi(argv[1]);
+	if(argc > 2)
+		nlookup = atoi(argv[2]);
+	if(argc > 3)
+		branches = atoi(argv[3]);
+	if(argc > 4)
+		seed = atoi(argv[4]);
+	if(branches != 10 && branches != 128) {
+		fprintf(stderr, "branches must be 10 or 128\n");
+		return 1;
+	}
+	srand(seed);
+
+	dt = dtrie_init(branches);
+	pt = ptrie_init(branches);
+	if(dt == NULL || pt == NULL)
+		return 1;
+
+	keys = malloc((size_t)nlookup * (MAX_LEN + 1));
+	if(keys == NULL)
+		return 1;
+
+	t0 = now();
+	srand(seed);
+	for(i = 0; i < nprefix; i++) {
+		len = 1 + rand() % 10;
+		rand_key(keys, len, branches);
+		if(dtrie_insert(dt, keys, len, (void *)(unsigned long)(i + 1), branches)
+				< 0)
+			return 1;
+	}
+	t_dins = now() - t0;
+	dmem = mem_used;
+	dchunks = mem_chunks;
+
+	t0 = now();
+	srand(seed);
+	for(i = 0; i < nprefix; i++) {
+		len = 1 + rand() % 10;
+		rand_key(keys, len, branches);
+		if(ptrie_insert(pt, keys, len, (void *)(unsigned long)(i + 1)) < 0)
+			return 1;
+	}
+	if(ptrie_pack(pt) < 0)
+		return 1;
+	t_pins = now() - t0;
+
+	for(i = 0; i < nlookup; i++) {
+		len = 1 + rand() % MAX_LEN;
+		rand_key(keys + i * (MAX_LEN + 1), len, branches);
+		keys[i * (MAX_LEN + 1) + len] = '\0';
+	}
+
+	t0 = now();
+	for(i = 0; i < nlookup; i++) {
+		rd = dtrie_longest_match(dt, keys + i * (MAX_LEN + 1),
+				strlen(keys + i * (MAX_LEN + 1)), NULL, branches);
+		if(rd)
+			sum_d += (unsigned long)*rd;
+	}
+	t_dlook = now() - t0;
+
+	t0 = now();
+	for(i = 0; i < nlookup; i++) {
+		rp = ptrie_longest_match(pt, keys + i * (MAX_LEN + 1),
+				strlen(keys + i * (MAX_LEN + 1)), NULL);
+		if(rp)
+			sum_p += (unsigned long)*rp;
+	}
+	t_plook = now() - t0;
+
+	for(i = 0; i < nlookup; i++) {
+		len = strlen(keys + i * (MAX_LEN + 1));
+		rd = dtrie_longest_match(
+				dt, keys + i * (MAX_LEN + 1), len, &nd, branches);
+		rp = ptrie_longest_match(pt, keys + i * (MAX_LEN + 1), len, &np);
+		if(nd != np || (rd == NULL) != (rp == NULL) || (rd && *rd != *rp)) {
+			if(errors++ < 10)
+				fprintf(stderr, "mismatch for %s: %d/%d\n",
+						keys + i * (MAX_LEN + 1), nd, np);
+		}
+	}
+	n = 0;
+	ptrie_walk(pt, count_walk, &n, 0);
+	if(n != dtrie_loaded_nodes(dt, branches)
+			|| n != ptrie_loaded_nodes(pt)) {
+		fprintf(stderr, "walk found %u nodes with data, expected %u\n", n,
+				dtrie_loaded_nodes(dt, branches));
+		errors++;
+	}
+
+	printf("prefixes %u, lookups %u, branches %u\n", nprefix, nlookup,
+			branches);
+	printf("dtrie: %u nodes, %lu bytes in %lu chunks\n",
+			dtrie_size(dt, branches), dmem, dchunks);
+	printf("ptrie: %u nodes, %lu bytes in %lu chunks\n", ptrie_size(pt),
+			mem_used - dmem, mem_chunks - dchunks);
+	printf("insert: dtrie %.3fs, ptrie %.3fs\n", t_dins, t_pins);
+	printf("lookup: dtrie %.1fns, ptrie %.1fns per number\n",
+			t_dlook * 1e9 / nlookup, t_plook * 1e9 / nlookup);
+
+	t0 = now();
+	dtrie_destroy(&dt, NULL, branches);
+	t_dfree = now() - t0;
+	t0 = now();
+	ptrie_destroy(&pt, NULL);
+	t_pfree = now() - t0;
+	printf("destroy: dtrie %.3fs, ptrie %.3fs\n", t_dfree, t_pfree);
+
+	if(sum_d != sum_p || mem_used != 0 || mem_chunks != 0)
+		errors++;
+	free(keys);
+	if(errors) {
+		printf("%u errors\n", errors);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
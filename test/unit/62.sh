@@ -0,0 +1,64 @@
+#!/bin/sh
+# compares the results of the cfg expressions compiled to bytecode and interpreted
+#
+# Copyright (C) 2026 kamailio.org
+#
+# This file is part of Kamailio, a free SIP server.
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Kamailio is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version
+#
+# Kamailio is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+. include/common
+. include/require.sh
+
+CFGFILE=62.cfg
+TMPFILE=$(mktemp -t kamailio-test.XXXXXXXXXX)
+SIPSAKOPTS="-H localhost -s sip:127.0.0.1:5060 -v"
+
+if ! (check_sipsak && check_kamailio && check_module "sl" && check_module "pv"); then
+	rm ${TMPFILE}
+	exit 0
+fi
+
+# run_case <defines> <X-A> <X-B> <X-C> <X-N> <X-S>: prints the reply reason
+run_case() {
+	${BIN} -L $MOD_DIR -Y $RUN_DIR -P $PIDFILE -w . -f ${CFGFILE} $1 > /dev/null
+	if [ $? -ne 0 ] ; then
+		echo "failed to start with '$1'"
+		return 1
+	fi
+	sleep 1
+	sipsak ${SIPSAKOPTS} --headers "X-A: $2\nX-B: $3\nX-C: $4\nX-N: $5\nX-S: $6\n" > ${TMPFILE}
+	kill_kamailio
+	sleep 1
+	grep "^SIP/2.0 200 " ${TMPFILE} | head -n 1
+}
+
+ret=0
+for values in "5 2 1 0x1f -3" "0 0 0 0 0" "-7 3 200 30 -1" "1 1 -5 0x20 12" ; do
+	set -- ${values}
+	INTERP=$(run_case "" $@)
+	BYTECODE=$(run_case "-A WITH_BYTECODE" $@)
+	if [ -z "${INTERP}" ] || [ "${INTERP}" != "${BYTECODE}" ] ; then
+		echo "results differ for '${values}':"
+		echo "  interpreted: ${INTERP}"
+		echo "  compiled:    ${BYTECODE}"
+		ret=1
+	fi
+done
+
+rm ${TMPFILE}
+exit ${ret}
@@ -0,0 +1,78 @@
+#!/bin/sh
+# runs the unit test configs with the expressions compiled and checked against the interpreter
+#
+# Copyright (C) 2026 kamailio.org
+#
+# This file is part of Kamailio, a free SIP server.
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Kamailio is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version
+#
+# Kamailio is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+. include/common
+. include/require.sh
+
+TMPCFG=$(mktemp ./kamailio-test-63.XXXXXXXXXX)
+TMPLOG=$(mktemp -t kamailio-test.XXXXXXXXXX)
+TMPFILE=$(mktemp -t kamailio-test.XXXXXXXXXX)
+SIPSAKOPTS="-H localhost -s sip:127.0.0.1:5060 -v"
+
+cleanup() {
+	rm -f ${TMPCFG} ${TMPLOG} ${TMPFILE}
+}
+
+if ! (check_sipsak && check_kamailio) ; then
+	cleanup
+	exit 0
+fi
+
+# run_cfg <cfg> <expr_bytecode>: prints the reply to an OPTIONS request,
+# nothing if the config does not start here (missing module, database, ...)
+run_cfg() {
+	echo "expr_bytecode=$2" | cat - $1 > ${TMPCFG}
+	${BIN} -L $MOD_DIR -Y $RUN_DIR -P $PIDFILE -w . -E -f ${TMPCFG} \
+		> /dev/null 2> ${TMPLOG}
+	if [ $? -ne 0 ] ; then
+		return 0
+	fi
+	sleep 1
+	sipsak ${SIPSAKOPTS} > ${TMPFILE} 2>&1
+	kill_kamailio
+	sleep 1
+	grep "^SIP/2.0 " ${TMPFILE} | head -n 1
+}
+
+ret=0
+for CFG in *.cfg ; do
+	if [ "${CFG}" = "route-empty.cfg" ] ; then
+		continue
+	fi
+	INTERP=$(run_cfg ${CFG} 0)
+	BYTECODE=$(run_cfg ${CFG} 2)
+	# mismatches found by the check of expr_bytecode=2
+	if grep "compiled expression" ${TMPLOG} ; then
+		echo "${CFG}: compiled expressions differ from the interpreter"
+		ret=1
+	fi
+	if [ "${INTERP}" != "${BYTECODE}" ] ; then
+		echo "${CFG}: replies differ:"
+		echo "  interpreted: ${INTERP}"
+		echo "  compiled:    ${BYTECODE}"
+		ret=1
+	fi
+done
+
+cleanup
+exit ${ret}
@@ -0,0 +1,754 @@
+/*
+ * pfxdb - build and query memory mapped prefix databases
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * The files are read by the mtree, pdt and prefix_route modules, see
+ * src/core/utils/pfxdb.h for the format.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../src/core/utils/pfxdb.h"
+
+#define PFXDB_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+enum
+{
+	DUP_ERROR = 0,
+	DUP_MULTI,
+	DUP_IGNORE
+};
+
+typedef struct rec
+{
+	uint32_t table; /* offsets in the input buffer */
+	uint32_t prefix;
+	uint32_t value;
+	uint16_t tlen;
+	uint8_t plen;
+	uint8_t pad;
+	uint32_t vlen;
+	uint32_t seq;
+} rec_t;
+
+static char *buf = NULL;
+static size_t buf_len = 0;
+static size_t buf_size = 0;
+static rec_t *recs = NULL;
+static uint32_t nrecs = 0;
+static uint32_t recs_size = 0;
+
+static int verbose = 0;
+
+
+static void print_usage(char *program)
+{
+	printf("Usage: %s [<option>...] <command> [<param>...]\n", program);
+	printf("  %s [-t <table>] [-d <delim>] [-m|-i] -o <file> build [<input>]\n",
+			program);
+	printf("  %s [-t <table>] -f <file> query <key>...\n", program);
+	printf("  %s -f <file> info\n", program);
+	printf("\n");
+	printf("  Commands:\n");
+	printf("    build: Build a pfxdb file from a text input (default stdin).\n");
+	printf("           Line format: <table><delim><prefix><delim><value>\n");
+	printf("           or <prefix><delim><value> when -t is given.\n");
+	printf("           Empty lines and lines starting with '#' are skipped.\n");
+	printf("           The file is written under a temporary name and\n");
+	printf("           renamed when complete.\n");
+	printf("    query: Print the values of the prefixes matching the keys.\n");
+	printf("    info:  Print the tables of a pfxdb file.\n");
+	printf("\n");
+	printf("  Options:\n");
+	printf("    -o <file>: Output pfxdb file.\n");
+	printf("    -f <file>: Input pfxdb file.\n");
+	printf("    -t <table>: Table name.\n");
+	printf("    -d <delim>: Field delimiter (default tab).\n");
+	printf("    -m: Keep all values of a prefix found more than once,\n");
+	printf("        in input order.\n");
+	printf("    -i: Keep only the first value of a prefix found more than\n");
+	printf("        once. By default a duplicate prefix is an error.\n");
+	printf("    -v: Verbose.\n");
+	printf("    -h: Print this help.\n");
+}
+
+
+static int buf_add(char *s, size_t len, uint32_t *off)
+{
+	char *nbuf;
+	size_t nsize;
+
+	if(buf_len + len + 1 > buf_size) {
+		nsize = (buf_size == 0) ? (1 << 20) : 2 * buf_size;
+		while(nsize < buf_len + len + 1)
+			nsize *= 2;
+		if(nsize > UINT32_MAX) {
+			fprintf(stderr, "input too large\n");
+			return -1;
+		}
+		nbuf = realloc(buf, nsize);
+		if(nbuf == NULL) {
+			fprintf(stderr, "out of memory\n");
+			return -1;
+		}
+		buf = nbuf;
+		buf_size = nsize;
+	}
+	memcpy(buf + buf_len, s, len);
+	buf[buf_len + len] = '\0';
+	*off = buf_len;
+	buf_len += len + 1;
+	return 0;
+}
+
+
+static int read_input(FILE *f, char *table, char delim)
+{
+	char *line = NULL;
+	size_t lsize = 0;
+	ssize_t n;
+	char *fld[3];
+	size_t flen[3];
+	int nf, i, lineno;
+	char *p, *q;
+	rec_t *r;
+	uint32_t tname = 0;
+
+	if(table && buf_add(table, strlen(table), &tname) < 0)
+		return -1;
+
+	lineno = 0;
+	while((n = getline(&line, &lsize, f)) >= 0) {
+		lineno++;
+		while(n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+			line[--n] = '\0';
+		if(n == 0 || line[0] == '#')
+			continue;
+		nf = (table) ? 2 : 3;
+		p = line;
+		for(i = 0; i < nf; i++) {
+			q = (i < nf - 1) ? strchr(p, delim) : NULL;
+			fld[i] = p;
+			flen[i] = (q) ? (size_t)(q - p) : strlen(p);
+			if(i < nf - 1 && q == NULL) {
+				fprintf(stderr, "line %d: expected %d fields\n", lineno, nf);
+				goto error;
+			}
+			if(q)
+				p = q + 1;
+		}
+		if(table) {
+			fld[2] = fld[1];
+			flen[2] = flen[1];
+			fld[1] = fld[0];
+			flen[1] = flen[0];
+		}
+		if(flen[1] == 0 || flen[1] > PFXDB_MAX_DEPTH) {
+			fprintf(stderr, "line %d: bad prefix length %zu\n", lineno,
+					flen[1]);
+			goto error;
+		}
+		if(!table && (flen[0] == 0 || flen[0] > UINT16_MAX)) {
+			fprintf(stderr, "line %d: bad table name\n", lineno);
+			goto error;
+		}
+		if(nrecs == recs_size) {
+			recs_size = (recs_size == 0) ? 65536 : 2 * recs_size;
+			r = realloc(recs, recs_size * sizeof(rec_t));
+			if(r == NULL) {
+				fprintf(stderr, "out of memory\n");
+				goto error;
+			}
+			recs = r;
+		}
+		r = &recs[nrecs];
+		memset(r, 0, sizeof(rec_t));
+		if(table) {
+			r->table = tname;
+			r->tlen = strlen(table);
+		} else {
+			if(buf_add(fld[0], flen[0], &r->table) < 0)
+				goto error;
+			r->tlen = flen[0];
+		}
+		if(buf_add(fld[1], flen[1], &r->prefix) < 0
+				|| buf_add(fld[2], flen[2], &r->value) < 0)
+			goto error;
+		r->plen = flen[1];
+		r->vlen = flen[2];
+		r->seq = nrecs;
+		nrecs++;
+	}
+	free(line);
+	return 0;
+
+error:
+	free(line);
+	return -1;
+}
+
+
+static int rec_cmp_table(const rec_t *r1, const rec_t *r2)
+{
+	int ret;
+
+	ret = memcmp(buf + r1->table, buf + r2->table,
+			(r1->tlen < r2->tlen) ? r1->tlen : r2->tlen);
+	if(ret != 0)
+		return ret;
+	return (r1->tlen < r2->tlen) ? -1 : (r1->tlen > r2->tlen);
+}
+
+static int rec_cmp(const void *v1, const void *v2)
+{
+	const rec_t *r1 = (const rec_t *)v1;
+	const rec_t *r2 = (const rec_t *)v2;
+	int ret;
+
+	ret = rec_cmp_table(r1, r2);
+	if(ret != 0)
+		return ret;
+	ret = memcmp(buf + r1->prefix, buf + r2->prefix,
+			(r1->plen < r2->plen) ? r1->plen : r2->plen);
+	if(ret != 0)
+		return ret;
+	if(r1->plen != r2->plen)
+		return (r1->plen < r2->plen) ? -1 : 1;
+	return (r1->seq < r2->seq) ? -1 : (r1->seq > r2->seq);
+}
+
+static int rec_same_prefix(rec_t *r1, rec_t *r2)
+{
+	return rec_cmp_table(r1, r2) == 0 && r1->plen == r2->plen
+		   && memcmp(buf + r1->prefix, buf + r2->prefix, r1->plen) == 0;
+}
+
+static uint32_t hash_str(char *s, uint32_t len)
+{
+	uint32_t h = 2166136261u;
+	uint32_t i;
+
+	for(i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+static int build(char *output, int dupmode)
+{
+	pfxdb_hdr_t hdr;
+	pfxdb_table_t *tables = NULL;
+	pfxdb_node_t *nodes = NULL;
+	uint32_t *refs = NULL, *vid = NULL, *htable = NULL, *uniq = NULL;
+	ksr_pfxtree_key_t *keys = NULL;
+	pfxdb_val_t *vals = NULL;
+	uint32_t i, j, k, m, n, t, h, hsize, nvals, ntables, nnodes, base;
+	uint32_t tnodes, nref;
+	uint64_t strs_size, off;
+	char *tmpname = NULL;
+	char *map = NULL;
+	int fd = -1;
+
+	qsort(recs, nrecs, sizeof(rec_t), rec_cmp);
+
+	/* duplicates */
+	m = 0;
+	for(i = 0; i < nrecs; i = j) {
+		for(j = i + 1; j < nrecs && rec_same_prefix(&recs[i], &recs[j]); j++)
+			;
+		if(j - i > 1) {
+			if(dupmode == DUP_ERROR) {
+				fprintf(stderr, "duplicate prefix [%.*s] in table [%.*s]\n",
+						recs[i].plen, buf + recs[i].prefix, recs[i].tlen,
+						buf + recs[i].table);
+				return -1;
+			}
+			if(dupmode == DUP_IGNORE) {
+				if(verbose)
+					fprintf(stderr, "ignoring duplicates of [%.*s]\n",
+							recs[i].plen, buf + recs[i].prefix);
+				recs[m++] = recs[i];
+				continue;
+			}
+		}
+		for(k = i; k < j; k++)
+			recs[m++] = recs[k];
+	}
+	n = m;
+
+	/* distinct values and tables, the string pool holds the table names
+	 * followed by the values */
+	for(hsize = 16; hsize < n; hsize <<= 1)
+		;
+	vid = malloc(n * sizeof(uint32_t) + 1);
+	uniq = malloc(n * sizeof(uint32_t) + 1);
+	htable = calloc(hsize, sizeof(uint32_t));
+	if(vid == NULL || uniq == NULL || htable == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto error;
+	}
+	ntables = 0;
+	strs_size = 0;
+	for(i = 0; i < n; i++) {
+		if(i == 0 || rec_cmp_table(&recs[i - 1], &recs[i]) != 0) {
+			ntables++;
+			strs_size += recs[i].tlen + 1;
+		}
+	}
+	nvals = 0;
+	for(i = 0; i < n; i++) {
+		h = hash_str(buf + recs[i].value, recs[i].vlen) & (hsize - 1);
+		while(htable[h] != 0) {
+			k = uniq[htable[h] - 1];
+			if(recs[k].vlen == recs[i].vlen
+					&& memcmp(buf + recs[k].value, buf + recs[i].value,
+							   recs[i].vlen)
+							   == 0)
+				break;
+			h = (h + 1) & (hsize - 1);
+		}
+		if(htable[h] == 0) {
+			uniq[nvals] = i;
+			htable[h] = ++nvals;
+			strs_size += recs[i].vlen + 1;
+		}
+		vid[i] = htable[h] - 1;
+	}
+	if(strs_size > UINT32_MAX) {
+		fprintf(stderr, "string pool too large\n");
+		goto error;
+	}
+
+	/* nodes: one tree per table */
+	keys = malloc(n * sizeof(ksr_pfxtree_key_t) + 1);
+	if(keys == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto error;
+	}
+	for(i = 0; i < n; i++) {
+		keys[i].s = (unsigned char *)buf + recs[i].prefix;
+		keys[i].len = recs[i].plen;
+	}
+	nnodes = 0;
+	for(i = 0; i < n; i = j) {
+		for(j = i + 1; j < n && rec_cmp_table(&recs[i], &recs[j]) == 0; j++)
+			;
+		nnodes += ksr_pfxtree_nodes(keys + i, j - i);
+	}
+
+	tables = calloc(ntables + 1, sizeof(pfxdb_table_t));
+	nodes = calloc(nnodes + 1, sizeof(pfxdb_node_t));
+	refs = malloc(n * sizeof(uint32_t) + 1);
+	vals = calloc(nvals + 1, sizeof(pfxdb_val_t));
+	if(tables == NULL || nodes == NULL || refs == NULL || vals == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto error;
+	}
+
+	/* the trees of the tables one after the other, the node and value
+	 * indexes of each tree being relative to its first node and value */
+	base = 0;
+	nref = 0;
+	t = 0;
+	for(i = 0; i < n; i = j) {
+		for(j = i + 1; j < n && rec_cmp_table(&recs[i], &recs[j]) == 0; j++)
+			;
+		tables[t].root = base;
+		tables[t].nrecs = j - i;
+		t++;
+		tnodes = ksr_pfxtree_nodes(keys + i, j - i);
+		if(ksr_pfxtree_fill(keys + i, j - i, nodes + base, tnodes, refs + nref)
+				< 0) {
+			fprintf(stderr, "node count mismatch\n");
+			goto error;
+		}
+		for(k = base; k < base + tnodes; k++) {
+			nodes[k].child += base;
+			nodes[k].values += nref;
+		}
+		for(k = nref; k < nref + (j - i); k++)
+			refs[k] = vid[i + refs[k]];
+		base += tnodes;
+		nref += j - i;
+	}
+	nodes[nnodes].values = nref;
+
+	/* file layout */
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PFXDB_MAGIC, PFXDB_MAGIC_LEN);
+	hdr.version = PFXDB_VERSION;
+	hdr.ntables = ntables;
+	hdr.nnodes = nnodes;
+	hdr.nrefs = nref;
+	hdr.nvals = nvals;
+	hdr.ctime = (uint64_t)time(NULL);
+	off = PFXDB_ALIGN(sizeof(hdr));
+	hdr.tables_off = off;
+	off = PFXDB_ALIGN(off + ntables * sizeof(pfxdb_table_t));
+	hdr.nodes_off = off;
+	off = PFXDB_ALIGN(off + (uint64_t)(nnodes + 1) * sizeof(pfxdb_node_t));
+	hdr.refs_off = off;
+	off = PFXDB_ALIGN(off + (uint64_t)nref * sizeof(uint32_t));
+	hdr.vals_off = off;
+	off = PFXDB_ALIGN(off + (uint64_t)nvals * sizeof(pfxdb_val_t));
+	hdr.strs_off = off;
+	hdr.strs_size = strs_size;
+	hdr.size = PFXDB_ALIGN(off + strs_size);
+
+	if(asprintf(&tmpname, "%s.%d.tmp", output, (int)getpid()) < 0) {
+		fprintf(stderr, "out of memory\n");
+		goto error;
+	}
+	fd = open(tmpname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		fprintf(stderr, "cannot create %s: %s\n", tmpname, strerror(errno));
+		goto error;
+	}
+	if(ftruncate(fd, hdr.size) < 0) {
+		fprintf(stderr, "cannot resize %s: %s\n", tmpname, strerror(errno));
+		goto error;
+	}
+	map = mmap(NULL, hdr.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED) {
+		map = NULL;
+		fprintf(stderr, "cannot mmap %s: %s\n", tmpname, strerror(errno));
+		goto error;
+	}
+
+	/* string pool */
+	off = 0;
+	t = 0;
+	for(i = 0; i < n; i++) {
+		if(i == 0 || rec_cmp_table(&recs[i - 1], &recs[i]) != 0) {
+			memcpy(map + hdr.strs_off + off, buf + recs[i].table,
+					recs[i].tlen);
+			tables[t].name = off;
+			tables[t].namelen = recs[i].tlen;
+			off += recs[i].tlen + 1;
+			t++;
+		}
+	}
+	for(i = 0; i < nvals; i++) {
+		k = uniq[i];
+		memcpy(map + hdr.strs_off + off, buf + recs[k].value, recs[k].vlen);
+		vals[i].off = off;
+		vals[i].len = recs[k].vlen;
+		off += recs[k].vlen + 1;
+	}
+
+	memcpy(map, &hdr, sizeof(hdr));
+	memcpy(map + hdr.tables_off, tables, ntables * sizeof(pfxdb_table_t));
+	memcpy(map + hdr.nodes_off, nodes, (nnodes + 1) * sizeof(pfxdb_node_t));
+	memcpy(map + hdr.refs_off, refs, nref * sizeof(uint32_t));
+	memcpy(map + hdr.vals_off, vals, nvals * sizeof(pfxdb_val_t));
+
+	if(msync(map, hdr.size, MS_SYNC) < 0 || fsync(fd) < 0) {
+		fprintf(stderr, "cannot write %s: %s\n", tmpname, strerror(errno));
+		goto error;
+	}
+	munmap(map, hdr.size);
+	map = NULL;
+	close(fd);
+	fd = -1;
+	if(rename(tmpname, output) < 0) {
+		fprintf(stderr, "cannot rename %s to %s: %s\n", tmpname, output,
+				strerror(errno));
+		goto error;
+	}
+
+	printf("%s: %u tables, %u records, %u nodes, %u distinct values, "
+		   "%llu bytes\n",
+			output, ntables, nref, nnodes, nvals,
+			(unsigned long long)hdr.size);
+
+	free(tmpname);
+	free(tables);
+	free(nodes);
+	free(refs);
+	free(vals);
+	free(keys);
+	free(vid);
+	free(uniq);
+	free(htable);
+	return 0;
+
+error:
+	if(map)
+		munmap(map, hdr.size);
+	if(fd >= 0) {
+		close(fd);
+		unlink(tmpname);
+	}
+	free(tmpname);
+	free(tables);
+	free(nodes);
+	free(refs);
+	free(vals);
+	free(keys);
+	free(vid);
+	free(uniq);
+	free(htable);
+	return -1;
+}
+
+
+static char *map_file(char *file, size_t *size)
+{
+	struct stat st;
+	char *map;
+	int fd;
+	pfxdb_hdr_t *hdr;
+
+	fd = open(file, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "cannot open %s: %s\n", file, strerror(errno));
+		if(fd >= 0)
+			close(fd);
+		return NULL;
+	}
+	if(st.st_size < (off_t)sizeof(pfxdb_hdr_t)) {
+		fprintf(stderr, "%s: file too small\n", file);
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		fprintf(stderr, "cannot mmap %s: %s\n", file, strerror(errno));
+		return NULL;
+	}
+	hdr = (pfxdb_hdr_t *)map;
+	if(memcmp(hdr->magic, PFXDB_MAGIC, PFXDB_MAGIC_LEN) != 0
+			|| hdr->version != PFXDB_VERSION
+			|| hdr->size != (uint64_t)st.st_size) {
+		fprintf(stderr, "%s: not a valid pfxdb file\n", file);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	*size = st.st_size;
+	return map;
+}
+
+
+static int info(char *file)
+{
+	pfxdb_hdr_t *hdr;
+	pfxdb_table_t *tables;
+	char *map;
+	size_t size;
+	time_t ct;
+	uint32_t i;
+
+	map = map_file(file, &size);
+	if(map == NULL)
+		return -1;
+	hdr = (pfxdb_hdr_t *)map;
+	tables = (pfxdb_table_t *)(map + hdr->tables_off);
+	ct = (time_t)hdr->ctime;
+	printf("file: %s\n", file);
+	printf("created: %s", ctime(&ct));
+	printf("size: %llu\n", (unsigned long long)hdr->size);
+	printf("nodes: %u\n", hdr->nnodes);
+	printf("records: %u\n", hdr->nrefs);
+	printf("distinct values: %u\n", hdr->nvals);
+	printf("tables: %u\n", hdr->ntables);
+	for(i = 0; i < hdr->ntables; i++) {
+		printf("  [%.*s] %u records\n", (int)tables[i].namelen,
+				map + hdr->strs_off + tables[i].name, tables[i].nrecs);
+	}
+	munmap(map, size);
+	return 0;
+}
+
+
+static int query(char *file, char *table, int argc, char **argv)
+{
+	pfxdb_hdr_t *hdr;
+	pfxdb_table_t *tables;
+	pfxdb_node_t *nodes, *node, *child;
+	uint32_t *refs;
+	pfxdb_val_t *vals;
+	char *map, *strs, *key;
+	size_t size;
+	uint32_t i, t, l;
+	int a, found;
+
+	map = map_file(file, &size);
+	if(map == NULL)
+		return -1;
+	hdr = (pfxdb_hdr_t *)map;
+	tables = (pfxdb_table_t *)(map + hdr->tables_off);
+	nodes = (pfxdb_node_t *)(map + hdr->nodes_off);
+	refs = (uint32_t *)(map + hdr->refs_off);
+	vals = (pfxdb_val_t *)(map + hdr->vals_off);
+	strs = map + hdr->strs_off;
+
+	for(t = 0; t < hdr->ntables; t++) {
+		if(tables[t].namelen == (table ? strlen(table) : 0)
+				&& (table == NULL
+						|| memcmp(strs + tables[t].name, table,
+								   tables[t].namelen)
+								   == 0))
+			break;
+	}
+	if(t == hdr->ntables) {
+		if(hdr->ntables == 1 && table == NULL) {
+			t = 0;
+		} else {
+			fprintf(stderr, "table not found\n");
+			munmap(map, size);
+			return -1;
+		}
+	}
+
+	for(a = 0; a < argc; a++) {
+		key = argv[a];
+		node = &nodes[tables[t].root];
+		found = 0;
+		for(l = 0;; l++) {
+			for(i = node->values; i < node[1].values; i++) {
+				printf("%s: [%.*s] [%.*s]\n", key, (int)node->depth, key,
+						(int)vals[refs[i]].len, strs + vals[refs[i]].off);
+				found = 1;
+			}
+			if(key[l] == '\0')
+				break;
+			child = ksr_pfxtree_child(nodes, node, (unsigned char)key[l]);
+			if(child == NULL)
+				break;
+			node = child;
+		}
+		if(!found)
+			printf("%s: no match\n", key);
+	}
+
+	munmap(map, size);
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	char *output = NULL;
+	char *file = NULL;
+	char *table = NULL;
+	char delim = '\t';
+	int dupmode = DUP_ERROR;
+	FILE *in;
+	int opt, ret;
+
+	while((opt = getopt(argc, argv, "o:f:t:d:mivh")) != -1) {
+		switch(opt) {
+			case 'o':
+				output = optarg;
+				break;
+			case 'f':
+				file = optarg;
+				break;
+			case 't':
+				table = optarg;
+				break;
+			case 'd':
+				if(strlen(optarg) != 1) {
+					fprintf(stderr, "delimiter must be one char\n");
+					return 1;
+				}
+				delim = optarg[0];
+				break;
+			case 'm':
+				dupmode = DUP_MULTI;
+				break;
+			case 'i':
+				dupmode = DUP_IGNORE;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			case 'h':
+				print_usage(argv[0]);
+				return 0;
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(optind >= argc) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if(strcmp(argv[optind], "build") == 0) {
+		if(output == NULL) {
+			fprintf(stderr, "no output file\n");
+			return 1;
+		}
+		if(optind + 1 < argc && strcmp(argv[optind + 1], "-") != 0) {
+			in = fopen(argv[optind + 1], "r");
+			if(in == NULL) {
+				fprintf(stderr, "cannot open %s: %s\n", argv[optind + 1],
+						strerror(errno));
+				return 1;
+			}
+		} else {
+			in = stdin;
+		}
+		ret = read_input(in, table, delim);
+		if(in != stdin)
+			fclose(in);
+		if(ret == 0)
+			ret = build(output, dupmode);
+	} else if(strcmp(argv[optind], "query") == 0) {
+		if(file == NULL) {
+			fprintf(stderr, "no pfxdb file\n");
+			return 1;
+		}
+		ret = query(file, table, argc - optind - 1, argv + optind + 1);
+	} else if(strcmp(argv[optind], "info") == 0) {
+		if(file == NULL) {
+			fprintf(stderr, "no pfxdb file\n");
+			return 1;
+		}
+		ret = info(file);
+	} else {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	free(recs);
+	free(buf);
+	return (ret == 0) ? 0 : 1;
+}